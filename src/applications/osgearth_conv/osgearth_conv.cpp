@@ -50,6 +50,7 @@ int usage(char** argv)
         << "\n    --max-level [int]                   : maximum level of detail"
         << "\n    --osg-options [OSG options string]  : options to pass to OSG readers/writers"
         << "\n    --extents [minLat] [minLong] [maxLat] [maxLong] : Lat/Long extends to copy"
+        << "\n    --threads [n]                       : number of threads reading and encoding tiles"
         << std::endl;
 
     return 0;
@@ -175,6 +176,10 @@ struct ProgressReporter : public osgEarth::ProgressCallback
  *      --max-level [int]     : max level of detail to copy
  *      --threads [n]         : threads to use (may crash. Careful.)
  *
+ * For large conversions to MBTiles, add "--out bulk_write true" so that
+ * the threads only read and encode tiles while a single writer commits
+ * them in large transactions and stores duplicate tiles only once.
+ *
  *      --extents [minLat] [minLong] [maxLat] [maxLong] : Lat/Long extends to copy (*)
  *
  * OSG arguments:
@@ -395,6 +400,11 @@ main(int argc, char** argv)
 
     visitor->run( outputProfile.get() );
 
+    // Release the output so it can flush any buffered writes (e.g. the MBTiles
+    // bulk_write mode) before we stop the clock.
+    visitor = 0L;
+    output = 0L;
+
     osg::Timer_t t1 = osg::Timer::instance()->tick();
 
     std::cout
@@ -0,0 +1,526 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#define LC "[osgearth_cullbench] "
+
+#include <osgEarth/Notify>
+#include <osgEarth/Map>
+#include <osgEarth/MapNode>
+#include <osgEarth/ImageLayer>
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/Registry>
+#include <osgEarth/TileSource>
+#include <osgEarthDrivers/debug/DebugOptions>
+#include <osgEarthDrivers/engine_rex/RexTerrainEngineOptions>
+#include <osgUtil/SceneView>
+#include <osgDB/DatabasePager>
+#include <osg/AnimationPath>
+#include <osg/ArgumentParser>
+#include <osg/CoordinateSystemNode>
+#include <osg/Stats>
+#include <osg/Timer>
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Thread>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <new>
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+
+#define WINDOW_WIDTH  1920
+#define WINDOW_HEIGHT 1080
+
+// documentation
+int usage(char** argv)
+{
+    std::cout
+        << "Measures the CPU cost of culling the Rex terrain along a camera path.\n"
+        << "Runs headless (no graphics context is needed) over a synthetic map.\n"
+        << "Each frame first pages in the tiles it needs (untimed), then times\n"
+        << "cull-only traversals of the loaded terrain.\n\n"
+        << argv[0]
+        << "\n    --path [file]                       : camera path to replay (osg::AnimationPath format, e.g. recorded"
+        << "\n                                          in osgviewer with 'z'); default is a synthetic descent"
+        << "\n    --save-path [file]                  : write the camera path to a file and continue"
+        << "\n    --frames [int]                      : frames to sample along the path (default = 100)"
+        << "\n    --repeat [int]                      : cull traversals timed per frame (default = 5)"
+        << "\n    --views [int]                       : views culled per frame, spread around the heading (default = 1)"
+        << "\n    --no-elevation                      : leave the synthetic elevation layer out of the map"
+        << "\n    --max-load-frames [int]             : limit on paging frames spent loading each frame (default = 2000)"
+        << std::endl;
+
+    return 0;
+}
+
+
+// Global allocation counter. Only counts while enabled, which is during the
+// timed cull traversals; paging is idle then, so the count is the cull's own.
+namespace
+{
+    OpenThreads::Atomic s_allocations;
+    volatile bool       s_countAllocations = false;
+}
+
+#if __cplusplus >= 201103L
+#define CULLBENCH_THROW_BAD_ALLOC
+#define CULLBENCH_NO_THROW noexcept
+#else
+#define CULLBENCH_THROW_BAD_ALLOC throw(std::bad_alloc)
+#define CULLBENCH_NO_THROW throw()
+#endif
+
+void* operator new(std::size_t size) CULLBENCH_THROW_BAD_ALLOC
+{
+    if (s_countAllocations)
+        ++s_allocations;
+    void* p = std::malloc(size > 0 ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size) CULLBENCH_THROW_BAD_ALLOC
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) CULLBENCH_NO_THROW
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) CULLBENCH_NO_THROW
+{
+    std::free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, std::size_t) CULLBENCH_NO_THROW
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) CULLBENCH_NO_THROW
+{
+    std::free(p);
+}
+#endif
+
+
+/**
+ * Synthetic elevation: a few octaves of sine waves, so every tile has relief
+ * and the terrain never runs out of data at high levels of detail.
+ */
+class SyntheticElevationSource : public TileSource
+{
+public:
+    SyntheticElevationSource() : TileSource(TileSourceOptions())
+    {
+        setPixelsPerTile(257u);
+    }
+
+    Status initialize(const osgDB::Options* dbOptions)
+    {
+        if ( !getProfile() )
+        {
+            setProfile( Registry::instance()->getGlobalGeodeticProfile() );
+        }
+        return STATUS_OK;
+    }
+
+    CachePolicy getCachePolicyHint(const Profile* profile) const
+    {
+        return CachePolicy::NO_CACHE;
+    }
+
+    osg::HeightField* createHeightField(const TileKey& key, ProgressCallback* progress)
+    {
+        int size = getPixelsPerTile();
+        const GeoExtent& extent = key.getExtent();
+        double dx = extent.width() / (double)(size-1);
+        double dy = extent.height() / (double)(size-1);
+
+        osg::HeightField* hf = new osg::HeightField();
+        hf->allocate(size, size);
+
+        for(int r = 0; r < size; ++r)
+        {
+            double lat = osg::DegreesToRadians(extent.yMin() + dy*(double)r);
+            for(int c = 0; c < size; ++c)
+            {
+                double lon = osg::DegreesToRadians(extent.xMin() + dx*(double)c);
+                double h =
+                    2500.0 * sin(3.0*lon) * cos(2.0*lat) +
+                     600.0 * sin(37.0*lon) * sin(41.0*lat) +
+                      60.0 * sin(611.0*lon) * cos(587.0*lat);
+                hf->setHeight(c, r, (float)h);
+            }
+        }
+        return hf;
+    }
+};
+
+
+/**
+ * Default camera path: a descent from orbit to low altitude that tilts
+ * toward the horizon on the way down, which exercises every LOD.
+ */
+osg::AnimationPath*
+createFlightPath(const osg::EllipsoidModel* em)
+{
+    osg::AnimationPath* path = new osg::AnimationPath();
+    const unsigned points = 61u;
+
+    for(unsigned i = 0; i < points; ++i)
+    {
+        double t = (double)i / (double)(points-1);
+        double lon = -120.0 + 40.0*t;
+        double lat =   25.0 + 20.0*t;
+        double alt = exp(log(5.0e6)*(1.0-t) + log(1.0e3)*t);
+        double pitch = 75.0*t; // degrees from straight down
+        double heading = 45.0;
+
+        osg::Matrixd local2world;
+        em->computeLocalToWorldTransformFromLatLongHeight(
+            osg::DegreesToRadians(lat), osg::DegreesToRadians(lon), alt, local2world);
+
+        osg::Matrixd world =
+            osg::Matrixd::rotate(osg::DegreesToRadians(pitch), osg::X_AXIS) *
+            osg::Matrixd::rotate(osg::DegreesToRadians(-heading), osg::Z_AXIS) *
+            local2world;
+
+        path->insert((double)i, osg::AnimationPath::ControlPoint(world.getTrans(), world.getRotate()));
+    }
+
+    return path;
+}
+
+
+/**
+ * Runs the terrain headless: one SceneView per view, sharing the scene
+ * graph and a database pager.
+ */
+struct Bench
+{
+    std::vector< osg::ref_ptr<osgUtil::SceneView> > _views;
+    std::vector< osg::ref_ptr<osg::Stats> >         _stats;
+    osg::ref_ptr<osgDB::DatabasePager>             _pager;
+    osg::ref_ptr<osg::FrameStamp>                  _frameStamp;
+
+    Bench(osg::Node* scene, unsigned numViews)
+    {
+        _frameStamp = new osg::FrameStamp();
+        _frameStamp->setFrameNumber(0);
+
+        _pager = osgDB::DatabasePager::create();
+        _pager->setDoPreCompile(false);
+
+        for(unsigned i = 0; i < numViews; ++i)
+        {
+            // the terrain engine reports its cull results here
+            osg::Stats* stats = new osg::Stats("cullbench");
+            stats->collectStats("rex", true);
+            _stats.push_back(stats);
+
+            osgUtil::SceneView* sceneView = new osgUtil::SceneView();
+            sceneView->setDefaults();
+            sceneView->setFrameStamp(_frameStamp.get());
+            sceneView->setViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+            sceneView->setProjectionMatrixAsPerspective(30.0, (double)WINDOW_WIDTH/(double)WINDOW_HEIGHT, 1.0, 1.0e8);
+            sceneView->getCamera()->setStats(stats);
+            sceneView->setSceneData(scene);
+            _views.push_back(sceneView);
+        }
+    }
+
+    ~Bench()
+    {
+        _pager->cancel();
+        for(unsigned i = 0; i < _views.size(); ++i)
+            _views[i]->setSceneData(0L);
+    }
+
+    // Points view i of n at the camera matrix, turned about the camera's
+    // up axis so the views together look all around.
+    void setCamera(const osg::Matrixd& world)
+    {
+        for(unsigned i = 0; i < _views.size(); ++i)
+        {
+            double yaw = osg::PI*2.0*(double)i / (double)_views.size();
+            _views[i]->setViewMatrix(osg::Matrixd::inverse(osg::Matrixd::rotate(yaw, osg::Y_AXIS) * world));
+        }
+    }
+
+    void advance()
+    {
+        _frameStamp->setFrameNumber(_frameStamp->getFrameNumber()+1);
+        _frameStamp->setReferenceTime(osg::Timer::instance()->time_s());
+        _frameStamp->setSimulationTime(_frameStamp->getReferenceTime());
+    }
+
+    // One full frame with paging: merge what the pager loaded, update, cull.
+    void page()
+    {
+        advance();
+        _pager->signalBeginFrame(_frameStamp.get());
+        _pager->updateSceneGraph(*_frameStamp.get());
+        _views[0]->update();
+        for(unsigned i = 0; i < _views.size(); ++i)
+        {
+            _views[i]->getCullVisitor()->setDatabaseRequestHandler(_pager.get());
+            _views[i]->cull();
+        }
+        _pager->signalEndFrame();
+    }
+
+    // Pages frames until the terrain stops changing and the pager is idle.
+    // Returns the number of frames it took.
+    unsigned load(unsigned maxFrames)
+    {
+        double lastCommands = -1.0, lastTiles = -1.0;
+        unsigned stable = 0u, frames = 0u;
+        while(frames < maxFrames && stable < 10u)
+        {
+            page();
+            ++frames;
+
+            double commands = 0.0, tiles = 0.0;
+            getResults(commands, tiles);
+            bool busy = _pager->getRequestsInProgress() || _pager->requiresUpdateSceneGraph();
+            if (!busy && commands == lastCommands && tiles == lastTiles)
+                ++stable;
+            else
+                stable = 0u;
+            lastCommands = commands;
+            lastTiles = tiles;
+
+            if (busy)
+                OpenThreads::Thread::microSleep(1000);
+        }
+        return frames;
+    }
+
+    // Cull-only traversal of all views (no paging); returns time in ms.
+    double cull(unsigned& allocations)
+    {
+        advance();
+        for(unsigned i = 0; i < _views.size(); ++i)
+            _views[i]->getCullVisitor()->setDatabaseRequestHandler(0L);
+
+        unsigned before = s_allocations;
+        s_countAllocations = true;
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned i = 0; i < _views.size(); ++i)
+        {
+            _views[i]->cull();
+        }
+        double t = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+        s_countAllocations = false;
+        allocations = (unsigned)s_allocations - before;
+        return t;
+    }
+
+    // Draw commands and live tiles the terrain reported for the last frame
+    // (draw commands summed over the views).
+    void getResults(double& commands, double& tiles) const
+    {
+        commands = 0.0;
+        tiles = 0.0;
+        unsigned frame = _frameStamp->getFrameNumber();
+        for(unsigned i = 0; i < _stats.size(); ++i)
+        {
+            double value;
+            if (_stats[i]->getAttribute(frame, "Rex draw commands", value))
+                commands += value;
+            if (_stats[i]->getAttribute(frame, "Rex live tiles", value))
+                tiles = value;
+        }
+    }
+};
+
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser args(&argc,argv);
+
+    if ( args.read("--help") )
+        return usage(argv);
+
+    std::string pathFile;
+    args.read("--path", pathFile);
+
+    std::string savePathFile;
+    args.read("--save-path", savePathFile);
+
+    unsigned frames = 100u;
+    args.read("--frames", frames);
+    frames = osg::maximum(frames, 1u);
+
+    unsigned repeat = 5u;
+    args.read("--repeat", repeat);
+    repeat = osg::maximum(repeat, 1u);
+
+    unsigned numViews = 1u;
+    args.read("--views", numViews);
+    numViews = osg::maximum(numViews, 1u);
+
+    unsigned maxLoadFrames = 2000u;
+    args.read("--max-load-frames", maxLoadFrames);
+
+    bool elevation = !args.read("--no-elevation");
+
+    // camera path
+    osg::ref_ptr<osg::EllipsoidModel> em = new osg::EllipsoidModel();
+    osg::ref_ptr<osg::AnimationPath> path;
+    if ( !pathFile.empty() )
+    {
+        std::ifstream in(pathFile.c_str());
+        if ( !in.is_open() )
+        {
+            OE_WARN << LC << "Cannot read camera path " << pathFile << std::endl;
+            return -1;
+        }
+        path = new osg::AnimationPath();
+        path->read(in);
+        if ( path->empty() )
+        {
+            OE_WARN << LC << "Camera path " << pathFile << " is empty" << std::endl;
+            return -1;
+        }
+    }
+    else
+    {
+        path = createFlightPath(em.get());
+    }
+
+    if ( !savePathFile.empty() )
+    {
+        std::ofstream out(savePathFile.c_str());
+        path->write(out);
+    }
+
+    // synthetic map: debug imagery, and elevation unless disabled
+    MapOptions mapOptions;
+    mapOptions.cachePolicy() = CachePolicy::NO_CACHE;
+    osg::ref_ptr<Map> map = new Map(mapOptions);
+
+    map->addLayer(new ImageLayer("debug", DebugOptions()));
+
+    if ( elevation )
+    {
+        SyntheticElevationSource* source = new SyntheticElevationSource();
+        source->open();
+        map->addLayer(new ElevationLayer(ElevationLayerOptions("synthetic"), source));
+    }
+
+    // Rex, keeping every tile it loads so the timed passes see the same terrain
+    RexTerrainEngine::RexTerrainEngineOptions terrainOptions;
+    terrainOptions.expirationThreshold() = 1000000u;
+    MapNodeOptions mapNodeOptions;
+    mapNodeOptions.setTerrainOptions(terrainOptions);
+    osg::ref_ptr<MapNode> mapNode = new MapNode(map.get(), mapNodeOptions);
+
+    Bench bench(mapNode.get(), numViews);
+
+    std::cout
+        << "Window " << WINDOW_WIDTH << "x" << WINDOW_HEIGHT << ", "
+        << numViews << (numViews > 1 ? " views, " : " view, ")
+        << frames << " frames, " << repeat << " culls per frame" << std::endl
+        << std::setw(8)  << "frame"
+        << std::setw(12) << "load frames"
+        << std::setw(12) << "cull ms"
+        << std::setw(12) << "min ms"
+        << std::setw(14) << "draw cmds"
+        << std::setw(12) << "live tiles"
+        << std::setw(14) << "allocs/cull" << std::endl;
+
+    std::vector<double> cullTimes;
+    double totalAllocs = 0.0;
+    double firstTime = path->getFirstTime();
+    double duration = path->getLastTime() - firstTime;
+
+    for(unsigned f = 0; f < frames; ++f)
+    {
+        double t = frames > 1 ? firstTime + duration*(double)f/(double)(frames-1) : firstTime;
+        osg::Matrixd world;
+        path->getMatrix(t, world);
+        bench.setCamera(world);
+
+        unsigned loadFrames = bench.load(maxLoadFrames);
+
+        // first cull after paging merges state, so don't count it
+        unsigned allocations;
+        bench.cull(allocations);
+
+        double sum = 0.0, best = DBL_MAX;
+        unsigned allocSum = 0u;
+        for(unsigned r = 0; r < repeat; ++r)
+        {
+            double ms = bench.cull(allocations);
+            sum += ms;
+            best = osg::minimum(best, ms);
+            allocSum += allocations;
+        }
+
+        double commands, tiles;
+        bench.getResults(commands, tiles);
+
+        double mean = sum / (double)repeat;
+        double allocs = (double)allocSum / (double)repeat;
+        cullTimes.push_back(mean);
+        totalAllocs += allocs;
+
+        std::cout
+            << std::setw(8) << f
+            << std::setw(12) << loadFrames
+            << std::fixed
+            << std::setw(12) << std::setprecision(3) << mean
+            << std::setw(12) << std::setprecision(3) << best
+            << std::setw(14) << std::setprecision(0) << commands
+            << std::setw(12) << std::setprecision(0) << tiles
+            << std::setw(14) << std::setprecision(0) << allocs
+            << std::endl;
+    }
+
+    std::vector<double> sorted(cullTimes);
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.0;
+    for(unsigned i = 0; i < sorted.size(); ++i)
+        total += sorted[i];
+
+    std::cout
+        << std::fixed << std::setprecision(3)
+        << "Cull ms: mean " << total / (double)sorted.size()
+        << ", median " << sorted[sorted.size()/2]
+        << ", p95 " << sorted[std::min(sorted.size()-1, (sorted.size()*95)/100)]
+        << ", max " << sorted.back()
+        << std::setprecision(0)
+        << "; allocations per cull: mean " << totalAllocs / (double)sorted.size()
+        << std::endl;
+
+    return 0;
+}
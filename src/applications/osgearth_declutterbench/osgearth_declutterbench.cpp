@@ -0,0 +1,190 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#define LC "[osgearth_declutterbench] "
+
+#include <osgEarth/Notify>
+#include <osgEarth/Random>
+#include <osgEarth/ScreenSpaceLayout>
+#include <osgUtil/SceneView>
+#include <osg/ArgumentParser>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/MatrixTransform>
+#include <osg/Timer>
+#include <iomanip>
+
+using namespace osgEarth;
+
+#define WINDOW_WIDTH  1920
+#define WINDOW_HEIGHT 1080
+
+// documentation
+int usage(char** argv)
+{
+    std::cout
+        << "Measures the cull and declutter time of screen-space labels as the label count grows.\n"
+        << "Runs headless (no graphics context is needed).\n\n"
+        << argv[0]
+        << "\n    --min-labels [int]                  : smallest label count to test (default = 1000)"
+        << "\n    --max-labels [int]                  : largest label count to test (default = 64000)"
+        << "\n    --frames [int]                      : frames to average per test (default = 20)"
+        << std::endl;
+
+    return 0;
+}
+
+
+/**
+ * Builds a scene of synthetic labels: quads of typical label sizes (in
+ * pixels) at random points on a plane filling the view. Each label gets its
+ * own drawable and Geode, as real labels do, since the declutterer groups
+ * drawables by parent.
+ */
+osg::Node*
+createLabels(unsigned count, Random& random)
+{
+    // a few shared label shapes
+    std::vector< osg::ref_ptr<osg::Vec3Array> > shapes;
+    for(unsigned i = 0; i < 8; ++i)
+    {
+        float w = 30.0f + 20.0f*(float)i;
+        float h = 12.0f + 2.0f*(float)(i%4);
+        osg::Vec3Array* verts = new osg::Vec3Array();
+        verts->push_back(osg::Vec3(-0.5f*w, -0.5f*h, 0.0f));
+        verts->push_back(osg::Vec3( 0.5f*w, -0.5f*h, 0.0f));
+        verts->push_back(osg::Vec3( 0.5f*w,  0.5f*h, 0.0f));
+        verts->push_back(osg::Vec3(-0.5f*w,  0.5f*h, 0.0f));
+        shapes.push_back(verts);
+    }
+
+    osg::Group* root = new osg::Group();
+    ScreenSpaceLayout::activate(root->getOrCreateStateSet());
+
+    for(unsigned i = 0; i < count; ++i)
+    {
+        osg::Geometry* geom = new osg::Geometry();
+        geom->setUseVertexBufferObjects(true);
+        geom->setVertexArray(shapes[random.next(shapes.size())].get());
+        geom->addPrimitiveSet(new osg::DrawArrays(GL_QUADS, 0, 4));
+
+        osg::Geode* geode = new osg::Geode();
+        geode->addDrawable(geom);
+
+        // points on the plane z=0 that fall inside the view (see the camera setup)
+        osg::Vec3d point(
+            (random.next() - 0.5) * 1000.0 * WINDOW_WIDTH / WINDOW_HEIGHT,
+            (random.next() - 0.5) * 1000.0,
+            0.0);
+
+        osg::MatrixTransform* xform = new osg::MatrixTransform(osg::Matrix::translate(point));
+        xform->addChild(geode);
+        root->addChild(xform);
+    }
+
+    return root;
+}
+
+// average time (ms) of culling the scene, decluttering included
+double
+timeCull(osgUtil::SceneView* sceneView, unsigned frames)
+{
+    osg::FrameStamp* fs = sceneView->getFrameStamp();
+
+    // first frame allocates the render graph, so don't count it
+    fs->setFrameNumber(fs->getFrameNumber()+1);
+    sceneView->cull();
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned f = 0; f < frames; ++f)
+    {
+        fs->setFrameNumber(fs->getFrameNumber()+1);
+        sceneView->cull();
+    }
+    return osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) / (double)frames;
+}
+
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser args(&argc,argv);
+
+    if ( args.read("--help") )
+        return usage(argv);
+
+    unsigned minLabels = 1000u;
+    args.read("--min-labels", minLabels);
+
+    unsigned maxLabels = 64000u;
+    args.read("--max-labels", maxLabels);
+
+    unsigned frames = 20u;
+    args.read("--frames", frames);
+    frames = osg::maximum(frames, 1u);
+
+    // Headless scene view looking straight down at the label plane. At a
+    // 1000-unit range with a 53-degree field of view, the plane fills the
+    // window and one unit is about one pixel.
+    osg::ref_ptr<osgUtil::SceneView> sceneView = new osgUtil::SceneView();
+    sceneView->setDefaults();
+    sceneView->setFrameStamp(new osg::FrameStamp());
+    sceneView->setViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+    sceneView->setProjectionMatrixAsPerspective(53.13, (double)WINDOW_WIDTH/(double)WINDOW_HEIGHT, 1.0, 10000.0);
+    sceneView->setViewMatrixAsLookAt(osg::Vec3d(0, 0, 1000), osg::Vec3d(0, 0, 0), osg::Vec3d(0, 1, 0));
+    sceneView->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+    sceneView->setCullingMode(sceneView->getCullingMode() & ~osg::CullSettings::SMALL_FEATURE_CULLING);
+
+    std::cout
+        << "Window " << WINDOW_WIDTH << "x" << WINDOW_HEIGHT << ", " << frames << " frames per test" << std::endl
+        << std::setw(10) << "labels"
+        << std::setw(12) << "cull ms"
+        << std::setw(14) << "declutter ms"
+        << std::setw(12) << "total ms"
+        << std::setw(16) << "us per label" << std::endl;
+
+    Random random(0u);
+
+    for(unsigned count = osg::maximum(minLabels, 1u); count <= maxLabels; count *= 2u)
+    {
+        osg::ref_ptr<osg::Node> labels = createLabels(count, random);
+        sceneView->setSceneData(labels.get());
+
+        // cull alone, then cull plus declutter
+        ScreenSpaceLayout::setDeclutteringEnabled(false);
+        double cullTime = timeCull(sceneView.get(), frames);
+
+        ScreenSpaceLayout::setDeclutteringEnabled(true);
+        double totalTime = timeCull(sceneView.get(), frames);
+
+        std::cout
+            << std::setw(10) << count
+            << std::fixed
+            << std::setw(12) << std::setprecision(2) << cullTime
+            << std::setw(14) << std::setprecision(2) << osg::maximum(totalTime - cullTime, 0.0)
+            << std::setw(12) << std::setprecision(2) << totalTime
+            << std::setw(16) << std::setprecision(3) << 1000.0*totalTime/(double)count
+            << std::endl;
+    }
+
+    sceneView->setSceneData(0L);
+    return 0;
+}
@@ -0,0 +1,191 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#define LC "[osgearth_gdalbench] "
+
+#include <osgEarth/Notify>
+#include <osgEarth/Profile>
+#include <osgEarth/TileSource>
+#include <osgEarth/ThreadingUtils>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <OpenThreads/Atomic>
+#include <iomanip>
+
+using namespace osgEarth;
+
+// documentation
+int usage(char** argv)
+{
+    std::cout
+        << "Measures GDAL tile read throughput as the number of reader threads grows.\n\n"
+        << argv[0] << " file.tif"
+        << "\n    --level [int]                       : level of detail to read (default = 8)"
+        << "\n    --max-threads [int]                 : largest thread count to test (default = 16)"
+        << "\n    --max-tiles [int]                   : maximum number of tiles to read per run (default = 1024)"
+        << "\n    --serialized                        : read through a single locked dataset handle"
+        << "\n    --elevation                         : read heightfields (default is images)"
+        << std::endl;
+
+    return 0;
+}
+
+
+/**
+ * Thread that reads tiles from a shared work list until it runs out.
+ */
+struct ReaderThread : public OpenThreads::Thread
+{
+    ReaderThread(TileSource* source, const std::vector<TileKey>& keys, OpenThreads::Atomic& next, bool heightFields) :
+        _source(source), _keys(keys), _next(next), _heightFields(heightFields), _tilesRead(0u) { }
+
+    void run()
+    {
+        for(unsigned i = (++_next)-1u; i < _keys.size(); i = (++_next)-1u)
+        {
+            osg::ref_ptr<osg::Referenced> result;
+            if ( _heightFields )
+                result = _source->createHeightField(_keys[i]);
+            else
+                result = _source->createImage(_keys[i]);
+
+            if ( result.valid() )
+                ++_tilesRead;
+        }
+    }
+
+    TileSource*                  _source;
+    const std::vector<TileKey>&  _keys;
+    OpenThreads::Atomic&         _next;
+    bool                         _heightFields;
+    unsigned                     _tilesRead;
+};
+
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser args(&argc,argv);
+
+    if ( argc < 2 )
+        return usage(argv);
+
+    unsigned level = 8u;
+    args.read("--level", level);
+
+    unsigned maxThreads = 16u;
+    args.read("--max-threads", maxThreads);
+
+    unsigned maxTiles = 1024u;
+    args.read("--max-tiles", maxTiles);
+
+    bool serialized = args.read("--serialized");
+    bool heightFields = args.read("--elevation") || args.read("--hf");
+
+    std::string file = argv[1];
+
+    Config conf;
+    conf.set("driver", "gdal");
+    conf.set("url", file);
+    if ( serialized )
+        conf.set("max_concurrent_readers", 0u);
+    else
+        conf.set("max_concurrent_readers", maxThreads);
+
+    osg::ref_ptr<TileSource> source = TileSourceFactory::create(TileSourceOptions(conf));
+    if ( !source.valid() || source->open().isError() )
+    {
+        OE_WARN << LC << "Failed to open " << file << std::endl;
+        return -1;
+    }
+
+    // Collect the keys that intersect the data:
+    std::vector<TileKey> keys;
+    const DataExtentList& extents = source->getDataExtents();
+    for(DataExtentList::const_iterator i = extents.begin(); i != extents.end() && keys.size() < maxTiles; ++i)
+    {
+        std::vector<TileKey> extentKeys;
+        source->getProfile()->getIntersectingTiles(*i, level, extentKeys);
+        for(unsigned k = 0; k < extentKeys.size() && keys.size() < maxTiles; ++k)
+            keys.push_back(extentKeys[k]);
+    }
+
+    if ( keys.empty() )
+    {
+        OE_WARN << LC << "No tiles intersect the data at level " << level << std::endl;
+        return -1;
+    }
+
+    std::cout << "Reading " << keys.size() << (heightFields ? " heightfields" : " images")
+        << " at level " << level << " from " << file
+        << (serialized ? " (serialized)" : "") << std::endl
+        << std::setw(8) << "threads" << std::setw(12) << "seconds" << std::setw(12) << "tiles/s" << std::setw(10) << "speedup" << std::endl;
+
+    // Warm up the GDAL block cache and the driver's dataset handles so the first run isn't penalized.
+    {
+        OpenThreads::Atomic next(0u);
+        ReaderThread warmup(source.get(), keys, next, heightFields);
+        warmup.run();
+    }
+
+    double baseline = 0.0;
+
+    for(unsigned numThreads = 1u; numThreads <= maxThreads; numThreads *= 2u)
+    {
+        OpenThreads::Atomic next(0u);
+
+        std::vector< ReaderThread* > threads;
+        for(unsigned t = 0; t < numThreads; ++t)
+            threads.push_back( new ReaderThread(source.get(), keys, next, heightFields) );
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        for(unsigned t = 0; t < numThreads; ++t)
+            threads[t]->start();
+
+        unsigned tilesRead = 0u;
+        for(unsigned t = 0; t < numThreads; ++t)
+        {
+            threads[t]->join();
+            tilesRead += threads[t]->_tilesRead;
+            delete threads[t];
+        }
+
+        double seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+        double rate = seconds > 0.0 ? (double)keys.size() / seconds : 0.0;
+        if ( numThreads == 1u )
+            baseline = rate;
+
+        std::cout
+            << std::setw(8) << numThreads
+            << std::setw(12) << std::fixed << std::setprecision(3) << seconds
+            << std::setw(12) << std::setprecision(1) << rate
+            << std::setw(10) << std::setprecision(2) << (baseline > 0.0 ? rate/baseline : 0.0)
+            << std::endl;
+
+        if ( tilesRead < keys.size() )
+        {
+            OE_INFO << LC << (keys.size()-tilesRead) << " keys returned no data" << std::endl;
+        }
+    }
+
+    return 0;
+}
@@ -50,6 +50,7 @@ using namespace osgEarth::Drivers;
 int list( osg::ArgumentParser& args );
 int seed( osg::ArgumentParser& args );
 int purge( osg::ArgumentParser& args );
+int compact( osg::ArgumentParser& args );
 int usage( const std::string& msg );
 int message( const std::string& msg );
 
@@ -65,6 +66,8 @@ int
         return list( args );
     else if ( args.read( "--purge" ) )
         return purge( args );        
+    else if ( args.read( "--compact" ) )
+        return compact( args );
     else
     return usage("");
 }
@@ -95,6 +98,8 @@ int
         << "        [--verbose]                     ; Displays progress of the seed operation" << std::endl
         << std::endl
         << "    --purge file.earth                  ; Purges a layer cache in a .earth file (interactive)" << std::endl
+        << std::endl
+        << "    --compact file.earth                ; Compacts every layer cache in a .earth file" << std::endl
         << std::endl;
 
     return -1;
@@ -589,4 +594,39 @@ purge( osg::ArgumentParser& args )
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+int
+compact( osg::ArgumentParser& args )
+{
+    osg::ref_ptr<osg::Node> node = osgDB::readNodeFiles( args );
+    if ( !node.valid() )
+        return usage( "Failed to read .earth file." );
+
+    MapNode* mapNode = MapNode::findMapNode( node.get() );
+    if ( !mapNode )
+        return usage( "Input file was not a .earth file" );
+
+    Map* map = mapNode->getMap();
+
+    if ( !map->getCache() )
+        return message( "Earth file does not contain a cache." );
+
+    TerrainLayerVector layers;
+    map->getLayers( layers );
+    for( TerrainLayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i )
+    {
+        TerrainLayer* layer = i->get();
+
+        CacheSettings* cacheSettings = layer->getCacheSettings();
+        CacheBin* bin = cacheSettings ? cacheSettings->getCacheBin() : 0L;
+        if ( bin )
+        {
+            std::cout << "Compacting \"" << layer->getName() << "\".." << std::flush;
+            bool ok = bin->compact();
+            std::cout << (ok ? " done." : " not supported by this cache.") << std::endl;
+        }
+    }
+
+    return 0;
+}
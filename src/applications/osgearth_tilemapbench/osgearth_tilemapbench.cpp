@@ -0,0 +1,225 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#define LC "[osgearth_tilemapbench] "
+
+#include <osgEarth/Notify>
+#include <osgEarth/Random>
+#include <osgEarth/Registry>
+#include <osgEarth/TileKey>
+#include <osgEarth/TileKeyHashMap>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <iomanip>
+#include <map>
+
+using namespace osgEarth;
+
+// documentation
+int usage(char** argv)
+{
+    std::cout
+        << "Times insert, find and erase of TileKeys in a std::map versus a TileKeyHashMap\n"
+        << "(the terrain engine's tile registry) as the number of tiles grows.\n\n"
+        << argv[0]
+        << "\n    --min-tiles [int]                   : smallest tile count to test (default = 1000)"
+        << "\n    --max-tiles [int]                   : largest tile count to test (default = 64000)"
+        << "\n    --passes [int]                      : passes to average per test (default = 10)"
+        << std::endl;
+
+    return 0;
+}
+
+// what the registry stores per tile
+struct Entry
+{
+    osg::ref_ptr<osg::Referenced> tile;
+};
+
+typedef std::vector<TileKey> TileKeyVector;
+
+/**
+ * Makes a tile set shaped like a terrain's: around each of a number of
+ * random focus points, the 4x4 block of tiles at every LOD down to 19.
+ */
+void
+createKeys(unsigned count, Random& random, TileKeyVector& out_keys)
+{
+    const Profile* profile = Registry::instance()->getGlobalGeodeticProfile();
+
+    std::map<TileKey, bool> unique;
+    out_keys.clear();
+    while ( out_keys.size() < count )
+    {
+        double u = random.next(), v = random.next();
+        for(unsigned lod = 0; lod < 20 && out_keys.size() < count; ++lod)
+        {
+            unsigned tx, ty;
+            profile->getNumTiles(lod, tx, ty);
+            int cx = (int)(u * (double)tx), cy = (int)(v * (double)ty);
+            for(int y = cy-1; y <= cy+2; ++y)
+            {
+                for(int x = cx-1; x <= cx+2; ++x)
+                {
+                    if ( x >= 0 && y >= 0 && x < (int)tx && y < (int)ty && out_keys.size() < count )
+                    {
+                        TileKey key(lod, x, y, profile);
+                        if ( unique.insert(std::make_pair(key, true)).second )
+                            out_keys.push_back(key);
+                    }
+                }
+            }
+        }
+    }
+
+    // shuffle so inserts don't arrive in a friendly order:
+    for(unsigned i = out_keys.size()-1; i > 0; --i)
+        std::swap(out_keys[i], out_keys[random.next(i+1)]);
+}
+
+struct Times
+{
+    Times() : insert(0.0), find(0.0), neighbors(0.0), erase(0.0) { }
+    double insert, find, neighbors, erase;  // total ms
+};
+
+template<typename MAP, typename FIND>
+void
+run(const TileKeyVector& keys, const TileKeyVector& neighbors, unsigned passes, FIND find, Times& times)
+{
+    osg::ref_ptr<osg::Referenced> tile = new osg::Referenced();
+    unsigned found = 0u;
+
+    for(unsigned p = 0; p < passes; ++p)
+    {
+        MAP map;
+
+        osg::Timer_t t0 = osg::Timer::instance()->tick();
+        for(TileKeyVector::const_iterator k = keys.begin(); k != keys.end(); ++k)
+            map[*k].tile = tile.get();
+
+        osg::Timer_t t1 = osg::Timer::instance()->tick();
+        for(TileKeyVector::const_iterator k = keys.begin(); k != keys.end(); ++k)
+            found += find(map, *k) ? 1u : 0u;
+
+        osg::Timer_t t2 = osg::Timer::instance()->tick();
+        for(TileKeyVector::const_iterator k = neighbors.begin(); k != neighbors.end(); ++k)
+            found += find(map, *k) ? 1u : 0u;
+
+        osg::Timer_t t3 = osg::Timer::instance()->tick();
+        for(TileKeyVector::const_iterator k = keys.begin(); k != keys.end(); ++k)
+            map.erase(*k);
+
+        osg::Timer_t t4 = osg::Timer::instance()->tick();
+
+        times.insert    += osg::Timer::instance()->delta_m(t0, t1);
+        times.find      += osg::Timer::instance()->delta_m(t1, t2);
+        times.neighbors += osg::Timer::instance()->delta_m(t2, t3);
+        times.erase     += osg::Timer::instance()->delta_m(t3, t4);
+    }
+
+    // keep the lookups from being optimized away
+    if ( found == 0u )
+        OE_WARN << LC << "No tiles found" << std::endl;
+}
+
+bool findInMap(std::map<TileKey, Entry>& map, const TileKey& key)
+{
+    return map.find(key) != map.end();
+}
+
+bool findInHashMap(TileKeyHashMap<Entry>& map, const TileKey& key)
+{
+    return map.find(key) != 0L;
+}
+
+void
+report(const char* name, unsigned count, unsigned passes, const Times& times)
+{
+    // nanoseconds per operation
+    double scale = 1.0e6 / (double)(count * passes);
+    std::cout
+        << std::setw(14) << name
+        << std::setw(10) << count
+        << std::fixed << std::setprecision(1)
+        << std::setw(12) << times.insert * scale
+        << std::setw(12) << times.find * scale
+        << std::setw(14) << times.neighbors * scale / 2.0
+        << std::setw(12) << times.erase * scale
+        << std::endl;
+}
+
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser args(&argc,argv);
+
+    if ( args.read("--help") )
+        return usage(argv);
+
+    unsigned minTiles = 1000u;
+    args.read("--min-tiles", minTiles);
+
+    unsigned maxTiles = 64000u;
+    args.read("--max-tiles", maxTiles);
+
+    unsigned passes = 10u;
+    args.read("--passes", passes);
+    passes = osg::maximum(passes, 1u);
+
+    std::cout
+        << "Nanoseconds per operation, " << passes << " passes per test" << std::endl
+        << std::setw(14) << "container"
+        << std::setw(10) << "tiles"
+        << std::setw(12) << "insert"
+        << std::setw(12) << "find"
+        << std::setw(14) << "neighbors"
+        << std::setw(12) << "erase"
+        << std::endl;
+
+    Random random(0u);
+
+    for(unsigned count = osg::maximum(minTiles, 1u); count <= maxTiles; count *= 2u)
+    {
+        TileKeyVector keys;
+        createKeys(count, random, keys);
+
+        // the east and south neighbors, as the registry looks up; some exist, some don't
+        TileKeyVector neighbors;
+        neighbors.reserve(2u*keys.size());
+        for(TileKeyVector::const_iterator k = keys.begin(); k != keys.end(); ++k)
+        {
+            neighbors.push_back(k->createNeighborKey(1, 0));
+            neighbors.push_back(k->createNeighborKey(0, 1));
+        }
+
+        Times mapTimes;
+        run< std::map<TileKey, Entry> >(keys, neighbors, passes, findInMap, mapTimes);
+        report("std::map", keys.size(), passes, mapTimes);
+
+        Times hashTimes;
+        run< TileKeyHashMap<Entry> >(keys, neighbors, passes, findInHashMap, hashTimes);
+        report("TileKeyHashMap", keys.size(), passes, hashTimes);
+    }
+
+    return 0;
+}
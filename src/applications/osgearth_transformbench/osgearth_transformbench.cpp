@@ -0,0 +1,285 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#define LC "[osgearth_transformbench] "
+
+#include <osgEarth/ECEF>
+#include <osgEarth/Notify>
+#include <osgEarth/Random>
+#include <osgEarth/SpatialReference>
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <iomanip>
+
+using namespace osgEarth;
+
+// documentation
+int usage(char** argv)
+{
+    std::cout
+        << "Times the batch coordinate conversion kernels (osgEarth::ECEF) against\n"
+        << "converting one point at a time with SpatialReference::transform, and checks\n"
+        << "the kernels bit for bit against the original per-point math.\n\n"
+        << argv[0]
+        << "\n    --points [int]                      : number of points to convert (default = 1000000)"
+        << "\n    --seed [int]                        : random seed (default = 0)"
+        << std::endl;
+
+    return 0;
+}
+
+typedef std::vector<osg::Vec3d> Points;
+
+// one conversion, done both ways
+struct Test
+{
+    std::string name;
+    Points      input;
+    Points      reference;  // original per-point math
+    Points      single;     // one point at a time through SpatialReference
+    Points      batch;      // batch kernel
+    double      singleTime;
+    double      batchTime;
+};
+
+// The per-point math the kernels replaced, kept here as the reference.
+void
+refGeodeticToECEF(Test& test, const osg::EllipsoidModel* em)
+{
+    test.reference = test.input;
+    for(Points::iterator p = test.reference.begin(); p != test.reference.end(); ++p)
+    {
+        double x, y, z;
+        em->convertLatLongHeightToXYZ(
+            osg::DegreesToRadians(p->y()), osg::DegreesToRadians(p->x()), p->z(),
+            x, y, z);
+        p->set(x, y, z);
+    }
+}
+
+void
+refECEFToGeodetic(Test& test, const osg::EllipsoidModel* em)
+{
+    test.reference = test.input;
+    for(Points::iterator p = test.reference.begin(); p != test.reference.end(); ++p)
+    {
+        double lat, lon, alt;
+        em->convertXYZToLatLongHeight(p->x(), p->y(), p->z(), lat, lon, alt);
+        p->set(osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat), alt);
+    }
+}
+
+void
+refGeodeticToMercator(Test& test)
+{
+    test.reference = test.input;
+    for(Points::iterator p = test.reference.begin(); p != test.reference.end(); ++p)
+    {
+        double lon = osg::clampBetween(p->x(), -180.0, 180.0);
+        double lat = osg::clampBetween(p->y(), -90.0, 90.0);
+        double xr = (osg::DegreesToRadians(lon) - (-osg::PI)) / (2.0*osg::PI);
+        double sinLat = sin(osg::DegreesToRadians(lat));
+        double oneMinusSinLat = 1-sinLat;
+        if ( oneMinusSinLat != 0.0 )
+        {
+            double yr = ((0.5 * log( (1+sinLat)/oneMinusSinLat )) - (-osg::PI)) / (2.0*osg::PI);
+            p->x() = osg::clampBetween(MERC_MINX + (xr * MERC_WIDTH), MERC_MINX, MERC_MAXX);
+            p->y() = osg::clampBetween(MERC_MINY + (yr * MERC_HEIGHT), MERC_MINY, MERC_MAXY);
+        }
+    }
+}
+
+void
+refMercatorToGeodetic(Test& test)
+{
+    test.reference = test.input;
+    for(Points::iterator p = test.reference.begin(); p != test.reference.end(); ++p)
+    {
+        double x = osg::clampBetween(p->x(), MERC_MINX, MERC_MAXX);
+        double y = osg::clampBetween(p->y(), MERC_MINY, MERC_MAXY);
+        double xr = -osg::PI + ((x-MERC_MINX)/MERC_WIDTH)*2.0*osg::PI;
+        double yr = -osg::PI + ((y-MERC_MINY)/MERC_HEIGHT)*2.0*osg::PI;
+        p->x() = osg::RadiansToDegrees( xr );
+        p->y() = osg::RadiansToDegrees( 2.0 * atan( exp(yr) ) - osg::PI_2 );
+    }
+}
+
+// converts one point at a time, the way callers did before the kernels
+void
+convertSingle(const SpatialReference* from, const SpatialReference* to, Test& test)
+{
+    test.single.resize(test.input.size());
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned i = 0; i < test.input.size(); ++i)
+    {
+        from->transform(test.input[i], to, test.single[i]);
+    }
+    test.singleTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+}
+
+// reports the timings and how many points differ (bit for bit) from the reference
+void
+report(const Test& test)
+{
+    unsigned mismatches = 0u;
+    double maxError = 0.0;
+    for(unsigned i = 0; i < test.input.size(); ++i)
+    {
+        const osg::Vec3d& a = test.reference[i];
+        const osg::Vec3d& b = test.batch[i];
+        if (a.x() != b.x() || a.y() != b.y() || a.z() != b.z())
+        {
+            ++mismatches;
+            maxError = osg::maximum(maxError, (a-b).length());
+        }
+    }
+
+    std::cout
+        << std::setw(22) << std::left << test.name << std::right
+        << std::fixed
+        << std::setw(12) << std::setprecision(2) << test.singleTime
+        << std::setw(12) << std::setprecision(2) << test.batchTime
+        << std::setw(10) << std::setprecision(1) << test.singleTime/osg::maximum(test.batchTime, 0.001)
+        << std::setw(12) << mismatches
+        << std::setw(14) << std::setprecision(9) << maxError
+        << std::endl;
+}
+
+#define TIME_BATCH(TEST, CALL) \
+    { \
+        TEST.batch = TEST.input; \
+        osg::Timer_t start = osg::Timer::instance()->tick(); \
+        CALL; \
+        TEST.batchTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()); \
+    }
+
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser args(&argc,argv);
+
+    if ( args.read("--help") )
+        return usage(argv);
+
+    unsigned numPoints = 1000000u;
+    args.read("--points", numPoints);
+    numPoints = osg::maximum(numPoints, 1u);
+
+    unsigned seed = 0u;
+    args.read("--seed", seed);
+
+    const SpatialReference* wgs84 = SpatialReference::get("wgs84");
+    const SpatialReference* ecef  = wgs84->getECEF();
+    const SpatialReference* merc  = SpatialReference::get("spherical-mercator");
+    const osg::EllipsoidModel* em = wgs84->getEllipsoid();
+
+    // random geodetic points between -500m and 9000m:
+    Random random(seed);
+    Points geodetic(numPoints);
+    for(unsigned i = 0; i < numPoints; ++i)
+    {
+        geodetic[i].set(
+            -180.0 + random.next()*360.0,
+            -90.0  + random.next()*180.0,
+            -500.0 + random.next()*9500.0);
+    }
+
+    std::cout
+        << numPoints << " points" << std::endl
+        << std::setw(22) << std::left << "conversion" << std::right
+        << std::setw(12) << "single ms"
+        << std::setw(12) << "batch ms"
+        << std::setw(10) << "speedup"
+        << std::setw(12) << "mismatches"
+        << std::setw(14) << "max error"
+        << std::endl;
+
+    Test toECEF;
+    toECEF.name = "geodetic -> ECEF";
+    toECEF.input = geodetic;
+    refGeodeticToECEF(toECEF, em);
+    convertSingle(wgs84, ecef, toECEF);
+    TIME_BATCH(toECEF, ECEF::geodeticToECEF(&toECEF.batch[0], numPoints, em));
+    report(toECEF);
+
+    Test fromECEF;
+    fromECEF.name = "ECEF -> geodetic";
+    fromECEF.input = toECEF.reference;
+    refECEFToGeodetic(fromECEF, em);
+    convertSingle(ecef, wgs84, fromECEF);
+    TIME_BATCH(fromECEF, ECEF::ECEFToGeodetic(&fromECEF.batch[0], numPoints, em));
+    report(fromECEF);
+
+    Test toMerc;
+    toMerc.name = "geodetic -> mercator";
+    toMerc.input = geodetic;
+    refGeodeticToMercator(toMerc);
+    convertSingle(wgs84, merc, toMerc);
+    TIME_BATCH(toMerc, ECEF::geodeticToSphericalMercator(&toMerc.batch[0], numPoints));
+    report(toMerc);
+
+    Test fromMerc;
+    fromMerc.name = "mercator -> geodetic";
+    fromMerc.input = toMerc.reference;
+    refMercatorToGeodetic(fromMerc);
+    convertSingle(merc, wgs84, fromMerc);
+    TIME_BATCH(fromMerc, ECEF::sphericalMercatorToGeodetic(&fromMerc.batch[0], numPoints));
+    report(fromMerc);
+
+    // local tangent plane at a fixed point; the single path is the
+    // plain matrix multiply callers use to localize ECEF points.
+    osg::Matrixd local2world, world2local;
+    ecef->createLocalToWorld(toECEF.reference[0], local2world);
+    world2local.invert(local2world);
+
+    Test toLTP;
+    toLTP.name = "ECEF -> tangent plane";
+    toLTP.input = toECEF.reference;
+    toLTP.single.resize(numPoints);
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned i = 0; i < numPoints; ++i)
+            toLTP.single[i] = toLTP.input[i] * world2local;
+        toLTP.singleTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+    }
+    toLTP.reference = toLTP.single;
+    TIME_BATCH(toLTP, ECEF::localize(&toLTP.batch[0], numPoints, world2local));
+    report(toLTP);
+
+    // the whole path through SpatialReference, which now uses the kernels;
+    // the batch call must match the single-point call:
+    Test srsToWorld;
+    srsToWorld.name = "transformToWorld";
+    srsToWorld.input = geodetic;
+    srsToWorld.single.resize(numPoints);
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned i = 0; i < numPoints; ++i)
+            wgs84->transformToWorld(srsToWorld.input[i], srsToWorld.single[i]);
+        srsToWorld.singleTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+    }
+    srsToWorld.reference = srsToWorld.single;
+    TIME_BATCH(srsToWorld, wgs84->transformToWorld(srsToWorld.batch));
+    report(srsToWorld);
+
+    return 0;
+}
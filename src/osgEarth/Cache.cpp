@@ -19,6 +19,7 @@
 #include <osgEarth/Cache>
 #include <osgEarth/Registry>
 #include <osgEarth/ThreadingUtils>
+#include <osgEarth/WriteBehindCacheBin>
 
 #include <osg/UserDataContainer>
 #include <osgDB/FileNameUtils>
@@ -136,10 +137,33 @@ Cache::getBin( const std::string& binID )
     return _bin.get();
 }
 
+CacheBin*
+Cache::addLayerBin( const std::string& binID )
+{
+    CacheBin* bin = addBin( binID );
+    if ( !bin || _options.writeBehind() != true )
+        return bin;
+
+    CacheBin* writeBehindBin = _writeBehindBins.get( binID );
+    if ( !writeBehindBin )
+    {
+        writeBehindBin = _writeBehindBins.getOrCreate(
+            binID,
+            new WriteBehindCacheBin( bin, _options.writeQueueSize().get() ) );
+    }
+    return writeBehindBin;
+}
+
 void
 Cache::removeBin( CacheBin* bin )
 {
-    _bins.remove( bin );
+    if ( bin )
+    {
+        // the bin may be the write-behind wrapper or the bin it wraps
+        std::string binID = bin->getID();
+        _writeBehindBins.remove( binID );
+        _bins.remove( binID );
+    }
 }
 
 //------------------------------------------------------------------------
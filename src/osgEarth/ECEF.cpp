@@ -20,6 +20,11 @@
 #include <osgEarth/ECEF>
 #include <osgEarth/Notify>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define OE_ECEF_SSE2 1
+#   include <emmintrin.h>
+#endif
+
 using namespace osgEarth;
 
 #define LC "[ECEF] "
@@ -87,15 +92,14 @@ ECEF::transformAndLocalize(const std::vector<osg::Vec3d>& input,
                            const SpatialReference*        outputSRS,
                            const osg::Matrixd&            world2local )
 {
-    const SpatialReference* ecefSRS = outputSRS->getECEF();
     output->reserve( output->size() + input.size() );
 
-    for( std::vector<osg::Vec3d>::const_iterator i = input.begin(); i != input.end(); ++i )
+    std::vector<osg::Vec3d> local;
+    transformAndLocalize( input, inputSRS, local, outputSRS, world2local );
+
+    for( std::vector<osg::Vec3d>::const_iterator i = local.begin(); i != local.end(); ++i )
     {
-        osg::Vec3d ecef;
-        inputSRS->transform( *i, ecefSRS, ecef );
-        //inputSRS->transformToECEF( *i, ecef );
-        output->push_back( ecef * world2local );
+        output->push_back( *i );
     }
 }
 
@@ -108,15 +112,7 @@ ECEF::transformAndLocalize(const std::vector<osg::Vec3d>& input,
                            const SpatialReference*        outputSRS,
                            const osg::Matrixd&            world2local )
 {
-    const SpatialReference* ecefSRS = outputSRS->getECEF();
-    out_verts->reserve( out_verts->size() + input.size() );
-    
-    for( std::vector<osg::Vec3d>::const_iterator i = input.begin(); i != input.end(); ++i )
-    {
-        osg::Vec3d ecef;
-        inputSRS->transform( *i, ecefSRS, ecef );
-        out_verts->push_back( ecef * world2local );
-    }
+    transformAndLocalize( input, inputSRS, out_verts, outputSRS, world2local );
 
     if ( out_normals )
     {
@@ -152,6 +148,33 @@ ECEF::transformAndLocalize(const std::vector<osg::Vec3d>& input,
     }
 }
 
+void
+ECEF::transformAndLocalize(const std::vector<osg::Vec3d>& input,
+                           const SpatialReference*        inputSRS,
+                           std::vector<osg::Vec3d>&       output,
+                           const SpatialReference*        outputSRS,
+                           const osg::Matrixd&            world2local )
+{
+    output = input;
+    if ( output.empty() )
+        return;
+
+    // transform the whole array in one pass; if that fails, fall back on
+    // one point at a time so the points that do transform still come out right.
+    const SpatialReference* ecefSRS = outputSRS->getECEF();
+    if ( !inputSRS->transform( output, ecefSRS ) )
+    {
+        for( unsigned i=0; i<input.size(); ++i )
+        {
+            osg::Vec3d ecef;
+            inputSRS->transform( input[i], ecefSRS, ecef );
+            output[i] = ecef;
+        }
+    }
+
+    localize( &output[0], output.size(), world2local );
+}
+
 void
 ECEF::transformAndGetRotationMatrix(const osg::Vec3d&       input,
                                     const SpatialReference* inputSRS,
@@ -178,3 +201,325 @@ ECEF::transformAndGetRotationMatrix(const osg::Vec3d&       input,
     // then convert that to ECEF.
     geoSRS->transform(geoPoint, ecefSRS, out_point);
 }
+
+// --------------------------------------------------------------------------
+// Batch kernels. Each has a scalar loop that uses exactly the arithmetic of
+// the per-point code, and on x86 an SSE2 loop that does the linear parts of
+// the conversion for two points at a time. SSE2 has no transcendental
+// functions, so sin, log and the like still go through the C library one
+// lane at a time. The two paths do the same IEEE operations in the same
+// order, so they agree to within a couple of ULPs (exactly, unless the
+// compiler contracts the scalar code into fused multiply-adds).
+
+namespace
+{
+    bool s_useSIMD = true;
+
+#ifdef OE_ECEF_SSE2
+    // Loads one coordinate (0=x, 1=y, 2=z) of two consecutive points.
+    inline __m128d load2(const osg::Vec3d* p, unsigned c)
+    {
+        return _mm_loadh_pd( _mm_load_sd(p[0].ptr() + c), p[1].ptr() + c );
+    }
+
+    inline void store2(osg::Vec3d* p, unsigned c, __m128d v)
+    {
+        _mm_storel_pd( p[0].ptr() + c, v );
+        _mm_storeh_pd( p[1].ptr() + c, v );
+    }
+
+    inline __m128d clamp2(__m128d v, __m128d lo, __m128d hi)
+    {
+        // same as osg::clampBetween, including for NaN (which passes through)
+        return _mm_or_pd(
+            _mm_and_pd( _mm_cmplt_pd(v, lo), lo ),
+            _mm_andnot_pd( _mm_cmplt_pd(v, lo),
+                _mm_or_pd(
+                    _mm_and_pd( _mm_cmpgt_pd(v, hi), hi ),
+                    _mm_andnot_pd( _mm_cmpgt_pd(v, hi), v ) ) ) );
+    }
+
+    // Applies a C library function to each lane.
+    inline __m128d apply2(double (*f)(double), __m128d v)
+    {
+        double lanes[2];
+        _mm_storeu_pd( lanes, v );
+        return _mm_set_pd( f(lanes[1]), f(lanes[0]) );
+    }
+#endif
+
+    // per-point mercator conversions, shared by the scalar loops and the
+    // leftover point of the SSE2 loops.
+    // http://en.wikipedia.org/wiki/Mercator_projection#Mathematics_of_the_projection
+    inline void geodeticToSphericalMercator1(osg::Vec3d& p)
+    {
+        double lon = osg::clampBetween(p.x(), -180.0, 180.0);
+        double lat = osg::clampBetween(p.y(), -90.0, 90.0);
+        double xr = (osg::DegreesToRadians(lon) - (-osg::PI)) / (2.0*osg::PI);
+        double sinLat = sin(osg::DegreesToRadians(lat));
+        double oneMinusSinLat = 1-sinLat;
+        if ( oneMinusSinLat != 0.0 )
+        {
+            double yr = ((0.5 * log( (1+sinLat)/oneMinusSinLat )) - (-osg::PI)) / (2.0*osg::PI);
+            p.x() = osg::clampBetween(MERC_MINX + (xr * MERC_WIDTH), MERC_MINX, MERC_MAXX);
+            p.y() = osg::clampBetween(MERC_MINY + (yr * MERC_HEIGHT), MERC_MINY, MERC_MAXY);
+        }
+    }
+
+    inline void sphericalMercatorToGeodetic1(osg::Vec3d& p)
+    {
+        double x = osg::clampBetween(p.x(), MERC_MINX, MERC_MAXX);
+        double y = osg::clampBetween(p.y(), MERC_MINY, MERC_MAXY);
+        double xr = -osg::PI + ((x-MERC_MINX)/MERC_WIDTH)*2.0*osg::PI;
+        double yr = -osg::PI + ((y-MERC_MINY)/MERC_HEIGHT)*2.0*osg::PI;
+        p.x() = osg::RadiansToDegrees( xr );
+        p.y() = osg::RadiansToDegrees( 2.0 * atan( exp(yr) ) - osg::PI_2 );
+    }
+}
+
+void
+ECEF::setUseSIMD(bool value)
+{
+    s_useSIMD = value;
+}
+
+bool
+ECEF::getUseSIMD()
+{
+#ifdef OE_ECEF_SSE2
+    return s_useSIMD;
+#else
+    return false;
+#endif
+}
+
+void
+ECEF::geodeticToECEF(osg::Vec3d*                points,
+                     unsigned                   count,
+                     const osg::EllipsoidModel* em)
+{
+    unsigned i = 0;
+
+#ifdef OE_ECEF_SSE2
+    if ( s_useSIMD )
+    {
+        // EllipsoidModel::convertLatLongHeightToXYZ, two points at a time
+        const double a = em->getRadiusEquator();
+        const double flattening = (a - em->getRadiusPolar()) / a;
+        const double e2 = 2*flattening - flattening*flattening;
+
+        const __m128d vA       = _mm_set1_pd( a );
+        const __m128d vE2      = _mm_set1_pd( e2 );
+        const __m128d vOne     = _mm_set1_pd( 1.0 );
+        const __m128d vOneMinusE2 = _mm_set1_pd( 1.0 - e2 );
+        const __m128d vPI      = _mm_set1_pd( osg::PI );
+        const __m128d v180     = _mm_set1_pd( 180.0 );
+
+        for( ; i+1 < count; i += 2 )
+        {
+            osg::Vec3d* p = points + i;
+            __m128d lon = _mm_div_pd( _mm_mul_pd(load2(p, 0), vPI), v180 );
+            __m128d lat = _mm_div_pd( _mm_mul_pd(load2(p, 1), vPI), v180 );
+            __m128d height = load2(p, 2);
+
+            __m128d sinLat = apply2( sin, lat );
+            __m128d cosLat = apply2( cos, lat );
+
+            __m128d N = _mm_div_pd( vA, _mm_sqrt_pd(
+                _mm_sub_pd( vOne, _mm_mul_pd(_mm_mul_pd(vE2, sinLat), sinLat) ) ) );
+            __m128d NPlusH = _mm_add_pd( N, height );
+
+            store2( p, 0, _mm_mul_pd(_mm_mul_pd(NPlusH, cosLat), apply2(cos, lon)) );
+            store2( p, 1, _mm_mul_pd(_mm_mul_pd(NPlusH, cosLat), apply2(sin, lon)) );
+            store2( p, 2, _mm_mul_pd(_mm_add_pd(_mm_mul_pd(N, vOneMinusE2), height), sinLat) );
+        }
+    }
+#endif
+
+    for( ; i<count; ++i )
+    {
+        osg::Vec3d& p = points[i];
+        double x, y, z;
+        em->convertLatLongHeightToXYZ(
+            osg::DegreesToRadians(p.y()), osg::DegreesToRadians(p.x()), p.z(),
+            x, y, z );
+        p.set(x, y, z);
+    }
+}
+
+void
+ECEF::ECEFToGeodetic(osg::Vec3d*                points,
+                     unsigned                   count,
+                     const osg::EllipsoidModel* em)
+{
+    // Mostly transcendental and branchy, so there's no SSE2 path; this saves
+    // the per-point dispatch and allocations of SpatialReference::transform.
+    for(unsigned i=0; i<count; ++i)
+    {
+        osg::Vec3d& p = points[i];
+        double lat, lon, alt;
+        em->convertXYZToLatLongHeight(
+            p.x(), p.y(), p.z(),
+            lat, lon, alt );
+        p.set(osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat), alt);
+    }
+}
+
+void
+ECEF::geodeticToSphericalMercator(osg::Vec3d* points,
+                                  unsigned    count)
+{
+    unsigned i = 0;
+
+#ifdef OE_ECEF_SSE2
+    if ( s_useSIMD )
+    {
+        const __m128d vPI      = _mm_set1_pd( osg::PI );
+        const __m128d vMinusPI = _mm_set1_pd( -osg::PI );
+        const __m128d v2PI     = _mm_set1_pd( 2.0*osg::PI );
+        const __m128d v180     = _mm_set1_pd( 180.0 );
+        const __m128d vMinus180= _mm_set1_pd( -180.0 );
+        const __m128d v90      = _mm_set1_pd( 90.0 );
+        const __m128d vMinus90 = _mm_set1_pd( -90.0 );
+        const __m128d vOne     = _mm_set1_pd( 1.0 );
+        const __m128d vHalf    = _mm_set1_pd( 0.5 );
+        const __m128d vZero    = _mm_setzero_pd();
+        const __m128d vMinX    = _mm_set1_pd( MERC_MINX );
+        const __m128d vMaxX    = _mm_set1_pd( MERC_MAXX );
+        const __m128d vMinY    = _mm_set1_pd( MERC_MINY );
+        const __m128d vMaxY    = _mm_set1_pd( MERC_MAXY );
+        const __m128d vWidth   = _mm_set1_pd( MERC_WIDTH );
+        const __m128d vHeight  = _mm_set1_pd( MERC_HEIGHT );
+
+        for( ; i+1 < count; i += 2 )
+        {
+            osg::Vec3d* p = points + i;
+            __m128d x0 = load2(p, 0);
+            __m128d y0 = load2(p, 1);
+
+            __m128d lon = clamp2( x0, vMinus180, v180 );
+            __m128d lat = clamp2( y0, vMinus90, v90 );
+            __m128d xr = _mm_div_pd( _mm_sub_pd(_mm_div_pd(_mm_mul_pd(lon, vPI), v180), vMinusPI), v2PI );
+            __m128d sinLat = apply2( sin, _mm_div_pd(_mm_mul_pd(lat, vPI), v180) );
+            __m128d oneMinusSinLat = _mm_sub_pd( vOne, sinLat );
+
+            __m128d ratio = _mm_div_pd( _mm_add_pd(vOne, sinLat), oneMinusSinLat );
+            __m128d yr = _mm_div_pd( _mm_sub_pd(_mm_mul_pd(vHalf, apply2(log, ratio)), vMinusPI), v2PI );
+
+            __m128d x = clamp2( _mm_add_pd(vMinX, _mm_mul_pd(xr, vWidth)), vMinX, vMaxX );
+            __m128d y = clamp2( _mm_add_pd(vMinY, _mm_mul_pd(yr, vHeight)), vMinY, vMaxY );
+
+            // a point at the north pole has no mercator position; leave it be.
+            __m128d pole = _mm_cmpeq_pd( oneMinusSinLat, vZero );
+            store2( p, 0, _mm_or_pd(_mm_and_pd(pole, x0), _mm_andnot_pd(pole, x)) );
+            store2( p, 1, _mm_or_pd(_mm_and_pd(pole, y0), _mm_andnot_pd(pole, y)) );
+        }
+    }
+#endif
+
+    for( ; i<count; ++i )
+    {
+        geodeticToSphericalMercator1( points[i] );
+    }
+}
+
+void
+ECEF::sphericalMercatorToGeodetic(osg::Vec3d* points,
+                                  unsigned    count)
+{
+    unsigned i = 0;
+
+#ifdef OE_ECEF_SSE2
+    if ( s_useSIMD )
+    {
+        const __m128d vPI      = _mm_set1_pd( osg::PI );
+        const __m128d vMinusPI = _mm_set1_pd( -osg::PI );
+        const __m128d vPI_2    = _mm_set1_pd( osg::PI_2 );
+        const __m128d v2       = _mm_set1_pd( 2.0 );
+        const __m128d v180     = _mm_set1_pd( 180.0 );
+        const __m128d vMinX    = _mm_set1_pd( MERC_MINX );
+        const __m128d vMaxX    = _mm_set1_pd( MERC_MAXX );
+        const __m128d vMinY    = _mm_set1_pd( MERC_MINY );
+        const __m128d vMaxY    = _mm_set1_pd( MERC_MAXY );
+        const __m128d vWidth   = _mm_set1_pd( MERC_WIDTH );
+        const __m128d vHeight  = _mm_set1_pd( MERC_HEIGHT );
+
+        for( ; i+1 < count; i += 2 )
+        {
+            osg::Vec3d* p = points + i;
+            __m128d x = clamp2( load2(p, 0), vMinX, vMaxX );
+            __m128d y = clamp2( load2(p, 1), vMinY, vMaxY );
+
+            // -PI + ((x-MINX)/WIDTH)*2.0*PI, evaluated left to right
+            __m128d xr = _mm_add_pd( vMinusPI, _mm_mul_pd(_mm_mul_pd(_mm_div_pd(_mm_sub_pd(x, vMinX), vWidth), v2), vPI) );
+            __m128d yr = _mm_add_pd( vMinusPI, _mm_mul_pd(_mm_mul_pd(_mm_div_pd(_mm_sub_pd(y, vMinY), vHeight), v2), vPI) );
+
+            __m128d lat = _mm_sub_pd( _mm_mul_pd(v2, apply2(atan, apply2(exp, yr))), vPI_2 );
+
+            store2( p, 0, _mm_div_pd(_mm_mul_pd(xr, v180), vPI) );
+            store2( p, 1, _mm_div_pd(_mm_mul_pd(lat, v180), vPI) );
+        }
+    }
+#endif
+
+    for( ; i<count; ++i )
+    {
+        sphericalMercatorToGeodetic1( points[i] );
+    }
+}
+
+void
+ECEF::localize(osg::Vec3d*         points,
+               unsigned            count,
+               const osg::Matrixd& m)
+{
+    // An affine matrix has no projective row, so skip the divide that
+    // osg::Matrixd::preMult does (it always divides by exactly 1.0).
+    if (m(0,3) == 0.0 && m(1,3) == 0.0 && m(2,3) == 0.0 && m(3,3) == 1.0)
+    {
+        const double
+            m00 = m(0,0), m01 = m(0,1), m02 = m(0,2),
+            m10 = m(1,0), m11 = m(1,1), m12 = m(1,2),
+            m20 = m(2,0), m21 = m(2,1), m22 = m(2,2),
+            m30 = m(3,0), m31 = m(3,1), m32 = m(3,2);
+
+        unsigned i = 0;
+
+#ifdef OE_ECEF_SSE2
+        if ( s_useSIMD )
+        {
+            const __m128d
+                v00 = _mm_set1_pd(m00), v01 = _mm_set1_pd(m01), v02 = _mm_set1_pd(m02),
+                v10 = _mm_set1_pd(m10), v11 = _mm_set1_pd(m11), v12 = _mm_set1_pd(m12),
+                v20 = _mm_set1_pd(m20), v21 = _mm_set1_pd(m21), v22 = _mm_set1_pd(m22),
+                v30 = _mm_set1_pd(m30), v31 = _mm_set1_pd(m31), v32 = _mm_set1_pd(m32);
+
+            for( ; i+1 < count; i += 2 )
+            {
+                osg::Vec3d* p = points + i;
+                __m128d x = load2(p, 0), y = load2(p, 1), z = load2(p, 2);
+
+                store2( p, 0, _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(v00, x), _mm_mul_pd(v10, y)), _mm_mul_pd(v20, z)), v30) );
+                store2( p, 1, _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(v01, x), _mm_mul_pd(v11, y)), _mm_mul_pd(v21, z)), v31) );
+                store2( p, 2, _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(v02, x), _mm_mul_pd(v12, y)), _mm_mul_pd(v22, z)), v32) );
+            }
+        }
+#endif
+
+        for( ; i<count; ++i )
+        {
+            double x = points[i].x(), y = points[i].y(), z = points[i].z();
+            points[i].set(
+                m00*x + m10*y + m20*z + m30,
+                m01*x + m11*y + m21*z + m31,
+                m02*x + m12*y + m22*z + m32 );
+        }
+    }
+    else
+    {
+        for(unsigned i=0; i<count; ++i)
+        {
+            points[i] = points[i] * m;
+        }
+    }
+}
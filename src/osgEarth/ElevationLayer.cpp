@@ -771,6 +771,186 @@ namespace
             }
         }
     }
+
+    //! Sorts the samples of a grid by the tile they fall in: the key itself or,
+    //! for samples in the border around it, one of its eight neighbors. The
+    //! regions are numbered 0-8 in rows of three, so (dTx, dTy) in tile
+    //! coordinates is region (dTy+1)*3 + (dTx+1), and 4 is the key itself.
+    //!
+    //! GeoExtent::contains() tests the two axes independently, so classifying
+    //! the columns and rows once is enough to place every sample.
+    struct KeyRegions
+    {
+        std::vector<char> _insideX, _insideY;
+        std::vector<signed char> _dTx, _dTy;
+
+        void set(const GeoExtent& extent, bool useNeighbors, const std::vector<double>& xs, const std::vector<double>& ys)
+        {
+            // a point known to be inside, to probe one axis at a time:
+            double cx, cy;
+            extent.getCentroid(cx, cy);
+
+            _insideX.resize(xs.size());
+            _dTx.resize(xs.size());
+            for (unsigned c = 0; c < xs.size(); ++c)
+            {
+                _insideX[c] = !useNeighbors || extent.contains(xs[c], cy);
+                _dTx[c] = xs[c] < extent.xMin() ? -1 : xs[c] > extent.xMax() ? +1 : 0;
+            }
+
+            _insideY.resize(ys.size());
+            _dTy.resize(ys.size());
+            for (unsigned r = 0; r < ys.size(); ++r)
+            {
+                _insideY[r] = !useNeighbors || extent.contains(cx, ys[r]);
+                _dTy[r] = ys[r] < extent.yMin() ? +1 : ys[r] > extent.yMax() ? -1 : 0;
+            }
+        }
+
+        //! Region of the sample at column c, row r
+        int get(unsigned c, unsigned r) const
+        {
+            return _insideX[c] && _insideY[r] ? 4 : (_dTy[r]+1)*3 + (_dTx[c]+1);
+        }
+
+        //! Key of region n, given the key at the center
+        static TileKey getKey(const TileKey& key, int n)
+        {
+            return n == 4 ? key : key.createNeighborKey(n%3 - 1, n/3 - 1);
+        }
+    };
+
+    //! Samples of a grid along one axis of a heightfield
+    struct PostAxis
+    {
+        std::vector<double> _pos;     // position in posts, clamped to the heightfield
+        std::vector<int>    _lo, _hi; // posts on either side
+        std::vector<char>   _inside;  // whether the sample lies within the extent
+
+        void set(const std::vector<double>& coords, double origin, double interval, int posts)
+        {
+            _pos.resize(coords.size());
+            _lo.resize(coords.size());
+            _hi.resize(coords.size());
+            for (unsigned i = 0; i < coords.size(); ++i)
+            {
+                double p = osg::clampBetween((coords[i] - origin) / interval, 0.0, (double)(posts-1));
+                int lo = osg::maximum((int)floor(p), 0);
+                int hi = osg::maximum(osg::minimum((int)ceil(p), posts-1), 0);
+                _pos[i] = p;
+                _lo[i] = osg::minimum(lo, hi);
+                _hi[i] = hi;
+            }
+        }
+    };
+
+    //! Samples a GeoHeightField at the points of a grid.
+    //!
+    //! Gives the same results as calling GeoHeightField::getElevation() at each
+    //! point, but works out the extent tests and pixel positions once per row
+    //! and column, and does bilinear sampling inline. Points that need an SRS
+    //! transform go through getElevation().
+    class GridSampler
+    {
+    public:
+        GridSampler(const GeoHeightField& field, const SpatialReference* srs, ElevationInterpolation interp,
+                    const std::vector<double>& xs, const std::vector<double>& ys) :
+            _field ( field ),
+            _srs   ( srs ),
+            _interp( interp ),
+            _xs    ( xs ),
+            _ys    ( ys )
+        {
+            const GeoExtent& extent = field.getExtent();
+            const osg::HeightField* hf = field.getHeightField();
+
+            // an equivalent SRS has the same vertical datum too, so there's no conversion.
+            _direct = srs && srs->isEquivalentTo(extent.getSRS());
+            if (!_direct)
+                return;
+
+            _heights = &hf->getFloatArray()->front();
+            _cols = hf->getNumColumns();
+
+            _x.set(xs, extent.xMin(), extent.width() / (double)(hf->getNumColumns()-1), hf->getNumColumns());
+            _y.set(ys, extent.yMin(), extent.height() / (double)(hf->getNumRows()-1), hf->getNumRows());
+
+            double cx, cy;
+            extent.getCentroid(cx, cy);
+            _x._inside.resize(xs.size());
+            for (unsigned c = 0; c < xs.size(); ++c)
+                _x._inside[c] = extent.contains(xs[c], cy);
+            _y._inside.resize(ys.size());
+            for (unsigned r = 0; r < ys.size(); ++r)
+                _y._inside[r] = extent.contains(cx, ys[r]);
+        }
+
+        //! Elevation at column c, row r of the grid; false if it's outside the heightfield.
+        bool sample(unsigned c, unsigned r, float& out) const
+        {
+            if (!_direct)
+                return _field.getElevation(_srs, _xs[c], _ys[r], _interp, _srs, out);
+
+            if (!_x._inside[c] || !_y._inside[r])
+                return false;
+
+            double px = _x._pos[c], py = _y._pos[r];
+
+            if (_interp != INTERP_BILINEAR)
+            {
+                out = HeightFieldUtils::getHeightAtPixel(_field.getHeightField(), px, py, _interp);
+                return true;
+            }
+
+            int colMin = _x._lo[c], colMax = _x._hi[c];
+            int rowMin = _y._lo[r], rowMax = _y._hi[r];
+
+            float llHeight = _heights[colMin + rowMin*_cols];
+            float lrHeight = _heights[colMax + rowMin*_cols];
+            float ulHeight = _heights[colMin + rowMax*_cols];
+            float urHeight = _heights[colMax + rowMax*_cols];
+
+            // leave the filling of holes to HeightFieldUtils.
+            if (llHeight == NO_DATA_VALUE || lrHeight == NO_DATA_VALUE ||
+                ulHeight == NO_DATA_VALUE || urHeight == NO_DATA_VALUE)
+            {
+                out = HeightFieldUtils::getHeightAtPixel(_field.getHeightField(), px, py, INTERP_BILINEAR);
+                return true;
+            }
+
+            // same arithmetic as HeightFieldUtils::getHeightAtPixel, so the results match exactly:
+            if (colMax == colMin && rowMax == rowMin)
+            {
+                out = llHeight;
+            }
+            else if (colMax == colMin)
+            {
+                out = ((double)rowMax - py) * llHeight + (py - (double)rowMin) * ulHeight;
+            }
+            else if (rowMax == rowMin)
+            {
+                out = ((double)colMax - px) * llHeight + (px - (double)colMin) * lrHeight;
+            }
+            else
+            {
+                double r1 = ((double)colMax - px) * (double)llHeight + (px - (double)colMin) * (double)lrHeight;
+                double r2 = ((double)colMax - px) * (double)ulHeight + (px - (double)colMin) * (double)urHeight;
+                out = ((double)rowMax - py) * r1 + (py - (double)rowMin) * r2;
+            }
+            return true;
+        }
+
+    private:
+        const GeoHeightField&      _field;
+        const SpatialReference*    _srs;
+        ElevationInterpolation     _interp;
+        const std::vector<double>& _xs;
+        const std::vector<double>& _ys;
+        bool                       _direct;
+        const float*               _heights;
+        int                        _cols;
+        PostAxis                   _x, _y;
+    };
 }
 
 bool
@@ -899,33 +1079,12 @@ ElevationLayerVector::populateHeightFieldAndNormalMap(osg::HeightField*      hf,
         ymin -= dy * (double)border;
     }
     
-    // We will load the actual heightfields on demand. We might not need them all.
-#if 0
-    GeoHeightFieldVector heightFields(contenders.size());
-    GeoHeightFieldVector offsetFields(offsets.size());
-    std::vector<bool>    heightFallback(contenders.size(), false);
-    std::vector<bool>    heightFailed(contenders.size(), false);
-    std::vector<bool>    offsetFailed(offsets.size(), false);
-#else
-    GeoHeightFieldVector heightFields[9];
-    GeoHeightFieldVector offsetFields[9]; //(offsets.size());
-    std::vector<bool>    heightFallback[9]; //(contenders.size(), false);
-    std::vector<bool>    heightFailed[9]; //(contenders.size(), false);
-    std::vector<bool>    offsetFailed[9]; //(offsets.size(), false);
-
-    for (int n = 0; n < 9; ++n)
-    {
-        heightFields[n].resize(contenders.size());
-        offsetFields[n].resize(offsets.size());
-        heightFallback[n].assign(9, false);
-        heightFailed[n].assign(9, false);
-        offsetFailed[n].assign(9, false);
-    }
-#endif
-
-    // The maximum number of heightfields to keep in this local cache
-    unsigned int maxHeightFields = 50;
-    unsigned numHeightFieldsInCache = 0;
+    // Grid coordinates of the samples
+    std::vector<double> xs(numColumns), ys(numRows);
+    for (unsigned c = 0; c < numColumns; ++c)
+        xs[c] = xmin + (dx * (double)c);
+    for (unsigned r = 0; r < numRows; ++r)
+        ys[r] = ymin + (dy * (double)r);
 
     const SpatialReference* keySRS = keyToUse.getProfile()->getSRS();
 
@@ -935,177 +1094,145 @@ ElevationLayerVector::populateHeightFieldAndNormalMap(osg::HeightField*      hf,
 
     // query resolution interval (x, y) of each sample.
     osg::ref_ptr<osg::ShortArray> deltaLOD = new osg::ShortArray(total);
-    
-    int nodataCount = 0;
 
-    for (unsigned c = 0; c < numColumns; ++c)
-    {
-        double x = xmin + (dx * (double)c);
-        for (unsigned r = 0; r < numRows; ++r)
-        {
-            double y = ymin + (dy * (double)r);
+    // Index of the layer that supplied each sample (-1 until resolved), so we
+    // only apply offset layers that sit on TOP of it.
+    std::vector<int> resolvedIndex(total, -1);
+    unsigned numUnresolved = total;
 
-            // Collect elevations from each layer as necessary.
-            int resolvedIndex = -1;
+    osg::FloatArray& heights = *hf->getFloatArray();
 
-            osg::Vec3 normal_sum(0,0,0);
-            unsigned normal_count = 0u;
+    // If there is a border, the edge points may not fall within the key extents 
+    // and we may need to fetch neighboring keys.
+    KeyRegions regions;
 
-            for(int i=0; i<contenders.size() && resolvedIndex<0; ++i)
-            {
-                ElevationLayer* layer = contenders[i].layer.get();                
-                TileKey contenderKey = contenders[i].key;
-                int index = contenders[i].index;
-
-                // If there is a border, the edge points may not fall within the key extents 
-                // and we may need to fetch a neighboring key.
-
-                int n = 4; // index 4 is the center/default tile
+    // Apply the contenders in order of priority. Each one fills in the samples
+    // that are still unresolved, reading one heightfield per region they fall
+    // in; a layer isn't read at all once higher ones cover the whole tile.
+    for (unsigned i = 0; i < contenders.size() && numUnresolved > 0u; ++i)
+    {
+        ElevationLayer* layer = contenders[i].layer.get();
+        const TileKey& contenderKey = contenders[i].key;
+        int index = contenders[i].index;
 
-                if (border > 0u && !contenderKey.getExtent().contains(x, y))
-                {
-                    int dTx = x < contenderKey.getExtent().xMin() ? -1 : x > contenderKey.getExtent().xMax() ? +1 : 0;
-                    int dTy = y < contenderKey.getExtent().yMin() ? +1 : y > contenderKey.getExtent().yMax() ? -1 : 0;
-                    contenderKey = contenderKey.createNeighborKey(dTx, dTy);
-                    n = (dTy+1)*3 + (dTx+1);
-                }
+        regions.set(contenderKey.getExtent(), border > 0u, xs, ys);
 
-                if ( heightFailed[n][i] )
-                    continue;
+        bool needed[9] = { false, false, false, false, false, false, false, false, false };
+        for (unsigned r = 0; r < numRows; ++r)
+            for (unsigned c = 0; c < numColumns; ++c)
+                if (resolvedIndex[r*numColumns + c] < 0)
+                    needed[regions.get(c, r)] = true;
 
-                TileKey actualKey = contenderKey;
+        for (int n = 0; n < 9; ++n)
+        {
+            if (!needed[n])
+                continue;
 
-                GeoHeightField& layerHF = heightFields[n][i];
+            TileKey regionKey = KeyRegions::getKey(contenderKey, n);
+            TileKey actualKey = regionKey;
 
+            // Fall back on parent layers to make sure that we have data at the location even if it's fallback.
+            GeoHeightField layerHF;
+            while (!layerHF.valid() && actualKey.valid())
+            {
+                layerHF = layer->createHeightField(actualKey, progress);
                 if (!layerHF.valid())
                 {
-                    // We couldn't get the heightfield from the cache, so try to create it.
-                    // We also fallback on parent layers to make sure that we have data at the location even if it's fallback.
-                    while (!layerHF.valid() && actualKey.valid())
-                    {
-                        layerHF = layer->createHeightField(actualKey, progress);
-                        if (!layerHF.valid())
-                        {
-                            actualKey = actualKey.createParentKey();
-                        }
-                    }
-
-                    // Mark this layer as fallback if necessary.
-                    if (layerHF.valid())
-                    {
-                        heightFallback[n][i] = (actualKey != contenderKey); // actualKey != contenders[i].second;
-                        numHeightFieldsInCache++;
-                    }
-                    else
-                    {
-                        heightFailed[n][i] = true;
-                        continue;
-                    }
+                    actualKey = actualKey.createParentKey();
                 }
+            }
 
-                if (layerHF.valid())
-                {
-                    bool isFallback = heightFallback[n][i];
+            if (!layerHF.valid())
+                continue;
 
-                    // We only have real data if this is not a fallback heightfield.
-                    if (!isFallback)
-                    {
-                        realData = true;
-                    }
-                    
-                    float elevation;
-                    if (layerHF.getElevation(keySRS, x, y, interpolation, keySRS, elevation))
-                    {
-                        if ( elevation != NO_DATA_VALUE )
-                        {
-                            // remember the index so we can only apply offset layers that
-                            // sit on TOP of this layer.
-                            resolvedIndex = index;
-
-                            hf->setHeight(c, r, elevation);
-
-                            if (deltaLOD)
-                            {
-                                (*deltaLOD)[r*numColumns + c] = key.getLOD() - actualKey.getLOD();
-                            }
-                        }
-                        else
-                        {
-                            ++nodataCount;
-                        }
-                    }                    
-                }
+            // We only have real data if this is not a fallback heightfield.
+            if (actualKey == regionKey)
+            {
+                realData = true;
+            }
 
+            short sampleDeltaLOD = (short)(key.getLOD() - actualKey.getLOD());
 
-                // Clear the heightfield cache if we have too many heightfields in the cache.
-                if (numHeightFieldsInCache >= maxHeightFields)
+            GridSampler sampler(layerHF, keySRS, interpolation, xs, ys);
+
+            for (unsigned r = 0; r < numRows; ++r)
+            {
+                for (unsigned c = 0; c < numColumns; ++c)
                 {
-                    //OE_NOTICE << "Clearing cache" << std::endl;
-                    for (unsigned int j = 0; j < 9; ++j)
+                    unsigned s = r*numColumns + c;
+                    if (resolvedIndex[s] >= 0 || regions.get(c, r) != n)
+                        continue;
+
+                    float elevation;
+                    if (sampler.sample(c, r, elevation) && elevation != NO_DATA_VALUE)
                     {
-                        for (unsigned int k = 0; k < heightFields[j].size(); k++)
-                        {
-                            heightFields[j][k] = GeoHeightField::INVALID;
-                            heightFallback[j][k] = false;
-                        }
+                        heights[s] = elevation;
+                        resolvedIndex[s] = index;
+                        (*deltaLOD)[s] = sampleDeltaLOD;
+                        --numUnresolved;
                     }
-                    numHeightFieldsInCache = 0;
                 }
             }
+        }
+    }
 
-            for(int i=offsets.size()-1; i>=0; --i)
-            {
-                // Only apply an offset layer if it sits on top of the resolved layer
-                // (or if there was no resolved layer).
-                if (resolvedIndex >= 0 && offsets[i].index < resolvedIndex)
-                    continue;
+    for(int i=offsets.size()-1; i>=0; --i)
+    {
+        ElevationLayer* offset = offsets[i].layer.get();
+        const TileKey& offsetKey = offsets[i].key;
+        int index = offsets[i].index;
 
-                TileKey contenderKey = offsets[i].key;
+        regions.set(offsetKey.getExtent(), border > 0u, xs, ys);
 
-                // If there is a border, the edge points may not fall within the key extents 
-                // and we may need to fetch a neighboring key.
+        // Only apply an offset layer if it sits on top of the resolved layer
+        // (or if there was no resolved layer).
+        bool needed[9] = { false, false, false, false, false, false, false, false, false };
+        for (unsigned r = 0; r < numRows; ++r)
+        {
+            for (unsigned c = 0; c < numColumns; ++c)
+            {
+                int resolved = resolvedIndex[r*numColumns + c];
+                if (resolved < 0 || index >= resolved)
+                    needed[regions.get(c, r)] = true;
+            }
+        }
 
-                int n = 4; // index 4 is the center/default tile
+        for (int n = 0; n < 9; ++n)
+        {
+            if (!needed[n])
+                continue;
 
-                if (border > 0u && !contenderKey.getExtent().contains(x, y))
-                {
-                    int dTx = x < contenderKey.getExtent().xMin() ? -1 : x > contenderKey.getExtent().xMax() ? +1 : 0;
-                    int dTy = y < contenderKey.getExtent().yMin() ? +1 : x > contenderKey.getExtent().yMax() ? -1 : 0;
-                    contenderKey = contenderKey.createNeighborKey(dTx, dTy);
-                    n = (dTy+1)*3 + (dTx+1);
-                }
-                
-                if ( offsetFailed[n][i] == true )
-                    continue;
+            TileKey regionKey = KeyRegions::getKey(offsetKey, n);
 
-                GeoHeightField& layerHF = offsetFields[n][i];
-                if ( !layerHF.valid() )
-                {
-                    ElevationLayer* offset = offsets[i].layer.get();
+            GeoHeightField layerHF = offset->createHeightField(regionKey, progress);
+            if (!layerHF.valid())
+                continue;
 
-                    layerHF = offset->createHeightField(contenderKey, progress);
-                    if ( !layerHF.valid() )
-                    {
-                        offsetFailed[n][i] = true;
-                        continue;
-                    }
-                }
+            // If we actually got a layer then we have real data
+            realData = true;
 
-                // If we actually got a layer then we have real data
-                realData = true;
+            short sampleDeltaLOD = (short)(key.getLOD() - regionKey.getLOD());
 
-                float elevation = 0.0f;
-                if (layerHF.getElevation(keySRS, x, y, interpolation, keySRS, elevation) &&
-                    elevation != NO_DATA_VALUE)
-                {                    
-                    hf->getHeight(c, r) += elevation;
+            GridSampler sampler(layerHF, keySRS, interpolation, xs, ys);
 
-                    // Update the resolution tracker to account for the offset. Sadly this
-                    // will wipe out the resolution of the actual data, and might result in 
-                    // normal faceting. See the comments on "createNormalMap" for more info
-                    if (deltaLOD)
+            for (unsigned r = 0; r < numRows; ++r)
+            {
+                for (unsigned c = 0; c < numColumns; ++c)
+                {
+                    unsigned s = r*numColumns + c;
+                    int resolved = resolvedIndex[s];
+                    if ((resolved >= 0 && index < resolved) || regions.get(c, r) != n)
+                        continue;
+
+                    float elevation = 0.0f;
+                    if (sampler.sample(c, r, elevation) && elevation != NO_DATA_VALUE)
                     {
-                        (*deltaLOD)[r*numColumns + c] = key.getLOD() - contenderKey.getLOD();
+                        heights[s] += elevation;
+
+                        // Update the resolution tracker to account for the offset. Sadly this
+                        // will wipe out the resolution of the actual data, and might result in 
+                        // normal faceting. See the comments on "createNormalMap" for more info
+                        (*deltaLOD)[s] = sampleDeltaLOD;
                     }
                 }
             }
@@ -22,7 +22,9 @@
 #include <osgEarth/Map>
 #include <osgEarth/Metrics>
 #include <osgEarth/Registry>
+#include <osgEarth/HeightFieldUtils>
 #include <osg/Shape>
+#include <algorithm>
 
 using namespace osgEarth;
 
@@ -30,35 +32,92 @@ using namespace osgEarth;
 
 #define OE_TEST OE_DEBUG
 
-
-ElevationPool::ElevationPool() :
-_entries(0u),
-_maxEntries( 128u ),
-_tileSize( 257u )
+namespace
 {
-    //nop
-    //_opQueue = Registry::instance()->getAsyncOperationQueue();
-    if (!_opQueue.valid())
+    // Stops the query thread that runs it. OperationThread::setDone() can
+    // make a thread quit holding a query it already took off the queue, so
+    // instead each thread is sent one of these behind the pending queries
+    // and stops once it has run everything ahead of it.
+    struct StopThreadOp : public osg::Operation
     {
-        _opQueue = new osg::OperationQueue();
-        for (unsigned i=0; i<2; ++i)
+        StopThreadOp() : osg::Operation("ElevationPool::StopThreadOp", false) { }
+
+        void operator()(osg::Object*)
         {
-            osg::OperationThread* thread = new osg::OperationThread();
-            thread->setOperationQueue(_opQueue.get());
-            thread->start();
-            _opThreads.push_back(thread);
+            osg::OperationThread* thread = dynamic_cast<osg::OperationThread*>(OpenThreads::Thread::CurrentThread());
+            if (thread)
+                thread->setDone(true);
         }
-    }
+    };
+}
+
+ElevationPool::ElevationPool() :
+_maxBytes  ( 0u ),
+_maxEntries( 0u ),
+_tileSize  ( 257u )
+{
+    setMaxEntries( 128u );
+
+    Threading::ScopedMutexLock lock(_opMutex);
+    startThreads(2u);
 }
 
 ElevationPool::~ElevationPool()
 {
+    Threading::ScopedMutexLock lock(_opMutex);
+
     _opQueue->releaseAllOperations();
 
     for (unsigned i = 0; i<_opThreads.size(); ++i)
         _opThreads[i]->setDone(true);
 }
 
+void
+ElevationPool::startThreads(unsigned num)
+{
+    _opQueue = new osg::OperationQueue();
+    for (unsigned i=0; i<num; ++i)
+    {
+        osg::OperationThread* thread = new osg::OperationThread();
+        thread->setOperationQueue(_opQueue.get());
+        thread->start();
+        _opThreads.push_back(thread);
+    }
+}
+
+void
+ElevationPool::stopThreads()
+{
+    // one per thread; a thread that runs one takes nothing else.
+    for (unsigned i = 0; i<_opThreads.size(); ++i)
+        _opQueue->add(new StopThreadOp());
+
+    for (unsigned i = 0; i<_opThreads.size(); ++i)
+        _opThreads[i]->join();
+
+    _opThreads.clear();
+}
+
+void
+ElevationPool::setNumThreads(unsigned value)
+{
+    value = osg::maximum(value, 1u);
+
+    Threading::ScopedMutexLock lock(_opMutex);
+    if (value != _opThreads.size())
+    {
+        stopThreads();
+        startThreads(value);
+    }
+}
+
+unsigned
+ElevationPool::getNumThreads() const
+{
+    Threading::ScopedMutexLock lock(_opMutex);
+    return _opThreads.size();
+}
+
 void
 ElevationPool::setMap(const Map* map)
 {
@@ -87,18 +146,128 @@ ElevationPool::setTileSize(unsigned value)
 {
     Threading::ScopedMutexLock lock(_tilesMutex);
     _tileSize = value;
+
+    // a budget in tiles follows the tile size:
+    if (_maxEntries > 0u)
+        _maxBytes = _maxEntries * getTileBytes();
+
     clearImpl();
 }
 
+unsigned
+ElevationPool::getTileBytes() const
+{
+    return _tileSize * _tileSize * sizeof(float) + sizeof(Tile);
+}
+
+void
+ElevationPool::setMaxEntries(unsigned maxEntries)
+{
+    Threading::ScopedMutexLock lock(_tilesMutex);
+    _maxEntries = osg::maximum(maxEntries, 1u);
+    _maxBytes = _maxEntries * getTileBytes();
+}
+
+unsigned
+ElevationPool::getMaxEntries() const
+{
+    return _maxEntries > 0u ? _maxEntries : _maxBytes / getTileBytes();
+}
+
+void
+ElevationPool::setMaxBytes(unsigned maxBytes)
+{
+    Threading::ScopedMutexLock lock(_tilesMutex);
+    _maxEntries = 0u;
+    _maxBytes = maxBytes;
+}
+
+unsigned
+ElevationPool::getMaxBytes() const
+{
+    return _maxBytes;
+}
+
+ElevationPool::Stats
+ElevationPool::getStats() const
+{
+    Stats stats;
+    stats.hits = _hits;
+    stats.misses = _misses;
+    stats.failures = _failures;
+    stats.evictions = _evictions;
+
+    stats.entries = _entries;
+    stats.bytes = stats.entries * getTileBytes();
+    return stats;
+}
+
+void
+ElevationPool::resetStats()
+{
+    _hits.exchange(0u);
+    _misses.exchange(0u);
+    _failures.exchange(0u);
+    _evictions.exchange(0u);
+}
+
+ElevationPool::Shard&
+ElevationPool::getShard(const TileKey& key)
+{
+    unsigned long long h = Tiles::pack(key);
+    h ^= (h >> 29) ^ (h >> 58);
+    return _shards[(unsigned)h % NUM_SHARDS];
+}
+
 Future<ElevationSample>
 ElevationPool::getElevation(const GeoPoint& point, unsigned lod)
 {
     GetElevationOp* op = new GetElevationOp(this, point, lod);
     Future<ElevationSample> result = op->_promise.getFuture();
+
+    Threading::ScopedMutexLock lock(_opMutex);
     _opQueue->add(op);
     return result;
 }
 
+Future<ElevationSamples>
+ElevationPool::getElevations(const std::vector<GeoPoint>& points, unsigned lod)
+{
+    osg::ref_ptr<Batch> batch = new Batch();
+    batch->_points = points;
+    batch->_lod = lod;
+    batch->_result = new ElevationSamples();
+    batch->_result->elevations.assign(points.size(), NO_DATA_VALUE);
+    batch->_result->resolutions.assign(points.size(), 0.0f);
+
+    Future<ElevationSamples> result = batch->_promise.getFuture();
+
+    if (points.empty())
+    {
+        batch->_promise.resolve(batch->_result.get());
+        return result;
+    }
+
+    Threading::ScopedMutexLock lock(_opMutex);
+
+    // Split the batch into one range per thread, but don't bother splitting
+    // small batches since each range costs a transform and a query set.
+    const unsigned minRange = 256u;
+    unsigned numRanges = osg::clampBetween((unsigned)points.size() / minRange, 1u, (unsigned)_opThreads.size());
+    unsigned rangeSize = (points.size() + numRanges - 1u) / numRanges;
+
+    batch->_remaining.exchange(numRanges);
+
+    for (unsigned i = 0; i < numRanges; ++i)
+    {
+        unsigned begin = i * rangeSize;
+        unsigned end = osg::minimum(begin + rangeSize, (unsigned)points.size());
+        _opQueue->add(new GetElevationsOp(this, batch.get(), begin, end));
+    }
+
+    return result;
+}
+
 ElevationPool::GetElevationOp::GetElevationOp(ElevationPool* pool, const GeoPoint& point, unsigned lod) :
 _pool(pool), _point(point), _lod(lod)
 {
@@ -117,6 +286,53 @@ ElevationPool::GetElevationOp::operator()(osg::Object*)
     }
 }
 
+ElevationPool::GetElevationsOp::GetElevationsOp(ElevationPool* pool, Batch* batch, unsigned begin, unsigned end) :
+_pool(pool), _batch(batch), _begin(begin), _end(end)
+{
+    //nop
+}
+
+void
+ElevationPool::GetElevationsOp::operator()(osg::Object*)
+{
+    osg::ref_ptr<ElevationPool> pool;
+    if (!_batch->_promise.isAbandoned() && _pool.lock(pool))
+    {
+        ElevationSamples* result = _batch->_result.get();
+        std::vector<osg::Vec3d> input;
+        std::vector<float> elevations, resolutions;
+
+        // Sample each run of points that share an SRS through one envelope:
+        unsigned runStart = _begin;
+        while (runStart < _end)
+        {
+            const SpatialReference* srs = _batch->_points[runStart].getSRS();
+
+            unsigned runEnd = runStart + 1u;
+            while (runEnd < _end && _batch->_points[runEnd].getSRS() == srs)
+                ++runEnd;
+
+            input.clear();
+            for (unsigned i = runStart; i < runEnd; ++i)
+                input.push_back(_batch->_points[i].vec3d());
+
+            osg::ref_ptr<ElevationEnvelope> env = pool->createEnvelope(srs, _batch->_lod);
+            env->getElevationsAndResolutions(input, elevations, resolutions);
+
+            std::copy(elevations.begin(), elevations.end(), result->elevations.begin() + runStart);
+            std::copy(resolutions.begin(), resolutions.end(), result->resolutions.begin() + runStart);
+
+            runStart = runEnd;
+        }
+    }
+
+    // last range out resolves the batch:
+    if (--_batch->_remaining == 0u)
+    {
+        _batch->_promise.resolve(_batch->_result.get());
+    }
+}
+
 bool
 ElevationPool::fetchTileFromMap(const TileKey& key, MapFrame& frame, Tile* tile)
 {
@@ -158,67 +374,91 @@ ElevationPool::fetchTileFromMap(const TileKey& key, MapFrame& frame, Tile* tile)
 }
 
 void
-ElevationPool::popMRU()
+ElevationPool::prune()
 {
-    // first rememeber the key of the item we're about the pop:
-    TileKey key = _mru.back()->_key;
+    const unsigned tileBytes = getTileBytes();
 
-    // establish a temporary observer on the item:
-    osg::observer_ptr<Tile> temp = _mru.back().get();
+    // Always keep the most recent tile so a tiny budget can't thrash.
+    while (_entries * tileBytes > _maxBytes && _entries > 1u)
+    {
+        // The oldest tile in the cache is the oldest of the shards' oldest
+        // tiles. Compare stamps by difference so the clock can wrap around.
+        int victim = -1;
+        unsigned oldestStamp = 0u;
+        for (unsigned i = 0; i < NUM_SHARDS; ++i)
+        {
+            Threading::ScopedMutexLock lock(_shards[i]._mutex);
+            Tile* oldest = _shards[i]._oldest;
+            if (oldest && (victim < 0 || (int)(oldest->_lastUsed - oldestStamp) < 0))
+            {
+                victim = i;
+                oldestStamp = oldest->_lastUsed;
+            }
+        }
 
-    // pop the Tile from the MRU:
-    _mru.pop_back();
+        if (victim < 0)
+            break;
 
-    // if our observer went to NULL, we know there are no more pointers
-    // to that Tile in the MRU, and we can remove it from the main list:
-    if (!temp.valid())
-    {
-        _tiles.erase(key);
+        // Another thread may have used or evicted the tile since; evicting
+        // whatever is oldest in that shard now is close enough.
+        Shard& shard = _shards[victim];
+        Threading::ScopedMutexLock lock(shard._mutex);
+        Tile* tile = shard._oldest;
+        if (tile)
+        {
+            // Envelopes holding the tile keep it alive until they're done.
+            TileKey key = tile->_key;
+            shard.unlink(tile);
+            shard._tiles.erase(key);
+            --_entries;
+            ++_evictions;
+        }
     }
 }
 
 bool
 ElevationPool::tryTile(const TileKey& key, MapFrame& frame, osg::ref_ptr<Tile>& out)
 {
-    // first see whether the tile is available
-    _tilesMutex.lock();
-
-    // locate the tile in the local tile cache:
-    osg::observer_ptr<Tile>& tile_obs = _tiles[key];
-
     osg::ref_ptr<Tile> tile;
+    bool load = false;
 
-    // Get a safe pointer to it. If this is NULL, we need to create and
-    // fetch a new tile from the Map.
-    if (!tile_obs.lock(tile))
+    // locate the tile in the local tile cache, and mark it as recently used:
     {
-        // a new tile; status -> EMPTY
-        tile = new Tile();
-        tile->_key = key;
+        Shard& shard = getShard(key);
+        Threading::ScopedMutexLock lock(shard._mutex);
 
-        // update the LRU:
-        _mru.push_front(tile.get());
-
-        // prune the MRU if necessary:
-        if (++_entries > _maxEntries )
+        osg::ref_ptr<Tile>& entry = shard._tiles[key];
+        if (!entry.valid())
         {
-            popMRU();
-            --_entries;
+            // a new tile; this thread loads it and the rest wait.
+            entry = new Tile();
+            entry->_key = key;
+            entry->_status.exchange(STATUS_IN_PROGRESS);
+            shard.pushFront(entry.get());
+            ++_entries;
+            load = true;
+        }
+        else
+        {
+            shard.unlink(entry.get());
+            shard.pushFront(entry.get());
         }
 
-        // add to the main cache (after putting it on the LRU).
-        tile_obs = tile;
+        entry->_lastUsed = ++_clock;
+        tile = entry.get();
     }
-       
-    // This means the tile object exists but has yet to be populated:
-    if ( tile->_status == STATUS_EMPTY )
+
+    if ( load )
     {
-        OE_TEST << "  getTile(" << key.str() << ") -> fetch from map\n";
-        tile->_status.exchange(STATUS_IN_PROGRESS);
-        _tilesMutex.unlock();
+        prune();
 
+        OE_TEST << "  getTile(" << key.str() << ") -> fetch from map\n";
+        ++_misses;
         bool ok = fetchTileFromMap(key, frame, tile.get());
         tile->_status.exchange( ok ? STATUS_AVAILABLE : STATUS_FAIL );
+
+        // wake up any other queries waiting on this tile:
+        tile->_loaded.set();
         
         out = ok ? tile.get() : 0L;
         return ok;
@@ -228,19 +468,8 @@ ElevationPool::tryTile(const TileKey& key, MapFrame& frame, osg::ref_ptr<Tile>&
     else if ( tile->_status == STATUS_AVAILABLE )
     {
         OE_TEST << "  getTile(" << key.str() << ") -> available\n";
+        ++_hits;
         out = tile.get();
-
-        // Mark this tile as recently used:
-        _mru.push_front(tile.get());
-
-        // prune the MRU if necessary
-        if (++_entries > _maxEntries)
-        {
-            popMRU();
-            --_entries;
-        }
-
-        _tilesMutex.unlock();
         return true;
     }
 
@@ -248,17 +477,31 @@ ElevationPool::tryTile(const TileKey& key, MapFrame& frame, osg::ref_ptr<Tile>&
     else if ( tile->_status == STATUS_FAIL )
     {
         OE_TEST << "  getTile(" << key.str() << ") -> fail\n";
-        _tilesMutex.unlock();
+        ++_failures;
         out = 0L;
         return false;
     }
 
-    // This means tile data fetch is still in progress (in another thread)
-    // and the caller should check back later.
+    // This means tile data fetch is still in progress (in another thread).
+    // Share that load instead of starting another one: wait for it to finish,
+    // and if it takes too long, tell the caller to check back later.
     else //if ( tile->_status == STATUS_IN_PROGRESS )
     {
         OE_DEBUG << "  getTile(" << key.str() << ") -> in progress...waiting\n";
-        _tilesMutex.unlock();
+
+        tile->_loaded.wait(1000u);
+
+        if ( tile->_status == STATUS_AVAILABLE )
+        {
+            out = tile.get();
+            return true;
+        }
+        else if ( tile->_status == STATUS_FAIL )
+        {
+            out = 0L;
+            return false;
+        }
+
         out = 0L;
         return true;            // out:NULL => check back later please.
     }
@@ -267,10 +510,20 @@ ElevationPool::tryTile(const TileKey& key, MapFrame& frame, osg::ref_ptr<Tile>&
 void
 ElevationPool::clearImpl()
 {
-    // assumes the tiles lock is taken.
-    _tiles.clear();
-    _mru.clear();
-    _entries = 0u;
+    // take every shard lock so the entry count stays in step with the shards:
+    for (unsigned i = 0; i < NUM_SHARDS; ++i)
+        _shards[i]._mutex.lock();
+
+    for (unsigned i = 0; i < NUM_SHARDS; ++i)
+    {
+        _shards[i]._tiles.clear();
+        _shards[i]._newest = 0L;
+        _shards[i]._oldest = 0L;
+    }
+    _entries.exchange(0u);
+
+    for (unsigned i = 0; i < NUM_SHARDS; ++i)
+        _shards[i]._mutex.unlock();
 }
 
 bool
@@ -335,6 +588,72 @@ ElevationPool::createEnvelope(const SpatialReference* srs, unsigned lod)
 
 //........................................................................
 
+namespace
+{
+    /**
+     * Bilinearly samples a group of points that all fall within one heightfield.
+     * The points must already be in the heightfield's SRS. The results match
+     * HeightFieldUtils::getHeightAtLocation(..., INTERP_BILINEAR), but the
+     * per-heightfield constants are hoisted out of the loop and the heights are
+     * read straight from the buffer.
+     */
+    void sampleBilinear(const GeoHeightField&           geohf,
+                        const std::vector<osg::Vec3d>&  points,
+                        const std::vector<unsigned>&    indices,
+                        std::vector<float>&             output)
+    {
+        const osg::HeightField* hf = geohf.getHeightField();
+        const GeoExtent& extent = geohf.getExtent();
+
+        const int cols = (int)hf->getNumColumns();
+        const int rows = (int)hf->getNumRows();
+        const float* heights = &hf->getFloatArray()->front();
+
+        const double xMin = extent.xMin();
+        const double yMin = extent.yMin();
+        const double maxCol = (double)(cols-1);
+        const double maxRow = (double)(rows-1);
+        const double xScale = maxCol / extent.width();
+        const double yScale = maxRow / extent.height();
+
+        for (std::vector<unsigned>::const_iterator i = indices.begin(); i != indices.end(); ++i)
+        {
+            const osg::Vec3d& p = points[*i];
+
+            double c = osg::clampBetween((p.x() - xMin) * xScale, 0.0, maxCol);
+            double r = osg::clampBetween((p.y() - yMin) * yScale, 0.0, maxRow);
+
+            int colMin = (int)c;
+            int rowMin = (int)r;
+            int colMax = osg::minimum(colMin+1, cols-1);
+            int rowMax = osg::minimum(rowMin+1, rows-1);
+
+            // fractional offsets; zero on the last row/column, which collapses
+            // the kernel to a linear (or exact) lookup.
+            double fx = colMax > colMin ? c - (double)colMin : 0.0;
+            double fy = rowMax > rowMin ? r - (double)rowMin : 0.0;
+
+            float ll = heights[rowMin*cols + colMin];
+            float lr = heights[rowMin*cols + colMax];
+            float ul = heights[rowMax*cols + colMin];
+            float ur = heights[rowMax*cols + colMax];
+
+            if (ll == NO_DATA_VALUE || lr == NO_DATA_VALUE || ul == NO_DATA_VALUE || ur == NO_DATA_VALUE)
+            {
+                if (!HeightFieldUtils::validateSamples(ur, ll, ul, lr))
+                {
+                    output[*i] = NO_DATA_VALUE;
+                    continue;
+                }
+            }
+
+            double r1 = (1.0-fx)*(double)ll + fx*(double)lr;
+            double r2 = (1.0-fx)*(double)ul + fx*(double)ur;
+            output[*i] = (float)((1.0-fy)*r1 + fy*r2);
+        }
+    }
+}
+
 ElevationEnvelope::ElevationEnvelope() :
 _pool(0L)
 {
@@ -425,26 +744,139 @@ ElevationEnvelope::getElevationAndResolution(double x, double y)
 }
 
 unsigned
-ElevationEnvelope::getElevations(const std::vector<osg::Vec3d>& input,
-                                 std::vector<float>& output)
+ElevationEnvelope::sampleBatch(const std::vector<osg::Vec3d>& input,
+                               std::vector<float>& out_elevations,
+                               std::vector<float>* out_resolutions)
 {
-    METRIC_SCOPED_EX("ElevationEnvelope::getElevations", 1, "num", toString(input.size()).c_str());
+    out_elevations.assign(input.size(), NO_DATA_VALUE);
+    if (out_resolutions)
+        out_resolutions->assign(input.size(), 0.0f);
 
-    unsigned count = 0u;
+    if (input.empty())
+        return 0u;
 
-    output.reserve(input.size());
-    output.clear();
+    // Transform all the points into the map's SRS in one call:
+    std::vector<osg::Vec3d> points(input);
+    for (std::vector<osg::Vec3d>::iterator p = points.begin(); p != points.end(); ++p)
+        p->z() = 0.0;
 
-    // for each input point:
-    for (std::vector<osg::Vec3d>::const_iterator v = input.begin(); v != input.end(); ++v)
+    const SpatialReference* mapSRS = _frame.getProfile()->getSRS();
+    if (_inputSRS.valid() && !_inputSRS->transform(points, mapSRS))
     {
-        float elevation, resolution;
-        sample(v->x(), v->y(), elevation, resolution);
-        output.push_back(elevation);
-        if (elevation != NO_DATA_VALUE)
+        OE_WARN << LC << "sampleBatch: xform failed" << std::endl;
+        return 0u;
+    }
+
+    // Bin the points by the tile that covers them. Tiles already in the query set
+    // take precedence (from high to low resolution), just as in sample().
+    typedef std::map<ElevationPool::Tile*, std::vector<unsigned> > Bins;
+    Bins bins;
+    std::vector<unsigned> misses;
+
+    for (unsigned i = 0; i < points.size(); ++i)
+    {
+        const osg::Vec3d& p = points[i];
+        bool found = false;
+
+        for (ElevationPool::QuerySet::const_iterator tile_ref = _tiles.begin();
+            tile_ref != _tiles.end() && !found;
+            ++tile_ref)
+        {
+            ElevationPool::Tile* tile = tile_ref->get();
+            if (tile->_bounds.contains(p.x(), p.y()) &&
+                tile->_hf.getExtent().contains(p.x(), p.y()))
+            {
+                bins[tile].push_back(i);
+                found = true;
+            }
+        }
+
+        if (!found)
+            misses.push_back(i);
+    }
+
+    // For points not covered by the query set, fetch one tile per key at the
+    // envelope's LOD and add it to the query set for subsequent calls.
+    std::set<ElevationPool::Tile*> fetched;
+
+    if (!misses.empty() && _pool)
+    {
+        std::map<TileKey, ElevationPool::Tile*> fetchedByKey;
+
+        for (std::vector<unsigned>::const_iterator i = misses.begin(); i != misses.end(); ++i)
+        {
+            const osg::Vec3d& p = points[*i];
+
+            TileKey key = _frame.getProfile()->createTileKey(p.x(), p.y(), _lod);
+            if (!key.valid())
+                continue;
+
+            ElevationPool::Tile* tile = 0L;
+
+            std::map<TileKey, ElevationPool::Tile*>::const_iterator f = fetchedByKey.find(key);
+            if (f != fetchedByKey.end())
+            {
+                tile = f->second;
+            }
+            else
+            {
+                osg::ref_ptr<ElevationPool::Tile> newTile;
+                if (_pool->getTile(key, _frame, newTile))
+                {
+                    _tiles.insert(newTile.get());
+                    tile = newTile.get();
+                    fetched.insert(tile);
+                }
+                // remember failures too so we only ask once per key:
+                fetchedByKey[key] = tile;
+            }
+
+            if (tile && tile->_hf.getExtent().contains(p.x(), p.y()))
+            {
+                bins[tile].push_back(*i);
+            }
+        }
+    }
+
+    // Interpolate each bin from its tile's height buffer:
+    for (Bins::const_iterator bin = bins.begin(); bin != bins.end(); ++bin)
+    {
+        ElevationPool::Tile* tile = bin->first;
+        if (!tile->_hf.valid())
+            continue;
+
+        sampleBilinear(tile->_hf, points, bin->second, out_elevations);
+
+        if (out_resolutions)
+        {
+            const osg::HeightField* hf = tile->_hf.getHeightField();
+            float res = fetched.find(tile) != fetched.end() ?
+                0.5f*(hf->getXInterval() + hf->getYInterval()) :
+                hf->getXInterval();
+
+            for (std::vector<unsigned>::const_iterator i = bin->second.begin(); i != bin->second.end(); ++i)
+                (*out_resolutions)[*i] = res;
+        }
+    }
+
+    unsigned count = 0u;
+    for (std::vector<float>::const_iterator e = out_elevations.begin(); e != out_elevations.end(); ++e)
+    {
+        if (*e != NO_DATA_VALUE)
             ++count;
     }
 
+    return count;
+}
+
+unsigned
+ElevationEnvelope::getElevations(const std::vector<osg::Vec3d>& input,
+                                 std::vector<float>& output)
+{
+    METRIC_SCOPED_EX("ElevationEnvelope::getElevations", 1, "num", toString(input.size()).c_str());
+
+    unsigned count = sampleBatch(input, output, 0L);
+
     if (count < input.size())
     {
         OE_WARN << LC << "Issue: Envelope had failed samples" << std::endl;
@@ -459,6 +891,15 @@ ElevationEnvelope::getElevations(const std::vector<osg::Vec3d>& input,
     return count;
 }
 
+unsigned
+ElevationEnvelope::getElevationsAndResolutions(const std::vector<osg::Vec3d>& input,
+                                               std::vector<float>& out_elevations,
+                                               std::vector<float>& out_resolutions)
+{
+    METRIC_SCOPED_EX("ElevationEnvelope::getElevationsAndResolutions", 1, "num", toString(input.size()).c_str());
+    return sampleBatch(input, out_elevations, &out_resolutions);
+}
+
 bool
 ElevationEnvelope::getElevationExtrema(const std::vector<osg::Vec3d>& input,
                                        float& min, float& max)
@@ -468,17 +909,17 @@ ElevationEnvelope::getElevationExtrema(const std::vector<osg::Vec3d>& input,
 
     min = FLT_MAX, max = -FLT_MAX;
 
-    unsigned count = 0;
+    std::vector<float> elevations;
+    sampleBatch(input, elevations, 0L);
 
     osg::Vec3d centroid;
 
-    for (std::vector<osg::Vec3d>::const_iterator v = input.begin(); v != input.end(); ++v)
+    for (unsigned i = 0; i < input.size(); ++i)
     {
-        centroid += *v;
+        centroid += input[i];
 
-        float elevation, resolution;
-        
-        if (sample(v->x(), v->y(), elevation, resolution))
+        float elevation = elevations[i];
+        if (elevation != NO_DATA_VALUE)
         {
             if (elevation < min) min = elevation;
             if (elevation > max) max = elevation;
@@ -18,6 +18,7 @@
  */
 
 #include <osgEarth/LocalTangentPlane>
+#include <osgEarth/ECEF>
 #include <osg/Math>
 #include <osg/Notify>
 #include <sstream>
@@ -61,14 +62,10 @@ TangentPlaneSpatialReference::_init()
 const SpatialReference*
 TangentPlaneSpatialReference::preTransform(std::vector<osg::Vec3d>& points) const
 {
-    for(std::vector<osg::Vec3d>::iterator i = points.begin(); i != points.end(); ++i)
+    if ( !points.empty() )
     {
-        osg::Vec3d world = (*i) * _local2world;
-        double lat, lon, height;
-        getEllipsoid()->convertXYZToLatLongHeight(world.x(), world.y(), world.z(), lat, lon, height);
-        i->x() = osg::RadiansToDegrees(lon);
-        i->y() = osg::RadiansToDegrees(lat);
-        i->z() = height;
+        ECEF::localize( &points[0], points.size(), _local2world );
+        ECEF::ECEFToGeodetic( &points[0], points.size(), getEllipsoid() );
     }
     return getGeodeticSRS();
 }
@@ -76,13 +73,10 @@ TangentPlaneSpatialReference::preTransform(std::vector<osg::Vec3d>& points) cons
 const SpatialReference*
 TangentPlaneSpatialReference::postTransform(std::vector<osg::Vec3d>& points) const
 {
-    osg::Vec3d world;
-    for(std::vector<osg::Vec3d>::iterator i = points.begin(); i != points.end(); ++i)
+    if ( !points.empty() )
     {
-        getEllipsoid()->convertLatLongHeightToXYZ(
-            osg::DegreesToRadians(i->y()), osg::DegreesToRadians(i->x()), i->z(),
-            world.x(), world.y(), world.z() );
-        i->set( world * _world2local );
+        ECEF::geodeticToECEF( &points[0], points.size(), getEllipsoid() );
+        ECEF::localize( &points[0], points.size(), _world2local );
     }
     return getGeodeticSRS();
 }
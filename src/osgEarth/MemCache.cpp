@@ -19,46 +19,130 @@
 #include <osgEarth/MemCache>
 #include <osgEarth/StringUtils>
 #include <osgEarth/ThreadingUtils>
-#include <osgEarth/Containers>
+#include <osgEarth/IOTypes>
+#include <osg/Image>
+#include <osg/Shape>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
 
 using namespace osgEarth;
 
 #define LC "[MemCacheBin] "
 
+// Number of separately locked shards in each bin.
+#define NUM_SHARDS 8u
+
+// Memory charged for an object of a type whose size we can't estimate.
+#define DEFAULT_OBJECT_SIZE 1024u
+
 //------------------------------------------------------------------------
 
-namespace
+namespace osgEarth
 {
-    typedef std::pair<osg::ref_ptr<const osg::Object>, Config> MemCacheEntry;
-    typedef LRUCache<std::string, MemCacheEntry> MemCacheLRU;
+    /**
+     * Number of records and memory in use, against optional limits.
+     * Each bin tracks its own, and the bins of a cache share another.
+     */
+    class MemCacheUsage : public osg::Referenced
+    {
+    public:
+        MemCacheUsage(unsigned maxEntries, unsigned maxBytes) :
+            _maxEntries(maxEntries), _maxBytes(maxBytes), _entries(0u), _bytes(0u) { }
+
+        void add(unsigned entries, unsigned bytes)
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            _entries += entries;
+            _bytes += bytes;
+        }
+
+        void remove(unsigned entries, unsigned bytes)
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            _entries -= osg::minimum(entries, _entries);
+            _bytes -= osg::minimum(bytes, _bytes);
+        }
+
+        bool isOverLimit() const
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            return
+                (_maxEntries > 0u && _entries > _maxEntries) ||
+                (_maxBytes > 0u && _bytes > _maxBytes);
+        }
+
+        void get(unsigned& entries, unsigned& bytes) const
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            entries = _entries;
+            bytes = _bytes;
+        }
+
+        const unsigned _maxEntries;
+        const unsigned _maxBytes;
+
+    protected:
+        virtual ~MemCacheUsage() { }
+
+    private:
+        unsigned _entries;
+        unsigned _bytes;
+        mutable Threading::Mutex _mutex;
+    };
 
-    struct MemCacheBin : public CacheBin
+    /**
+     * A bin of a MemCache. Records are kept in shards by hashed key; a record
+     * also holds the full key, so a hash collision just reads as a miss (and
+     * a write replaces the record it collides with).
+     */
+    class MemCacheBin : public CacheBin
     {
-        MemCacheBin( const std::string& id, unsigned maxSize )
-            : CacheBin( id ),
-              _lru    ( true /* MT-safe */, maxSize )
+    public:
+        MemCacheBin(const std::string& id, unsigned maxSize, MemCacheUsage* sharedUsage) :
+            CacheBin    ( id ),
+            _clock      ( 0.0 ),
+            _usage      ( new MemCacheUsage(maxSize, 0u) ),
+            _sharedUsage( sharedUsage )
         {
             //nop
         }
 
-        ReadResult readObject(const std::string& key, const osgDB::Options*)
+        virtual ~MemCacheBin()
         {
-            MemCacheLRU::Record rec;
-            _lru.get(key, rec);
+            clear();
+        }
 
-            // clone required since the cache is in memory
+        ReadResult readObject(const std::string& key, const osgDB::Options*)
+        {
+            unsigned hash = hashString(key);
+            Shard& shard = getShard(hash);
 
-            if ( rec.valid() )
+            osg::ref_ptr<const osg::Object> object;
+            Config meta;
             {
-                //OE_INFO << LC << "hits: " << _lru.getStats()._hitRatio*100.0f << "%" << std::endl;
+                Threading::ScopedMutexLock lock(shard._mutex);
+                ++shard._queries;
+                Record* rec = shard.find(hash, key);
+                if ( rec )
+                {
+                    ++shard._hits;
+                    shard.touch(hash, *rec, getClock());
+                    object = rec->_object.get();
+                    meta = rec->_meta;
+                }
+            }
 
+            // clone required since the cache is in memory
+            if ( object.valid() )
+            {
                 return ReadResult( 
-                   osg::clone(rec.value().first.get(), osg::CopyOp::DEEP_COPY_ALL),
-                   rec.value().second );
+                   osg::clone(object.get(), osg::CopyOp::DEEP_COPY_ALL),
+                   meta );
             }
             else
             {
-                //OE_INFO << LC << "hits: " << _lru.getStats()._hitRatio*100.0f << "%" << std::endl;
                 return ReadResult();
             }
         }
@@ -75,68 +159,373 @@ namespace
 
         bool write( const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* writeOptions)
         {
-            if ( object ) 
+            if ( !object )
+                return false;
+
+            osg::ref_ptr<const osg::Object> cloned = osg::clone(object, osg::CopyOp::DEEP_COPY_ALL);
+            unsigned size = getSizeInBytes(cloned.get(), key);
+            double value = getCost(cloned.get()) / (double)size;
+
+            unsigned hash = hashString(key);
+            Shard& shard = getShard(hash);
+
+            // release evicted objects after unlocking, since that can take a while.
+            std::vector< osg::ref_ptr<const osg::Object> > released;
             {
-                osg::ref_ptr<const osg::Object> cloned = osg::clone(object, osg::CopyOp::DEEP_COPY_ALL);
-                _lru.insert( key, std::make_pair(cloned.get(), meta) );
-                return true;
+                Threading::ScopedMutexLock lock(shard._mutex);
+
+                Shard::Records::iterator i = shard._records.find(hash);
+                if ( i != shard._records.end() )
+                {
+                    released.push_back( i->second._object.get() );
+                    erase(shard, i);
+                }
+
+                Record& rec = shard._records[hash];
+                rec._key = key;
+                rec._object = cloned.get();
+                rec._meta = meta;
+                rec._size = size;
+                rec._value = value;
+                rec._priority = getClock() + value;
+                shard._queue.insert( std::make_pair(rec._priority, hash) );
+
+                _usage->add(1u, size);
+                _sharedUsage->add(0u, size);
             }
-            else
-                return false;
+
+            makeRoom(shard, hash, released);
+
+            return true;
         }
 
         bool remove(const std::string& key)
         {
-            _lru.erase(key);
+            unsigned hash = hashString(key);
+            Shard& shard = getShard(hash);
+            osg::ref_ptr<const osg::Object> released;
+
+            Threading::ScopedMutexLock lock(shard._mutex);
+            Shard::Records::iterator i = shard._records.find(hash);
+            if ( i != shard._records.end() && i->second._key == key )
+            {
+                released = i->second._object.get();
+                erase(shard, i);
+            }
             return true;
         }
 
         bool touch(const std::string& key)
         {
-            // just doing a get will put it at the front of the LRU list
-            MemCacheLRU::Record dummy;
-            return _lru.get(key, dummy);
+            unsigned hash = hashString(key);
+            Shard& shard = getShard(hash);
+
+            Threading::ScopedMutexLock lock(shard._mutex);
+            Record* rec = shard.find(hash, key);
+            if ( rec )
+                shard.touch(hash, *rec, getClock());
+            return rec != 0L;
         }
 
         RecordStatus getRecordStatus( const std::string& key )
         {
+            unsigned hash = hashString(key);
+            Shard& shard = getShard(hash);
+
             // ignore minTime; MemCache does not support expiration
-            return _lru.has(key) ? STATUS_OK : STATUS_NOT_FOUND;
+            Threading::ScopedMutexLock lock(shard._mutex);
+            return shard.find(hash, key) ? STATUS_OK : STATUS_NOT_FOUND;
         }
 
-        bool purge()
+        bool clear()
         {
-            _lru.clear();
+            for(unsigned s = 0; s < NUM_SHARDS; ++s)
+            {
+                Shard& shard = _shards[s];
+                std::vector< osg::ref_ptr<const osg::Object> > released;
+                {
+                    Threading::ScopedMutexLock lock(shard._mutex);
+                    while ( !shard._records.empty() )
+                    {
+                        released.push_back( shard._records.begin()->second._object.get() );
+                        erase(shard, shard._records.begin());
+                    }
+                }
+            }
+
+            Threading::ScopedMutexLock lock(_clockMutex);
+            _clock = 0.0;
             return true;
         }
 
+        unsigned getStorageSize()
+        {
+            unsigned entries, bytes;
+            _usage->get(entries, bytes);
+            return bytes;
+        }
+
         std::string getHashedKey(const std::string& key) const
         {
             return key;
         }
 
-        MemCacheLRU _lru;
+        CacheStats getStats() const
+        {
+            unsigned entries, bytes, queries = 0u, hits = 0u;
+            _usage->get(entries, bytes);
+            for(unsigned s = 0; s < NUM_SHARDS; ++s)
+            {
+                Threading::ScopedMutexLock lock(_shards[s]._mutex);
+                queries += _shards[s]._queries;
+                hits += _shards[s]._hits;
+            }
+            return CacheStats(
+                entries, _usage->_maxEntries, queries, queries > 0u ? (float)hits/(float)queries : 0.0f,
+                bytes, _sharedUsage->_maxBytes );
+        }
+
+    private:
+
+        struct Record
+        {
+            std::string                     _key;
+            osg::ref_ptr<const osg::Object> _object;
+            Config                          _meta;
+            unsigned                        _size;      // estimated memory use
+            double                          _value;     // cost to recreate per byte
+            double                          _priority;  // eviction order; lowest goes first
+        };
+
+        struct Shard
+        {
+            Shard() : _queries(0u), _hits(0u) { }
+
+            typedef std::map<unsigned, Record> Records;                  // by hashed key
+            typedef std::set< std::pair<double, unsigned> > Queue;       // (priority, hashed key)
+
+            Records _records;
+            Queue   _queue;
+            unsigned _queries;
+            unsigned _hits;
+            mutable Threading::Mutex _mutex;
+
+            Record* find(unsigned hash, const std::string& key)
+            {
+                Records::iterator i = _records.find(hash);
+                return i != _records.end() && i->second._key == key ? &i->second : 0L;
+            }
+
+            // a record that's read goes back to the end of the queue, less
+            // far for records that are cheap to recreate.
+            void touch(unsigned hash, Record& rec, double clock)
+            {
+                _queue.erase( std::make_pair(rec._priority, hash) );
+                rec._priority = clock + rec._value;
+                _queue.insert( std::make_pair(rec._priority, hash) );
+            }
+
+            // the least valuable record, passing over the one with hash
+            // "*except" if that's set.
+            Queue::iterator lowest(const unsigned* except)
+            {
+                Queue::iterator i = _queue.begin();
+                if ( i != _queue.end() && except && i->second == *except )
+                    ++i;
+                return i;
+            }
+        };
+
+        Shard& getShard(unsigned hash)
+        {
+            return _shards[hash % NUM_SHARDS];
+        }
+
+        // priority of the last record evicted
+        double getClock() const
+        {
+            Threading::ScopedMutexLock lock(_clockMutex);
+            return _clock;
+        }
+
+        // Evicts the least valuable records in the whole bin until it's back
+        // under its limits, keeping the record just written (the one with
+        // "keepHash" in "keepShard"). Takes one shard's mutex at a time, so
+        // call it with none of them taken.
+        void makeRoom(Shard& keepShard, unsigned keepHash, std::vector< osg::ref_ptr<const osg::Object> >& released)
+        {
+            while ( _usage->isOverLimit() || _sharedUsage->isOverLimit() )
+            {
+                Shard* victimShard = 0L;
+                double victimPriority = 0.0;
+                for(unsigned s = 0; s < NUM_SHARDS; ++s)
+                {
+                    Shard& shard = _shards[s];
+                    Threading::ScopedMutexLock lock(shard._mutex);
+                    Shard::Queue::iterator i = shard.lowest(&shard == &keepShard ? &keepHash : 0L);
+                    if ( i != shard._queue.end() && (!victimShard || i->first < victimPriority) )
+                    {
+                        victimShard = &shard;
+                        victimPriority = i->first;
+                    }
+                }
+
+                // nothing left but the new record
+                if ( !victimShard )
+                    break;
+
+                // the shard may have changed since we looked; if so, its least
+                // valuable record now is still a fair choice.
+                Threading::ScopedMutexLock lock(victimShard->_mutex);
+                Shard::Queue::iterator victim = victimShard->lowest(victimShard == &keepShard ? &keepHash : 0L);
+                if ( victim != victimShard->_queue.end() )
+                {
+                    // "inflate" the clock so records that don't get read age out
+                    {
+                        Threading::ScopedMutexLock clockLock(_clockMutex);
+                        _clock = std::max(_clock, victim->first);
+                    }
+
+                    Shard::Records::iterator i = victimShard->_records.find(victim->second);
+                    released.push_back( i->second._object.get() );
+                    erase(*victimShard, i);
+                }
+            }
+        }
+
+        // removes a record; assumes the shard's mutex is taken.
+        void erase(Shard& shard, Shard::Records::iterator i)
+        {
+            _usage->remove(1u, i->second._size);
+            _sharedUsage->remove(0u, i->second._size);
+            shard._queue.erase( std::make_pair(i->second._priority, i->first) );
+            shard._records.erase(i);
+        }
+
+        // estimated memory used by a record
+        static unsigned getSizeInBytes(const osg::Object* object, const std::string& key)
+        {
+            unsigned size = sizeof(Record) + key.size();
+
+            if ( dynamic_cast<const osg::Image*>(object) )
+            {
+                const osg::Image* image = static_cast<const osg::Image*>(object);
+                size += sizeof(osg::Image) + image->getTotalSizeInBytesIncludingMipmaps();
+            }
+            else if ( dynamic_cast<const osg::HeightField*>(object) )
+            {
+                const osg::HeightField* hf = static_cast<const osg::HeightField*>(object);
+                size += sizeof(osg::HeightField) + hf->getNumColumns()*hf->getNumRows()*sizeof(float);
+            }
+            else if ( dynamic_cast<const StringObject*>(object) )
+            {
+                size += sizeof(StringObject) + static_cast<const StringObject*>(object)->getString().size();
+            }
+            else
+            {
+                size += DEFAULT_OBJECT_SIZE;
+            }
+            return size;
+        }
+
+        // relative cost of recreating a record. Heightfields cost more than
+        // images: building a tile's elevation reads its neighbors too.
+        static double getCost(const osg::Object* object)
+        {
+            return dynamic_cast<const osg::HeightField*>(object) ? 2.0 : 1.0;
+        }
+
+        Shard                       _shards[NUM_SHARDS];
+        double                      _clock;
+        mutable Threading::Mutex    _clockMutex;
+        osg::ref_ptr<MemCacheUsage> _usage;
+        osg::ref_ptr<MemCacheUsage> _sharedUsage;
     };
-    
+}
 
+namespace
+{
     static Threading::Mutex s_defaultBinMutex;
 }
 
 //------------------------------------------------------------------------
 
-MemCache::MemCache( unsigned maxBinSize ) :
+MemCache::MemCache( unsigned maxBinSize, unsigned maxBytes ) :
 _maxBinSize( std::max(maxBinSize, 1u) ),
-_reads(0),
-_writes(0),
-_hits(0)
+_usage     ( new MemCacheUsage(0u, maxBytes) )
+{
+    //nop
+}
+
+MemCache::MemCache( const MemCache& rhs, const osg::CopyOp& op ) :
+Cache      ( rhs, op ),
+_maxBinSize( rhs._maxBinSize ),
+_usage     ( new MemCacheUsage(0u, rhs._usage->_maxBytes) )
+{
+    //nop
+}
+
+MemCache::~MemCache()
 {
     //nop
 }
 
+unsigned
+MemCache::getMaxBytes() const
+{
+    return _usage->_maxBytes;
+}
+
+unsigned
+MemCache::getNumBytes() const
+{
+    unsigned entries, bytes;
+    _usage->get(entries, bytes);
+    return bytes;
+}
+
 CacheBin*
 MemCache::addBin( const std::string& binID )
 {
-    return _bins.getOrCreate( binID, new MemCacheBin(binID, _maxBinSize) );
+    osg::ref_ptr<MemCacheBin> newBin = new MemCacheBin(binID, _maxBinSize, _usage.get());
+    CacheBin* bin = _bins.getOrCreate( binID, newBin.get() );
+    if ( bin == newBin.get() )
+    {
+        Threading::ScopedMutexLock lock( _allBinsMutex );
+        _allBins.push_back( newBin.get() );
+    }
+    return bin;
+}
+
+void
+MemCache::removeBin( CacheBin* bin )
+{
+    if ( bin )
+    {
+        std::string binID = bin->getID();
+        Cache::removeBin( bin );
+
+        osg::ref_ptr<MemCacheBin> removed;
+        {
+            Threading::ScopedMutexLock lock( _allBinsMutex );
+            for(std::vector< osg::ref_ptr<MemCacheBin> >::iterator i = _allBins.begin(); i != _allBins.end(); ++i)
+            {
+                if ( (*i)->getID() == binID )
+                {
+                    removed = i->get();
+                    _allBins.erase( i );
+                    break;
+                }
+            }
+        }
+
+        // Empty it too: whoever still holds the bin would otherwise keep its
+        // records using up the memory the other bins share.
+        if ( removed.valid() )
+        {
+            removed->clear();
+        }
+    }
 }
 
 CacheBin*
@@ -157,18 +546,52 @@ MemCache::getOrCreateDefaultBin()
         // double check
         if ( !_defaultBin.valid() )
         {
-            _defaultBin = new MemCacheBin("__default", _maxBinSize);
+            MemCacheBin* bin = new MemCacheBin("__default", _maxBinSize, _usage.get());
+            {
+                Threading::ScopedMutexLock lock( _allBinsMutex );
+                _allBins.push_back( bin );
+            }
+            _defaultBin = bin;
         }
     }
 
     return _defaultBin.get();
 }
 
+CacheStats
+MemCache::getStats(const std::string& binID)
+{
+    MemCacheBin* bin = static_cast<MemCacheBin*>(getBin(binID));
+    return bin ? bin->getStats() : CacheStats(0u, _maxBinSize, 0u, 0.0f, 0u, getMaxBytes());
+}
+
+CacheStats
+MemCache::getStats()
+{
+    unsigned entries = 0u, maxEntries = 0u, queries = 0u;
+    float hits = 0.0f;
+    {
+        Threading::ScopedMutexLock lock( _allBinsMutex );
+        for(unsigned i = 0; i < _allBins.size(); ++i)
+        {
+            CacheStats stats = _allBins[i]->getStats();
+            entries += stats._entries;
+            maxEntries += stats._maxEntries;
+            queries += stats._queries;
+            hits += stats._hitRatio * (float)stats._queries;
+        }
+    }
+    return CacheStats(
+        entries, maxEntries, queries, queries > 0u ? hits/(float)queries : 0.0f,
+        getNumBytes(), getMaxBytes() );
+}
 
 void
 MemCache::dumpStats(const std::string& binID)
 {
-    MemCacheBin* bin = static_cast<MemCacheBin*>(getBin(binID));
-    CacheStats stats = bin->_lru.getStats();
-    OE_INFO << LC << "hit ratio = " << stats._hitRatio << std::endl;
+    CacheStats stats = getStats(binID);
+    OE_INFO << LC 
+        << "entries = " << stats._entries << "/" << stats._maxEntries
+        << ", bytes = " << stats._bytes
+        << ", hit ratio = " << stats._hitRatio << std::endl;
 }
@@ -296,7 +296,7 @@ ModelLayer::setReadOptions(const osgDB::Options* readOptions)
         }
 
         // make our cacheing bin!
-        CacheBin* bin = _cacheSettings->getCache()->addBin(binID);
+        CacheBin* bin = _cacheSettings->getCache()->addLayerBin(binID);
         if (bin)
         {
             OE_INFO << LC << "Cache bin is [" << binID << "]\n";
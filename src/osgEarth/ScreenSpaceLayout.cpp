@@ -130,6 +130,111 @@ namespace
     
     typedef std::pair<const osg::Node*, osg::BoundingBox> RenderLeafBox;
 
+    // Width and height (pixels) of a DeclutterGrid cell, and the most cells
+    // along either axis.
+#define DECLUTTER_GRID_CELL_SIZE 64.0f
+#define DECLUTTER_GRID_MAX_CELLS 256u
+
+    /**
+     * Uniform grid over the window that indexes the screen-space boxes of
+     * the drawables that passed the declutter test. A new box is only tested
+     * against the boxes in the cells it covers, which keeps decluttering
+     * roughly linear in the number of drawables.
+     */
+    class DeclutterGrid
+    {
+    public:
+        DeclutterGrid() : _x0(0.0f), _y0(0.0f), _cols(1u), _rows(1u) { }
+
+        // Empties the grid and fits it to a window.
+        void reset(float x, float y, float width, float height)
+        {
+            _x0 = x;
+            _y0 = y;
+            _cols = osg::clampBetween((unsigned)ceil(width / DECLUTTER_GRID_CELL_SIZE), 1u, DECLUTTER_GRID_MAX_CELLS);
+            _rows = osg::clampBetween((unsigned)ceil(height / DECLUTTER_GRID_CELL_SIZE), 1u, DECLUTTER_GRID_MAX_CELLS);
+
+            // keep the cells' storage from frame to frame
+            unsigned numCells = _cols * _rows;
+            if (_cells.size() < numCells)
+                _cells.resize(numCells);
+            for (unsigned i = 0; i < numCells; ++i)
+                _cells[i].clear();
+
+            _boxes.clear();
+        }
+
+        // Whether a box overlaps any box in the grid, not counting boxes
+        // from the same parent.
+        bool overlaps(const osg::BoundingBox& box, const osg::Node* parent) const
+        {
+            unsigned c0, c1, r0, r1;
+            getCells(box, c0, c1, r0, r1);
+
+            for (unsigned r = r0; r <= r1; ++r)
+            {
+                for (unsigned c = c0; c <= c1; ++c)
+                {
+                    const std::vector<unsigned>& cell = _cells[r*_cols + c];
+                    for (std::vector<unsigned>::const_iterator i = cell.begin(); i != cell.end(); ++i)
+                    {
+                        const RenderLeafBox& used = _boxes[*i];
+
+                        // only need a 2D test since we're in clip space
+                        bool isClear =
+                            box.xMin() > used.second.xMax() ||
+                            box.xMax() < used.second.xMin() ||
+                            box.yMin() > used.second.yMax() ||
+                            box.yMax() < used.second.yMin();
+
+                        if (!isClear && parent != used.first)
+                            return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        void insert(const osg::BoundingBox& box, const osg::Node* parent)
+        {
+            unsigned index = _boxes.size();
+            _boxes.push_back(std::make_pair(parent, box));
+
+            unsigned c0, c1, r0, r1;
+            getCells(box, c0, c1, r0, r1);
+
+            for (unsigned r = r0; r <= r1; ++r)
+                for (unsigned c = c0; c <= c1; ++c)
+                    _cells[r*_cols + c].push_back(index);
+        }
+
+    private:
+        // Range of cells covered by a box; anything off the window lands
+        // in the edge cells.
+        void getCells(const osg::BoundingBox& box, unsigned& c0, unsigned& c1, unsigned& r0, unsigned& r1) const
+        {
+            c0 = toCell(box.xMin() - _x0, _cols);
+            c1 = toCell(box.xMax() - _x0, _cols);
+            r0 = toCell(box.yMin() - _y0, _rows);
+            r1 = toCell(box.yMax() - _y0, _rows);
+        }
+
+        static unsigned toCell(float offset, unsigned count)
+        {
+            float f = offset / DECLUTTER_GRID_CELL_SIZE;
+            if (!(f > 0.0f)) // also catches NaN
+                return 0u;
+            if (f >= (float)count)
+                return count - 1u;
+            return (unsigned)f;
+        }
+
+        float _x0, _y0;
+        unsigned _cols, _rows;
+        std::vector< std::vector<unsigned> > _cells; // indices into _boxes
+        std::vector<RenderLeafBox> _boxes;
+    };
+
     // Data structure stored one-per-View.
     struct PerCamInfo
     {
@@ -141,7 +246,7 @@ namespace
         // re-usable structures (to avoid unnecessary re-allocation)
         osgUtil::RenderBin::RenderLeafList _passed;
         osgUtil::RenderBin::RenderLeafList _failed;
-        std::vector<RenderLeafBox>         _used;
+        DeclutterGrid                      _used;
 
         // time stamp of the previous pass, for calculating animation speed
         osg::Timer_t _lastTimeStamp;
@@ -270,8 +375,6 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
         // Reset the local re-usable containers
         local._passed.clear();          // drawables that pass occlusion test
         local._failed.clear();          // drawables that fail occlusion test
-        local._used.clear();            // list of occupied bounding boxes in screen space
-
         // compute a window matrix so we can do window-space culling. If this is an RTT camera
         // with a reference camera attachment, we actually want to declutter in the window-space
         // of the reference camera. (e.g., for picking).
@@ -282,19 +385,23 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
         osg::Vec3f  refCamScale(1.0f, 1.0f, 1.0f);
         osg::Matrix refCamScaleMat;
         osg::Matrix refWindowMatrix = windowMatrix;
+        const osg::Viewport* refVP = vp;
 
         if ( cam->isRenderToTextureCamera() )
         {
             osg::Camera* refCam = dynamic_cast<osg::Camera*>(cam->getUserData());
             if ( refCam )
             {
-                const osg::Viewport* refVP = refCam->getViewport();
+                refVP = refCam->getViewport();
                 refCamScale.set( vp->width() / refVP->width(), vp->height() / refVP->height(), 1.0 );
                 refCamScaleMat.makeScale( refCamScale );
                 refWindowMatrix = refVP->computeWindowMatrix();
             }
         }
 
+        // occupied bounding boxes in (reference) window space
+        local._used.reset( refVP->x(), refVP->y(), refVP->width(), refVP->height() );
+
         // Track the parent nodes of drawables that are obscured (and culled). Drawables
         // with the same parent node (typically a Geode) are considered to be grouped and
         // will be culled as a group.
@@ -433,28 +540,11 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
                     visible = false;
                 }
 
-                else
+                // weed out any drawables that are obscured by closer drawables.
+                // (a conflict with a box from the same drawable parent is acceptable)
+                else if ( local._used.overlaps(box, drawableParent) )
                 {
-                    // weed out any drawables that are obscured by closer drawables.
-                    // TODO: think about a more efficient algorithm - right now we are just using
-                    // brute force to compare all bbox's
-                    for( std::vector<RenderLeafBox>::const_iterator j = local._used.begin(); j != local._used.end(); ++j )
-                    {
-                        // only need a 2D test since we're in clip space
-                        bool isClear =
-                            box.xMin() > j->second.xMax() ||
-                            box.xMax() < j->second.xMin() ||
-                            box.yMin() > j->second.yMax() ||
-                            box.yMax() < j->second.yMin();
-
-                        // if there's an overlap (and the conflict isn't from the same drawable
-                        // parent, which is acceptable), then the leaf is culled.
-                        if ( !isClear && drawableParent != j->first )
-                        {
-                            visible = false;
-                            break;
-                        }
-                    }
+                    visible = false;
                 }
             }
 
@@ -462,7 +552,7 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
             {
                 // passed the test, so add the leaf's bbox to the "used" list, and add the leaf
                 // to the final draw list.
-                local._used.push_back( std::make_pair(drawableParent, box) );
+                local._used.insert( box, drawableParent );
                 local._passed.push_back( leaf );
             }
 
@@ -52,65 +52,31 @@ namespace
         return "";
     }    
 
-    // http://en.wikipedia.org/wiki/Mercator_projection#Mathematics_of_the_projection
+    // Batch conversions; the math lives in ECEF so other code can share it.
     bool sphericalMercatorToGeographic( std::vector<osg::Vec3d>& points )
     {
-        for( unsigned i=0; i<points.size(); ++i )
-        {
-            double x = osg::clampBetween(points[i].x(), MERC_MINX, MERC_MAXX);
-            double y = osg::clampBetween(points[i].y(), MERC_MINY, MERC_MAXY);
-            double xr = -osg::PI + ((x-MERC_MINX)/MERC_WIDTH)*2.0*osg::PI;
-            double yr = -osg::PI + ((y-MERC_MINY)/MERC_HEIGHT)*2.0*osg::PI;
-            points[i].x() = osg::RadiansToDegrees( xr );
-            points[i].y() = osg::RadiansToDegrees( 2.0 * atan( exp(yr) ) - osg::PI_2 );
-            // z doesn't change here.
-        }
+        if ( !points.empty() )
+            ECEF::sphericalMercatorToGeodetic( &points[0], points.size() );
         return true;
     }
 
-    // http://en.wikipedia.org/wiki/Mercator_projection#Mathematics_of_the_projection
     bool geographicToSphericalMercator( std::vector<osg::Vec3d>& points )
     {
-        for( unsigned i=0; i<points.size(); ++i )
-        {
-            double lon = osg::clampBetween(points[i].x(), -180.0, 180.0);
-            double lat = osg::clampBetween(points[i].y(), -90.0, 90.0);
-            double xr = (osg::DegreesToRadians(lon) - (-osg::PI)) / (2.0*osg::PI);
-            double sinLat = sin(osg::DegreesToRadians(lat));
-            double oneMinusSinLat = 1-sinLat;
-            if ( oneMinusSinLat != 0.0 )
-            {
-                double yr = ((0.5 * log( (1+sinLat)/oneMinusSinLat )) - (-osg::PI)) / (2.0*osg::PI);
-                points[i].x() = osg::clampBetween(MERC_MINX + (xr * MERC_WIDTH), MERC_MINX, MERC_MAXX);
-                points[i].y() = osg::clampBetween(MERC_MINY + (yr * MERC_HEIGHT), MERC_MINY, MERC_MAXY);
-                // z doesn't change here.
-            }
-        }
+        if ( !points.empty() )
+            ECEF::geodeticToSphericalMercator( &points[0], points.size() );
         return true;
     }
 
     void geodeticToECEF(std::vector<osg::Vec3d>& points, const osg::EllipsoidModel* em)
     {
-        for( unsigned i=0; i<points.size(); ++i )
-        {
-            double x, y, z;
-            em->convertLatLongHeightToXYZ(
-                osg::DegreesToRadians( points[i].y() ), osg::DegreesToRadians( points[i].x() ), points[i].z(),
-                x, y, z );
-            points[i].set( x, y, z );
-        }
+        if ( !points.empty() )
+            ECEF::geodeticToECEF( &points[0], points.size(), em );
     }
 
     void ECEFtoGeodetic(std::vector<osg::Vec3d>& points, const osg::EllipsoidModel* em)
     {
-        for( unsigned i=0; i<points.size(); ++i )
-        {
-            double lat, lon, alt;
-            em->convertXYZToLatLongHeight(
-                points[i].x(), points[i].y(), points[i].z(),
-                lat, lon, alt );
-            points[i].set( osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat), alt );
-        }
+        if ( !points.empty() )
+            ECEF::ECEFToGeodetic( &points[0], points.size(), em );
     }
 }
 
@@ -453,12 +419,13 @@ SpatialReference::~SpatialReference()
 {
     if ( _handle )
     {
-        GDAL_SCOPED_LOCK;
-
-        for (TransformHandleCache::iterator itr = _transformHandleCache.begin(); itr != _transformHandleCache.end(); ++itr)
+        for (unsigned i = 0; i < _idleTransformHandles.size(); ++i)
         {
-            OCTDestroyCoordinateTransformation(itr->second);
+            destroyTransformHandles( _idleTransformHandles[i] );
         }
+        _idleTransformHandles.clear();
+
+        GDAL_SCOPED_LOCK;
 
         if ( _owns_handle )
         {
@@ -659,10 +626,29 @@ SpatialReference::_isEquivalentTo( const SpatialReference* rhs, bool considerVDa
     }
 
     // last resort, since it requires the lock
+    return isSameOGR( rhs );
+}
+
+bool
+SpatialReference::isSameOGR( const SpatialReference* rhs ) const
+{
+    // The WKT names the OGR definition, so it keys the result.
+    {
+        Threading::ScopedReadLock shared( _sameAsCacheMutex );
+        SameAsCache::const_iterator i = _sameAsCache.find( rhs->_wkt );
+        if ( i != _sameAsCache.end() )
+            return i->second;
+    }
+
+    bool same;
     {
         GDAL_SCOPED_LOCK;
-        return TRUE == ::OSRIsSame( _handle, rhs->_handle );
+        same = TRUE == ::OSRIsSame( _handle, rhs->_handle );
     }
+
+    Threading::ScopedWriteLock exclusive( _sameAsCacheMutex );
+    _sameAsCache[rhs->_wkt] = same;
+    return same;
 }
 
 const SpatialReference*
@@ -1074,6 +1060,15 @@ SpatialReference::transform(std::vector<osg::Vec3d>& points,
         return success;
     }
 
+    // Same horizontal system (differing only in vertical datum, for example):
+    // X and Y don't change, so don't bother with OGR.
+    if ( inputSRS->isHorizEquivalentTo(outputSRS) )
+    {
+        success = inputSRS->transformZ( points, outputSRS, inputSRS->isGeographic() );
+        outputSRS->postTransform( points );
+        return success;
+    }
+
     // if the points are starting as geographic, do the Z's first to avoid an unneccesary
     // transformation in the case of differing vdatums.
     bool z_done = false;
@@ -1150,18 +1145,63 @@ SpatialReference::transform2D(double x, double y,
 }
 
 
+// Most idle handle sets an SRS keeps for reuse
+#define MAX_IDLE_TRANSFORM_HANDLES 16u
+
+SpatialReference::TransformHandleCache*
+SpatialReference::checkoutTransformHandles() const
+{
+    {
+        Threading::ScopedMutexLock lock( _transformHandlesMutex );
+        if ( !_idleTransformHandles.empty() )
+        {
+            TransformHandleCache* handles = _idleTransformHandles.back();
+            _idleTransformHandles.pop_back();
+            return handles;
+        }
+    }
+    return new TransformHandleCache();
+}
+
+void
+SpatialReference::returnTransformHandles(TransformHandleCache* handles) const
+{
+    {
+        Threading::ScopedMutexLock lock( _transformHandlesMutex );
+        if ( _idleTransformHandles.size() < MAX_IDLE_TRANSFORM_HANDLES )
+        {
+            _idleTransformHandles.push_back( handles );
+            return;
+        }
+    }
+    destroyTransformHandles( handles );
+}
+
+void
+SpatialReference::destroyTransformHandles(TransformHandleCache* handles)
+{
+    GDAL_SCOPED_LOCK;
+    for (TransformHandleCache::iterator itr = handles->begin(); itr != handles->end(); ++itr)
+    {
+        if ( itr->second )
+            OCTDestroyCoordinateTransformation(itr->second);
+    }
+    delete handles;
+}
+
 bool
 SpatialReference::transformXYPointArrays(double*  x,
                                          double*  y,
                                          unsigned count,
                                          const SpatialReference* out_srs) const
 {  
-    // Transform the X and Y values inside an exclusive GDAL/OGR lock
-    GDAL_SCOPED_LOCK;
+    // This transform has a set of handles to itself (each handle with its
+    // own PROJ context), so only creating a handle needs the GDAL/OGR lock.
+    TransformHandleCache* cache = checkoutTransformHandles();
 
     void* xform_handle = NULL;
-    TransformHandleCache::const_iterator itr = _transformHandleCache.find(out_srs->getWKT());
-    if (itr != _transformHandleCache.end())
+    TransformHandleCache::const_iterator itr = cache->find(out_srs->getWKT());
+    if (itr != cache->end())
     {
         //OE_DEBUG << LC << "using cached transform handle" << std::endl;
         xform_handle = itr->second;
@@ -1169,20 +1209,26 @@ SpatialReference::transformXYPointArrays(double*  x,
     else
     {
         OE_DEBUG << LC << "allocating new OCT Transform" << std::endl;
+        GDAL_SCOPED_LOCK;
         xform_handle = OCTNewCoordinateTransformation( _handle, out_srs->_handle);
-        const_cast<SpatialReference*>(this)->_transformHandleCache[out_srs->getWKT()] = xform_handle;
+        (*cache)[out_srs->getWKT()] = xform_handle;
     }
 
+    bool ok = false;
     if ( !xform_handle )
     {
         OE_WARN << LC
             << "SRS xform not possible" << std::endl
             << "    From => " << getName() << std::endl
             << "    To   => " << out_srs->getName() << std::endl;
-        return false;
+    }
+    else
+    {
+        ok = OCTTransform( xform_handle, count, x, y, 0L ) > 0;
     }
 
-    return OCTTransform( xform_handle, count, x, y, 0L ) > 0;
+    returnTransformHandles( cache );
+    return ok;
 }
 
 
@@ -1312,6 +1358,55 @@ SpatialReference::transformFromWorld(const osg::Vec3d& world,
     }
 }
 
+bool 
+SpatialReference::transformToWorld(std::vector<osg::Vec3d>& points) const
+{
+    if ( (isGeographic() && !isPlateCarre()) || isCube() )
+    {
+        return transform(points, getECEF());
+    }
+    else // isProjected || _is_plate_carre
+    {
+        if ( _vdatum.valid() && !points.empty() )
+        {
+            std::vector<osg::Vec3d> geo(points);
+            if ( !transform(geo, getGeographicSRS()) )
+                return false;
+
+            for( unsigned i=0; i<points.size(); ++i )
+            {
+                points[i].z() = _vdatum->msl2hae( geo[i].y(), geo[i].x(), points[i].z() );
+            }
+        }
+        return true;
+    }
+}
+
+bool 
+SpatialReference::transformFromWorld(std::vector<osg::Vec3d>& points) const
+{
+    if ( (isGeographic() && !isPlateCarre()) || isCube() )
+    {
+        return getECEF()->transform(points, this);
+    }
+    else // isProjected || _is_plate_carre
+    {
+        if ( _vdatum.valid() && !points.empty() )
+        {
+            // get the geographic coords by converting x/y/hae -> lat/long/msl:
+            std::vector<osg::Vec3d> lla(points);
+            if ( !transform(lla, getGeographicSRS()) )
+                return false;
+
+            for( unsigned i=0; i<points.size(); ++i )
+            {
+                points[i].z() = lla[i].z();
+            }
+        }
+        return true;
+    }
+}
+
 double
 SpatialReference::transformUnits(double                  input,
                                  const SpatialReference* outSRS,
@@ -216,6 +216,29 @@ osgEarth::hashToString(const std::string& input)
     return Stringify() << std::hex << std::setw(8) << std::setfill('0') << hashString(input);
 }
 
+unsigned
+osgEarth::hashStringFNV1a( const std::string& input, unsigned seed )
+{
+    unsigned h = seed;
+    for (std::string::const_iterator c = input.begin(); c != input.end(); ++c)
+    {
+        h ^= (unsigned char)*c;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+std::string
+osgEarth::contentHash( const std::string& data )
+{
+    unsigned h1 = hashString(data);
+    unsigned h2 = hashStringFNV1a(data);
+    unsigned h3 = hashStringFNV1a(data, h1);
+    return Stringify() << std::hex << std::setfill('0')
+        << std::setw(8) << h1 << std::setw(8) << h2 << std::setw(8) << h3
+        << "-" << data.length();
+}
+
 
 /** Parses an HTML color ("#rrggbb" or "#rrggbbaa") into an OSG color. */
 osg::Vec4f
@@ -306,7 +306,7 @@ TerrainLayer::open()
         // Initialize the l2 cache if it's size is > 0
         if ( l2CacheSize > 0 )
         {
-            _memCache = new MemCache( l2CacheSize );
+            _memCache = new MemCache( l2CacheSize, options().driver()->L2CacheBytes().get() );
         }
 
         // create the unique cache ID for the cache bin.
@@ -332,6 +332,7 @@ TerrainLayer::open()
             hashConf.remove("cache_policy");
             hashConf.remove("visible");
             hashConf.remove("l2_cache_size");
+            hashConf.remove("l2_cache_bytes");
 
             OE_DEBUG << "hashConfFinal = " << hashConf.toJSON(true) << std::endl;
 
@@ -409,7 +410,7 @@ TerrainLayer::open()
         // Finally, open and activate a caching bin for this layer.
         if (_cacheSettings->isCacheEnabled())
         {
-            CacheBin* bin = _cacheSettings->getCache()->addBin(_runtimeCacheId);
+            CacheBin* bin = _cacheSettings->getCache()->addLayerBin(_runtimeCacheId);
             if (bin)
             {
                 _cacheSettings->setCacheBin(bin);
@@ -144,6 +144,7 @@ TileBlacklist::write(std::ostream &output) const
 TileSourceOptions::TileSourceOptions( const ConfigOptions& options ) :
 DriverConfigOptions   ( options ),
 _L2CacheSize          ( 16 ),
+_L2CacheBytes         ( 0u ),
 _bilinearReprojection ( true ),
 _coverage             ( false )
 { 
@@ -157,6 +158,7 @@ TileSourceOptions::getConfig() const
     Config conf = DriverConfigOptions::getConfig();
     conf.set( "blacklist_filename", _blacklistFilename);
     conf.set( "l2_cache_size", _L2CacheSize );
+    conf.set( "l2_cache_bytes", _L2CacheBytes );
     conf.set( "bilinear_reprojection", _bilinearReprojection );
     conf.set( "coverage", _coverage );
     conf.set( "osg_option_string", _osgOptionString );
@@ -178,6 +180,7 @@ TileSourceOptions::fromConfig( const Config& conf )
 {
     conf.getIfSet( "blacklist_filename", _blacklistFilename);
     conf.getIfSet( "l2_cache_size", _L2CacheSize );
+    conf.getIfSet( "l2_cache_bytes", _L2CacheBytes );
     conf.getIfSet( "bilinear_reprojection", _bilinearReprojection );
     conf.getIfSet( "coverage", _coverage );
     conf.getIfSet( "osg_option_string", _osgOptionString );
@@ -226,7 +229,7 @@ _maxValidValue(  32000.0f )
     // Initialize the l2 cache if it's size is > 0
     if ( l2CacheSize > 0 )
     {
-        _memCache = new MemCache( l2CacheSize );
+        _memCache = new MemCache( l2CacheSize, *options.L2CacheBytes() );
     }
 
     if (_options.blacklistFilename().isSet())
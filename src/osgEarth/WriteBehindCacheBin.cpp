@@ -0,0 +1,397 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarth/WriteBehindCacheBin>
+#include <osgEarth/DateTime>
+#include <osgEarth/Metrics>
+#include <osgEarth/Notify>
+#include <osg/Image>
+#include <osg/Shape>
+#include <OpenThreads/Thread>
+#include <OpenThreads/ScopedLock>
+
+using namespace osgEarth;
+
+#define LC "[WriteBehindCacheBin] "
+
+typedef OpenThreads::ScopedLock<OpenThreads::Mutex> ScopedLock;
+
+namespace
+{
+    // Images and heightfields go back to the caller, who may modify them
+    // while the write is pending, so the queue keeps its own copy (and
+    // gives a copy to readers).
+    const osg::Object* copyIfMutable(const osg::Object* object)
+    {
+        if (dynamic_cast<const osg::Image*>(object) || dynamic_cast<const osg::HeightField*>(object))
+            return osg::clone(object, osg::CopyOp::DEEP_COPY_ALL);
+        else
+            return object;
+    }
+}
+
+//........................................................................
+
+class WriteBehindCacheBin::WriteThread : public OpenThreads::Thread
+{
+public:
+    WriteThread(WriteBehindCacheBin* bin) : _bin(bin) { }
+
+    void run() { _bin->run(); }
+
+private:
+    WriteBehindCacheBin* _bin;
+};
+
+//........................................................................
+
+WriteBehindCacheBin::WriteBehindCacheBin(CacheBin* bin, unsigned maxQueueSize) :
+CacheBin     ( bin->getID() ),
+_bin         ( bin ),
+_maxQueueSize( osg::maximum(maxQueueSize, 1u) ),
+_busy        ( false ),
+_done        ( false ),
+_dropped     ( 0u ),
+_coalesced   ( 0u ),
+_thread      ( 0L )
+{
+    setHashKeys( bin->getHashKeys() );
+}
+
+WriteBehindCacheBin::~WriteBehindCacheBin()
+{
+    if (_thread)
+    {
+        {
+            ScopedLock lock(_mutex);
+            if (!_records.empty())
+            {
+                OE_INFO << LC << "Writing " << _records.size() << " queued records to bin [" << getID() << "]" << std::endl;
+            }
+            _done = true;
+            _queued.signal();
+        }
+        _thread->join();
+        delete _thread;
+        _thread = 0L;
+    }
+}
+
+void
+WriteBehindCacheBin::run()
+{
+    while (true)
+    {
+        std::string key;
+        Record record;
+        unsigned size;
+        {
+            ScopedLock lock(_mutex);
+
+            while (_order.empty() && !_done)
+                _queued.wait(&_mutex);
+
+            // only stop once the queue is empty:
+            if (_order.empty())
+                break;
+
+            key = _order.front();
+            _order.pop_front();
+
+            Records::iterator i = _records.find(key);
+            record = i->second;
+            _records.erase(i);
+
+            _writingKey = key;
+            _writing = record;
+            _busy = true;
+            size = _records.size();
+        }
+
+        reportQueueSize(size);
+
+        _bin->write(key, record._object.get(), record._meta, record._dbo.get());
+
+        {
+            ScopedLock lock(_mutex);
+            _busy = false;
+            _writingKey.clear();
+            _writing = Record();
+            _written.broadcast();
+        }
+    }
+}
+
+const WriteBehindCacheBin::Record*
+WriteBehindCacheBin::findQueued(const std::string& key) const
+{
+    Records::const_iterator i = _records.find(key);
+    if (i != _records.end())
+        return &i->second;
+
+    if (_busy && _writingKey == key)
+        return &_writing;
+
+    return 0L;
+}
+
+void
+WriteBehindCacheBin::waitForWrite(const std::string& key)
+{
+    while (_busy && (key.empty() || _writingKey == key))
+        _written.wait(&_mutex);
+}
+
+void
+WriteBehindCacheBin::reportQueueSize(unsigned size) const
+{
+    if (Metrics::enabled())
+    {
+        Metrics::counter("WriteBehindCache", getID(), size);
+    }
+}
+
+void
+WriteBehindCacheBin::flush()
+{
+    ScopedLock lock(_mutex);
+    while (!_order.empty() || _busy)
+        _written.wait(&_mutex);
+}
+
+unsigned
+WriteBehindCacheBin::getQueueSize() const
+{
+    ScopedLock lock(_mutex);
+    return _records.size();
+}
+
+unsigned
+WriteBehindCacheBin::getNumDropped() const
+{
+    ScopedLock lock(_mutex);
+    return _dropped;
+}
+
+unsigned
+WriteBehindCacheBin::getNumCoalesced() const
+{
+    ScopedLock lock(_mutex);
+    return _coalesced;
+}
+
+bool
+WriteBehindCacheBin::write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* dbo)
+{
+    if (!object)
+        return false;
+
+    osg::ref_ptr<const osg::Object> copy = copyIfMutable(object);
+
+    unsigned size;
+    {
+        ScopedLock lock(_mutex);
+
+        if (_done)
+            return false;
+
+        Records::iterator i = _records.find(key);
+        if (i != _records.end())
+        {
+            ++_coalesced;
+        }
+        else if (_records.size() >= _maxQueueSize)
+        {
+            if (_dropped++ == 0u)
+            {
+                OE_INFO << LC << "Write queue for bin [" << getID() << "] is full; dropping writes" << std::endl;
+            }
+            return false;
+        }
+        else
+        {
+            i = _records.insert(Records::value_type(key, Record())).first;
+            _order.push_back(key);
+        }
+
+        Record& record = i->second;
+        record._object = copy.get();
+        record._meta   = meta;
+        record._dbo    = dbo;
+        record._time   = DateTime().asTimeStamp();
+
+        if (!_thread)
+        {
+            _thread = new WriteThread(this);
+            _thread->start();
+        }
+
+        _queued.signal();
+        size = _records.size();
+    }
+
+    reportQueueSize(size);
+    return true;
+}
+
+ReadResult
+WriteBehindCacheBin::readObject(const std::string& key, const osgDB::Options* dbo)
+{
+    Record record;
+    {
+        ScopedLock lock(_mutex);
+        const Record* queued = findQueued(key);
+        if (queued)
+            record = *queued;
+    }
+    if (record._object.valid())
+    {
+        ReadResult r(const_cast<osg::Object*>(copyIfMutable(record._object.get())), record._meta);
+        r.setLastModifiedTime(record._time);
+        return r;
+    }
+    return _bin->readObject(key, dbo);
+}
+
+ReadResult
+WriteBehindCacheBin::readImage(const std::string& key, const osgDB::Options* dbo)
+{
+    Record record;
+    {
+        ScopedLock lock(_mutex);
+        const Record* queued = findQueued(key);
+        if (queued && dynamic_cast<const osg::Image*>(queued->_object.get()))
+            record = *queued;
+    }
+    if (record._object.valid())
+    {
+        ReadResult r(const_cast<osg::Object*>(copyIfMutable(record._object.get())), record._meta);
+        r.setLastModifiedTime(record._time);
+        return r;
+    }
+    return _bin->readImage(key, dbo);
+}
+
+ReadResult
+WriteBehindCacheBin::readString(const std::string& key, const osgDB::Options* dbo)
+{
+    {
+        ScopedLock lock(_mutex);
+        const Record* record = findQueued(key);
+        if (record && dynamic_cast<const StringObject*>(record->_object.get()))
+        {
+            ReadResult r(const_cast<osg::Object*>(record->_object.get()), record->_meta);
+            r.setLastModifiedTime(record->_time);
+            return r;
+        }
+    }
+    return _bin->readString(key, dbo);
+}
+
+CacheBin::RecordStatus
+WriteBehindCacheBin::getRecordStatus(const std::string& key)
+{
+    {
+        ScopedLock lock(_mutex);
+        if (findQueued(key))
+            return STATUS_OK;
+    }
+    return _bin->getRecordStatus(key);
+}
+
+bool
+WriteBehindCacheBin::remove(const std::string& key)
+{
+    bool removed = false;
+    {
+        ScopedLock lock(_mutex);
+        Records::iterator i = _records.find(key);
+        if (i != _records.end())
+        {
+            _records.erase(i);
+            _order.remove(key);
+            removed = true;
+        }
+
+        // don't let a write in progress restore the record:
+        waitForWrite(key);
+    }
+    return _bin->remove(key) || removed;
+}
+
+bool
+WriteBehindCacheBin::touch(const std::string& key)
+{
+    {
+        ScopedLock lock(_mutex);
+        Records::iterator i = _records.find(key);
+        if (i != _records.end())
+        {
+            i->second._time = DateTime().asTimeStamp();
+            return true;
+        }
+        waitForWrite(key);
+    }
+    return _bin->touch(key);
+}
+
+Config
+WriteBehindCacheBin::readMetadata()
+{
+    return _bin->readMetadata();
+}
+
+bool
+WriteBehindCacheBin::writeMetadata(const Config& meta)
+{
+    return _bin->writeMetadata(meta);
+}
+
+bool
+WriteBehindCacheBin::clear()
+{
+    {
+        ScopedLock lock(_mutex);
+        _records.clear();
+        _order.clear();
+        waitForWrite(std::string());
+    }
+    return _bin->clear();
+}
+
+bool
+WriteBehindCacheBin::compact()
+{
+    flush();
+    return _bin->compact();
+}
+
+unsigned
+WriteBehindCacheBin::getStorageSize()
+{
+    return _bin->getStorageSize();
+}
+
+std::string
+WriteBehindCacheBin::getHashedKey(const std::string& key) const
+{
+    return _bin->getHashedKey(key);
+}
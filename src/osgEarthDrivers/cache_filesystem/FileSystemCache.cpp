@@ -25,9 +25,13 @@
 #include <osgEarth/FileUtils>
 #include <osgEarth/StringUtils>
 #include <osgEarth/Registry>
+#include <osgEarth/DateTime>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
 #include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
 #include <sys/stat.h>
 
 using namespace osgEarth;
@@ -36,12 +40,19 @@ using namespace osgEarth::Threading;
 
 #ifndef _WIN32
 #   include <unistd.h>
+#   include <OpenThreads/Atomic>
+#   include "PackCacheBin"
 #endif
 
 #define OSG_FORMAT "osgb"
 #define OSG_EXT   ".osgb"
 #define OSG_COMPRESS
 
+#define BLOBS_DIR "blobs"
+
+// metadata key for the timestamp of a record that shares its file
+#define RECORD_TIME_KEY "osgearth_record_time"
+
 namespace
 {
     /** 
@@ -71,7 +82,11 @@ namespace
 
         void init();
 
+        CacheBin* createBin( const std::string& binID );
+
         std::string _rootPath;
+        bool        _dedup;
+        bool        _pack;
     };
 
     /** 
@@ -81,7 +96,7 @@ namespace
     class FileSystemCacheBin : public CacheBin
     {
     public:
-        FileSystemCacheBin( const std::string& name, const std::string& rootPath );
+        FileSystemCacheBin( const std::string& name, const std::string& rootPath, bool dedup );
 
     public: // CacheBin interface
 
@@ -103,6 +118,8 @@ namespace
 
         bool clear();
 
+        bool compact();
+
         Config readMetadata();
 
         bool writeMetadata( const Config& meta );
@@ -118,7 +135,19 @@ namespace
 
         const osgDB::Options* mergeOptions(const osgDB::Options* in);
 
+        // path of the shared file holding records with this content
+        std::string getBlobPath(const std::string& content) const;
+
+        // writes a record as a link to the shared file for its content.
+        bool writeDeduplicated(const std::string& filename, const std::string& content);
+
+        // replaces duplicate record files under a folder with links; returns
+        // the number of files replaced.
+        unsigned compactDirectory(const std::string& dir);
+
         bool                              _ok;
+        bool                              _dedup;
+        std::string                       _blobsPath;      // full path to the shared record files
         bool                              _binPathExists;
         std::string                       _metaPath;       // full path to the bin's metadata file
         std::string                       _binPath;        // full path to the bin's root folder
@@ -138,6 +167,17 @@ namespace
         }
     }
 
+    bool readFile( const std::string& fullPath, std::string& out )
+    {
+        std::ifstream in( fullPath.c_str(), std::ios::binary );
+        if ( !in.is_open() )
+            return false;
+        std::stringstream buf;
+        buf << in.rdbuf();
+        out = buf.str();
+        return true;
+    }
+
     void readMeta( const std::string& fullPath, Config& meta )
     {
         std::ifstream inmeta( fullPath.c_str() );
@@ -151,6 +191,43 @@ namespace
             meta.fromJSON( bufStr );
         }
     }
+
+    // A record that is a link to a shared file also shares that file's
+    // timestamp, so it keeps its own in its metadata. Takes the timestamp
+    // out of the metadata if it's there, else returns the file's.
+    osgEarth::TimeStamp takeRecordTime( const std::string& path, Config& meta )
+    {
+        osgEarth::TimeStamp t = meta.value<osgEarth::TimeStamp>(RECORD_TIME_KEY, 0);
+        if ( t > 0 )
+        {
+            meta.remove( RECORD_TIME_KEY );
+            return t;
+        }
+        return osgEarth::getLastModifiedTime(path);
+    }
+
+#ifndef _WIN32
+    // A name next to "path" that no other thread or process will pick.
+    std::string getTempName( const std::string& path )
+    {
+        static OpenThreads::Atomic s_count;
+        return Stringify() << path << "." << ::getpid() << "." << (unsigned)++s_count << ".tmp";
+    }
+
+    // Gives a record that is about to share its file a timestamp of its own.
+    void keepRecordTime( const std::string& path, osgEarth::TimeStamp t )
+    {
+        std::string metaname = path.substr(0, path.length() - std::string(OSG_EXT).length()) + ".meta";
+        Config meta;
+        if ( osgDB::fileExists(metaname) )
+            readMeta( metaname, meta );
+        if ( !meta.hasChild(RECORD_TIME_KEY) )
+        {
+            meta.set( RECORD_TIME_KEY, t );
+            writeMeta( metaname, meta );
+        }
+    }
+#endif
 }
 
 
@@ -178,6 +255,32 @@ namespace
         }
 
         _rootPath = URI( *fsco.rootPath(), options.referrer() ).full();
+        _dedup = fsco.deduplicate() == true;
+        _pack = fsco.format().isSetTo("pack");
+
+        if ( fsco.format().isSet() && !_pack && fsco.format().get() != "files" )
+        {
+            OE_WARN << LC << "Unknown format \"" << fsco.format().get() << "\"; using \"files\"" << std::endl;
+        }
+
+#ifdef _WIN32
+        if ( _dedup )
+        {
+            OE_WARN << LC << "Deduplication is not supported on this platform" << std::endl;
+            _dedup = false;
+        }
+        if ( _pack )
+        {
+            OE_WARN << LC << "The pack format is not supported on this platform" << std::endl;
+            _pack = false;
+        }
+#else
+        if ( _pack && _dedup )
+        {
+            OE_WARN << LC << "Deduplication does not apply to the pack format" << std::endl;
+            _dedup = false;
+        }
+#endif
         init();
     }
 
@@ -190,7 +293,7 @@ namespace
     CacheBin*
     FileSystemCache::addBin( const std::string& name )
     {
-        return _bins.getOrCreate( name, new FileSystemCacheBin( name, _rootPath ) );
+        return _bins.getOrCreate( name, createBin( name ) );
     }
 
     CacheBin*
@@ -202,12 +305,22 @@ namespace
             Threading::ScopedMutexLock lock( s_defaultBinMutex );
             if ( !_defaultBin.valid() ) // double-check
             {
-                _defaultBin = new FileSystemCacheBin( "__default", _rootPath );
+                _defaultBin = createBin( "__default" );
             }
         }
         return _defaultBin.get();
     }
 
+    CacheBin*
+    FileSystemCache::createBin( const std::string& name )
+    {
+#ifndef _WIN32
+        if ( _pack )
+            return new PackCacheBin( name, _rootPath );
+#endif
+        return new FileSystemCacheBin( name, _rootPath, _dedup );
+    }
+
     //------------------------------------------------------------------------
 
     std::string
@@ -288,13 +401,16 @@ namespace
     }
 
     FileSystemCacheBin::FileSystemCacheBin(const std::string&   binID,
-                                           const std::string&   rootPath) :
+                                           const std::string&   rootPath,
+                                           bool                 dedup) :
     CacheBin            ( binID ),
     _binPathExists      ( false ),
-    _ok( true )
+    _ok( true ),
+    _dedup( dedup )
     {
         _binPath = osgDB::concatPaths( rootPath, binID );
         _metaPath = osgDB::concatPaths( _binPath, "osgearth_cacheinfo.json" );
+        _blobsPath = osgDB::concatPaths( _binPath, BLOBS_DIR );
 
         _rw = osgDB::Registry::instance()->getReaderWriterForExtension(OSG_FORMAT);
 
@@ -338,8 +454,6 @@ namespace
         if ( !osgDB::fileExists(path) )
             return ReadResult( ReadResult::RESULT_NOT_FOUND );
 
-        osgEarth::TimeStamp timeStamp = osgEarth::getLastModifiedTime(path);     
-
         osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);
 
         osgDB::ReaderWriter::ReadResult r;
@@ -356,6 +470,8 @@ namespace
             if ( osgDB::fileExists(metafile) )
                 readMeta( metafile, meta );
 
+            osgEarth::TimeStamp timeStamp = takeRecordTime( path, meta );
+
             ReadResult rr( r.getImage(), meta );
             rr.setLastModifiedTime(timeStamp);
             return rr;            
@@ -375,8 +491,6 @@ namespace
         if ( !osgDB::fileExists(path) )
             return ReadResult( ReadResult::RESULT_NOT_FOUND );
 
-        osgEarth::TimeStamp timeStamp = osgEarth::getLastModifiedTime(path);
-
         osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);
 
         osgDB::ReaderWriter::ReadResult r;
@@ -393,6 +507,8 @@ namespace
             if ( osgDB::fileExists(metafile) )
                 readMeta( metafile, meta );
 
+            osgEarth::TimeStamp timeStamp = takeRecordTime( path, meta );
+
             ReadResult rr( r.getObject(), meta );
             rr.setLastModifiedTime(timeStamp);
             return rr;            
@@ -438,30 +554,56 @@ namespace
 
             osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(writeOptions);
 
-            if ( dynamic_cast<const osg::Image*>(object) )
+            std::string filename = fileURI.full() + OSG_EXT;
+
+#ifndef _WIN32
+            // The file may be a link to a shared record (see compact), so
+            // unlink it rather than overwrite the shared content in place.
+            ::unlink( filename.c_str() );
+#endif
+
+            if ( _dedup )
+            {
+                // serialize to memory so we can identify the content:
+                std::stringstream buf;
+                if ( dynamic_cast<const osg::Image*>(object) )
+                    r = _rw->writeImage( *static_cast<const osg::Image*>(object), buf, dbo.get() );
+                else if ( dynamic_cast<const osg::Node*>(object) )
+                    r = _rw->writeNode( *static_cast<const osg::Node*>(object), buf, dbo.get() );
+                else
+                    r = _rw->writeObject( *object, buf, dbo.get() );
+
+                objWriteOK = r.success() && writeDeduplicated( filename, buf.str() );
+            }
+            else if ( dynamic_cast<const osg::Image*>(object) )
             {
-                std::string filename = fileURI.full() + OSG_EXT;
                 r = _rw->writeImage( *static_cast<const osg::Image*>(object), filename, dbo.get() );
                 objWriteOK = r.success();
             }
             else if ( dynamic_cast<const osg::Node*>(object) )
             {
-                std::string filename = fileURI.full() + OSG_EXT;
                 r = _rw->writeNode(*static_cast<const osg::Node*>(object), filename, dbo.get());
                 objWriteOK = r.success();
             }
             else
             {
-                std::string filename = fileURI.full() + OSG_EXT;
                 r = _rw->writeObject(*object, filename, dbo.get());
                 objWriteOK = r.success();
             }
 
             // write metadata
-            if ( !meta.empty() && objWriteOK )
+            if ( objWriteOK )
             {
+                Config recordMeta = meta;
+                if ( _dedup )
+                    recordMeta.set( RECORD_TIME_KEY, DateTime().asTimeStamp() );
+
+                // replace, or drop, what an earlier version of the record left
                 std::string metaname = fileURI.full() + ".meta";
-                writeMeta( metaname, meta );
+                if ( !recordMeta.empty() )
+                    writeMeta( metaname, recordMeta );
+                else
+                    ::unlink( metaname.c_str() );
             }
         }
 
@@ -478,6 +620,68 @@ namespace
         return objWriteOK;
     }
 
+    std::string
+    FileSystemCacheBin::getBlobPath(const std::string& content) const
+    {
+        std::string hash = osgEarth::contentHash(content);
+        return osgDB::concatPaths( osgDB::concatPaths(_blobsPath, hash.substr(0, 2)), hash + OSG_EXT );
+    }
+
+    bool
+    FileSystemCacheBin::writeDeduplicated(const std::string& filename, const std::string& content)
+    {
+#ifndef _WIN32
+        std::string blob = getBlobPath(content);
+        bool wroteBlob = false;
+
+        if ( !osgDB::fileExists(blob) )
+        {
+            osgEarth::makeDirectoryForFile( blob );
+
+            // write to a temporary name first so a reader never sees a partial record:
+            std::string temp = getTempName( blob );
+            std::ofstream out( temp.c_str(), std::ios::binary );
+            if ( out.is_open() )
+            {
+                out.write( content.c_str(), content.length() );
+                out.close();
+            }
+            if ( !out || ::rename(temp.c_str(), blob.c_str()) != 0 )
+            {
+                ::unlink( temp.c_str() );
+                blob.clear();
+            }
+            else
+            {
+                wroteBlob = true;
+            }
+        }
+
+        // (the record's timestamp goes in its metadata)
+        if ( !blob.empty() && ::link(blob.c_str(), filename.c_str()) == 0 )
+        {
+            // Different content can share a hash, so unless this record made
+            // the blob, compare the bytes. Check the linked file rather than
+            // the blob so a blob replaced in the meantime can't slip through.
+            std::string linked;
+            if ( wroteBlob || (readFile(filename, linked) && linked == content) )
+                return true;
+
+            OE_DEBUG << LC << "Content hash collision on " << blob << std::endl;
+            ::unlink( filename.c_str() );
+        }
+#endif
+
+        // no link (e.g., too many links to the blob, or a hash collision);
+        // store a private copy.
+        std::ofstream out( filename.c_str(), std::ios::binary );
+        if ( !out.is_open() )
+            return false;
+        out.write( content.c_str(), content.length() );
+        out.close();
+        return !out.fail();
+    }
+
     CacheBin::RecordStatus
     FileSystemCacheBin::getRecordStatus(const std::string& key)
     {
@@ -498,8 +702,10 @@ namespace
         if ( !binValidForReading() ) return false;
         URI fileURI( getHashedKey(key), _metaPath );
         std::string path( fileURI.full() + OSG_EXT );
+        std::string metaname( fileURI.full() + ".meta" );
 
         ScopedWriteLock lock(_mutex);
+        ::unlink( metaname.c_str() );
         return ::unlink( path.c_str() ) == 0;
     }
 
@@ -509,8 +715,23 @@ namespace
         if ( !binValidForReading() ) return false;
         URI fileURI( getHashedKey(key), _metaPath );
         std::string path( fileURI.full() + OSG_EXT );
+        std::string metaname( fileURI.full() + ".meta" );
 
         ScopedWriteLock lock(_mutex);
+
+        // a record that shares its file keeps its timestamp in its metadata:
+        if ( osgDB::fileExists(metaname) )
+        {
+            Config meta;
+            readMeta( metaname, meta );
+            if ( meta.hasChild(RECORD_TIME_KEY) )
+            {
+                meta.set( RECORD_TIME_KEY, DateTime().asTimeStamp() );
+                writeMeta( metaname, meta );
+                return true;
+            }
+        }
+
         return osgEarth::touchFile( path );
     }
 
@@ -566,6 +787,124 @@ namespace
         return purgeDirectory( binDir );
     }
 
+    unsigned
+    FileSystemCacheBin::compactDirectory(const std::string& dir)
+    {
+        unsigned count = 0u;
+#ifndef _WIN32
+        osgDB::DirectoryContents dc = osgDB::getDirectoryContents( dir );
+
+        for( osgDB::DirectoryContents::iterator i = dc.begin(); i != dc.end(); ++i )
+        {
+            if ( i->compare(".") == 0 || i->compare("..") == 0 )
+                continue;
+
+            std::string full = osgDB::concatPaths(dir, *i);
+            if ( full == _blobsPath )
+                continue;
+
+            osgDB::FileType type = osgDB::fileType( full );
+
+            if ( type == osgDB::DIRECTORY )
+            {
+                count += compactDirectory( full );
+            }
+            else if ( type == osgDB::REGULAR_FILE && osgEarth::endsWith(full, OSG_EXT) )
+            {
+                // lock each record so a concurrent write can't be overwritten
+                // by stale content:
+                ScopedWriteLock lock(_mutex);
+
+                std::string content;
+                if ( !readFile(full, content) )
+                    continue;
+
+                std::string blob = getBlobPath(content);
+
+                struct stat fileInfo, blobInfo;
+                if ( ::stat(full.c_str(), &fileInfo) != 0 )
+                    continue;
+
+                if ( ::stat(blob.c_str(), &blobInfo) != 0 )
+                {
+                    // first of its kind; this file becomes the shared record.
+                    osgEarth::makeDirectoryForFile( blob );
+                    keepRecordTime( full, fileInfo.st_mtime );
+                    ::link( full.c_str(), blob.c_str() );
+                }
+                else if ( fileInfo.st_ino != blobInfo.st_ino )
+                {
+                    // a duplicate; make sure before replacing it with a link.
+                    std::string blobContent;
+                    if ( readFile(blob, blobContent) && blobContent == content )
+                    {
+                        std::string temp = getTempName( full );
+                        if ( ::link(blob.c_str(), temp.c_str()) == 0 )
+                        {
+                            keepRecordTime( full, fileInfo.st_mtime );
+                            if ( ::rename(temp.c_str(), full.c_str()) == 0 )
+                            {
+                                ++count;
+                            }
+                            else
+                            {
+                                ::unlink( temp.c_str() );
+                            }
+                        }
+                    }
+                }
+            }
+        }
+#endif
+        return count;
+    }
+
+    bool
+    FileSystemCacheBin::compact()
+    {
+#ifdef _WIN32
+        return false;
+#else
+        if ( !binValidForWriting() )
+            return false;
+
+        // This could take a while.
+        OE_INFO << LC << "Compacting cache bin [" << getID() << "]" << std::endl;
+
+        unsigned replaced = compactDirectory( _binPath );
+
+        // Remove shared records that no longer have any users:
+        unsigned orphans = 0u;
+        osgDB::DirectoryContents buckets = osgDB::getDirectoryContents( _blobsPath );
+        for( osgDB::DirectoryContents::iterator b = buckets.begin(); b != buckets.end(); ++b )
+        {
+            if ( b->compare(".") == 0 || b->compare("..") == 0 )
+                continue;
+
+            std::string bucket = osgDB::concatPaths(_blobsPath, *b);
+            osgDB::DirectoryContents blobs = osgDB::getDirectoryContents( bucket );
+            for( osgDB::DirectoryContents::iterator i = blobs.begin(); i != blobs.end(); ++i )
+            {
+                std::string blob = osgDB::concatPaths(bucket, *i);
+
+                ScopedWriteLock lock(_mutex);
+                struct stat info;
+                if ( ::stat(blob.c_str(), &info) == 0 && S_ISREG(info.st_mode) && info.st_nlink <= 1 )
+                {
+                    if ( ::unlink(blob.c_str()) == 0 )
+                        ++orphans;
+                }
+            }
+        }
+
+        OE_INFO << LC << "Compacted cache bin [" << getID() << "]: "
+            << replaced << " duplicate records linked, "
+            << orphans << " unused records removed" << std::endl;
+
+        return true;
+#endif
+    }
+
     Config
     FileSystemCacheBin::readMetadata()
     {
@@ -0,0 +1,892 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "PackCacheBin"
+#include <osgEarth/Registry>
+#include <osgEarth/DateTime>
+#include <osgEarth/FileUtils>
+#include <osgEarth/StringUtils>
+#include <osgEarth/URI>
+#include <osgDB/Registry>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define LC "[PackCacheBin] "
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+using namespace osgEarth::Threading;
+
+#define OSG_FORMAT "osgb"
+#define OSG_COMPRESS
+
+#define INDEX_FILE      "pack.idx"
+#define INDEX_MAGIC     0x4b504f45u     // "OEPK"
+#define INDEX_VERSION   1u
+#define RECORD_MAGIC    0x52504f45u     // "OEPR"
+
+// Slot states in the index
+#define SLOT_EMPTY      0u
+#define SLOT_USED       1u
+#define SLOT_REMOVED    2u
+
+// Initial number of index slots (must be a power of two)
+#define INITIAL_CAPACITY    65536u
+
+// Size at which a pack file is closed and a new one started. Each pack is
+// mapped at this size up front so that appends never move the mapping.
+#define MAX_PACK_SIZE       (256u * 1024u * 1024u)
+
+namespace
+{
+    /**
+     * Read-only stream buffer over a block of memory, so the osgb reader can
+     * deserialize a record directly from the mapped pack file.
+     */
+    class MemoryBuffer : public std::streambuf
+    {
+    public:
+        MemoryBuffer( const char* data, unsigned length )
+        {
+            char* p = const_cast<char*>(data);
+            setg( p, p, p + length );
+        }
+
+    protected:
+        pos_type seekoff( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which )
+        {
+            if ( (which & std::ios_base::in) == 0 )
+                return pos_type(off_type(-1));
+
+            char* target =
+                dir == std::ios_base::beg ? eback() + off :
+                dir == std::ios_base::cur ? gptr() + off :
+                egptr() + off;
+
+            if ( target < eback() || target > egptr() )
+                return pos_type(off_type(-1));
+
+            setg( eback(), target, egptr() );
+            return pos_type(off_type(target - eback()));
+        }
+
+        pos_type seekpos( pos_type pos, std::ios_base::openmode which )
+        {
+            return seekoff( off_type(pos), std::ios_base::beg, which );
+        }
+    };
+
+    bool writeAll( int fd, const char* data, unsigned length, off_t offset )
+    {
+        while ( length > 0 )
+        {
+            ssize_t n = ::pwrite( fd, data, length, offset );
+            if ( n < 0 )
+            {
+                if ( errno == EINTR )
+                    continue;
+                return false;
+            }
+            data   += n;
+            length -= (unsigned)n;
+            offset += n;
+        }
+        return true;
+    }
+}
+
+//------------------------------------------------------------------------
+
+PackCacheBin::PackCacheBin(const std::string& binID,
+                           const std::string& rootPath) :
+CacheBin  ( binID ),
+_ok       ( true ),
+_indexFD  ( -1 ),
+_indexSize( 0u ),
+_index    ( 0L )
+{
+    _binPath   = osgDB::concatPaths( rootPath, binID );
+    _metaPath  = osgDB::concatPaths( _binPath, "osgearth_cacheinfo.json" );
+    _indexPath = osgDB::concatPaths( _binPath, INDEX_FILE );
+
+    _rw = osgDB::Registry::instance()->getReaderWriterForExtension(OSG_FORMAT);
+
+#ifdef OSG_COMPRESS
+#ifdef OSGEARTH_HAVE_ZLIB
+    _zlibOptions = Registry::instance()->cloneOrCreateOptions();
+    _zlibOptions->setPluginStringData("Compressor", "zlib");
+#endif
+#endif
+
+    // open an existing bin; a new one is created on the first write.
+    if ( osgDB::fileExists(_indexPath) )
+    {
+        ScopedWriteLock lock(_mutex);
+        open( false );
+    }
+}
+
+PackCacheBin::~PackCacheBin()
+{
+    ScopedWriteLock lock(_mutex);
+    close();
+}
+
+bool
+PackCacheBin::binValidForReading()
+{
+    if ( !_rw.valid() )
+        _ok = false;
+    return _ok;
+}
+
+bool
+PackCacheBin::binValidForWriting()
+{
+    if ( !_rw.valid() )
+        _ok = false;
+    return _ok;
+}
+
+const osgDB::Options*
+PackCacheBin::mergeOptions(const osgDB::Options* dbo)
+{
+    if (!dbo)
+    {
+        return _zlibOptions.get();
+    }
+    else if (!_zlibOptions.valid())
+    {
+        return dbo;
+    }
+    else
+    {
+        osgDB::Options* merged = Registry::cloneOrCreateOptions(dbo);
+        merged->setPluginStringData("Compressor", "zlib");
+        return merged;
+    }
+}
+
+std::string
+PackCacheBin::getHashedKey(const std::string& key) const
+{
+    // keys are stored verbatim in the pack records.
+    return key;
+}
+
+std::string
+PackCacheBin::getPackPath(unsigned generation, unsigned n) const
+{
+    return osgDB::concatPaths( _binPath, Stringify() << "pack_" << generation << "_" << n << ".dat" );
+}
+
+PackCacheBin::IndexEntry*
+PackCacheBin::getEntries(IndexHeader* index)
+{
+    return reinterpret_cast<IndexEntry*>(index + 1);
+}
+
+PackCacheBin::IndexHeader*
+PackCacheBin::mapIndex(const std::string& path, unsigned capacity, bool create, int& fd, unsigned& size)
+{
+    fd = ::open( path.c_str(), create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR, 0644 );
+    if ( fd < 0 )
+        return 0L;
+
+    if ( create )
+    {
+        // a zero-filled file is an index full of empty slots.
+        size = sizeof(IndexHeader) + capacity * sizeof(IndexEntry);
+        if ( ::ftruncate(fd, size) != 0 )
+        {
+            ::close( fd );
+            fd = -1;
+            return 0L;
+        }
+    }
+    else
+    {
+        struct stat buf;
+        if ( ::fstat(fd, &buf) != 0 || buf.st_size < (off_t)sizeof(IndexHeader) )
+        {
+            ::close( fd );
+            fd = -1;
+            return 0L;
+        }
+        size = (unsigned)buf.st_size;
+    }
+
+    void* map = ::mmap( 0L, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if ( map == MAP_FAILED )
+    {
+        ::close( fd );
+        fd = -1;
+        return 0L;
+    }
+
+    IndexHeader* index = static_cast<IndexHeader*>(map);
+
+    if ( create )
+    {
+        index->_magic    = INDEX_MAGIC;
+        index->_version  = INDEX_VERSION;
+        index->_capacity = capacity;
+    }
+    else
+    {
+        bool valid =
+            index->_magic == INDEX_MAGIC &&
+            index->_version == INDEX_VERSION &&
+            index->_capacity > 0 &&
+            (index->_capacity & (index->_capacity - 1)) == 0 &&
+            size == sizeof(IndexHeader) + index->_capacity * sizeof(IndexEntry) &&
+            index->_count + index->_removed <= index->_capacity;
+
+        if ( !valid )
+        {
+            ::munmap( map, size );
+            ::close( fd );
+            fd = -1;
+            return 0L;
+        }
+    }
+
+    return index;
+}
+
+bool
+PackCacheBin::openPack(unsigned generation, unsigned n, bool create, Pack& pack)
+{
+    std::string path = getPackPath( generation, n );
+
+    pack._fd = ::open( path.c_str(), create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR, 0644 );
+    if ( pack._fd < 0 )
+        return false;
+
+    struct stat buf;
+    if ( ::fstat(pack._fd, &buf) != 0 || buf.st_size > (off_t)MAX_PACK_SIZE )
+    {
+        ::close( pack._fd );
+        pack._fd = -1;
+        return false;
+    }
+    pack._size = (unsigned)buf.st_size;
+
+    // Map the maximum size now; only the part below _size is ever touched,
+    // and records appended with pwrite show up in the mapping.
+    void* map = ::mmap( 0L, MAX_PACK_SIZE, PROT_READ, MAP_SHARED, pack._fd, 0 );
+    if ( map == MAP_FAILED )
+    {
+        ::close( pack._fd );
+        pack._fd = -1;
+        return false;
+    }
+    pack._map = static_cast<char*>(map);
+    return true;
+}
+
+void
+PackCacheBin::closePacks(std::vector<Pack>& packs)
+{
+    for (unsigned i = 0; i < packs.size(); ++i)
+    {
+        if ( packs[i]._map )
+            ::munmap( packs[i]._map, MAX_PACK_SIZE );
+        if ( packs[i]._fd >= 0 )
+            ::close( packs[i]._fd );
+    }
+    packs.clear();
+}
+
+bool
+PackCacheBin::open(bool create)
+{
+    if ( _index )
+        return true;
+
+    if ( osgDB::fileExists(_indexPath) )
+    {
+        _index = mapIndex( _indexPath, 0u, false, _indexFD, _indexSize );
+
+        if ( _index )
+        {
+            _packs.resize( _index->_numPacks );
+            for (unsigned i = 0; i < _packs.size(); ++i)
+            {
+                if ( !openPack(_index->_generation, i, false, _packs[i]) )
+                {
+                    close();
+                    break;
+                }
+            }
+        }
+
+        if ( !_index )
+        {
+            OE_WARN << LC << "Cache bin [" << getID() << "] is damaged and will be cleared" << std::endl;
+
+            osgDB::DirectoryContents dc = osgDB::getDirectoryContents( _binPath );
+            for( osgDB::DirectoryContents::iterator i = dc.begin(); i != dc.end(); ++i )
+            {
+                if ( i->find("pack_") == 0 )
+                    ::unlink( osgDB::concatPaths(_binPath, *i).c_str() );
+            }
+            ::unlink( _indexPath.c_str() );
+        }
+    }
+
+    if ( !_index && create )
+    {
+        osgEarth::makeDirectoryForFile( _indexPath );
+        _index = mapIndex( _indexPath, INITIAL_CAPACITY, true, _indexFD, _indexSize );
+        if ( !_index )
+        {
+            OE_WARN << LC << "FAILED to create cache bin index at [" << _indexPath << "]" << std::endl;
+        }
+    }
+
+    return _index != 0L;
+}
+
+void
+PackCacheBin::close()
+{
+    closePacks( _packs );
+
+    if ( _index )
+    {
+        ::munmap( _index, _indexSize );
+        _index = 0L;
+        _indexSize = 0u;
+    }
+    if ( _indexFD >= 0 )
+    {
+        ::close( _indexFD );
+        _indexFD = -1;
+    }
+}
+
+PackCacheBin::IndexEntry*
+PackCacheBin::find(const std::string& key, Record* record) const
+{
+    if ( !_index )
+        return 0L;
+
+    unsigned hash1 = osgEarth::hashString(key);
+    unsigned hash2 = osgEarth::hashStringFNV1a(key);
+
+    IndexEntry* entries = getEntries(_index);
+    unsigned mask = _index->_capacity - 1;
+
+    for (unsigned i = 0, slot = hash1 & mask; i < _index->_capacity; ++i, slot = (slot + 1) & mask)
+    {
+        IndexEntry& entry = entries[slot];
+
+        if ( entry._state == SLOT_EMPTY )
+            return 0L;
+
+        if ( entry._state != SLOT_USED || entry._hash1 != hash1 || entry._hash2 != hash2 )
+            continue;
+
+        // ignore entries that don't point at a whole record
+        if ( entry._pack >= _packs.size() ||
+             entry._length < sizeof(RecordHeader) ||
+             entry._offset > _packs[entry._pack]._size ||
+             entry._length > _packs[entry._pack]._size - entry._offset )
+            continue;
+
+        const char* data = _packs[entry._pack]._map + entry._offset;
+
+        RecordHeader header;
+        ::memcpy( &header, data, sizeof(RecordHeader) );
+
+        if ( header._magic != RECORD_MAGIC ||
+             (unsigned long long)sizeof(RecordHeader) + header._keyLength + header._metaLength + header._dataLength != entry._length ||
+             header._keyLength != key.length() ||
+             key.compare(0, key.length(), data + sizeof(RecordHeader), header._keyLength) != 0 )
+            continue;
+
+        if ( record )
+        {
+            record->_entry      = &entry;
+            record->_meta       = data + sizeof(RecordHeader) + header._keyLength;
+            record->_metaLength = header._metaLength;
+            record->_data       = record->_meta + header._metaLength;
+            record->_dataLength = header._dataLength;
+        }
+        return &entry;
+    }
+
+    return 0L;
+}
+
+PackCacheBin::IndexEntry*
+PackCacheBin::findFreeSlot(IndexHeader* index, unsigned hash1)
+{
+    IndexEntry* entries = getEntries(index);
+    unsigned mask = index->_capacity - 1;
+
+    for (unsigned i = 0, slot = hash1 & mask; i < index->_capacity; ++i, slot = (slot + 1) & mask)
+    {
+        if ( entries[slot]._state != SLOT_USED )
+            return &entries[slot];
+    }
+    return 0L;
+}
+
+bool
+PackCacheBin::reserve()
+{
+    // keep the load (including removed slots, which lengthen probes) under 70%.
+    if ( (_index->_count + _index->_removed + 1) * 10u <= _index->_capacity * 7u )
+        return true;
+
+    // rebuild at a size that leaves the index half empty; this also
+    // discards the removed slots.
+    unsigned capacity = _index->_capacity;
+    while ( (_index->_count + 1) * 2u > capacity )
+        capacity *= 2u;
+
+    return resizeIndex( capacity );
+}
+
+bool
+PackCacheBin::resizeIndex(unsigned capacity)
+{
+    std::string tempPath = _indexPath + ".tmp";
+
+    int fd;
+    unsigned size;
+    IndexHeader* index = mapIndex( tempPath, capacity, true, fd, size );
+    if ( !index )
+    {
+        OE_WARN << LC << "FAILED to resize cache bin index [" << _indexPath << "]" << std::endl;
+        return false;
+    }
+
+    index->_generation = _index->_generation;
+    index->_numPacks   = _index->_numPacks;
+
+    IndexEntry* entries = getEntries(_index);
+    for (unsigned i = 0; i < _index->_capacity; ++i)
+    {
+        if ( entries[i]._state == SLOT_USED )
+        {
+            *findFreeSlot(index, entries[i]._hash1) = entries[i];
+            ++index->_count;
+        }
+    }
+
+    if ( ::rename(tempPath.c_str(), _indexPath.c_str()) != 0 )
+    {
+        ::munmap( index, size );
+        ::close( fd );
+        ::unlink( tempPath.c_str() );
+        return false;
+    }
+
+    ::munmap( _index, _indexSize );
+    ::close( _indexFD );
+
+    _index     = index;
+    _indexFD   = fd;
+    _indexSize = size;
+
+    OE_DEBUG << LC << "Resized index for bin [" << getID() << "] to " << capacity << " slots" << std::endl;
+    return true;
+}
+
+bool
+PackCacheBin::append(IndexHeader* index, std::vector<Pack>& packs, const char* data, unsigned length, unsigned& pack, unsigned& offset)
+{
+    if ( length > MAX_PACK_SIZE )
+        return false;
+
+    if ( packs.empty() || packs.back()._size + length > MAX_PACK_SIZE )
+    {
+        Pack newPack;
+        if ( !openPack(index->_generation, packs.size(), true, newPack) )
+            return false;
+        packs.push_back( newPack );
+        index->_numPacks = packs.size();
+    }
+
+    Pack& p = packs.back();
+    if ( !writeAll(p._fd, data, length, (off_t)p._size) )
+        return false;
+
+    pack   = packs.size() - 1;
+    offset = p._size;
+    p._size += length;
+    return true;
+}
+
+ReadResult
+PackCacheBin::readImage(const std::string& key, const osgDB::Options* readOptions)
+{
+    osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);
+    return read(key, ImageReader(_rw.get(), dbo.get()));
+}
+
+ReadResult
+PackCacheBin::readObject(const std::string& key, const osgDB::Options* readOptions)
+{
+    osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);
+    return read(key, ObjectReader(_rw.get(), dbo.get()));
+}
+
+ReadResult
+PackCacheBin::read(const std::string& key, const Reader& reader)
+{
+    if ( !binValidForReading() )
+        return ReadResult(ReadResult::RESULT_NOT_FOUND);
+
+    // The lock stays held while decoding, since the object is read
+    // straight out of the mapped pack file.
+    ScopedReadLock lock(_mutex);
+
+    Record record;
+    if ( !find(key, &record) )
+        return ReadResult(ReadResult::RESULT_NOT_FOUND);
+
+    MemoryBuffer buf( record._data, record._dataLength );
+    std::istream datastream( &buf );
+
+    osgDB::ReaderWriter::ReadResult r = reader.read(datastream);
+    if ( !r.success() )
+        return ReadResult(ReadResult::RESULT_READER_ERROR);
+
+    Config meta;
+    if ( record._metaLength > 0 )
+        meta.fromJSON( std::string(record._meta, record._metaLength) );
+
+    OE_DEBUG << LC << "Read \"" << key << "\" from cache bin [" << getID() << "]" << std::endl;
+
+    ReadResult rr( r.getObject(), meta );
+    rr.setLastModifiedTime( (TimeStamp)record._entry->_time );
+    return rr;
+}
+
+ReadResult
+PackCacheBin::readString(const std::string& key, const osgDB::Options* readOptions)
+{
+    ReadResult r = readObject(key, readOptions);
+    if ( r.succeeded() )
+    {
+        if ( r.get<StringObject>() )
+            return r;
+        else
+            return ReadResult();
+    }
+    else
+    {
+        return r;
+    }
+}
+
+bool
+PackCacheBin::write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* writeOptions)
+{
+    if ( !binValidForWriting() || !object )
+        return false;
+
+    // serialize outside the lock:
+    osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(writeOptions);
+
+    std::stringstream buf;
+    osgDB::ReaderWriter::WriteResult r;
+    if ( dynamic_cast<const osg::Image*>(object) )
+        r = _rw->writeImage( *static_cast<const osg::Image*>(object), buf, dbo.get() );
+    else if ( dynamic_cast<const osg::Node*>(object) )
+        r = _rw->writeNode( *static_cast<const osg::Node*>(object), buf, dbo.get() );
+    else
+        r = _rw->writeObject( *object, buf, dbo.get() );
+
+    if ( !r.success() )
+    {
+        OE_WARN << LC << "FAILED to write \"" << key << "\" to cache bin " << getID()
+            << "; msg = \"" << r.message() << "\"" << std::endl;
+        return false;
+    }
+
+    std::string data = buf.str();
+    std::string metaJSON = meta.empty() ? std::string() : meta.toJSON();
+
+    RecordHeader header;
+    header._magic      = RECORD_MAGIC;
+    header._keyLength  = key.length();
+    header._metaLength = metaJSON.length();
+    header._dataLength = data.length();
+
+    std::string record;
+    record.reserve( sizeof(RecordHeader) + key.length() + metaJSON.length() + data.length() );
+    record.append( reinterpret_cast<const char*>(&header), sizeof(RecordHeader) );
+    record.append( key );
+    record.append( metaJSON );
+    record.append( data );
+
+    ScopedWriteLock lock(_mutex);
+
+    if ( !open(true) )
+        return false;
+
+    // An existing record for this key is simply abandoned in its pack;
+    // compact() reclaims the space.
+    IndexEntry* entry = find(key, 0L);
+    if ( !entry )
+    {
+        if ( !reserve() )
+            return false;
+    }
+
+    unsigned pack, offset;
+    if ( !append(_index, _packs, record.data(), record.length(), pack, offset) )
+    {
+        OE_WARN << LC << "FAILED to write \"" << key << "\" to cache bin " << getID() << std::endl;
+        return false;
+    }
+
+    if ( !entry )
+    {
+        unsigned hash1 = osgEarth::hashString(key);
+        entry = findFreeSlot(_index, hash1);
+        if ( entry->_state == SLOT_REMOVED )
+            --_index->_removed;
+        ++_index->_count;
+
+        entry->_hash1 = hash1;
+        entry->_hash2 = osgEarth::hashStringFNV1a(key);
+    }
+
+    entry->_pack   = pack;
+    entry->_offset = offset;
+    entry->_length = record.length();
+    entry->_time   = (unsigned)DateTime().asTimeStamp();
+    entry->_state  = SLOT_USED;
+
+    OE_DEBUG << LC << "Wrote \"" << key << "\" to cache bin [" << getID() << "]" << std::endl;
+    return true;
+}
+
+CacheBin::RecordStatus
+PackCacheBin::getRecordStatus(const std::string& key)
+{
+    if ( !binValidForReading() )
+        return STATUS_NOT_FOUND;
+
+    ScopedReadLock lock(_mutex);
+    return find(key, 0L) ? STATUS_OK : STATUS_NOT_FOUND;
+}
+
+bool
+PackCacheBin::remove(const std::string& key)
+{
+    if ( !binValidForReading() ) return false;
+
+    ScopedWriteLock lock(_mutex);
+
+    IndexEntry* entry = find(key, 0L);
+    if ( !entry )
+        return false;
+
+    entry->_state = SLOT_REMOVED;
+    --_index->_count;
+    ++_index->_removed;
+    return true;
+}
+
+bool
+PackCacheBin::touch(const std::string& key)
+{
+    if ( !binValidForReading() ) return false;
+
+    ScopedWriteLock lock(_mutex);
+
+    IndexEntry* entry = find(key, 0L);
+    if ( !entry )
+        return false;
+
+    entry->_time = (unsigned)DateTime().asTimeStamp();
+    return true;
+}
+
+bool
+PackCacheBin::clear()
+{
+    if ( !binValidForReading() )
+        return false;
+
+    ScopedWriteLock lock(_mutex);
+
+    close();
+
+    bool allOK = true;
+    osgDB::DirectoryContents dc = osgDB::getDirectoryContents( _binPath );
+    for( osgDB::DirectoryContents::iterator i = dc.begin(); i != dc.end(); ++i )
+    {
+        if ( i->find("pack_") == 0 || *i == INDEX_FILE )
+        {
+            std::string full = osgDB::concatPaths(_binPath, *i);
+            if ( ::unlink(full.c_str()) != 0 )
+                allOK = false;
+            OE_DEBUG << LC << "Unlink: " << full << std::endl;
+        }
+    }
+    return allOK;
+}
+
+bool
+PackCacheBin::compact()
+{
+    if ( !binValidForWriting() )
+        return false;
+
+    ScopedWriteLock lock(_mutex);
+
+    if ( !open(false) )
+        return true;
+
+    OE_INFO << LC << "Compacting cache bin [" << getID() << "]" << std::endl;
+
+    // copy the live records into a new generation of packs:
+    unsigned capacity = INITIAL_CAPACITY;
+    while ( _index->_count * 2u > capacity )
+        capacity *= 2u;
+
+    std::string tempPath = _indexPath + ".tmp";
+    int fd;
+    unsigned size;
+    IndexHeader* index = mapIndex( tempPath, capacity, true, fd, size );
+    if ( !index )
+        return false;
+
+    index->_generation = _index->_generation + 1;
+
+    std::vector<Pack> packs;
+    bool ok = true;
+    unsigned long long oldSize = _indexSize, newSize = size;
+
+    IndexEntry* entries = getEntries(_index);
+    for (unsigned i = 0; i < _index->_capacity && ok; ++i)
+    {
+        IndexEntry entry = entries[i];
+        if ( entry._state != SLOT_USED ||
+             entry._pack >= _packs.size() ||
+             entry._offset > _packs[entry._pack]._size ||
+             entry._length > _packs[entry._pack]._size - entry._offset )
+            continue;
+
+        ok = append( index, packs, _packs[entry._pack]._map + entry._offset, entry._length, entry._pack, entry._offset );
+        if ( ok )
+        {
+            *findFreeSlot(index, entry._hash1) = entry;
+            ++index->_count;
+        }
+    }
+
+    for (unsigned i = 0; i < packs.size() && ok; ++i)
+    {
+        ok = ::fdatasync(packs[i]._fd) == 0;
+        newSize += packs[i]._size;
+    }
+
+    if ( !ok || ::rename(tempPath.c_str(), _indexPath.c_str()) != 0 )
+    {
+        OE_WARN << LC << "FAILED to compact cache bin [" << getID() << "]" << std::endl;
+        for (unsigned i = 0; i < packs.size(); ++i)
+            ::unlink( getPackPath(index->_generation, i).c_str() );
+        closePacks( packs );
+        ::munmap( index, size );
+        ::close( fd );
+        ::unlink( tempPath.c_str() );
+        return false;
+    }
+
+    // retire the old generation:
+    unsigned oldGeneration = _index->_generation;
+    for (unsigned i = 0; i < _packs.size(); ++i)
+    {
+        oldSize += _packs[i]._size;
+        ::unlink( getPackPath(oldGeneration, i).c_str() );
+    }
+    close();
+
+    _index     = index;
+    _indexFD   = fd;
+    _indexSize = size;
+    _packs.swap( packs );
+
+    OE_INFO << LC << "Compacted cache bin [" << getID() << "]: "
+        << oldSize << " bytes -> " << newSize << " bytes" << std::endl;
+
+    return true;
+}
+
+unsigned
+PackCacheBin::getStorageSize()
+{
+    ScopedReadLock lock(_mutex);
+
+    unsigned total = _indexSize;
+    for (unsigned i = 0; i < _packs.size(); ++i)
+        total += _packs[i]._size;
+    return total;
+}
+
+Config
+PackCacheBin::readMetadata()
+{
+    if ( !binValidForReading() ) return Config();
+
+    ScopedReadLock lock(_mutex);
+
+    Config conf;
+    conf.fromJSON( URI(_metaPath).getString(_zlibOptions.get()) );
+
+    return conf;
+}
+
+bool
+PackCacheBin::writeMetadata( const Config& conf )
+{
+    if ( !binValidForWriting() ) return false;
+
+    ScopedWriteLock lock(_mutex);
+
+    osgEarth::makeDirectoryForFile( _metaPath );
+
+    std::fstream output( _metaPath.c_str(), std::ios_base::out );
+    if ( output.is_open() )
+    {
+        output << conf.toJSON(true);
+        output.flush();
+        output.close();
+        return true;
+    }
+    return false;
+}
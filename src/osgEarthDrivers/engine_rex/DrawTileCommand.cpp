@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include "DrawTileCommand"
+#include <algorithm>
 
 using namespace osgEarth::Drivers::RexTerrainEngine;
 
@@ -130,7 +131,7 @@ DrawTileCommand::draw(osg::RenderInfo& ri, DrawState& dsMaster, osg::Referenced*
             dc.normalTexture    = (*_sharedSamplers)[SamplerBinding::NORMAL]._texture.get();
             dc.coverageTexture  = (*_sharedSamplers)[SamplerBinding::COVERAGE]._texture.get();
         }
-        dc.key = &_key;
+        dc.key = _key;
         dc.range = _range;
         _drawCallback->draw(ri, dc, layerData);
 
@@ -140,7 +141,7 @@ DrawTileCommand::draw(osg::RenderInfo& ri, DrawState& dsMaster, osg::Referenced*
 
     else
     // If there's a geometry, draw it now:
-    if (_geom.valid())
+    if (_geom)
     {
         GLenum ptype = _drawPatch ? GL_PATCHES : GL_TRIANGLES;
 
@@ -181,3 +182,111 @@ DrawTileCommand::draw(osg::RenderInfo& ri, DrawState& dsMaster, osg::Referenced*
 #endif
     }    
 }
+
+//........................................................................
+
+void
+DrawCommandBuffer::reset(unsigned numLayers)
+{
+    if (_lists.size() < numLayers)
+        _lists.resize(numLayers);
+
+    for (unsigned i = 0; i < _lists.size(); ++i)
+        _lists[i].clear();
+}
+
+void
+DrawCommandBuffer::sort(DrawTileCommands& commands)
+{
+    unsigned n = commands.size();
+    if (n < 2u)
+        return;
+
+    // Sort key: inverted LOD in the high byte, so high LODs come first,
+    // then the geometry's address to group commands sharing geometry.
+    _entries.resize(n);
+    for (unsigned i = 0; i < n; ++i)
+    {
+        const DrawTileCommand& cmd = commands[i];
+        unsigned lod = cmd._key ? osg::minimum(cmd._key->getLOD(), 255u) : 0u;
+        _entries[i]._key =
+            ((unsigned long long)(255u - lod) << 56) |
+            ((unsigned long long)(size_t)cmd._geom & 0x00FFFFFFFFFFFFFFULL);
+        _entries[i]._index = i;
+    }
+
+    // LSD radix sort, a byte at a time. It's stable, so commands with equal
+    // keys keep the order in which the culler added them. Bytes that are the
+    // same in every key (most of the address bits) are skipped.
+    _temp.resize(n);
+    SortEntry* src = &_entries[0];
+    SortEntry* dst = &_temp[0];
+
+    for (unsigned shift = 0; shift < 64u; shift += 8u)
+    {
+        unsigned counts[256] = { 0 };
+        for (unsigned i = 0; i < n; ++i)
+            ++counts[(src[i]._key >> shift) & 0xFF];
+
+        if (counts[(src[0]._key >> shift) & 0xFF] == n)
+            continue;
+
+        unsigned offset = 0u;
+        for (unsigned b = 0; b < 256u; ++b)
+        {
+            unsigned count = counts[b];
+            counts[b] = offset;
+            offset += count;
+        }
+
+        for (unsigned i = 0; i < n; ++i)
+            dst[counts[(src[i]._key >> shift) & 0xFF]++] = src[i];
+
+        std::swap(src, dst);
+    }
+
+    // Put the commands in sorted order in place, one permutation cycle at a time.
+    _order.resize(n);
+    for (unsigned i = 0; i < n; ++i)
+        _order[i] = src[i]._index;
+
+    for (unsigned i = 0; i < n; ++i)
+    {
+        if (_order[i] == i)
+            continue;
+
+        DrawTileCommand temp = commands[i];
+        unsigned j = i;
+        while (true)
+        {
+            unsigned k = _order[j];
+            _order[j] = j;
+            if (k == i)
+            {
+                commands[j] = temp;
+                break;
+            }
+            commands[j] = commands[k];
+            j = k;
+        }
+    }
+}
+
+//........................................................................
+
+osg::ref_ptr<DrawCommandBuffer>
+DrawCommandBufferPool::acquire()
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    // Only the pool references a buffer that's free. Since only this method
+    // adds references, a free buffer can't become busy behind our back.
+    for (unsigned i = 0; i < _buffers.size(); ++i)
+    {
+        if (_buffers[i]->referenceCount() == 1)
+            return _buffers[i];
+    }
+
+    _buffers.push_back(new DrawCommandBuffer());
+    return _buffers.back();
+}
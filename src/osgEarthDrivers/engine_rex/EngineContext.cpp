@@ -38,6 +38,7 @@ EngineContext::EngineContext(const Map*                     map,
                              Loader*                        loader,
                              Unloader*                      unloader,
                              TileRasterizer*                tileRasterizer,
+                             Prefetcher*                    prefetcher,
                              TileNodeRegistry*              liveTiles,
                              const RenderBindings&          renderBindings,
                              const RexTerrainEngineOptions& options,
@@ -49,6 +50,7 @@ _geometryPool  ( geometryPool ),
 _loader        ( loader ),
 _unloader      ( unloader ),
 _tileRasterizer( tileRasterizer ),
+_prefetcher    ( prefetcher ),
 _liveTiles     ( liveTiles ),
 _renderBindings( renderBindings ),
 _options       ( options ),
@@ -19,7 +19,9 @@
 #include "GeometryPool"
 #include <osgEarth/Locators>
 #include <osgEarth/NodeUtils>
+#include <osgEarth/Metrics>
 #include <osg/Point>
+#include <algorithm>
 #include <cstdlib> // for getenv
 
 using namespace osgEarth;
@@ -54,6 +56,9 @@ _debug   ( false )
 
     _tileSize = _options.tileSize().get();
 
+    double megabytes = osg::clampBetween((double)_options.geometryPoolSize().get(), 0.0, 4095.0);
+    _maxBytes = (unsigned)(megabytes * 1048576.0);
+
     // activate debugging mode
     if ( getenv("OSGEARTH_DEBUG_REX_GEOMETRY_POOL") != 0L )
     {
@@ -83,31 +88,50 @@ GeometryPool::getPooledGeometry(const TileKey&               tileKey,
     GeometryKey geomKey;
     createKeyForTileKey( tileKey, _tileSize, mapInfo, geomKey );
 
-    if ( _enabled )
-    {
-        // Look it up in the pool:
-        Threading::ScopedMutexLock exclusive( _geometryMapMutex );
+    // masked geometry is unique to its tile, so never pool it.
+    bool masking = maskSet && maskSet->hasMasks();
 
-        bool masking = maskSet && maskSet->hasMasks();
+    if ( _enabled && !masking )
+    {
+        Shard& shard = getShard( geomKey );
 
-        GeometryMap::iterator i = _geometryMap.find( geomKey );
-        if ( !masking && i != _geometryMap.end() )
+        // Look it up in the pool:
         {
-            // Found. return it.
-            out = i->second.get();
+            Threading::ScopedMutexLock exclusive( shard._mutex );
+
+            GeometryMap::iterator i = shard._geometryMap.find( geomKey );
+            if ( i != shard._geometryMap.end() )
+            {
+                // Found. return it.
+                i->second._lastUsed = _frameNumber;
+                ++shard._hits;
+                out = i->second._geom.get();
+                return;
+            }
         }
-        else
-        {
-            // Not found. Create it.
-            out = createGeometry( tileKey, mapInfo, maskSet );
 
-            if (!masking)
-                _geometryMap[ geomKey ] = out.get();
+        // Not found. Create it; that's the slow part, so do it without the lock.
+        osg::ref_ptr<SharedGeometry> geom = createGeometry( tileKey, mapInfo, maskSet );
+
+        {
+            Threading::ScopedMutexLock exclusive( shard._mutex );
 
-            if ( _debug )
+            // Another thread may have beaten us to it; if so, share theirs.
+            PoolEntry& entry = shard._geometryMap[ geomKey ];
+            if ( !entry._geom.valid() )
             {
-                OE_NOTICE << LC << "Geometry pool size = " << _geometryMap.size() << "\n";
+                entry._geom = geom.get();
+                entry._bytes = geom->getTotalDataSize();
             }
+            entry._lastUsed = _frameNumber;
+            ++shard._misses;
+            out = entry._geom.get();
+        }
+
+        if ( _debug )
+        {
+            Stats stats = getStats();
+            OE_NOTICE << LC << "Geometry pool size = " << stats.geometries << " (" << stats.bytes/1024u << " KB)\n";
         }
     }
 
@@ -117,6 +141,18 @@ GeometryPool::getPooledGeometry(const TileKey&               tileKey,
     }
 }
 
+GeometryPool::Shard&
+GeometryPool::getShard(const GeometryKey& key)
+{
+    unsigned h =
+        ((unsigned)key.lod   * 0x9E3779B1u) ^
+        ((unsigned)key.tileY * 0x85EBCA6Bu) ^
+        (key.size            * 0xC2B2AE35u) ^
+        (key.patch ? 1u : 0u);
+    h ^= h >> 16;
+    return _shards[h % NUM_SHARDS];
+}
+
 void
 GeometryPool::createKeyForTileKey(const TileKey&             tileKey,
                                   unsigned                   size,
@@ -415,39 +451,75 @@ GeometryPool::setReleaser(ResourceReleaser* releaser)
 void
 GeometryPool::traverse(osg::NodeVisitor& nv)
 {
-    if (nv.getVisitorType() == nv.UPDATE_VISITOR && _releaser.valid() && _enabled)
+    if (nv.getVisitorType() == nv.UPDATE_VISITOR && _enabled)
     {
-        // look for usused pool objects and push them to the resource releaser.
-        ResourceReleaser::ObjectList objects;
-        {
-            Threading::ScopedMutexLock exclusive( _geometryMapMutex );
+        unsigned frame = nv.getFrameStamp() ? nv.getFrameStamp()->getFrameNumber() : 0u;
+        _frameNumber.exchange(frame);
+
+        // Find the unused pool objects, and mark the rest as used this frame.
+        unsigned bytes = 0u;
+        _candidates.clear();
 
-            std::vector<GeometryKey> keys;
+        for (unsigned s = 0; s < NUM_SHARDS; ++s)
+        {
+            Shard& shard = _shards[s];
+            Threading::ScopedMutexLock exclusive( shard._mutex );
 
-            for (GeometryMap::iterator i = _geometryMap.begin(); i != _geometryMap.end(); ++i)
+            for (GeometryMap::iterator i = shard._geometryMap.begin(); i != shard._geometryMap.end(); ++i)
             {
-                if (i->second.get()->referenceCount() == 1)
+                PoolEntry& entry = i->second;
+                bytes += entry._bytes;
+
+                if (entry._geom->referenceCount() == 1)
+                {
+                    Candidate c;
+                    c._key = i->first;
+                    c._shard = s;
+                    c._lastUsed = entry._lastUsed;
+                    c._bytes = entry._bytes;
+                    _candidates.push_back(c);
+                }
+                else
                 {
-                    keys.push_back(i->first);
-                    objects.push_back(i->second.get());
-                    
-                    //OE_INFO << "Releasing: " << i->second.get() << std::endl;
+                    entry._lastUsed = frame;
                 }
             }
-            for (std::vector<GeometryKey>::iterator key = keys.begin(); key != keys.end(); ++key)
+        }
+
+        // Push the least recently used objects to the resource releaser
+        // until the pool fits in its size limit.
+        if (bytes > _maxBytes && !_candidates.empty() && _releaser.valid())
+        {
+            std::sort(_candidates.begin(), _candidates.end());
+
+            ResourceReleaser::ObjectList objects;
+
+            for (std::vector<Candidate>::const_iterator c = _candidates.begin(); c != _candidates.end() && bytes > _maxBytes; ++c)
             {
-                if (_geometryMap[*key]->referenceCount() != 2) // one for the map, and one for the local objects list
-                    OE_WARN << LC << "Erasing key geom with refcount <> 2" << std::endl;
+                Shard& shard = _shards[c->_shard];
+                Threading::ScopedMutexLock exclusive( shard._mutex );
 
-                _geometryMap.erase(*key);
+                // Skip it if a tile picked it up since we looked. Only the pool hands
+                // out references (under the lock), so an unused object here stays unused.
+                GeometryMap::iterator i = shard._geometryMap.find(c->_key);
+                if (i != shard._geometryMap.end() && i->second._geom->referenceCount() == 1)
+                {
+                    objects.push_back(i->second._geom.get());
+                    bytes -= i->second._bytes;
+                    shard._geometryMap.erase(i);
+                    ++shard._evictions;
+                }
             }
 
-            //OE_WARN << "Released " << keys.size() << ", pool = " << _geometryMap.size() << std::endl;
+            if (!objects.empty())
+            {
+                _releaser->push(objects);
+            }
         }
 
-        if (!objects.empty())
+        if (Metrics::enabled())
         {
-            _releaser->push(objects);
+            Metrics::counter("RexStats", "Geometry pool KB", (double)(bytes/1024u));
         }
     }
 
@@ -464,32 +536,53 @@ GeometryPool::clear()
     ResourceReleaser::ObjectList objects;
 
     // collect all objects in a thread safe manner
+    for (unsigned s = 0; s < NUM_SHARDS; ++s)
     {
-        Threading::ScopedMutexLock exclusive( _geometryMapMutex );
+        Shard& shard = _shards[s];
+        Threading::ScopedMutexLock exclusive( shard._mutex );
 
-        for (GeometryMap::iterator i = _geometryMap.begin(); i != _geometryMap.end(); ++i)
+        for (GeometryMap::iterator i = shard._geometryMap.begin(); i != shard._geometryMap.end(); ++i)
         {
-            //if (i->second.get()->referenceCount() == 1)
-            {
-                objects.push_back(i->second.get());
-            }
+            objects.push_back(i->second._geom.get());
         }
 
-        _geometryMap.clear();
-
-        if (!objects.empty())
-        {
-            OE_INFO << LC << "Cleared " << objects.size() << " objects from the geometry pool\n";
-        }
+        shard._geometryMap.clear();
     }
 
     // submit to the releaser.
     if (!objects.empty())
     {
+        OE_INFO << LC << "Cleared " << objects.size() << " objects from the geometry pool\n";
         _releaser->push(objects);
     }
 }
 
+GeometryPool::Stats
+GeometryPool::getStats() const
+{
+    Stats stats;
+
+    for (unsigned s = 0; s < NUM_SHARDS; ++s)
+    {
+        const Shard& shard = _shards[s];
+        Threading::ScopedMutexLock exclusive( shard._mutex );
+
+        stats.hits      += shard._hits;
+        stats.misses    += shard._misses;
+        stats.evictions += shard._evictions;
+        stats.geometries += shard._geometryMap.size();
+
+        for (GeometryMap::const_iterator i = shard._geometryMap.begin(); i != shard._geometryMap.end(); ++i)
+        {
+            stats.bytes += i->second._bytes;
+            if (i->second._geom->referenceCount() == 1)
+                stats.unusedBytes += i->second._bytes;
+        }
+    }
+
+    return stats;
+}
+
 //.........................................................................
 // Code mostly adapted from osgTerrain SharedGeometry.
 
@@ -516,6 +609,20 @@ SharedGeometry::~SharedGeometry()
     //nop
 }
 
+unsigned
+SharedGeometry::getTotalDataSize() const
+{
+    unsigned size = 0u;
+    if (_vertexArray.valid())   size += _vertexArray->getTotalDataSize();
+    if (_normalArray.valid())   size += _normalArray->getTotalDataSize();
+    if (_colorArray.valid())    size += _colorArray->getTotalDataSize();
+    if (_texcoordArray.valid()) size += _texcoordArray->getTotalDataSize();
+    if (_neighborArray.valid()) size += _neighborArray->getTotalDataSize();
+    if (_drawElements.valid())  size += _drawElements->getTotalDataSize();
+    if (_maskElements.valid())  size += _maskElements->getTotalDataSize();
+    return size;
+}
+
 #ifdef SUPPORTS_VAO
 osg::VertexArrayState* SharedGeometry::createVertexArrayState(osg::RenderInfo& renderInfo) const
 {
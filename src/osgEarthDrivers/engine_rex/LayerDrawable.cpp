@@ -25,6 +25,7 @@ using namespace osgEarth::Drivers::RexTerrainEngine;
 
 
 LayerDrawable::LayerDrawable() :
+_tiles(0L),
 _renderType(Layer::RENDERTYPE_TILE),
 _order(0),
 _layer(0L),
@@ -71,7 +72,7 @@ LayerDrawable::drawImplementation(osg::RenderInfo& ri) const
             ds._ext->glUniform1f(ds._layerMaxRangeUL, (GLfloat)FLT_MAX);
     }
 
-    for (DrawTileCommands::const_iterator tile = _tiles.begin(); tile != _tiles.end(); ++tile)
+    for (DrawTileCommands::const_iterator tile = _tiles->begin(); tile != _tiles->end(); ++tile)
     {
         tile->draw(ri, *_drawState, 0L);
     }
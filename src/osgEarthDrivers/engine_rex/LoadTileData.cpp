@@ -41,8 +41,8 @@ _enableCancel(true)
 namespace
 {
     struct MyProgress : public ProgressCallback {
-        LoadTileData* _req;
-        MyProgress(LoadTileData* req) : _req(req) {}
+        Loader::Request* _req;
+        MyProgress(Loader::Request* req) : _req(req) {}
         bool isCanceled() { return _req->isIdle(); }
     };
 }
@@ -141,3 +141,98 @@ LoadTileData::apply(const osg::FrameStamp* stamp)
         _dataModel = 0L;
     }
 }
+
+//........................................................................
+
+#undef  LC
+#define LC "[LoadTileQuad] "
+
+LoadTileQuad::LoadTileQuad(TileNode* parent, EngineContext* context) :
+_context(context)
+{
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        _tilenodes[i] = parent->getSubTile(i);
+        _pending[i] = true;
+    }
+
+    // the loader ranks requests by the LOD of their key.
+    this->setTileKey(parent->getSubTile(0)->getKey());
+    this->setName(parent->getKey().str() + " children");
+    _mapFrame.setMap(context->getMap());
+    _engine = context->getEngine();
+}
+
+// invoke runs in the background pager thread.
+void
+LoadTileQuad::invoke()
+{
+    if (!_mapFrame.isValid())
+        return;
+
+    osg::ref_ptr<TerrainEngineNode> engine;
+    if (!_engine.lock(engine))
+        return;
+
+    // ensure the map frame is up to date:
+    if (_mapFrame.needsSync())
+        _mapFrame.sync();
+
+    osg::ref_ptr<ProgressCallback> progress = new MyProgress(this);
+
+    // a child's first load always fetches every layer.
+    CreateTileModelFilter filter;
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        if (!_pending[i] || progress->isCanceled())
+            continue;
+
+        osg::ref_ptr<TileNode> tilenode;
+        if (_tilenodes[i].lock(tilenode))
+        {
+            _dataModels[i] = engine->createTileModel(
+                _mapFrame,
+                tilenode->getKey(),
+                filter,
+                progress.get() );
+        }
+    }
+}
+
+// apply() runs in the update traversal and can safely alter the scene graph
+void
+LoadTileQuad::apply(const osg::FrameStamp* stamp)
+{
+    const RenderBindings& bindings = _context->getRenderBindings();
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        if (!_dataModels[i].valid())
+            continue;
+
+        // ensure it's in sync with the map revision (not out of date); if not,
+        // the child stays pending and loads again the next time around.
+        if (_dataModels[i]->getRevision() == _context->getMap()->getDataModelRevision())
+        {
+            osg::ref_ptr<TileNode> tilenode;
+            if (_tilenodes[i].lock(tilenode))
+            {
+                tilenode->merge(_dataModels[i].get(), bindings);
+
+                // Hand the tile back to its own request for any later loads.
+                tilenode->setQuadRequest(0L);
+                tilenode->setDirty(false);
+
+                OE_DEBUG << LC << "apply " << _dataModels[i]->getKey().str() << "\n";
+            }
+            _pending[i] = false;
+        }
+        else
+        {
+            OE_INFO << LC << "apply " << _dataModels[i]->getKey().str() << " ignored b/c it is out of date\n";
+        }
+
+        _dataModels[i] = 0L;
+    }
+}
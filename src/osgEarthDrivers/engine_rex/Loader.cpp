@@ -42,6 +42,7 @@ Loader::Request::Request()
     _priority = 0;
     _lastFrameSubmitted = 0;
     _lastTick = 0;
+    _mergeQueueIndex = -1;
 }
 
 osg::StateSet*
@@ -90,6 +91,12 @@ SimpleLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& n
     return request != 0L;
 }
 
+void
+SimpleLoader::cancel(Loader::Request* request)
+{
+    // nop - requests run synchronously.
+}
+
 void
 SimpleLoader::clear()
 {
@@ -178,11 +185,131 @@ namespace
 }
 
 
+//...............................................
+
+void
+PagerLoader::MergeQueue::set(unsigned i, const Entry& entry)
+{
+    _heap[i] = entry;
+    _heap[i]._request->_mergeQueueIndex = (int)i;
+}
+
+void
+PagerLoader::MergeQueue::siftUp(unsigned i)
+{
+    Entry entry = _heap[i];
+    while ( i > 0 )
+    {
+        unsigned parent = (i-1)/2;
+        if ( !(_heap[parent]._priority < entry._priority) )
+            break;
+        set( i, _heap[parent] );
+        i = parent;
+    }
+    set( i, entry );
+}
+
+void
+PagerLoader::MergeQueue::siftDown(unsigned i)
+{
+    Entry entry = _heap[i];
+    unsigned size = _heap.size();
+    while ( true )
+    {
+        unsigned child = 2*i+1;
+        if ( child >= size )
+            break;
+        if ( child+1 < size && _heap[child]._priority < _heap[child+1]._priority )
+            ++child;
+        if ( !(entry._priority < _heap[child]._priority) )
+            break;
+        set( i, _heap[child] );
+        i = child;
+    }
+    set( i, entry );
+}
+
+void
+PagerLoader::MergeQueue::removeAt(unsigned i)
+{
+    _heap[i]._request->_mergeQueueIndex = -1;
+
+    unsigned last = _heap.size()-1;
+    if ( i < last )
+    {
+        set( i, _heap[last] );
+        _heap.pop_back();
+
+        // the moved entry may belong above or below its new position:
+        if ( i > 0 && _heap[(i-1)/2]._priority < _heap[i]._priority )
+            siftUp( i );
+        else
+            siftDown( i );
+    }
+    else
+    {
+        _heap.pop_back();
+    }
+}
+
+void
+PagerLoader::MergeQueue::push(Loader::Request* req, float priority)
+{
+    if ( req->_mergeQueueIndex >= 0 )
+    {
+        update( req, priority );
+        return;
+    }
+
+    Entry entry;
+    entry._request = req;
+    entry._priority = priority;
+    _heap.push_back( entry );
+    siftUp( _heap.size()-1 );
+}
+
+void
+PagerLoader::MergeQueue::pop()
+{
+    if ( !_heap.empty() )
+        removeAt( 0 );
+}
+
+void
+PagerLoader::MergeQueue::update(Loader::Request* req, float priority)
+{
+    int i = req->_mergeQueueIndex;
+    if ( i < 0 || i >= (int)_heap.size() || _heap[i]._request.get() != req )
+        return;
+
+    float old = _heap[i]._priority;
+    _heap[i]._priority = priority;
+    if ( priority > old )
+        siftUp( i );
+    else if ( priority < old )
+        siftDown( i );
+}
+
+bool
+PagerLoader::MergeQueue::remove(Loader::Request* req)
+{
+    int i = req->_mergeQueueIndex;
+    if ( i < 0 || i >= (int)_heap.size() || _heap[i]._request.get() != req )
+        return false;
+
+    removeAt( i );
+    return true;
+}
+
+//...............................................
+
 PagerLoader::PagerLoader(TerrainEngineNode* engine) :
-_checkpoint    ( (osg::Timer_t)0 ),
-_mergesPerFrame( 0 ),
-_frameNumber   ( 0 ),
-_numLODs       ( 20u )
+_checkpoint      ( (osg::Timer_t)0 ),
+_mergesPerFrame  ( 0 ),
+_mergeBudget     ( 0.0f ),
+_averageMergeTime( 0.0 ),
+_frameNumber     ( 0 ),
+_numLODs         ( 20u )
 {
     _myNodePath.push_back( this );
 
@@ -212,6 +339,13 @@ PagerLoader::setMergesPerFrame(int value)
     this->setNumChildrenRequiringUpdateTraversal( 1 );
 }
 
+void
+PagerLoader::setMergeBudget(float ms)
+{
+    _mergeBudget = std::max(ms, 0.0f);
+    this->setNumChildrenRequiringUpdateTraversal( 1 );
+}
+
 void
 PagerLoader::setLODPriorityScale(unsigned lod, float priorityScale)
 {
@@ -226,9 +360,26 @@ PagerLoader::setLODPriorityOffset(unsigned lod, float offset)
         _priorityOffsets[lod] = offset;
 }
 
+float
+PagerLoader::computePriority(Loader::Request* request, float priority) const
+{
+    // scale and bias the priority, and then normalize it to [0..1] range.
+    unsigned lod = request->getTileKey().getLOD();
+    float p = priority * _priorityScales[lod] + _priorityOffsets[lod];
+    return p / (float)(_numLODs+1);
+}
+
 bool
 PagerLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& nv)
 {
+    // a request waiting to merge keeps its place in line current as the camera moves:
+    if ( request && request->isMerging() )
+    {
+        Threading::ScopedMutexLock lock( _mergeQueueMutex );
+        _mergeQueue.update( request, computePriority(request, priority) );
+        return false;
+    }
+
     // check that the request is not already completed but unmerged:
     //if ( request && !request->isMerging() && nv.getDatabaseRequestHandler() )
     if ( request && !request->isMerging() && !request->isFinished() && nv.getDatabaseRequestHandler() )
@@ -253,9 +404,7 @@ PagerLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& nv
             request->_lastTick = osg::Timer::instance()->tick();
 
             // update the priority, scale and bias it, and then normalize it to [0..1] range.
-            unsigned lod = request->getTileKey().getLOD();
-            float p = priority * _priorityScales[lod] + _priorityOffsets[lod];            
-            request->_priority = p / (float)(_numLODs+1);
+            request->_priority = computePriority(request, priority);
 
             // timestamp it
             request->setFrameNumber( fn );
@@ -292,6 +441,32 @@ PagerLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& nv
     return false;
 }
 
+void
+PagerLoader::cancel(Loader::Request* request)
+{
+    if ( !request )
+        return;
+
+    bool pending = false;
+    {
+        Threading::ScopedMutexLock lock( _requestsMutex );
+        pending = _requests.erase( request->getUID() ) > 0;
+    }
+    {
+        Threading::ScopedMutexLock lock( _mergeQueueMutex );
+        _mergeQueue.remove( request );
+    }
+
+    if ( pending )
+    {
+        // going IDLE also tells a running invoke() to stop, and tells
+        // addChild() to discard the result.
+        request->setState( Request::IDLE );
+        if ( REPORT_ACTIVITY )
+            Registry::instance()->endActivity( request->getName() );
+    }
+}
+
 void
 PagerLoader::clear()
 {
@@ -302,7 +477,7 @@ PagerLoader::clear()
 void
 PagerLoader::traverse(osg::NodeVisitor& nv)
 {
-    // only called when _mergesPerFrame > 0
+    // only called when merges are queued (see queueMerges)
     if ( nv.getVisitorType() == nv.UPDATE_VISITOR )
     {
         if ( nv.getFrameStamp() )
@@ -310,20 +485,40 @@ PagerLoader::traverse(osg::NodeVisitor& nv)
             setFrameStamp(nv.getFrameStamp());
         }
 
-        int count;
-        for(count=0; count < _mergesPerFrame && !_mergeQueue.empty(); ++count)
+        // Merge the highest priority requests, up to the count limit and the time
+        // budget. A merge that probably won't fit in the time left (judging by
+        // the average merge time) waits for the next frame; but always merge
+        // at least one request per frame so the queue keeps moving.
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        int count = 0;
+        while ( _mergesPerFrame == 0 || count < _mergesPerFrame )
         {
-            Request* req = _mergeQueue.begin()->get();
-            if ( req && req->_lastTick >= _checkpoint )
+            if ( _mergeBudget > 0.0f && count > 0 )
+            {
+                double elapsed = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+                if ( elapsed + _averageMergeTime > (double)_mergeBudget )
+                    break;
+            }
+
+            RefRequest req;
+            {
+                Threading::ScopedMutexLock lock( _mergeQueueMutex );
+                if ( _mergeQueue.empty() )
+                    break;
+                req = _mergeQueue.top();
+                _mergeQueue.pop();
+            }
+
+            if ( req->_lastTick >= _checkpoint )
             {
                 OE_START_TIMER(req_apply);
                 req->apply( getFrameStamp() );
-                double s = OE_STOP_TIMER(req_apply);
-
-                req->setState(Request::FINISHED);
+                double ms = 1000.0 * OE_STOP_TIMER(req_apply);
+                _averageMergeTime = _averageMergeTime > 0.0 ? 0.9*_averageMergeTime + 0.1*ms : ms;
+                ++count;
             }
 
-            _mergeQueue.erase( _mergeQueue.begin() );
+            req->setState(Request::FINISHED);
         }
 
         // cull finished requests.
@@ -364,6 +559,10 @@ PagerLoader::traverse(osg::NodeVisitor& nv)
                 else if ( req->isMerging() && frameDiff > 1800 )
                 {
                     //OE_INFO << LC << req->getName() << "(" << i->second->getUID() << ") died waiting " << frameDiff << " frames to merge" << std::endl; 
+                    {
+                        Threading::ScopedMutexLock lock( _mergeQueueMutex );
+                        _mergeQueue.remove( req );
+                    }
                     req->setState( Request::IDLE );
                     if ( REPORT_ACTIVITY )
                         Registry::instance()->endActivity( req->getName() );
@@ -391,13 +590,16 @@ PagerLoader::addChild(osg::Node* node)
     if ( result.valid() )
     {
         Request* req = result->getRequest();
-        if ( req )
+
+        // an IDLE request was canceled (or expired) while it was running.
+        if ( req && !req->isIdle() )
         {
             if ( req->_lastTick >= _checkpoint )
             {
-                if ( _mergesPerFrame > 0 )
+                if ( queueMerges() )
                 {
-                    _mergeQueue.insert( req );
+                    Threading::ScopedMutexLock lock( _mergeQueueMutex );
+                    _mergeQueue.push( req, req->_priority );
                     req->setState( Request::MERGING );
                 }
                 else
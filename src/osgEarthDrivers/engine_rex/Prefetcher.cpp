@@ -0,0 +1,239 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2008-2014 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "Prefetcher"
+#include "TerrainCuller"
+#include "TileNode"
+#include <osgEarth/Metrics>
+#include <osgUtil/CullVisitor>
+#include <cmath>
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers::RexTerrainEngine;
+
+#define LC "[Prefetcher] "
+
+// Forget cameras that haven't culled for this many frames.
+#define MAX_HISTORY_AGE 60u
+
+Prefetcher::Prefetcher(float lookAhead, unsigned budget) :
+_lookAhead( osg::clampBetween(lookAhead, 0.0f, 10.0f) ),
+_budget   ( budget )
+{
+    // sign up for the update traversal so we can follow up on prefetches.
+    setNumChildrenRequiringUpdateTraversal(1u);
+}
+
+Prefetcher::~Prefetcher()
+{
+    Stats stats = getStats();
+    if (stats.issued > 0u)
+    {
+        OE_INFO << LC
+            << "Prefetched " << stats.issued << " tiles: "
+            << stats.hits << " hits (" << (100u*stats.hits/stats.issued) << "%), "
+            << stats.late << " late, "
+            << stats.canceled << " canceled" << std::endl;
+    }
+}
+
+void
+Prefetcher::cull(osgUtil::CullVisitor* cv, osg::Node* terrain, EngineContext* context)
+{
+    const osg::Camera* camera = cv->getCurrentCamera();
+    const osg::FrameStamp* fs = cv->getFrameStamp();
+
+    // Inherit-viewpoint cameras never load tiles, and nothing loads without a pager.
+    if (!camera || !fs || !terrain || !cv->getDatabaseRequestHandler() ||
+        camera->getReferenceFrame() == osg::Camera::ABSOLUTE_RF_INHERIT_VIEWPOINT)
+    {
+        return;
+    }
+
+    osg::ref_ptr<osg::RefMatrix> modelView;
+    int budget = 0;
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+
+        osg::Matrixd predicted;
+        if (!predict(camera, *cv->getModelViewMatrix(), fs, predicted))
+            return;
+
+        modelView = new osg::RefMatrix(predicted);
+        budget = (int)_budget - (int)_pending.size();
+    }
+
+    // Cull from the predicted viewpoint. Even with no budget left, this keeps
+    // the loads already in flight current.
+    TerrainCuller culler(cv, context, modelView.get());
+    culler._prefetch = true;
+    culler._prefetchBudget = budget;
+    terrain->accept(culler);
+
+    if (!culler._prefetchedTiles.empty())
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        for (std::vector<TileNode*>::const_iterator i = culler._prefetchedTiles.begin(); i != culler._prefetchedTiles.end(); ++i)
+        {
+            _pending.push_back(*i);
+            ++_issued;
+        }
+    }
+}
+
+bool
+Prefetcher::predict(const osg::Camera* camera, const osg::Matrixd& modelView, const osg::FrameStamp* fs, osg::Matrixd& out)
+{
+    unsigned frame = fs->getFrameNumber();
+    double time = fs->getReferenceTime();
+
+    History& h = _histories[camera];
+
+    // Another view of the same camera this frame (stereo, say) is already covered.
+    if (h._frame == frame && h._time == time)
+        return false;
+
+    // Work in the terrain's local frame, where the inverse model view matrix
+    // is the camera's position and orientation.
+    osg::Matrixd world = osg::Matrixd::inverse(modelView);
+    osg::Vec3d eye = world.getTrans();
+    osg::Matrixd rotation(world.getRotate());
+
+    bool predicted = false;
+    double dt = time - h._time;
+
+    if (h._frame+1u == frame && dt > 0.0)
+    {
+        // smooth the velocity over the last few frames:
+        osg::Vec3d velocity = (eye - h._eye) / dt;
+        h._velocity = h._valid ? (h._velocity + velocity)*0.5 : velocity;
+        h._valid = true;
+
+        // the turn since last frame (rotation = h._rotation * turn), as an angle about an axis:
+        double angle = 0.0;
+        osg::Vec3d axis;
+        (osg::Matrixd::inverse(h._rotation) * rotation).getRotate().getRotate(angle, axis);
+        if (angle > osg::PI)
+            angle -= 2.0*osg::PI;
+
+        // keep turning at the same rate, but not all the way around:
+        angle = osg::clampBetween(angle*_lookAhead/dt, -osg::PI_4, osg::PI_4);
+
+        osg::Vec3d offset = h._velocity * _lookAhead;
+
+        // skip it unless the camera will move far enough to need other tiles.
+        if (offset.length2() > 1.0 || fabs(angle) > 0.01)
+        {
+            out = osg::Matrixd::inverse(
+                rotation *
+                osg::Matrixd::rotate(angle, axis) *
+                osg::Matrixd::translate(eye + offset));
+
+            predicted = true;
+        }
+    }
+    else
+    {
+        // missed a frame; start measuring again.
+        h._valid = false;
+    }
+
+    h._frame = frame;
+    h._time = time;
+    h._eye = eye;
+    h._rotation = rotation;
+
+    return predicted;
+}
+
+void
+Prefetcher::tileVisited(bool loaded)
+{
+    if (loaded)
+        ++_hits;
+    else
+        ++_late;
+}
+
+Prefetcher::Stats
+Prefetcher::getStats() const
+{
+    Stats stats;
+    stats.issued = _issued;
+    stats.hits = _hits;
+    stats.late = _late;
+    stats.canceled = _canceled;
+    return stats;
+}
+
+void
+Prefetcher::traverse(osg::NodeVisitor& nv)
+{
+    if (nv.getVisitorType() == nv.UPDATE_VISITOR && nv.getFrameStamp())
+    {
+        unsigned frame = nv.getFrameStamp()->getFrameNumber();
+
+        Threading::ScopedMutexLock lock(_mutex);
+
+        for (TileList::iterator i = _pending.begin(); i != _pending.end(); )
+        {
+            bool done = true;
+
+            // Tiles that expired, loaded, or that the main cull took over are
+            // done. A load that neither cull asked for last frame was a bad
+            // prediction, so free up the pager for something useful.
+            osg::ref_ptr<TileNode> tile;
+            if (i->lock(tile) && tile->isPrefetched() && tile->isDirty())
+            {
+                if (tile->getLastLoadFrame()+1u < frame)
+                {
+                    tile->cancelLoad();
+                    tile->setPrefetched(false);
+                    ++_canceled;
+                }
+                else
+                {
+                    done = false;
+                }
+            }
+
+            if (done)
+                i = _pending.erase(i);
+            else
+                ++i;
+        }
+
+        for (Histories::iterator i = _histories.begin(); i != _histories.end(); )
+        {
+            if (i->second._frame + MAX_HISTORY_AGE < frame)
+                _histories.erase(i++);
+            else
+                ++i;
+        }
+
+        if (Metrics::enabled())
+        {
+            Stats stats = getStats();
+            Metrics::counter("RexStats",
+                "Prefetch loads", (double)_pending.size(),
+                "Prefetch hit rate %", stats.issued > 0u ? 100.0*(double)stats.hits/(double)stats.issued : 0.0);
+        }
+    }
+
+    osg::Group::traverse(nv);
+}
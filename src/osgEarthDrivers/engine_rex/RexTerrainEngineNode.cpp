@@ -35,6 +35,7 @@
 #include <osg/BlendFunc>
 #include <osg/Depth>
 #include <osg/CullFace>
+#include <osg/Stats>
 
 #include <cstdlib> // for getenv
 
@@ -264,6 +265,7 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& options)
     PagerLoader* loader = new PagerLoader( this );
     loader->setNumLODs(_terrainOptions.maxLOD().getOrUse(DEFAULT_MAX_LOD));
     loader->setMergesPerFrame( _terrainOptions.mergesPerFrame().get() );
+    loader->setMergeBudget( _terrainOptions.mergeBudget().get() );
     for (std::vector<RexTerrainEngineOptions::LODOptions>::const_iterator i = _terrainOptions.lods().begin(); i != _terrainOptions.lods().end(); ++i) {
         if (i->_lod.isSet()) {
             loader->setLODPriorityScale(i->_lod.get(), i->_priorityScale.getOrUse(1.0f));
@@ -284,6 +286,13 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& options)
     _rasterizer = new TileRasterizer();
     this->addChild( _rasterizer );
 
+    // Tile prefetcher if requested
+    if ( _terrainOptions.prefetch() == true )
+    {
+        _prefetcher = new Prefetcher( _terrainOptions.prefetchTime().get(), _terrainOptions.prefetchBudget().get() );
+        this->addChild( _prefetcher.get() );
+    }
+
     // Initialize the core render bindings.
     setupRenderBindings();
 
@@ -313,6 +322,7 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& options)
         _loader.get(),
         _unloader.get(),
         _rasterizer,
+        _prefetcher.get(),
         _liveTiles.get(),
         _renderBindings,
         _terrainOptions,
@@ -573,6 +583,7 @@ RexTerrainEngineNode::traverse(osg::NodeVisitor& nv)
         LayerDrawable* lastLayer = 0L;
         unsigned order = 0;
         bool surfaceStateSetPushed = false;
+        unsigned drawCommands = 0u;
 
         //std::stringstream buf;
 
@@ -581,10 +592,11 @@ RexTerrainEngineNode::traverse(osg::NodeVisitor& nv)
             ++i)
         {
             // Note: Cannot save lastLayer here because its _tiles may be empty, which can lead to a crash later
-            if (!i->get()->_tiles.empty())
+            if (!i->get()->_tiles->empty())
             {
                 lastLayer = i->get();
                 lastLayer->_order = -1;
+                drawCommands += lastLayer->_tiles->size();
 
                 // if this is a RENDERTYPE_TILE, we need to activate the default surface state set.
                 if (lastLayer->_renderType == Layer::RENDERTYPE_TILE)
@@ -630,6 +642,21 @@ RexTerrainEngineNode::traverse(osg::NodeVisitor& nv)
 
         this->getEngineContext()->endCull( cv );
 
+        // Report the cull results to the camera's stats, if it's collecting them.
+        osg::Stats* stats = cv->getCurrentCamera() ? cv->getCurrentCamera()->getStats() : 0L;
+        if (stats && stats->collectStats("rex") && nv.getFrameStamp())
+        {
+            unsigned frame = nv.getFrameStamp()->getFrameNumber();
+            stats->setAttribute(frame, "Rex draw commands", (double)drawCommands);
+            stats->setAttribute(frame, "Rex live tiles", (double)(_liveTiles.valid() ? _liveTiles->size() : 0u));
+        }
+
+        // Start loading the tiles the camera is headed for.
+        if ( _prefetcher.valid() )
+        {
+            _prefetcher->cull( cv, _terrain.get(), getEngineContext() );
+        }
+
         // If the culler found any orphaned data, we need to update the render model
         // during the next update cycle.
         if (culler._orphanedPassesDetected > 0u)
@@ -25,13 +25,15 @@
 using namespace osgEarth::Drivers::RexTerrainEngine;
 
 
-TerrainCuller::TerrainCuller(osgUtil::CullVisitor* cullVisitor, EngineContext* context) :
+TerrainCuller::TerrainCuller(osgUtil::CullVisitor* cullVisitor, EngineContext* context, osg::RefMatrix* modelView) :
 _frame(0L),
 _camera(0L),
 _currentTileNode(0L),
 _orphanedPassesDetected(0u),
 _cv(cullVisitor),
-_context(context)
+_context(context),
+_prefetch(false),
+_prefetchBudget(0)
 {
     setVisitorType(CULL_VISITOR);
     setTraversalMode(TRAVERSE_ALL_CHILDREN);
@@ -41,7 +43,7 @@ _context(context)
     pushReferenceViewPoint(_cv->getReferenceViewPoint());
     pushViewport(_cv->getViewport());
     pushProjectionMatrix(_cv->getProjectionMatrix());
-    pushModelViewMatrix(_cv->getModelViewMatrix(), _cv->getCurrentCamera()->getReferenceFrame());
+    pushModelViewMatrix(modelView ? modelView : _cv->getModelViewMatrix(), _cv->getCurrentCamera()->getReferenceFrame());
     _camera = _cv->getCurrentCamera();
 }
 
@@ -49,7 +51,8 @@ void
 TerrainCuller::setup(const MapFrame& frame, const RenderBindings& bindings)
 {
     unsigned frameNum = getFrameStamp() ? getFrameStamp()->getFrameNumber() : 0u;
-    _terrain.setup(frame, bindings, frameNum, *this, _camera);
+    osg::ref_ptr<DrawCommandBuffer> commands = _context->_drawCommandBuffers.acquire();
+    _terrain.setup(frame, bindings, commands.get(), frameNum, *this, _camera);
 }
 
 float
@@ -71,11 +74,11 @@ TerrainCuller::addDrawCommand(UID uid, const TileRenderModel* model, const Rende
         return 0L;
 
     // add a new Draw command to the appropriate layer
-    osg::ref_ptr<LayerDrawable> layer = _terrain.layer(uid);
-    if (layer.valid())
+    LayerDrawable* layer = _terrain.findLayer(uid);
+    if (layer)
     {
-        layer->_tiles.push_back(DrawTileCommand());
-        DrawTileCommand& tile = layer->_tiles.back();
+        layer->_tiles->push_back(DrawTileCommand());
+        DrawTileCommand& tile = layer->_tiles->back();
 
         // install everything we need in the Draw Command:
         tile._colorSamplers = pass ? &pass->_samplers : 0L;
@@ -85,7 +88,7 @@ TerrainCuller::addDrawCommand(UID uid, const TileRenderModel* model, const Rende
         tile._keyValue = tileNode->getTileKeyValue();
         tile._geom = surface->getDrawable()->_geom.get();
         tile._morphConstants = tileNode->getMorphConstants();
-        tile._key = tileNode->getKey();
+        tile._key = &tileNode->getKey();
 
 #if 1
         osg::Vec3 c = surface->getBound().center() * surface->getInverseMatrix();
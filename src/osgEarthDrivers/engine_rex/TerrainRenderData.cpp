@@ -31,15 +31,16 @@ TerrainRenderData::sortDrawCommands()
 {
     for (LayerDrawableList::iterator i = _layerList.begin(); i != _layerList.end(); ++i)
     {
-        i->get()->_tiles.sort();
+        _commands->sort(*i->get()->_tiles);
     }
 }
 
 void
-TerrainRenderData::setup(const MapFrame& frame, const RenderBindings& bindings,
+TerrainRenderData::setup(const MapFrame& frame, const RenderBindings& bindings, DrawCommandBuffer* commands,
                          unsigned frameNum, osg::NodeVisitor& nv, const osg::Camera* camera)
 {
     _bindings = &bindings;
+    _commands = commands;
 
     // Create a new State object to track sampler and uniform settings
     _drawState = new DrawState();
@@ -101,6 +102,14 @@ TerrainRenderData::setup(const MapFrame& frame, const RenderBindings& bindings,
     // Include a "blank" layer for missing data.
     LayerDrawable* blank = addLayerDrawable(0L);
     blank->getOrCreateStateSet()->setDefine("OE_TERRAIN_RENDER_IMAGERY", osg::StateAttribute::OFF);
+
+    // Give each layer a command list from the frame's buffer.
+    _commands->reset(_layerList.size());
+    for (unsigned i = 0; i < _layerList.size(); ++i)
+    {
+        _layerList[i]->_tiles = &_commands->list(i);
+        _layerList[i]->_commands = _commands.get();
+    }
 }
 
 LayerDrawable*
@@ -371,6 +371,13 @@ TileNode::cull(TerrainCuller* culler)
     {
         return false;
     }
+
+    // Tell the prefetcher whether it got here first.
+    bool prefetch = culler->_prefetch;
+    if ( !prefetch && _prefetched.exchange(0u) != 0u && context->getPrefetcher() )
+    {
+        context->getPrefetcher()->tileVisited( !_dirty );
+    }
     
     // determine whether we can and should subdivide to a higher resolution:
     bool childrenInRange = shouldSubDivide(culler, context->getSelectionInfo());
@@ -399,6 +406,12 @@ TileNode::cull(TerrainCuller* culler)
         canLoadData       = false;
     }
 
+    // A prefetch only creates children within its budget; each set counts as one load.
+    if ( prefetch && culler->_prefetchBudget <= 0 )
+    {
+        canCreateChildren = false;
+    }
+
     if (childrenInRange)
     {
         // We are in range of the child nodes. Either draw them or load them.
@@ -417,6 +430,9 @@ TileNode::cull(TerrainCuller* culler)
 
                 // This means that you cannot start loading data immediately; must wait a frame.
                 canLoadData = false;
+
+                if ( prefetch )
+                    --culler->_prefetchBudget;
             }
 
             _mutex.unlock();
@@ -444,8 +460,8 @@ TileNode::cull(TerrainCuller* culler)
         canAcceptSurface = true;
     }
 
-    // accept this surface if necessary.
-    if ( canAcceptSurface )
+    // accept this surface if necessary (a prefetch draws nothing).
+    if ( canAcceptSurface && !prefetch )
     {
         _surface->accept( *culler );
         _lastAcceptSurfaceFrame.exchange( culler->getFrameStamp()->getFrameNumber() );
@@ -562,6 +578,16 @@ TileNode::createChildren(EngineContext* context)
         // Add to the scene graph.
         addChild( node );
     }
+
+    // Optionally load all four children with a single request.
+    if ( context->getOptions().quadLoading() == true )
+    {
+        osg::ref_ptr<LoadTileQuad> quad = new LoadTileQuad( this, context );
+        for(unsigned quadrant=0; quadrant<4; ++quadrant)
+        {
+            getSubTile(quadrant)->setQuadRequest( quad.get() );
+        }
+    }
 }
 
 void
@@ -872,8 +898,54 @@ TileNode::load(TerrainCuller* culler)
     // normalize the composite priority to [0..1].
     //priority /= (float)(numLods+1); // GW: moved this to the PagerLoader.
 
+    Loader::Request* request = getLoadRequest();
+
+    if ( culler->_prefetch )
+    {
+        // Leave loads the main cull asked for this frame alone. New loads must
+        // fit in the budget, and rank below the tiles in view.
+        unsigned frame = culler->getFrameStamp()->getFrameNumber();
+        bool idle = request->isIdle();
+        bool resubmit = request->isRunning() && request->getLastFrameSubmitted() != frame;
+
+        if ( (idle && culler->_prefetchBudget > 0) || resubmit )
+        {
+            priority -= (float)(numLods+1);
+
+            if ( _context->getLoader()->load( request, priority, *culler ) && idle )
+            {
+                --culler->_prefetchBudget;
+                _prefetched.exchange(1u);
+                culler->_prefetchedTiles.push_back( this );
+            }
+        }
+        return;
+    }
+
     // Submit to the loader.
-    _context->getLoader()->load( _loadRequest.get(), priority, *culler );
+    _context->getLoader()->load( request, priority, *culler );
+}
+
+Loader::Request*
+TileNode::getLoadRequest() const
+{
+    if ( _quadRequest.valid() )
+        return _quadRequest.get();
+    else
+        return _loadRequest.get();
+}
+
+void
+TileNode::setQuadRequest(LoadTileQuad* request)
+{
+    _quadRequest = request;
+}
+
+unsigned
+TileNode::getLastLoadFrame() const
+{
+    Loader::Request* request = getLoadRequest();
+    return request ? request->getLastFrameSubmitted() : 0u;
 }
 
 void
@@ -885,6 +957,19 @@ TileNode::loadSync()
     loadTileData->apply(0L);
 }
 
+void
+TileNode::cancelLoad()
+{
+    if ( _context.valid() && _context->getLoader() )
+    {
+        if ( _quadRequest.valid() )
+            _context->getLoader()->cancel( _quadRequest.get() );
+
+        if ( _loadRequest.valid() )
+            _context->getLoader()->cancel( _loadRequest.get() );
+    }
+}
+
 bool
 TileNode::areSubTilesDormant(const osg::FrameStamp* fs) const
 {
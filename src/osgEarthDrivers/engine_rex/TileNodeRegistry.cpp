@@ -110,12 +110,10 @@ TileNodeRegistry::addSafely(TileNode* tile)
     startListeningFor(tile->getKey().createNeighborKey(0, 1), tile);
 
     // check for tiles that are waiting on this tile, and notify them!
-    TileKeyOneToMany::iterator notifier = _notifiers.find( tile->getKey() );
-    if ( notifier != _notifiers.end() )
+    TileKeySet* listeners = _notifiers.find( tile->getKey() );
+    if ( listeners )
     {
-        TileKeySet& listeners = notifier->second;
-
-        for(TileKeySet::iterator listener = listeners.begin(); listener != listeners.end(); ++listener)
+        for(TileKeySet::iterator listener = listeners->begin(); listener != listeners->end(); ++listener)
         {
             TileNode* listenerTile = _tiles.find( *listener );
             if ( listenerTile )
@@ -123,7 +121,7 @@ TileNodeRegistry::addSafely(TileNode* tile)
                 listenerTile->notifyOfArrival( tile );
             }
         }
-        _notifiers.erase( notifier );
+        _notifiers.erase( tile->getKey() );
     }
 
     OE_DEBUG << LC << _name 
@@ -297,16 +295,16 @@ TileNodeRegistry::stopListeningFor(const TileKey& tileToWaitFor, TileNode* waite
     //Threading::ScopedMutexLock lock( _tilesMutex );
     // ASSUME EXCLUSIVE LOCK
 
-    TileKeyOneToMany::iterator i = _notifiers.find(tileToWaitFor);
-    if (i != _notifiers.end())
+    TileKeySet* waiters = _notifiers.find(tileToWaitFor);
+    if (waiters)
     {
         // remove the waiter from this set:
-        i->second.erase(waiter->getKey());
+        waiters->erase(waiter->getKey());
 
         // if the set is now empty, remove the set entirely
-        if (i->second.empty())
+        if (waiters->empty())
         {
-            _notifiers.erase(i);
+            _notifiers.erase(tileToWaitFor);
         }
     }
 }
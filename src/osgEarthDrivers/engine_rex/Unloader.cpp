@@ -52,6 +52,8 @@ namespace
             TileNode* tn = dynamic_cast<TileNode*>( &node );
             if ( tn )
             {
+                // don't spend any more loading or merging time on it:
+                tn->cancelLoad();
                 _nodes.push_back(tn);
                 _tiles->remove( tn );
                 _count++;
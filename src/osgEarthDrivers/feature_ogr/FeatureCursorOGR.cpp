@@ -69,12 +69,70 @@ namespace
 }
 
 
+OGRDataSourcePool::OGRDataSourcePool(const std::string& source, unsigned maxHandles) :
+_source    ( source ),
+_maxHandles( maxHandles ),
+_numHandles( 0u )
+{
+    //nop
+}
+
+OGRDataSourcePool::~OGRDataSourcePool()
+{
+    OGR_SCOPED_LOCK;
+    for (std::vector<OGRDataSourceH>::iterator i = _idle.begin(); i != _idle.end(); ++i)
+        OGRReleaseDataSource( *i );
+}
+
+OGRDataSourceH
+OGRDataSourcePool::checkout()
+{
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        if ( !_idle.empty() )
+        {
+            OGRDataSourceH handle = _idle.back();
+            _idle.pop_back();
+            return handle;
+        }
+
+        if ( _numHandles >= _maxHandles )
+            return 0L;
+
+        ++_numHandles;
+    }
+
+    // Not shared, so the handle belongs to this cursor alone.
+    OGRDataSourceH handle;
+    {
+        OGR_SCOPED_LOCK;
+        handle = OGROpen( _source.c_str(), 0, 0L );
+    }
+
+    if ( !handle )
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        --_numHandles;
+    }
+    return handle;
+}
+
+void
+OGRDataSourcePool::checkin(OGRDataSourceH handle)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _idle.push_back( handle );
+}
+
+
 FeatureCursorOGR::FeatureCursorOGR(OGRDataSourceH              dsHandle,
                                    OGRLayerH                   layerHandle,
                                    const FeatureSource*        source,
                                    const FeatureProfile*       profile,
                                    const Symbology::Query&     query,
-                                   const FeatureFilterList&    filters) :
+                                   const FeatureFilterList&    filters,
+                                   OGRDataSourcePool*          pool,
+                                   bool                        columnarAttributes) :
 _source           ( source ),
 _dsHandle         ( dsHandle ),
 _layerHandle      ( layerHandle ),
@@ -85,118 +143,148 @@ _chunkSize        ( 500 ),
 _nextHandleToQueue( 0L ),
 _resultSetEndReached(false),
 _profile          ( profile ),
-_filters          ( filters )
+_filters          ( filters ),
+_pool             ( pool ),
+_columnarAttributes( columnarAttributes )
 {
+    // A pooled handle belongs to this cursor alone, so it needs no lock.
+    if ( _pool.valid() )
+    {
+        executeQuery();
+    }
+    else
     {
         OGR_SCOPED_LOCK;
+        executeQuery();
+    }
 
-        std::string expr;
-        std::string from = OGR_FD_GetName( OGR_L_GetLayerDefn( _layerHandle ));        
-        
-        
-        std::string driverName = OGR_Dr_GetName( OGR_DS_GetDriver( dsHandle ) );             
-        // Quote the layer name if it is a shapefile, so we can handle any weird filenames like those with spaces or hyphens.
-        // Or quote any layers containing spaces for PostgreSQL
-        if (driverName == "ESRI Shapefile" || driverName == "VRT" ||
-            from.find(" ") != std::string::npos)
-        {
-            std::string delim = "\"";
-            from = delim + from + delim;
-        }
+    readChunk();
+}
 
-        if ( _query.expression().isSet() )
-        {
-            // build the SQL: allow the Query to include either a full SQL statement or
-            // just the WHERE clause.
-            expr = _query.expression().value();
+void
+FeatureCursorOGR::executeQuery()
+{
+    std::string expr;
+    std::string from = OGR_FD_GetName( OGR_L_GetLayerDefn( _layerHandle ));        
+    
+    
+    std::string driverName = OGR_Dr_GetName( OGR_DS_GetDriver( _dsHandle ) );             
+    // Quote the layer name if it is a shapefile, so we can handle any weird filenames like those with spaces or hyphens.
+    // Or quote any layers containing spaces for PostgreSQL
+    if (driverName == "ESRI Shapefile" || driverName == "VRT" ||
+        from.find(" ") != std::string::npos)
+    {
+        std::string delim = "\"";
+        from = delim + from + delim;
+    }
 
-            // if the expression is just a where clause, expand it into a complete SQL expression.
-            std::string temp = osgEarth::toLower(expr);
+    if ( _query.expression().isSet() )
+    {
+        // build the SQL: allow the Query to include either a full SQL statement or
+        // just the WHERE clause.
+        expr = _query.expression().value();
 
-            if ( temp.find( "select" ) != 0 )
-            {
-                std::stringstream buf;
-                buf << "SELECT * FROM " << from << " WHERE " << expr;
-                std::string bufStr;
-                bufStr = buf.str();
-                expr = bufStr;
-            }
-        }
-        else
+        // if the expression is just a where clause, expand it into a complete SQL expression.
+        std::string temp = osgEarth::toLower(expr);
+
+        if ( temp.find( "select" ) != 0 )
         {
             std::stringstream buf;
-            buf << "SELECT * FROM " << from;
-            expr = buf.str();
+            buf << "SELECT * FROM " << from << " WHERE " << expr;
+            std::string bufStr;
+            bufStr = buf.str();
+            expr = bufStr;
         }
+    }
+    else
+    {
+        std::stringstream buf;
+        buf << "SELECT * FROM " << from;
+        expr = buf.str();
+    }
 
-        //Include the order by clause if it's set
-        if (_query.orderby().isSet())
-        {                     
-            std::string orderby = _query.orderby().value();
-            
-            std::string temp = osgEarth::toLower(orderby);
-
-            if ( temp.find( "order by" ) != 0 )
-            {                
-                std::stringstream buf;
-                buf << "ORDER BY " << orderby;                
-                std::string bufStr;
-                bufStr = buf.str();
-                orderby = buf.str();
-            }
-            expr += (" " + orderby );
-        }
+    //Include the order by clause if it's set
+    if (_query.orderby().isSet())
+    {                     
+        std::string orderby = _query.orderby().value();
+        
+        std::string temp = osgEarth::toLower(orderby);
 
-        // if the tilekey is set, convert it to feature profile coords
-        if ( _query.tileKey().isSet() && !_query.bounds().isSet() && profile )
-        {
-            GeoExtent localEx = _query.tileKey()->getExtent().transform( profile->getSRS() );
-            _query.bounds() = localEx.bounds();
+        if ( temp.find( "order by" ) != 0 )
+        {                
+            std::stringstream buf;
+            buf << "ORDER BY " << orderby;                
+            std::string bufStr;
+            bufStr = buf.str();
+            orderby = buf.str();
         }
+        expr += (" " + orderby );
+    }
 
-        // if there's a spatial extent in the query, build the spatial filter:
-        if ( _query.bounds().isSet() )
-        {
-            OGRGeometryH ring = OGR_G_CreateGeometry( wkbLinearRing );
-            OGR_G_AddPoint(ring, _query.bounds()->xMin(), _query.bounds()->yMin(), 0 );
-            OGR_G_AddPoint(ring, _query.bounds()->xMin(), _query.bounds()->yMax(), 0 );
-            OGR_G_AddPoint(ring, _query.bounds()->xMax(), _query.bounds()->yMax(), 0 );
-            OGR_G_AddPoint(ring, _query.bounds()->xMax(), _query.bounds()->yMin(), 0 );
-            OGR_G_AddPoint(ring, _query.bounds()->xMin(), _query.bounds()->yMin(), 0 );
-
-            _spatialFilter = OGR_G_CreateGeometry( wkbPolygon );
-            OGR_G_AddGeometryDirectly( _spatialFilter, ring ); 
-            // note: "Directly" above means _spatialFilter takes ownership if ring handle
-        }
+    // if the tilekey is set, convert it to feature profile coords
+    if ( _query.tileKey().isSet() && !_query.bounds().isSet() && _profile.valid() )
+    {
+        GeoExtent localEx = _query.tileKey()->getExtent().transform( _profile->getSRS() );
+        _query.bounds() = localEx.bounds();
+    }
 
+    // if there's a spatial extent in the query, build the spatial filter:
+    if ( _query.bounds().isSet() )
+    {
+        OGRGeometryH ring = OGR_G_CreateGeometry( wkbLinearRing );
+        OGR_G_AddPoint(ring, _query.bounds()->xMin(), _query.bounds()->yMin(), 0 );
+        OGR_G_AddPoint(ring, _query.bounds()->xMin(), _query.bounds()->yMax(), 0 );
+        OGR_G_AddPoint(ring, _query.bounds()->xMax(), _query.bounds()->yMax(), 0 );
+        OGR_G_AddPoint(ring, _query.bounds()->xMax(), _query.bounds()->yMin(), 0 );
+        OGR_G_AddPoint(ring, _query.bounds()->xMin(), _query.bounds()->yMin(), 0 );
+
+        _spatialFilter = OGR_G_CreateGeometry( wkbPolygon );
+        OGR_G_AddGeometryDirectly( _spatialFilter, ring ); 
+        // note: "Directly" above means _spatialFilter takes ownership if ring handle
+    }
 
-        OE_DEBUG << LC << "SQL: " << expr << std::endl;
-        _resultSetHandle = OGR_DS_ExecuteSQL( _dsHandle, expr.c_str(), _spatialFilter, 0L );
 
-        if ( _resultSetHandle )
-        {
-            OGR_L_ResetReading( _resultSetHandle );
-        }
-    }
+    OE_DEBUG << LC << "SQL: " << expr << std::endl;
+    _resultSetHandle = OGR_DS_ExecuteSQL( _dsHandle, expr.c_str(), _spatialFilter, 0L );
 
-    readChunk();
+    if ( _resultSetHandle )
+    {
+        OGR_L_ResetReading( _resultSetHandle );
+    }
 }
 
 FeatureCursorOGR::~FeatureCursorOGR()
 {
-    OGR_SCOPED_LOCK;
+    if ( _pool.valid() )
+    {
+        if ( _nextHandleToQueue )
+            OGR_F_Destroy( _nextHandleToQueue );
+
+        if ( _resultSetHandle && _resultSetHandle != _layerHandle )
+            OGR_DS_ReleaseResultSet( _dsHandle, _resultSetHandle );
+
+        if ( _spatialFilter )
+            OGR_G_DestroyGeometry( _spatialFilter );
+
+        if ( _dsHandle )
+            _pool->checkin( _dsHandle );
+    }
+    else
+    {
+        OGR_SCOPED_LOCK;
 
-    if ( _nextHandleToQueue )
-        OGR_F_Destroy( _nextHandleToQueue );
+        if ( _nextHandleToQueue )
+            OGR_F_Destroy( _nextHandleToQueue );
 
-    if ( _resultSetHandle != _layerHandle )
-        OGR_DS_ReleaseResultSet( _dsHandle, _resultSetHandle );
+        if ( _resultSetHandle != _layerHandle )
+            OGR_DS_ReleaseResultSet( _dsHandle, _resultSetHandle );
 
-    if ( _spatialFilter )
-        OGR_G_DestroyGeometry( _spatialFilter );
+        if ( _spatialFilter )
+            OGR_G_DestroyGeometry( _spatialFilter );
 
-    if ( _dsHandle )
-        OGRReleaseDataSource( _dsHandle );
+        if ( _dsHandle )
+            OGRReleaseDataSource( _dsHandle );
+    }
 }
 
 bool
@@ -230,18 +318,35 @@ FeatureCursorOGR::readChunk()
 {
     if ( !_resultSetHandle )
         return;
-    
-    OGR_SCOPED_LOCK;
 
+    if ( _pool.valid() )
+    {
+        readChunkFeatures();
+    }
+    else
+    {
+        OGR_SCOPED_LOCK;
+        readChunkFeatures();
+    }
+}
+
+void
+FeatureCursorOGR::readChunkFeatures()
+{
     while( _queue.size() < _chunkSize && !_resultSetEndReached )
     {
+        // the features of a chunk share one set of attribute columns.
+        osg::ref_ptr<AttributeColumns> columns;
+        if ( _columnarAttributes )
+            columns = OgrUtils::createAttributeColumns( OGR_L_GetLayerDefn(_resultSetHandle) );
+
         FeatureList filterList;
         while( filterList.size() < _chunkSize && !_resultSetEndReached )
         {
             OGRFeatureH handle = OGR_L_GetNextFeature( _resultSetHandle );
             if ( handle )
             {
-                osg::ref_ptr<Feature> feature = OgrUtils::createFeature( handle, _profile.get() );
+                osg::ref_ptr<Feature> feature = OgrUtils::createFeature( handle, _profile.get(), columns.get() );
 
                 if (feature.valid() &&
                     !_source->isBlacklisted( feature->getFID() ) &&
@@ -257,6 +362,10 @@ FeatureCursorOGR::readChunk()
             }
         }
 
+        // the chunk's rows are all written; keep each distinct string once.
+        if ( columns.valid() )
+            columns->finishLoading();
+
         // preprocess the features using the filter list:
         if ( !_filters.empty() )
         {
@@ -192,6 +192,10 @@ public:
 
             if (openMode == 1)
                 _writable = true;
+
+            // Cursors on a writable source share its handle so they see its edits.
+            if ( !_writable && _options.maxConcurrentReaders().get() > 0u )
+                _readPool = new OGRDataSourcePool( _source, _options.maxConcurrentReaders().get() );
                 
             // Open a specific layer within the data source, if applicable:
             _layerHandle = openLayer(_dsHandle, _options.layer().value());
@@ -330,12 +334,39 @@ public:
             OGRDataSourceH dsHandle = 0L;
             OGRLayerH layerHandle = 0L;
 
-            // open the handles safely:
+            // Each cursor requires its own DS handle so that multi-threaded access will work.
+            // A pooled handle goes back to the pool when the cursor is done.
+            if ( _readPool.valid() )
             {
-                OGR_SCOPED_LOCK;
+                dsHandle = _readPool->checkout();
+                if ( dsHandle )
+                {
+                    {
+                        OGR_SCOPED_LOCK;
+                        layerHandle = openLayer(dsHandle, _options.layer().get());
+                    }
 
-                // Each cursor requires its own DS handle so that multi-threaded access will work.
-                // The cursor impl will dispose of the new DS handle.
+                    if ( layerHandle )
+                    {
+                        return new FeatureCursorOGR( 
+                            dsHandle,
+                            layerHandle, 
+                            this,
+                            getFeatureProfile(),
+                            query,
+                            getFilters(),
+                            _readPool.get(),
+                            _options.columnarAttributes().get() );
+                    }
+
+                    _readPool->checkin( dsHandle );
+                    return 0L;
+                }
+            }
+
+            // No pool, or all of its handles are busy: share a handle under the lock.
+            {
+                OGR_SCOPED_LOCK;
                 dsHandle = OGROpenShared( _source.c_str(), 0, &_ogrDriverHandle );
                 if ( dsHandle )
                 {
@@ -352,7 +383,9 @@ public:
                     this,
                     getFeatureProfile(),
                     query,
-                    getFilters() );
+                    getFilters(),
+                    0L,
+                    _options.columnarAttributes().get() );
             }
             else
             {
@@ -424,8 +457,6 @@ public:
         OGRFeatureH feature_handle = OGR_F_Create( OGR_L_GetLayerDefn( _layerHandle ) );
         if ( feature_handle )
         {
-            const AttributeTable& attrs = feature->getAttrs();
-
             // assign the attributes:
             int num_fields = OGR_F_GetFieldCount( feature_handle );
             for( int i=0; i<num_fields; i++ )
@@ -434,19 +465,19 @@ public:
                 std::string name = OGR_Fld_GetNameRef( field_handle_ref );
                 int field_index = OGR_F_GetFieldIndex( feature_handle, name.c_str() );
 
-                AttributeTable::const_iterator a = attrs.find( toLower(name) );
-                if ( a != attrs.end() )
+                AttributeValue a;
+                if ( feature->getAttr( name, a ) )
                 {
                     switch( OGR_Fld_GetType(field_handle_ref) )
                     {
                     case OFTInteger:
-                        OGR_F_SetFieldInteger( feature_handle, field_index, a->second.getInt(0) );
+                        OGR_F_SetFieldInteger( feature_handle, field_index, a.getInt(0) );
                         break;
                     case OFTReal:
-                        OGR_F_SetFieldDouble( feature_handle, field_index, a->second.getDouble(0.0) );
+                        OGR_F_SetFieldDouble( feature_handle, field_index, a.getDouble(0.0) );
                         break;
                     case OFTString:
-                        OGR_F_SetFieldString( feature_handle, field_index, a->second.getString().c_str() );
+                        OGR_F_SetFieldString( feature_handle, field_index, a.getString().c_str() );
                         break;
                     default:break;
                     }
@@ -534,6 +565,7 @@ private:
     OGRDataSourceH _dsHandle;
     OGRLayerH _layerHandle;
     OGRSFDriverH _ogrDriverHandle;
+    osg::ref_ptr<OGRDataSourcePool> _readPool;
     osg::ref_ptr<Symbology::Geometry> _geometry; // explicit geometry.
     const OGRFeatureOptions _options;
     int _featureCount;
@@ -37,6 +37,7 @@
 #include <sstream>
 #include <stdlib.h>
 #include <memory.h>
+#include <float.h>
 
 #include <gdal_priv.h>
 #include <gdalwarper.h>
@@ -669,14 +670,24 @@ public:
       _srcDS(NULL),
       _warpedDS(NULL),
       _options(options),
-      _maxDataLevel(30)
+      _maxDataLevel(30),
+      _warpMode(WARP_NONE),
+      _numReadHandles(0u)
     {
+        _windowedReads = _options.windowedReads() == true;
     }
 
     virtual ~GDALTileSource()
     {
         GDAL_SCOPED_LOCK;
 
+        // Close the private read handles.
+        for (std::vector<ReadHandles>::iterator i = _idleReadHandles.begin(); i != _idleReadHandles.end(); ++i)
+        {
+            closeReadHandles(*i);
+        }
+        _idleReadHandles.clear();
+
         // Close the _warpedDS dataset if :
         // - it exists
         // - and is different from _srcDS
@@ -815,6 +826,7 @@ public:
                         if (_srcDS)
                         {
                             OE_INFO << LC << INDENT << "Read VRT from cache!" << std::endl;
+                            _readSource = result.getString();
                         }
                     }
                 }
@@ -830,6 +842,13 @@ public:
 
                     if (_srcDS)
                     {
+                        // The serialized VRT lets us reopen the combined dataset for concurrent reads.
+                        char** vrtXML = _srcDS->GetMetadata("xml:VRT");
+                        if (vrtXML && vrtXML[0])
+                        {
+                            _readSource = vrtXML[0];
+                        }
+
                         //Cache the VRT so we don't have to build it next time.
                         if (_cacheBin)
                         {
@@ -875,6 +894,7 @@ public:
 
                 if (_srcDS)
                 {
+                    _readSource = files[0];
 
                     char **subDatasets = _srcDS->GetMetadata( "SUBDATASETS");
                     int numSubDatasets = CSLCount( subDatasets );
@@ -889,6 +909,7 @@ public:
                         char *pszSubdatasetName = CPLStrdup( CSLFetchNameValue( subDatasets, buf.str().c_str() ) );
                         GDALClose( _srcDS );
                         _srcDS = (GDALDataset*)GDALOpen( pszSubdatasetName, GA_ReadOnly ) ;
+                        _readSource = pszSubdatasetName;
                         CPLFree( pszSubdatasetName );
                     }
                 }
@@ -1019,28 +1040,21 @@ public:
 
         if ( requiresReprojection || (profile && !profile->getSRS()->isEquivalentTo( src_srs.get() )) )
         {
+            _warpSrcWKT = src_srs->getWKT();
+
             if ( profile && profile->getSRS()->isGeographic() && (src_srs->isNorthPolar() || src_srs->isSouthPolar()) )
             {
-                _warpedDS = (GDALDataset*)GDALAutoCreateWarpedVRTforPolarStereographic(
-                    _srcDS,
-                    src_srs->getWKT().c_str(),
-                    profile->getSRS()->getWKT().c_str(),
-                    GRA_NearestNeighbour,
-                    5.0,
-                    NULL);
+                _warpMode = WARP_POLAR;
+                _warpDestWKT = profile->getSRS()->getWKT();
             }
             else
             {
-                std::string destWKT = profile ? profile->getSRS()->getWKT() : src_srs->getWKT();
-                _warpedDS = (GDALDataset*)GDALAutoCreateWarpedVRT(
-                    _srcDS,
-                    src_srs->getWKT().c_str(),
-                    destWKT.c_str(),
-                    GRA_NearestNeighbour,
-                    5.0,
-                    0);
+                _warpMode = WARP_AUTO;
+                _warpDestWKT = profile ? profile->getSRS()->getWKT() : src_srs->getWKT();
             }
 
+            _warpedDS = createWarpedDataset(_srcDS);
+
             if ( _warpedDS )
             {
                 warpedSRSWKT = _warpedDS->GetProjectionRef();
@@ -1218,12 +1232,11 @@ public:
 
 
     /**
-    * Finds a raster band based on color interpretation
+    * Finds a raster band based on color interpretation.
+    * Caller must either own the dataset handle or hold the GDAL lock.
     */
     static GDALRasterBand* findBandByColorInterp(GDALDataset *ds, GDALColorInterp colorInterp)
     {
-        GDAL_SCOPED_LOCK;
-
         for (int i = 1; i <= ds->GetRasterCount(); ++i)
         {
             if (ds->GetRasterBand(i)->GetColorInterpretation() == colorInterp) return ds->GetRasterBand(i);
@@ -1233,8 +1246,6 @@ public:
 
     static GDALRasterBand* findBandByDataType(GDALDataset *ds, GDALDataType dataType)
     {
-        GDAL_SCOPED_LOCK;
-
         for (int i = 1; i <= ds->GetRasterCount(); ++i)
         {
             if (ds->GetRasterBand(i)->GetRasterDataType() == dataType) return ds->GetRasterBand(i);
@@ -1320,6 +1331,118 @@ public:
         }
     }
 
+    /**
+     * Creates the warping VRT for a source dataset, or returns the source
+     * dataset itself if it doesn't need warping. Caller must hold the GDAL lock.
+     */
+    GDALDataset* createWarpedDataset(GDALDataset* srcDS)
+    {
+        if (_warpMode == WARP_POLAR)
+        {
+            return (GDALDataset*)GDALAutoCreateWarpedVRTforPolarStereographic(
+                srcDS,
+                _warpSrcWKT.c_str(),
+                _warpDestWKT.c_str(),
+                GRA_NearestNeighbour,
+                5.0,
+                NULL);
+        }
+        else if (_warpMode == WARP_AUTO)
+        {
+            return (GDALDataset*)GDALAutoCreateWarpedVRT(
+                srcDS,
+                _warpSrcWKT.c_str(),
+                _warpDestWKT.c_str(),
+                GRA_NearestNeighbour,
+                5.0,
+                0);
+        }
+        else
+        {
+            return srcDS;
+        }
+    }
+
+    /**
+     * Dataset handles private to one reader. GDAL datasets are not thread-safe,
+     * but separate handles on the same source can be read concurrently.
+     */
+    struct ReadHandles
+    {
+        ReadHandles() : _srcDS(0L), _warpedDS(0L) { }
+        GDALDataset* _srcDS;
+        GDALDataset* _warpedDS;
+    };
+
+    /** Caller must hold the GDAL lock. */
+    void closeReadHandles(ReadHandles& handles)
+    {
+        if (handles._warpedDS && handles._warpedDS != handles._srcDS)
+            GDALClose(handles._warpedDS);
+        if (handles._srcDS)
+            GDALClose(handles._srcDS);
+        handles._srcDS = handles._warpedDS = 0L;
+    }
+
+    /**
+     * Checks out a set of private dataset handles, opening new ones if necessary.
+     * Returns false if the source cannot be reopened or all the allowed handles
+     * are in use; the caller should then read the shared dataset under the GDAL lock.
+     */
+    bool checkoutReadHandles(ReadHandles& out)
+    {
+        std::string source;
+        {
+            Threading::ScopedMutexLock lock(_readHandlesMutex);
+            if (_readSource.empty())
+                return false;
+
+            if (!_idleReadHandles.empty())
+            {
+                out = _idleReadHandles.back();
+                _idleReadHandles.pop_back();
+                return true;
+            }
+
+            if (_numReadHandles >= _options.maxConcurrentReaders().get())
+                return false;
+
+            ++_numReadHandles;
+            source = _readSource;
+        }
+
+        {
+            GDAL_SCOPED_LOCK;
+            out._srcDS = (GDALDataset*)GDALOpen(source.c_str(), GA_ReadOnly);
+            if (out._srcDS)
+                out._warpedDS = createWarpedDataset(out._srcDS);
+        }
+
+        if (!out._warpedDS)
+        {
+            OE_WARN << LC << "Failed to open a concurrent read handle; reads will be serialized" << std::endl;
+            {
+                GDAL_SCOPED_LOCK;
+                closeReadHandles(out);
+            }
+            // Give back the slot, and don't try again.
+            Threading::ScopedMutexLock lock(_readHandlesMutex);
+            --_numReadHandles;
+            _readSource.clear();
+            return false;
+        }
+
+        OE_DEBUG << LC << "Opened concurrent read handle " << _numReadHandles << std::endl;
+        return true;
+    }
+
+    /** Returns dataset handles obtained from checkoutReadHandles. */
+    void returnReadHandles(const ReadHandles& handles)
+    {
+        Threading::ScopedMutexLock lock(_readHandlesMutex);
+        _idleReadHandles.push_back(handles);
+    }
+
     void pixelToGeo(double x, double y, double &geoX, double &geoY)
     {
         geoX = _geotransform[0] + _geotransform[1] * x + _geotransform[2] * y;
@@ -1350,8 +1473,24 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
+        ReadHandles handles;
+        if (checkoutReadHandles(handles))
+        {
+            osg::Image* image = readImage(key, handles._warpedDS, progress);
+            returnReadHandles(handles);
+            return image;
+        }
+        else
+        {
+            GDAL_SCOPED_LOCK;
+            return readImage(key, _warpedDS, progress);
+        }
+    }
 
+    osg::Image* readImage( const TileKey&        key,
+                           GDALDataset*          warpedDS,
+                           ProgressCallback*     progress)
+    {
         int tileSize = getPixelsPerTile(); //_options.tileSize().value();
 
         osg::ref_ptr<osg::Image> image;
@@ -1415,8 +1554,8 @@ public:
         int height = (int)(src_max_y - src_min_y);
 
 
-        int rasterWidth = _warpedDS->GetRasterXSize();
-        int rasterHeight = _warpedDS->GetRasterYSize();
+        int rasterWidth = warpedDS->GetRasterXSize();
+        int rasterHeight = warpedDS->GetRasterYSize();
         if (off_x + width > rasterWidth || off_y + height > rasterHeight)
         {
             OE_WARN << LC << "Read window outside of bounds of dataset.  Source Dimensions=" << rasterWidth << "x" << rasterHeight << " Read Window=" << off_x << ", " << off_y << " " << width << "x" << height << std::endl;
@@ -1450,44 +1589,44 @@ public:
 
 
 
-        GDALRasterBand* bandRed = findBandByColorInterp(_warpedDS, GCI_RedBand);
-        GDALRasterBand* bandGreen = findBandByColorInterp(_warpedDS, GCI_GreenBand);
-        GDALRasterBand* bandBlue = findBandByColorInterp(_warpedDS, GCI_BlueBand);
-        GDALRasterBand* bandAlpha = findBandByColorInterp(_warpedDS, GCI_AlphaBand);
+        GDALRasterBand* bandRed = findBandByColorInterp(warpedDS, GCI_RedBand);
+        GDALRasterBand* bandGreen = findBandByColorInterp(warpedDS, GCI_GreenBand);
+        GDALRasterBand* bandBlue = findBandByColorInterp(warpedDS, GCI_BlueBand);
+        GDALRasterBand* bandAlpha = findBandByColorInterp(warpedDS, GCI_AlphaBand);
 
-        GDALRasterBand* bandGray = findBandByColorInterp(_warpedDS, GCI_GrayIndex);
+        GDALRasterBand* bandGray = findBandByColorInterp(warpedDS, GCI_GrayIndex);
 
-        GDALRasterBand* bandPalette = findBandByColorInterp(_warpedDS, GCI_PaletteIndex);
+        GDALRasterBand* bandPalette = findBandByColorInterp(warpedDS, GCI_PaletteIndex);
 
         if (!bandRed && !bandGreen && !bandBlue && !bandAlpha && !bandGray && !bandPalette)
         {
             OE_DEBUG << LC << "Could not determine bands based on color interpretation, using band count" << std::endl;
             //We couldn't find any valid bands based on the color interp, so just make an educated guess based on the number of bands in the file
             //RGB = 3 bands
-            if (_warpedDS->GetRasterCount() == 3)
+            if (warpedDS->GetRasterCount() == 3)
             {
-                bandRed   = _warpedDS->GetRasterBand( 1 );
-                bandGreen = _warpedDS->GetRasterBand( 2 );
-                bandBlue  = _warpedDS->GetRasterBand( 3 );
+                bandRed   = warpedDS->GetRasterBand( 1 );
+                bandGreen = warpedDS->GetRasterBand( 2 );
+                bandBlue  = warpedDS->GetRasterBand( 3 );
             }
             //RGBA = 4 bands
-            else if (_warpedDS->GetRasterCount() == 4)
+            else if (warpedDS->GetRasterCount() == 4)
             {
-                bandRed   = _warpedDS->GetRasterBand( 1 );
-                bandGreen = _warpedDS->GetRasterBand( 2 );
-                bandBlue  = _warpedDS->GetRasterBand( 3 );
-                bandAlpha = _warpedDS->GetRasterBand( 4 );
+                bandRed   = warpedDS->GetRasterBand( 1 );
+                bandGreen = warpedDS->GetRasterBand( 2 );
+                bandBlue  = warpedDS->GetRasterBand( 3 );
+                bandAlpha = warpedDS->GetRasterBand( 4 );
             }
             //Gray = 1 band
-            else if (_warpedDS->GetRasterCount() == 1)
+            else if (warpedDS->GetRasterCount() == 1)
             {
-                bandGray = _warpedDS->GetRasterBand( 1 );
+                bandGray = warpedDS->GetRasterBand( 1 );
             }
             //Gray + alpha = 2 bands
-            else if (_warpedDS->GetRasterCount() == 2)
+            else if (warpedDS->GetRasterCount() == 2)
             {
-                bandGray  = _warpedDS->GetRasterBand( 1 );
-                bandAlpha = _warpedDS->GetRasterBand( 2 );
+                bandGray  = warpedDS->GetRasterBand( 1 );
+                bandAlpha = warpedDS->GetRasterBand( 2 );
             }
         }
 
@@ -1507,6 +1646,9 @@ public:
             //Initialize the alpha values to 255.
             memset(alpha, 255, target_width * target_height);
 
+            // Resampled values, used when interpolating the imagery
+            std::vector<float> redSamples, greenSamples, blueSamples, alphaSamples;
+
             image = new osg::Image;
             image->allocateImage(tileSize, tileSize, 1, pixelFormat, GL_UNSIGNED_BYTE);
             memset(image->data(), 0, image->getImageSizeInBytes());
@@ -1551,6 +1693,25 @@ public:
 
                 image->flipVertical();
             }
+            else if (sampleGrid(bandRed,   xmin, ymin, dx, dy, tileSize, tileSize, false, redSamples)   &&
+                     sampleGrid(bandGreen, xmin, ymin, dx, dy, tileSize, tileSize, false, greenSamples) &&
+                     sampleGrid(bandBlue,  xmin, ymin, dx, dy, tileSize, tileSize, false, blueSamples)  &&
+                     (bandAlpha == NULL || sampleGrid(bandAlpha, xmin, ymin, dx, dy, tileSize, tileSize, false, alphaSamples)))
+            {
+                for (int r = 0; r < tileSize; ++r)
+                {
+                    for (int c = 0; c < tileSize; ++c)
+                    {
+                        // Same conversion as the per-sample path below, NO_DATA included.
+                        unsigned i = r*tileSize + c;
+                        unsigned char* pixel = image->data(c,r);
+                        pixel[0] = (unsigned char)redSamples[i];
+                        pixel[1] = (unsigned char)greenSamples[i];
+                        pixel[2] = (unsigned char)blueSamples[i];
+                        pixel[3] = bandAlpha ? (unsigned char)alphaSamples[i] : 255;
+                    }
+                }
+            }
             else
             {
                 //Sample each point exactly
@@ -1651,7 +1812,7 @@ public:
                                 gdalSampleSize == 4 ? *(float*)ptr :
                                 NO_DATA_VALUE;
 
-                            if ( !isValidValue_noLock(value, bandGray) )
+                            if ( !isValidValue(value, bandGray) )
                                 value = NO_DATA_VALUE;
 
                             temp.r() = value;
@@ -1679,6 +1840,9 @@ public:
                 //Initialize the alpha values to 255.
                 memset(alpha, 255, target_width * target_height);
 
+                // Resampled values, used when interpolating the imagery
+                std::vector<float> graySamples, alphaSamples;
+
                 image = new osg::Image;
                 image->allocateImage(tileSize, tileSize, 1, pixelFormat, GL_UNSIGNED_BYTE);
                 memset(image->data(), 0, image->getImageSizeInBytes());
@@ -1717,6 +1881,21 @@ public:
 
                     image->flipVertical();
                 }
+                else if (sampleGrid(bandGray, xmin, ymin, dx, dy, tileSize, tileSize, false, graySamples) &&
+                         (bandAlpha == NULL || sampleGrid(bandAlpha, xmin, ymin, dx, dy, tileSize, tileSize, false, alphaSamples)))
+                {
+                    for (int r = 0; r < tileSize; ++r)
+                    {
+                        for (int c = 0; c < tileSize; ++c)
+                        {
+                            // Same conversion as the per-sample path below, NO_DATA included.
+                            unsigned i = r*tileSize + c;
+                            unsigned char* pixel = image->data(c,r);
+                            pixel[0] = pixel[1] = pixel[2] = (unsigned char)graySamples[i];
+                            pixel[3] = bandAlpha ? (unsigned char)alphaSamples[i] : 255;
+                        }
+                    }
+                }
                 else
                 {
                     for (int r = 0; r < tileSize; ++r)
@@ -1832,7 +2011,14 @@ public:
         return image.release();
     }
 
-    bool isValidValue_noLock(float v, GDALRasterBand* band)
+    // Caller must either own the band's dataset handle or hold the GDAL lock.
+    bool isValidValue(float v, GDALRasterBand* band)
+    {
+        return isValidValue(v, getBandNoDataValue(band));
+    }
+
+    // Caller must either own the band's dataset handle or hold the GDAL lock.
+    float getBandNoDataValue(GDALRasterBand* band)
     {
         float bandNoData = -32767.0f;
         int success;
@@ -1841,7 +2027,12 @@ public:
         {
             bandNoData = value;
         }
+        return bandNoData;
+    }
 
+    /** Checks a value against a band's no data value (see getBandNoDataValue) */
+    bool isValidValue(float v, float bandNoData)
+    {
         //Check to see if the value is equal to the bands specified no data
         if (bandNoData == v) return false;
         //Check to see if the value is equal to the user specified nodata value
@@ -1854,12 +2045,6 @@ public:
         return true;
     }
 
-    bool isValidValue(float v, GDALRasterBand* band)
-    {
-        GDAL_SCOPED_LOCK;
-        return isValidValue_noLock( v, band );
-    }
-
 
     float getInterpolatedValue(GDALRasterBand *band, double x, double y, bool applyOffset=true)
     {
@@ -1985,6 +2170,193 @@ public:
         return result;
     }
 
+    /**
+     * Adjusts a pixel coordinate the same way getInterpolatedValue does and
+     * returns whether it falls inside the dataset.
+     */
+    static bool adjustSamplePixel(double& p, int size, bool applyOffset)
+    {
+        if (applyOffset)
+        {
+            p -= 0.5;
+            if (p < 0 && p >= -0.5)
+                p = 0;
+            else if (p > size-1 && p <= size-0.5)
+                p = size-1;
+        }
+        return p >= 0 && p <= size-1;
+    }
+
+    /**
+     * Samples a regular numCols x numRows grid of points, starting at (xmin, ymin)
+     * with spacing (dx, dy), from a raster band. Reads all the source pixels covering
+     * the grid with a single RasterIO call and interpolates them in memory.
+     *
+     * When the window is read at full resolution, the values match calling
+     * getInterpolatedValue for each point, up to float rounding. Windows of more
+     * than 4 source pixels per sample are subsampled by GDAL first, so there the
+     * values are interpolated from the subsampled pixels and will differ.
+     *
+     * Output is row-major with row 0 at ymin. Returns false if the grid cannot be
+     * sampled this way (rotated georeferencing, a failed read, or windowed reads
+     * disabled), in which case the caller should fall back on getInterpolatedValue.
+     */
+    bool sampleGrid(GDALRasterBand* band,
+                    double xmin, double ymin, double dx, double dy,
+                    int numCols, int numRows,
+                    bool applyOffset,
+                    std::vector<float>& output)
+    {
+        if (!_windowedReads)
+            return false;
+
+        // Rows and columns must be separable.
+        if (_invtransform[2] != 0.0 || _invtransform[4] != 0.0)
+            return false;
+
+        int rasterWidth  = _warpedDS->GetRasterXSize();
+        int rasterHeight = _warpedDS->GetRasterYSize();
+
+        output.assign(numCols * numRows, NO_DATA_VALUE);
+
+        // Source pixel location of each output column and row:
+        std::vector<double> colPixel(numCols), rowPixel(numRows);
+        std::vector<unsigned char> colValid(numCols), rowValid(numRows);
+        double unused;
+
+        double colMinPixel = DBL_MAX, colMaxPixel = -DBL_MAX;
+        for (int c = 0; c < numCols; ++c)
+        {
+            geoToPixel(xmin + dx*(double)c, ymin, colPixel[c], unused);
+            colValid[c] = adjustSamplePixel(colPixel[c], rasterWidth, applyOffset) ? 1 : 0;
+            if (colValid[c])
+            {
+                colMinPixel = osg::minimum(colMinPixel, colPixel[c]);
+                colMaxPixel = osg::maximum(colMaxPixel, colPixel[c]);
+            }
+        }
+
+        double rowMinPixel = DBL_MAX, rowMaxPixel = -DBL_MAX;
+        for (int r = 0; r < numRows; ++r)
+        {
+            geoToPixel(xmin, ymin + dy*(double)r, unused, rowPixel[r]);
+            rowValid[r] = adjustSamplePixel(rowPixel[r], rasterHeight, applyOffset) ? 1 : 0;
+            if (rowValid[r])
+            {
+                rowMinPixel = osg::minimum(rowMinPixel, rowPixel[r]);
+                rowMaxPixel = osg::maximum(rowMaxPixel, rowPixel[r]);
+            }
+        }
+
+        // Nothing to read; the grid is entirely outside the dataset.
+        if (colMinPixel > colMaxPixel || rowMinPixel > rowMaxPixel)
+            return true;
+
+        // Source window covering every sample and its neighbors:
+        int winCol = osg::maximum((int)floor(colMinPixel), 0);
+        int winRow = osg::maximum((int)floor(rowMinPixel), 0);
+        int winWidth  = osg::minimum((int)ceil(colMaxPixel), rasterWidth-1)  - winCol + 1;
+        int winHeight = osg::minimum((int)ceil(rowMaxPixel), rasterHeight-1) - winRow + 1;
+
+        // Don't read more than a few source pixels per sample. Beyond that, let GDAL
+        // subsample the window (using overviews if available) and interpolate the
+        // subsampled buffer instead.
+        int bufWidth  = osg::minimum(winWidth,  4*numCols);
+        int bufHeight = osg::minimum(winHeight, 4*numRows);
+
+        std::vector<float> window(bufWidth * bufHeight);
+        CPLErr err = band->RasterIO(GF_Read, winCol, winRow, winWidth, winHeight, &window[0], bufWidth, bufHeight, GDT_Float32, 0, 0);
+        if (err != CE_None)
+        {
+            OE_DEBUG << LC << "RasterIO failed, falling back on per-sample reads" << std::endl;
+            return false;
+        }
+
+        float bandNoData = getBandNoDataValue(band);
+        for (unsigned i = 0; i < window.size(); ++i)
+        {
+            if (!isValidValue(window[i], bandNoData))
+                window[i] = NO_DATA_VALUE;
+        }
+
+        // Precompute the buffer indices and weights for each column and row.
+        bool nearest = _options.interpolation() == INTERP_NEAREST;
+        std::vector<int>   col0(numCols), col1(numCols), row0(numRows), row1(numRows);
+        std::vector<float> colWeight(numCols), rowWeight(numRows);
+
+        double scaleX = (double)winWidth  / (double)bufWidth;
+        double scaleY = (double)winHeight / (double)bufHeight;
+
+        for (int c = 0; c < numCols; ++c)
+        {
+            double p = colPixel[c] - winCol;
+            if (bufWidth != winWidth)
+                p = (p + 0.5) / scaleX - 0.5;
+            getSampleIndices(p, bufWidth, nearest, col0[c], col1[c], colWeight[c]);
+        }
+
+        for (int r = 0; r < numRows; ++r)
+        {
+            double p = rowPixel[r] - winRow;
+            if (bufHeight != winHeight)
+                p = (p + 0.5) / scaleY - 0.5;
+            getSampleIndices(p, bufHeight, nearest, row0[r], row1[r], rowWeight[r]);
+        }
+
+        // Interpolate. Nearest sampling has zero weights and identical indices,
+        // so the same kernel serves every interpolation mode.
+        for (int r = 0; r < numRows; ++r)
+        {
+            if (!rowValid[r])
+                continue;
+
+            const float* lower = &window[row0[r] * bufWidth];
+            const float* upper = &window[row1[r] * bufWidth];
+            float fy = rowWeight[r];
+            float* out = &output[r * numCols];
+
+            for (int c = 0; c < numCols; ++c)
+            {
+                if (!colValid[c])
+                    continue;
+
+                float ll = lower[col0[c]];
+                float lr = lower[col1[c]];
+                float ul = upper[col0[c]];
+                float ur = upper[col1[c]];
+
+                if (ll == NO_DATA_VALUE || lr == NO_DATA_VALUE || ul == NO_DATA_VALUE || ur == NO_DATA_VALUE)
+                    continue;
+
+                float fx = colWeight[c];
+                float bottom = ll + (lr - ll)*fx;
+                float top    = ul + (ur - ul)*fx;
+                out[c] = bottom + (top - bottom)*fy;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * Computes the two neighboring buffer indices and the interpolation weight
+     * for a sample at buffer coordinate p.
+     */
+    static void getSampleIndices(double p, int size, bool nearest, int& i0, int& i1, float& weight)
+    {
+        if (nearest)
+        {
+            i0 = i1 = osg::clampBetween((int)osg::round(p), 0, size-1);
+            weight = 0.0f;
+        }
+        else
+        {
+            i0 = osg::clampBetween((int)floor(p), 0, size-1);
+            i1 = osg::clampBetween((int)ceil(p),  0, size-1);
+            weight = i1 > i0 ? (float)(p - (double)i0) : 0.0f;
+        }
+    }
+
 
 #if 1
     osg::HeightField* createHeightField( const TileKey&        key,
@@ -1996,8 +2368,24 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
+        ReadHandles handles;
+        if (checkoutReadHandles(handles))
+        {
+            osg::HeightField* hf = readHeightField(key, handles._warpedDS, progress);
+            returnReadHandles(handles);
+            return hf;
+        }
+        else
+        {
+            GDAL_SCOPED_LOCK;
+            return readHeightField(key, _warpedDS, progress);
+        }
+    }
 
+    osg::HeightField* readHeightField( const TileKey&        key,
+                                       GDALDataset*          warpedDS,
+                                       ProgressCallback*     progress)
+    {
         int tileSize = getPixelsPerTile();
 
         //Allocate the heightfield
@@ -2011,11 +2399,11 @@ public:
             key.getExtent().getBounds(xmin, ymin, xmax, ymax);
 
             // Try to find a FLOAT band
-            GDALRasterBand* band = findBandByDataType(_warpedDS, GDT_Float32);
+            GDALRasterBand* band = findBandByDataType(warpedDS, GDT_Float32);
             if (band == NULL)
             {
                 // Just get first band
-                band = _warpedDS->GetRasterBand(1);
+                band = warpedDS->GetRasterBand(1);
             }
 
             if (_options.interpolation() == INTERP_NEAREST)
@@ -2034,9 +2422,9 @@ public:
                 int iNumRows = iRowMax - iRowMin + 1;
 
                 int iWinColMin = max(0, iColMin);
-                int iWinColMax = min(_warpedDS->GetRasterXSize()-1, iColMax);
+                int iWinColMax = min(warpedDS->GetRasterXSize()-1, iColMax);
                 int iWinRowMin = max(0, iRowMin);
-                int iWinRowMax = min(_warpedDS->GetRasterYSize()-1, iRowMax);
+                int iWinRowMax = min(warpedDS->GetRasterYSize()-1, iRowMax);
                 int iNumWinCols = iWinColMax - iWinColMin + 1;
                 int iNumWinRows = iWinRowMax - iWinRowMin + 1;
 
@@ -2064,14 +2452,20 @@ public:
             {
                 double dx = (xmax - xmin) / (tileSize-1);
                 double dy = (ymax - ymin) / (tileSize-1);
-                for (int r = 0; r < tileSize; ++r)
+
+                // The heightfield's height list is row-major starting at ymin,
+                // which is the layout sampleGrid produces.
+                if (!sampleGrid(band, xmin, ymin, dx, dy, tileSize, tileSize, true, hf->getHeightList()))
                 {
-                    double geoY = ymin + (dy * (double)r);
-                    for (int c = 0; c < tileSize; ++c)
+                    for (int r = 0; r < tileSize; ++r)
                     {
-                        double geoX = xmin + (dx * (double)c);
-                        float h = getInterpolatedValue(band, geoX, geoY);
-                        hf->setHeight(c, r, h);
+                        double geoY = ymin + (dy * (double)r);
+                        for (int c = 0; c < tileSize; ++c)
+                        {
+                            double geoX = xmin + (dx * (double)c);
+                            float h = getInterpolatedValue(band, geoX, geoY);
+                            hf->setHeight(c, r, h);
+                        }
                     }
                 }
             }
@@ -2400,6 +2794,19 @@ private:
     osg::ref_ptr< osgDB::Options > _dbOptions;
 
     unsigned int _maxDataLevel;
+
+    // How to recreate the dataset for concurrent reads:
+    enum WarpMode { WARP_NONE, WARP_AUTO, WARP_POLAR };
+    std::string _readSource;
+    WarpMode    _warpMode;
+    std::string _warpSrcWKT;
+    std::string _warpDestWKT;
+
+    std::vector<ReadHandles> _idleReadHandles;
+    unsigned                 _numReadHandles;
+    Threading::Mutex         _readHandlesMutex;
+
+    bool _windowedReads;
 };
 
 
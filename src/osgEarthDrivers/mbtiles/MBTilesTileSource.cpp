@@ -25,6 +25,9 @@
 #include <osgEarth/Registry>
 #include <osgEarth/ImageUtils>
 #include <osgDB/FileUtils>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Condition>
+#include <OpenThreads/ScopedLock>
 
 #include <sstream>
 #include <iomanip>
@@ -57,17 +60,157 @@ namespace
 
 //......................................................................
 
+/**
+ * Single writer thread for bulk write mode. Callers of storeImage() encode
+ * their tiles in parallel and queue them here; this thread commits them in
+ * large transactions. The queue is bounded so fast producers block instead
+ * of buffering the whole dataset in memory.
+ */
+class MBTilesTileSource::BulkWriter : public OpenThreads::Thread
+{
+public:
+    BulkWriter(MBTilesTileSource* source, unsigned batchSize) :
+        _source(source),
+        _batchSize(osg::maximum(batchSize, 1u)),
+        _maxQueued(osg::maximum(batchSize, 1u) * 4u),
+        _done(false)
+    {
+        //nop
+    }
+
+    //! Queues a tile for writing; takes ownership of the tile's data.
+    void push(PendingTile& tile)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+        while (_queue.size() >= _maxQueued && !_done)
+            _notFull.wait(&_mutex);
+
+        _queue.push_back(PendingTile());
+        PendingTile& queued = _queue.back();
+        queued._z = tile._z;
+        queued._x = tile._x;
+        queued._y = tile._y;
+        queued._data.swap(tile._data);
+        queued._id.swap(tile._id);
+
+        if (_queue.size() >= _batchSize)
+            _notEmpty.signal();
+    }
+
+    //! Writes everything still queued and stops the thread.
+    void finish()
+    {
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+            _done = true;
+            _notEmpty.signal();
+            _notFull.broadcast();
+        }
+        join();
+    }
+
+    void run()
+    {
+        std::vector<PendingTile> batch;
+
+        while (true)
+        {
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+                // wait for a full batch, but don't sit on a partial one forever:
+                while (_queue.size() < _batchSize && !_done)
+                {
+                    if (_notEmpty.wait(&_mutex, 250u) != 0 && !_queue.empty())
+                        break;
+                }
+
+                if (_queue.empty() && _done)
+                    break;
+
+                batch.swap(_queue);
+                _notFull.broadcast();
+            }
+
+            _source->writeTiles(batch);
+            batch.clear();
+        }
+    }
+
+private:
+    MBTilesTileSource* _source;
+    unsigned _batchSize;
+    unsigned _maxQueued;
+    std::vector<PendingTile> _queue;
+    OpenThreads::Mutex _mutex;
+    OpenThreads::Condition _notEmpty;
+    OpenThreads::Condition _notFull;
+    bool _done;
+};
+
+//......................................................................
+
 MBTilesTileSource::MBTilesTileSource(const TileSourceOptions& options) :
 TileSource( options ),
 _options  ( options ),
 _database ( NULL ),
 _minLevel ( 0 ),
 _maxLevel ( 20 ),
-_forceRGB ( false )
+_forceRGB ( false ),
+_selectTile( NULL ),
+_dedup    ( false ),
+_insertTile( NULL ),
+_selectImage( NULL ),
+_insertImage( NULL ),
+_insertMap( NULL ),
+_bulkWriter( NULL ),
+_numReaders( 0u )
 {
     //nop
 }
 
+MBTilesTileSource::~MBTilesTileSource()
+{
+    // commit anything still queued for writing:
+    if (_bulkWriter)
+    {
+        _bulkWriter->finish();
+        delete _bulkWriter;
+        _bulkWriter = NULL;
+    }
+
+    for (std::vector<ReadConnection>::iterator i = _idleReaders.begin(); i != _idleReaders.end(); ++i)
+    {
+        closeReader(*i);
+    }
+    _idleReaders.clear();
+
+    if (_selectTile)
+    {
+        sqlite3_finalize(_selectTile);
+    }
+
+    if (_insertTile)
+        sqlite3_finalize(_insertTile);
+    if (_insertImage)
+        sqlite3_finalize(_insertImage);
+    if (_insertMap)
+        sqlite3_finalize(_insertMap);
+    if (_selectImage)
+        sqlite3_finalize(_selectImage);
+
+    if (_database)
+    {
+        // Leave the file in rollback-journal mode so that readers that can't
+        // create the WAL index (e.g., on read-only media) can still open it.
+        if ( (getMode() & MODE_WRITE) != 0 )
+            sqlite3_exec(_database, "PRAGMA journal_mode=DELETE", 0L, 0L, 0L);
+
+        sqlite3_close(_database);
+    }
+}
+
 Status
 MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
 {
@@ -120,9 +263,22 @@ MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
             << "Database \"" << fullFilename << "\": " << sqlite3_errmsg(_database) );
     }
 
+    // With write-ahead logging, the read-only connections keep reading while
+    // this one writes instead of waiting on its rollback journal. NORMAL sync
+    // is still safe against corruption in WAL mode and skips most fsyncs.
+    if ( readWrite )
+    {
+        if ( !execute("PRAGMA journal_mode=WAL") )
+            OE_INFO << LC << "Write-ahead logging is not available; reads will wait on writes" << std::endl;
+        execute("PRAGMA synchronous=NORMAL");
+    }
+
     // New database setup:
     if ( isNewDatabase )
     {
+        // in bulk mode, store each distinct tile image only once:
+        _dedup = _options.bulkWrite() == true;
+
         // create necessary db tables:
         createTables();
 
@@ -165,6 +321,16 @@ MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
     // If the database pre-existed, read in the information from the metadata.
     else // !isNewDatabase
     {
+        // Is this a deduplicated database (tiles is a view over map and images)?
+        sqlite3_stmt* select = NULL;
+        std::string query = "SELECT count(*) FROM sqlite_master WHERE type = 'table' AND name IN ('map', 'images')";
+        if ( sqlite3_prepare_v2(_database, query.c_str(), -1, &select, 0L) == SQLITE_OK )
+        {
+            if ( sqlite3_step(select) == SQLITE_ROW )
+                _dedup = sqlite3_column_int(select, 0) == 2;
+            sqlite3_finalize(select);
+        }
+
         if ( _options.computeLevels() == true )
         {
             computeLevels();
@@ -274,6 +440,28 @@ MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
 
     }
 
+    // Bulk write mode: queue encoded tiles for a single writer thread.
+    if ( readWrite && _options.bulkWrite() == true )
+    {
+        _bulkWriter = new BulkWriter(this, _options.bulkBatchSize().get());
+        _bulkWriter->start();
+        OE_INFO << LC << "Bulk write mode" << (_dedup ? " (deduplicated)" : "") << std::endl;
+    }
+
+    // Concurrent reads use private read-only connections, which requires a
+    // thread-safe build of sqlite3 since we open them with SQLITE_OPEN_NOMUTEX.
+    if (_options.maxConcurrentReaders().get() > 0u)
+    {
+        if (sqlite3_threadsafe() != 0)
+        {
+            _readerFilename = fullFilename;
+        }
+        else
+        {
+            OE_INFO << LC << "sqlite3 is not thread-safe; tile reads will be serialized" << std::endl;
+        }
+    }
+
     // do we require RGB? for jpeg?
     _forceRGB =
         osgEarth::endsWith(_tileFormat, "jpg", false) ||
@@ -300,12 +488,110 @@ MBTilesTileSource::getCachePolicyHint(const Profile* targetProfile) const
 }
 
 
+bool
+MBTilesTileSource::checkoutReader(ReadConnection& out)
+{
+    std::string filename;
+    {
+        Threading::ScopedMutexLock lock(_readersMutex);
+        if (_readerFilename.empty())
+            return false;
+
+        if (!_idleReaders.empty())
+        {
+            out = _idleReaders.back();
+            _idleReaders.pop_back();
+            return true;
+        }
+
+        if (_numReaders >= _options.maxConcurrentReaders().get())
+            return false;
+
+        ++_numReaders;
+        filename = _readerFilename;
+    }
+
+    bool ok = sqlite3_open_v2(filename.c_str(), &out._database, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, 0L) == SQLITE_OK;
+
+    if (ok)
+    {
+        // Wait out a writer's lock instead of failing the read, and make sure
+        // this connection never takes a write lock itself.
+        sqlite3_busy_timeout(out._database, 5000);
+        sqlite3_exec(out._database, "PRAGMA query_only=1", 0L, 0L, 0L);
+
+        std::string query = "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
+        ok = sqlite3_prepare_v2(out._database, query.c_str(), -1, &out._select, 0L) == SQLITE_OK;
+    }
+
+    if (!ok)
+    {
+        OE_WARN << LC << "Failed to open a concurrent read connection; reads will be serialized" << std::endl;
+        closeReader(out);
+
+        // Don't try again.
+        Threading::ScopedMutexLock lock(_readersMutex);
+        _readerFilename.clear();
+        return false;
+    }
+
+    OE_DEBUG << LC << "Opened concurrent read connection " << _numReaders << std::endl;
+    return true;
+}
+
+void
+MBTilesTileSource::returnReader(const ReadConnection& conn)
+{
+    Threading::ScopedMutexLock lock(_readersMutex);
+    _idleReaders.push_back(conn);
+}
+
+void
+MBTilesTileSource::closeReader(ReadConnection& conn)
+{
+    if (conn._select)
+        sqlite3_finalize(conn._select);
+    if (conn._database)
+        sqlite3_close(conn._database);
+    conn._select = 0L;
+    conn._database = 0L;
+}
+
+bool
+MBTilesTileSource::readTileData(sqlite3* database, sqlite3_stmt* select, int z, int x, int y, std::string& out)
+{
+    sqlite3_bind_int( select, 1, z );
+    sqlite3_bind_int( select, 2, x );
+    sqlite3_bind_int( select, 3, y );
+
+    bool valid = false;
+
+    int rc = sqlite3_step( select );
+    if ( rc == SQLITE_ROW)
+    {
+        // the pointer returned from _blob gets freed internally by sqlite, supposedly
+        const char* data = (const char*)sqlite3_column_blob( select, 0 );
+        int dataLen = sqlite3_column_bytes( select, 0 );
+        out.assign( data, dataLen );
+        valid = true;
+    }
+    else if ( rc != SQLITE_DONE )
+    {
+        OE_DEBUG << LC << "SQL QUERY failed for tile " << z << "/" << x << "/" << y << ": " << sqlite3_errmsg(database) << std::endl;
+    }
+
+    // Reset right away so the statement doesn't hold its read transaction
+    // open (which would keep a WAL checkpoint from completing).
+    sqlite3_reset( select );
+    sqlite3_clear_bindings( select );
+
+    return valid;
+}
+
 osg::Image*
 MBTilesTileSource::createImage(const TileKey&    key,
                                ProgressCallback* progress)
 {
-    Threading::ScopedMutexLock exclusiveLock(_mutex);
-
     int z = key.getLevelOfDetail();
     int x = key.getTileX();
     int y = key.getTileY();
@@ -326,78 +612,67 @@ MBTilesTileSource::createImage(const TileKey&    key,
     y  = numRows - y - 1;
 
     //Get the image
-    sqlite3_stmt* select = NULL;
-    std::string query = "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
-    int rc = sqlite3_prepare_v2( _database, query.c_str(), -1, &select, 0L );
-    if ( rc != SQLITE_OK )
+    std::string dataBuffer;
+    bool valid = false;
+
+    ReadConnection reader;
+    if (checkoutReader(reader))
     {
-        OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
-        return NULL;
+        valid = readTileData(reader._database, reader._select, z, x, y, dataBuffer);
+        returnReader(reader);
     }
-
-    bool valid = true;
-
-    sqlite3_bind_int( select, 1, z );
-    sqlite3_bind_int( select, 2, x );
-    sqlite3_bind_int( select, 3, y );
-
-    osg::Image* result = NULL;
-    rc = sqlite3_step( select );
-    if ( rc == SQLITE_ROW)
+    else
     {
-        // the pointer returned from _blob gets freed internally by sqlite, supposedly
-        const char* data = (const char*)sqlite3_column_blob( select, 0 );
-        int dataLen = sqlite3_column_bytes( select, 0 );
-
-        std::string dataBuffer( data, dataLen );
+        Threading::ScopedMutexLock exclusiveLock(_mutex);
 
-        // decompress if necessary:
-        if ( _compressor.valid() )
+        if ( !_selectTile )
         {
-            std::istringstream inputStream(dataBuffer);
-            std::string value;
-            if ( !_compressor->decompress(inputStream, value) )
+            std::string query = "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
+            int rc = sqlite3_prepare_v2( _database, query.c_str(), -1, &_selectTile, 0L );
+            if ( rc != SQLITE_OK )
             {
-                OE_WARN << LC << "Decompression failed" << std::endl;
-                valid = false;
-            }
-            else
-            {
-                dataBuffer = value;
+                OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
+                _selectTile = NULL;
+                return NULL;
             }
         }
 
-        // decode the raw image data:
-        if ( valid )
+        valid = readTileData(_database, _selectTile, z, x, y, dataBuffer);
+    }
+
+    if ( !valid )
+    {
+        return NULL;
+    }
+
+    // decompress if necessary:
+    if ( _compressor.valid() )
+    {
+        std::istringstream inputStream(dataBuffer);
+        std::string value;
+        if ( !_compressor->decompress(inputStream, value) )
         {
-            std::istringstream inputStream(dataBuffer);
-            osgDB::ReaderWriter::ReadResult rr = _rw->readImage( inputStream, _dbOptions.get() );
-            if (rr.validImage())
-            {
-                result = rr.takeImage();
-            }
+            OE_WARN << LC << "Decompression failed" << std::endl;
+            return NULL;
         }
+        dataBuffer = value;
     }
-    else
+
+    // decode the raw image data:
+    osg::Image* result = NULL;
+    std::istringstream inputStream(dataBuffer);
+    osgDB::ReaderWriter::ReadResult rr = _rw->readImage( inputStream, _dbOptions.get() );
+    if (rr.validImage())
     {
-        OE_DEBUG << LC << "SQL QUERY failed for " << query << ": " << std::endl;
-        valid = false;
+        result = rr.takeImage();
     }
 
-    sqlite3_finalize( select );
     return result;
 }
 
 bool
-MBTilesTileSource::storeImage(const TileKey&    key,
-                              osg::Image*       image,
-                              ProgressCallback* progress)
+MBTilesTileSource::encodeTile(osg::Image* image, std::string& out)
 {
-    if ( (getMode() & MODE_WRITE) == 0 )
-        return false;
-
-    Threading::ScopedMutexLock exclusiveLock(_mutex);
-
     // encode the data stream:
     std::stringstream buf;
     osgDB::ReaderWriter::WriteResult wr;
@@ -417,68 +692,218 @@ MBTilesTileSource::storeImage(const TileKey&    key,
         return false;
     }
 
-    std::string value = buf.str();
+    out = buf.str();
 
     // compress if necessary:
     if ( _compressor.valid() )
     {
         std::ostringstream output;
-        if ( !_compressor->compress(output, value) )
+        if ( !_compressor->compress(output, out) )
         {
             OE_WARN << LC << "Compressor failed" << std::endl;
             return false;
         }
-        value = output.str();
+        out = output.str();
     }
 
-    int z = key.getLOD();
-    int x = key.getTileX();
-    int y = key.getTileY();
+    return true;
+}
+
+bool
+MBTilesTileSource::storeImage(const TileKey&    key,
+                              osg::Image*       image,
+                              ProgressCallback* progress)
+{
+    if ( (getMode() & MODE_WRITE) == 0 )
+        return false;
+
+    // Encode outside the lock so several threads can do it at once.
+    PendingTile tile;
+    if ( !encodeTile(image, tile._data) )
+        return false;
+
+    if ( _dedup )
+        tile._id = osgEarth::contentHash(tile._data);
+
+    tile._z = key.getLOD();
+    tile._x = key.getTileX();
+    tile._y = key.getTileY();
 
     // flip Y axis
     unsigned int numRows, numCols;
     key.getProfile()->getNumTiles(key.getLevelOfDetail(), numCols, numRows);
-    y  = numRows - y - 1;
+    tile._y  = numRows - tile._y - 1;
 
-    // Prep the insert statement:
-    sqlite3_stmt* insert = NULL;
-    std::string query = "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)";
-    int rc = sqlite3_prepare_v2( _database, query.c_str(), -1, &insert, 0L );
-    if ( rc != SQLITE_OK )
+    if ( _bulkWriter )
     {
-        OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
-        return false;
+        _bulkWriter->push(tile);
+        return true;
     }
 
-    // bind parameters:
-    sqlite3_bind_int( insert, 1, z );
-    sqlite3_bind_int( insert, 2, x );
-    sqlite3_bind_int( insert, 3, y );
+    Threading::ScopedMutexLock exclusiveLock(_mutex);
+    return writeTile(tile);
+}
+
+bool
+MBTilesTileSource::writeTiles(std::vector<PendingTile>& tiles)
+{
+    Threading::ScopedMutexLock exclusiveLock(_mutex);
 
-    // bind the data blob:
-    sqlite3_bind_blob( insert, 4, value.c_str(), value.length(), SQLITE_STATIC );
+    bool inTransaction = execute("BEGIN TRANSACTION");
 
-    // run the sql.
     bool ok = true;
-    int tries = 0;
-    do {
-        rc = sqlite3_step(insert);
+    for (std::vector<PendingTile>::const_iterator tile = tiles.begin(); tile != tiles.end(); ++tile)
+    {
+        if ( !writeTile(*tile) )
+            ok = false;
+    }
+
+    if ( inTransaction && !execute("COMMIT TRANSACTION") )
+    {
+        OE_WARN << LC << "Failed to commit " << tiles.size() << " tiles" << std::endl;
+        execute("ROLLBACK TRANSACTION");
+        ok = false;
+    }
+
+    OE_DEBUG << LC << "Wrote " << tiles.size() << " tiles" << std::endl;
+    return ok;
+}
+
+bool
+MBTilesTileSource::execute(const std::string& sql)
+{
+    char* errorMsg = 0L;
+    if ( SQLITE_OK != sqlite3_exec(_database, sql.c_str(), 0L, 0L, &errorMsg) )
+    {
+        OE_WARN << LC << "Failed query: " << sql << "; " << (errorMsg ? errorMsg : "") << std::endl;
+        sqlite3_free( errorMsg );
+        return false;
+    }
+    return true;
+}
+
+namespace
+{
+    // steps a statement, retrying while the database is busy.
+    int stepWithRetry(sqlite3_stmt* stmt)
+    {
+        int rc;
+        int tries = 0;
+        do {
+            rc = sqlite3_step(stmt);
+        }
+        while (++tries < 100 && (rc == SQLITE_BUSY || rc == SQLITE_LOCKED));
+        return rc;
+    }
+
+    bool prepare(sqlite3* database, const std::string& query, sqlite3_stmt*& stmt)
+    {
+        if ( stmt )
+            return true;
+
+        if ( sqlite3_prepare_v2(database, query.c_str(), -1, &stmt, 0L) != SQLITE_OK )
+        {
+            OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(database) << std::endl;
+            stmt = NULL;
+            return false;
+        }
+        return true;
     }
-    while (++tries < 100 && (rc == SQLITE_BUSY || rc == SQLITE_LOCKED));
 
-    if (SQLITE_OK != rc && SQLITE_DONE != rc)
+    bool finishStatement(sqlite3* database, sqlite3_stmt* stmt, int rc)
     {
+        sqlite3_reset( stmt );
+        sqlite3_clear_bindings( stmt );
+
+        if (SQLITE_OK != rc && SQLITE_DONE != rc)
+        {
 #if SQLITE_VERSION_NUMBER >= 3007015
-        OE_WARN << LC << "Failed query: " << query << "(" << rc << ")" << sqlite3_errstr(rc) << "; " << sqlite3_errmsg(_database) << std::endl;
+            OE_WARN << LC << "Failed query: " << sqlite3_sql(stmt) << "(" << rc << ")" << sqlite3_errstr(rc) << "; " << sqlite3_errmsg(database) << std::endl;
 #else
-        OE_WARN << LC << "Failed query: " << query << "(" << rc << ")" << rc << "; " << sqlite3_errmsg(_database) << std::endl;
+            OE_WARN << LC << "Failed query: " << sqlite3_sql(stmt) << "(" << rc << ")" << rc << "; " << sqlite3_errmsg(database) << std::endl;
 #endif
-        ok = false;
+            return false;
+        }
+        return true;
     }
+}
 
-    sqlite3_finalize( insert );
+bool
+MBTilesTileSource::storeImageData(const PendingTile& tile, std::string& out_id)
+{
+    if ( !prepare(_database, "SELECT tile_data FROM images WHERE tile_id = ?", _selectImage) ||
+         !prepare(_database, "INSERT INTO images (tile_id, tile_data) VALUES (?, ?)", _insertImage) )
+    {
+        return false;
+    }
 
-    return ok;
+    // The content hash names the image, but two different images can still
+    // share a hash. Compare the bytes, and on a collision try the next name.
+    const unsigned maxCollisions = 16u;
+    for (unsigned i = 0; i < maxCollisions; ++i)
+    {
+        out_id = i == 0u ? tile._id : (Stringify() << tile._id << "." << i);
+
+        sqlite3_bind_text( _selectImage, 1, out_id.c_str(), out_id.length(), SQLITE_STATIC );
+        int rc = stepWithRetry(_selectImage);
+        bool found = rc == SQLITE_ROW;
+        bool same = found &&
+            (unsigned)sqlite3_column_bytes(_selectImage, 0) == tile._data.length() &&
+            (tile._data.empty() || ::memcmp(sqlite3_column_blob(_selectImage, 0), tile._data.c_str(), tile._data.length()) == 0);
+        if ( !finishStatement(_database, _selectImage, found ? SQLITE_DONE : rc) )
+            return false;
+
+        if ( same )
+            return true;
+
+        if ( !found )
+        {
+            sqlite3_bind_text( _insertImage, 1, out_id.c_str(), out_id.length(), SQLITE_STATIC );
+            sqlite3_bind_blob( _insertImage, 2, tile._data.c_str(), tile._data.length(), SQLITE_STATIC );
+            return finishStatement(_database, _insertImage, stepWithRetry(_insertImage));
+        }
+
+        OE_DEBUG << LC << "Content hash collision on " << out_id << std::endl;
+    }
+
+    OE_WARN << LC << "Too many content hash collisions on " << tile._id << std::endl;
+    return false;
+}
+
+bool
+MBTilesTileSource::writeTile(const PendingTile& tile)
+{
+    if ( _dedup )
+    {
+        // store the image once, keyed by its content hash:
+        std::string id;
+        if ( !storeImageData(tile, id) )
+            return false;
+
+        if ( !prepare(_database, "INSERT OR REPLACE INTO map (zoom_level, tile_column, tile_row, tile_id) VALUES (?, ?, ?, ?)", _insertMap) )
+            return false;
+
+        sqlite3_bind_int( _insertMap, 1, tile._z );
+        sqlite3_bind_int( _insertMap, 2, tile._x );
+        sqlite3_bind_int( _insertMap, 3, tile._y );
+        sqlite3_bind_text( _insertMap, 4, id.c_str(), id.length(), SQLITE_STATIC );
+        return finishStatement(_database, _insertMap, stepWithRetry(_insertMap));
+    }
+    else
+    {
+        if ( !prepare(_database, "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)", _insertTile) )
+            return false;
+
+        // bind parameters:
+        sqlite3_bind_int( _insertTile, 1, tile._z );
+        sqlite3_bind_int( _insertTile, 2, tile._x );
+        sqlite3_bind_int( _insertTile, 3, tile._y );
+
+        // bind the data blob:
+        sqlite3_bind_blob( _insertTile, 4, tile._data.c_str(), tile._data.length(), SQLITE_STATIC );
+
+        return finishStatement(_database, _insertTile, stepWithRetry(_insertTile));
+    }
 }
 
 bool
@@ -560,7 +985,11 @@ MBTilesTileSource::computeLevels()
 
     osg::Timer_t startTime = osg::Timer::instance()->tick();
     sqlite3_stmt* select = NULL;
-    std::string query = "SELECT min(zoom_level), max(zoom_level) from tiles";
+    // (query the map table directly in a deduplicated database; it's much
+    // faster than going through the tiles view)
+    std::string query = _dedup ?
+        "SELECT min(zoom_level), max(zoom_level) from map" :
+        "SELECT min(zoom_level), max(zoom_level) from tiles";
     int rc = sqlite3_prepare_v2( _database, query.c_str(), -1, &select, 0L );
     if ( rc != SQLITE_OK )
     {
@@ -601,6 +1030,50 @@ MBTilesTileSource::createTables()
         return false;
     }
 
+    char* errorMsg = 0L;
+
+    if ( _dedup )
+    {
+        // Deduplicated layout: each distinct image is stored once in [images],
+        // [map] points each tile at its image, and [tiles] is a view so readers
+        // see the standard schema.
+        const char* queries[] = {
+            "CREATE TABLE IF NOT EXISTS map ("
+            " zoom_level integer,"
+            " tile_column integer,"
+            " tile_row integer,"
+            " tile_id text)",
+
+            "CREATE UNIQUE INDEX IF NOT EXISTS map_index ON map ("
+            " zoom_level, tile_column, tile_row)",
+
+            "CREATE TABLE IF NOT EXISTS images ("
+            " tile_id text,"
+            " tile_data blob)",
+
+            "CREATE UNIQUE INDEX IF NOT EXISTS images_id ON images (tile_id)",
+
+            "CREATE VIEW IF NOT EXISTS tiles AS SELECT"
+            " map.zoom_level AS zoom_level,"
+            " map.tile_column AS tile_column,"
+            " map.tile_row AS tile_row,"
+            " images.tile_data AS tile_data"
+            " FROM map JOIN images ON images.tile_id = map.tile_id"
+        };
+
+        for (unsigned i = 0; i < sizeof(queries)/sizeof(queries[0]); ++i)
+        {
+            if (SQLITE_OK != sqlite3_exec(_database, queries[i], 0L, 0L, &errorMsg))
+            {
+                OE_WARN << LC << "Failed to create deduplicated tables: " << errorMsg << std::endl;
+                sqlite3_free( errorMsg );
+                return false;
+            }
+        }
+
+        return true;
+    }
+
     query =
         "CREATE TABLE IF NOT EXISTS tiles ("
         " zoom_level integer,"
@@ -608,8 +1081,6 @@ MBTilesTileSource::createTables()
         " tile_row integer,"
         " tile_data blob)";
 
-    char* errorMsg = 0L;
-
     if (SQLITE_OK != sqlite3_exec(_database, query.c_str(), 0L, 0L, &errorMsg))
     {
         OE_WARN << LC << "Failed to create table [tiles]: " << errorMsg << std::endl;
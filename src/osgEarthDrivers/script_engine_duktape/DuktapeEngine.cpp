@@ -18,6 +18,7 @@
  */
 #include "DuktapeEngine"
 #include "JSGeometry"
+#include <osgEarthFeatures/AttributeColumns>
 #include <osgEarth/JsonUtils>
 #include <osgEarth/StringUtils>
 #include <osgEarthFeatures/GeometryUtils>
@@ -31,6 +32,10 @@
 // complete the feature set.
 //#define MAXIMUM_ISOLATION
 
+// Number of distinct snippets each context keeps compiled; past this, the
+// cache starts over.
+#define MAX_COMPILED 256u
+
 using namespace osgEarth;
 using namespace osgEarth::Features;
 using namespace osgEarth::Drivers::Duktape;
@@ -54,12 +59,28 @@ namespace
         return 0;
     }
 
+    // The feature behind a native pointer, provided it's still the current
+    // feature (see setFeature); a script could keep an older one around.
+    static Feature* getFeature(duk_context* ctx, duk_idx_t index)
+    {
+        void* ptr = duk_get_pointer(ctx, index);
+
+        duk_push_global_stash(ctx);                      // [stash]
+        duk_get_prop_string(ctx, -1, "oe_duk_feature");  // [stash, ptr]
+        void* current = duk_get_pointer(ctx, -1);
+        duk_pop_2(ctx);                                  // []
+
+        return ptr && ptr == current ? reinterpret_cast<Feature*>(ptr) : 0L;
+    }
+
     static duk_ret_t oe_duk_save_feature(duk_context* ctx)
     {
         // stack: [ptr]
 
         // pull the feature ptr from argument #0
-        Feature* feature = reinterpret_cast<Feature*>(duk_require_pointer(ctx, 0));
+        Feature* feature = getFeature(ctx, 0);
+        if ( !feature )
+            return 0;
 
         // Fetch the feature data:
         duk_push_global_object(ctx);                    
@@ -70,7 +91,9 @@ namespace
 
          // [ptr, global, feature]
 
-        if ( duk_get_prop_string(ctx, -1, "properties") && duk_is_object(ctx, -1) )
+        // Only the properties and geometry that the script read or replaced
+        // can have changed.
+        if ( duk_get_prop_string(ctx, -1, "__properties") && duk_is_object(ctx, -1) )
         {
             // [ptr, global, feature, props]
             duk_enum(ctx, -1, 0);                       
@@ -108,7 +131,7 @@ namespace
         }
 
         // save the geometry, if set:
-        if ( duk_get_prop_string(ctx, -1, "geometry")&& duk_is_object(ctx, -1) )
+        if ( duk_get_prop_string(ctx, -1, "__geometry") && duk_is_object(ctx, -1) )
         {
             // [ptr, global, feature, geometry]
             std::string json( duk_json_encode(ctx, -1) ); // [ptr, global, feature, json]
@@ -129,6 +152,85 @@ namespace
         duk_pop_2(ctx);     // [ptr] (as we found it)
         return 0;           // no return values.
     }
+
+    // input:  feature ptr
+    // output: properties object, as in the feature's GeoJSON
+    static duk_ret_t oe_duk_feature_properties(duk_context* ctx)
+    {
+        const Feature* feature = getFeature(ctx, 0);
+
+        duk_idx_t props_i = duk_push_object(ctx);
+
+        // read columnar attributes in place, so the feature keeps them.
+        const AttributeColumns* columns = feature ? feature->getAttributeColumns() : 0L;
+        if ( columns )
+        {
+            unsigned row = feature->getAttributeRow();
+            for(unsigned c = 0; c < columns->getNumColumns(); ++c)
+            {
+                if ( !columns->isSet(row, c) )
+                {
+                    duk_push_null(ctx);
+                }
+                else
+                {
+                    switch(columns->getColumnType(c)) {
+                    case ATTRTYPE_DOUBLE: duk_push_number (ctx, columns->getDouble(row, c)); break;
+                    case ATTRTYPE_INT:    duk_push_int    (ctx, columns->getInt(row, c)); break;
+                    case ATTRTYPE_BOOL:   duk_push_boolean(ctx, columns->getBool(row, c)); break;
+                    case ATTRTYPE_STRING:
+                    default:              duk_push_string (ctx, columns->getString(row, c).c_str()); break;
+                    }
+                }
+                duk_put_prop_string(ctx, props_i, columns->getColumnName(c).c_str());
+            }
+        }
+        else if ( feature )
+        {
+            const AttributeTable& attrs = feature->getAttrs();
+            for(AttributeTable::const_iterator a = attrs.begin(); a != attrs.end(); ++a)
+            {
+                if ( !a->second.second.set )
+                {
+                    duk_push_null(ctx);
+                }
+                else
+                {
+                    switch(a->second.first) {
+                    case ATTRTYPE_DOUBLE: duk_push_number (ctx, a->second.getDouble()); break;
+                    case ATTRTYPE_INT:    duk_push_int    (ctx, a->second.getInt()); break;
+                    case ATTRTYPE_BOOL:   duk_push_boolean(ctx, a->second.getBool()); break;
+                    case ATTRTYPE_STRING:
+                    default:              duk_push_string (ctx, a->second.getString().c_str()); break;
+                    }
+                }
+                duk_put_prop_string(ctx, props_i, a->first.c_str());
+            }
+        }
+        return 1;
+    }
+
+    // input:  feature ptr
+    // output: GeoJSON geometry object, or undefined if there's no geometry
+    static duk_ret_t oe_duk_feature_geometry(duk_context* ctx)
+    {
+        const Feature* feature = getFeature(ctx, 0);
+
+        std::string json;
+        if ( feature && feature->getGeometry() )
+            json = GeometryUtils::geometryToGeoJSON(feature->getGeometry());
+
+        if ( json.empty() )
+        {
+            duk_push_undefined(ctx);
+        }
+        else
+        {
+            duk_push_string(ctx, json.c_str());
+            duk_json_decode(ctx, -1);
+        }
+        return 1;
+    }
 }
 
 //............................................................................
@@ -138,31 +240,40 @@ namespace
     // Create a "feature" object in the global namespace.
     void setFeature(duk_context* ctx, Feature const* feature, bool complete)
     {
+        // The native accessors only serve the current feature.
+        if ( complete )
+        {
+            duk_push_global_stash(ctx);                          // [stash]
+            duk_push_pointer(ctx, (void*)feature);               // [stash, ptr]
+            duk_put_prop_string(ctx, -2, "oe_duk_feature");      // [stash]
+            duk_pop(ctx);                                        // []
+        }
+
+        if ( !feature )
+            return;
+
         duk_push_global_object(ctx);                             // [global]
 
-        // Complete profile: properties, geometry, and API bindings.
+        // Complete profile: properties, geometry, and API bindings. The
+        // object only holds the feature's pointer; the prototype reads the
+        // properties and geometry from the feature on first use.
         if ( complete )
         {
-            std::string geojson = feature->getGeoJSON();
-            duk_push_string(ctx, geojson.c_str());               // [global, json]
-            duk_json_decode(ctx, -1);                            // [global, feature]
-            duk_push_pointer(ctx, (void*)feature);               // [global, feature, ptr]
-            duk_put_prop_string(ctx, -2, "__ptr");               // [global, feature]
-            duk_put_prop_string(ctx, -2, "feature");             // [global]
+            duk_push_object(ctx);                                // [global, feature]
+            duk_get_prop_string(ctx, -2, "oe_duk_feature_prototype"); // [global, feature, proto]
+            duk_set_prototype(ctx, -2);                          // [global, feature]
 
-            // add the save() function and the "attributes" alias.
-            duk_eval_string_noresult(ctx,
-                "feature.save = function() {"
-                "    oe_duk_save_feature(this.__ptr);"
-                "} ");
+            duk_push_string(ctx, "Feature");
+            duk_put_prop_string(ctx, -2, "type");
+            duk_push_uint(ctx, (unsigned)feature->getFID());
+            duk_put_prop_string(ctx, -2, "id");
+            duk_push_pointer(ctx, (void*)feature);
+            duk_put_prop_string(ctx, -2, "__ptr");
 
-            duk_eval_string_noresult(ctx,
-                "Object.defineProperty(feature, 'attributes', {get:function() {return feature.properties;}});");
-
-            GeometryAPI::bindToFeature(ctx);
+            duk_put_prop_string(ctx, -2, "feature");             // [global]
         }
 
-        // Minimal profile: ID and properties only. MUCH faster!
+        // Minimal profile: ID and properties only.
         else
         {
             duk_idx_t feature_i = duk_push_object(ctx);
@@ -171,6 +282,25 @@ namespace
                 duk_put_prop_string(ctx, feature_i, "id");
 
                 duk_idx_t props_i = duk_push_object(ctx);
+
+                // read columnar attributes in place, so the feature keeps them.
+                const AttributeColumns* columns = feature->getAttributeColumns();
+                if ( columns )
+                {
+                    unsigned row = feature->getAttributeRow();
+                    for(unsigned c = 0; c < columns->getNumColumns(); ++c)
+                    {
+                        switch(columns->getColumnType(c)) {
+                        case ATTRTYPE_DOUBLE: duk_push_number (ctx, columns->getDouble(row, c)); break;
+                        case ATTRTYPE_INT:    duk_push_int    (ctx, columns->getInt(row, c)); break;
+                        case ATTRTYPE_BOOL:   duk_push_boolean(ctx, columns->getBool(row, c)); break;
+                        case ATTRTYPE_STRING:
+                        default:              duk_push_string (ctx, columns->getString(row, c).c_str()); break;
+                        }
+                        duk_put_prop_string(ctx, props_i, columns->getColumnName(c).c_str());
+                    }
+                }
+                else
                 {
                     const AttributeTable& attrs = feature->getAttrs();
                     for(AttributeTable::const_iterator a = attrs.begin(); a != attrs.end(); ++a)
@@ -188,12 +318,33 @@ namespace
                 }
                 duk_put_prop_string(ctx, feature_i, "properties");
             }
-            duk_put_prop_string(ctx, -2, "feature");
+            duk_put_prop_string(ctx, -2, "feature");             // [global]
         }
 
         duk_pop(ctx); 
     }
-    
+
+    // Pops the result of running a snippet (or the error, if it failed).
+    ScriptResult popResult(duk_context* ctx, const std::string& code, bool ok)
+    {
+        std::string resultString;
+
+        const char* resultVal = duk_to_string(ctx, -1);
+        if ( resultVal )
+            resultString = resultVal;
+
+        if ( !ok )
+        {
+            OE_WARN << LC << "Error: source =" << std::endl << code << std::endl;
+        }
+
+        // pop the return value:
+        duk_pop(ctx); // []
+
+        return ok ?
+            ScriptResult(resultString, true) :
+            ScriptResult("", false, resultString);
+    }
 }
 
 //............................................................................
@@ -201,6 +352,8 @@ namespace
 DuktapeEngine::Context::Context()
 {
     _ctx = 0L;
+    _complete = false;
+    _numCompiled = 0u;
 }
 
 void
@@ -210,6 +363,7 @@ DuktapeEngine::Context::initialize(const ScriptEngineOptions& options, bool comp
     {
         // new heap + context.
         _ctx = duk_create_heap_default();
+        _complete = complete;
 
         // if there is a static script, evaluate it first. This will register
         // any functions or objects with the EcmaScript global object.
@@ -224,6 +378,12 @@ DuktapeEngine::Context::initialize(const ScriptEngineOptions& options, bool comp
             duk_pop(_ctx); // []
         }
 
+        // cache of compiled snippets, keyed by source code.
+        duk_push_global_stash( _ctx );                   // [stash]
+        duk_push_object( _ctx );                         // [stash, compiled]
+        duk_put_prop_string( _ctx, -2, "oe_duk_compiled" ); // [stash]
+        duk_pop( _ctx );                                 // []
+
         duk_push_global_object( _ctx );
 
         // Add global log function.
@@ -236,7 +396,45 @@ DuktapeEngine::Context::initialize(const ScriptEngineOptions& options, bool comp
             duk_push_c_function(_ctx, oe_duk_save_feature, 1/*numargs*/); // [global, function]
             duk_put_prop_string(_ctx, -2, "oe_duk_save_feature");         // [global]
 
+            // native accessors for the feature object
+            duk_push_c_function(_ctx, oe_duk_feature_properties, 1);
+            duk_put_prop_string(_ctx, -2, "oe_duk_feature_properties");
+
+            duk_push_c_function(_ctx, oe_duk_feature_geometry, 1);
+            duk_put_prop_string(_ctx, -2, "oe_duk_feature_geometry");
+
             GeometryAPI::install(_ctx);
+
+            // Prototype of every feature object. The properties and geometry
+            // are read on first use and cached in the feature object.
+            duk_eval_string_noresult(_ctx,
+                "oe_duk_feature_prototype = {"
+                "    save: function() {"
+                "        oe_duk_save_feature(this.__ptr);"
+                "    }"
+                "};"
+                "Object.defineProperty(oe_duk_feature_prototype, 'properties', {"
+                "    get: function() {"
+                "        if (this.__properties === undefined)"
+                "            this.__properties = oe_duk_feature_properties(this.__ptr);"
+                "        return this.__properties;"
+                "    },"
+                "    set: function(value) { this.__properties = value; }"
+                "});"
+                "Object.defineProperty(oe_duk_feature_prototype, 'attributes', {"
+                "    get: function() { return this.properties; }"
+                "});"
+                "Object.defineProperty(oe_duk_feature_prototype, 'geometry', {"
+                "    get: function() {"
+                "        if (!this.__geometryRead) {"
+                "            var geometry = oe_duk_feature_geometry(this.__ptr);"
+                "            this.__geometry = geometry ? oe_duk_bind_geometry_api(geometry) : geometry;"
+                "            this.__geometryRead = true;"
+                "        }"
+                "        return this.__geometry;"
+                "    },"
+                "    set: function(value) { this.__geometry = value; this.__geometryRead = true; }"
+                "});");
         }
 
         duk_pop(_ctx); // []
@@ -252,6 +450,71 @@ DuktapeEngine::Context::~Context()
     }
 }
 
+bool
+DuktapeEngine::Context::compile(const std::string& code)
+{
+    duk_push_global_stash(_ctx);                          // [stash]
+    duk_get_prop_string(_ctx, -1, "oe_duk_compiled");     // [stash, compiled]
+
+    if ( !duk_get_prop_string(_ctx, -1, code.c_str()) )   // [stash, compiled, function]
+    {
+        duk_pop(_ctx);                                    // [stash, compiled]
+
+        // compile as eval code, like duk_peval_string does.
+        if ( duk_pcompile_string(_ctx, DUK_COMPILE_EVAL, code.c_str()) != 0 )
+        {
+            // [stash, compiled, error]
+            duk_remove(_ctx, -2);
+            duk_remove(_ctx, -2);                         // [error]
+            return false;
+        }
+
+        // [stash, compiled, function]
+        if ( _numCompiled >= MAX_COMPILED )
+        {
+            duk_push_object(_ctx);                        // [stash, compiled, function, new]
+            duk_dup(_ctx, -1);                            // [stash, compiled, function, new, new]
+            duk_put_prop_string(_ctx, -5, "oe_duk_compiled"); // [stash, compiled, function, new]
+            duk_replace(_ctx, -3);                        // [stash, new, function]
+            _numCompiled = 0u;
+        }
+
+        duk_dup(_ctx, -1);                                // [stash, compiled, function, function]
+        duk_put_prop_string(_ctx, -3, code.c_str());      // [stash, compiled, function]
+        ++_numCompiled;
+    }
+
+    duk_remove(_ctx, -2);
+    duk_remove(_ctx, -2);                                 // [function]
+    return true;
+}
+
+void
+DuktapeEngine::Context::setFeature(const Feature* feature)
+{
+    // A missing feature leaves the last one in place, but the native
+    // accessors have to let go of it since it may go away.
+    if ( !feature || feature != _feature.get() )
+    {
+        // encode the feature in the global object and push a native pointer:
+        ::setFeature(_ctx, feature, _complete);
+    }
+
+    // remember the feature so we don't re-create it if not necessary
+    _feature = feature;
+}
+
+ScriptResult
+DuktapeEngine::Context::call(const std::string& code)
+{
+    // run the script, with the global object as "this" like duk_peval_string.
+    // On error, the top of stack will hold the error message instead of the
+    // return value.
+    duk_push_global_object(_ctx);                        // [function, global]
+    bool ok = (duk_pcall_method(_ctx, 0) == 0);          // [ "result" ]
+    return popResult(_ctx, code, ok);
+}
+
 //............................................................................
 
 DuktapeEngine::DuktapeEngine(const ScriptEngineOptions& options) :
@@ -280,41 +543,59 @@ DuktapeEngine::run(const std::string&   code,
     // brand new context every time
     Context c;
     c.initialize( _options, complete );
-    duk_context* ctx = c._ctx;
 #else
     // cache the Context on a per-thread basis
     Context& c = _contexts.get();
     c.initialize( _options, complete );
-    duk_context* ctx = c._ctx;
 #endif
 
-	if ( feature && feature != c._feature.get() )
-    {
-		// encode the feature in the global object and push a native pointer:
-		setFeature(ctx, feature, complete);
-	}
+    c.setFeature( feature );
 
-    // remember the feature so we don't re-create it if not necessary
-    c._feature = feature;
+    if ( !c.compile(code) )
+        return popResult( c._ctx, code, false );
 
-    // run the script. On error, the top of stack will hold the error
-    // message instead of the return value.
-    std::string resultString;
+    return c.call( code );
+}
 
-    bool ok = (duk_peval_string(ctx, code.c_str()) == 0); // [ "result" ]
-    const char* resultVal = duk_to_string(ctx, -1);
-    if ( resultVal )
-        resultString = resultVal;
+void
+DuktapeEngine::run(const std::string&        code,
+                   const FeatureList&        features,
+                   std::vector<ScriptResult>& results,
+                   FilterContext const*      context)
+{
+    results.clear();
 
-    if ( !ok )
+    if (code.empty())
     {
-        OE_WARN << LC << "Error: source =" << std::endl << code << std::endl;
+        results.resize(features.size(), ScriptResult(EMPTY_STRING, false, "Script is empty."));
+        return;
     }
 
-    // pop the return value:
-    duk_pop(ctx); // []
+    bool complete = (getProfile() == "full");
+
+#ifdef MAXIMUM_ISOLATION
+    Context c;
+    c.initialize( _options, complete );
+#else
+    Context& c = _contexts.get();
+    c.initialize( _options, complete );
+#endif
+
+    if ( !c.compile(code) )
+    {
+        ScriptResult error = popResult( c._ctx, code, false );
+        results.resize(features.size(), error);
+        return;
+    }
+
+    // [function]
+    results.reserve(features.size());
+    for(FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+    {
+        c.setFeature( i->get() );
+        duk_dup( c._ctx, -1 );              // [function, function]
+        results.push_back( c.call(code) );  // [function]
+    }
 
-    return ok ?
-        ScriptResult(resultString, true) :
-        ScriptResult("", false, resultString);
+    duk_pop( c._ctx );                      // []
 }
@@ -49,20 +49,20 @@ static JSValueRef JSFeature_getProperty(JSContextRef ctx, JSObjectRef object, JS
             return object;
         }
         
-        osgEarth::Features::AttributeTable::const_iterator it = feature->getAttrs().find(attr);
-        if (it != feature->getAttrs().end())
+        osgEarth::Features::AttributeValue value;
+        if (feature->getAttr(attr, value))
         {
-            osgEarth::Features::AttributeType atype = (*it).second.first;
+            osgEarth::Features::AttributeType atype = value.first;
             switch (atype)
             {
                 case osgEarth::Features::ATTRTYPE_BOOL:
-                    return JSValueMakeBoolean(ctx, (*it).second.getBool());
+                    return JSValueMakeBoolean(ctx, value.getBool());
                 case osgEarth::Features::ATTRTYPE_DOUBLE:
-                    return JSValueMakeNumber(ctx, (*it).second.getDouble());
+                    return JSValueMakeNumber(ctx, value.getDouble());
                 case osgEarth::Features::ATTRTYPE_INT:
-                    return JSValueMakeNumber(ctx, (*it).second.getInt());
+                    return JSValueMakeNumber(ctx, value.getInt());
                 default:
-                    return JSValueMakeString(ctx, JSStringCreateWithUTF8CString((*it).second.getString().c_str()));
+                    return JSValueMakeString(ctx, JSStringCreateWithUTF8CString(value.getString().c_str()));
             }
         }
     }
@@ -82,30 +82,30 @@ JSFeature::GetAttributesObjectTemplate(v8::Isolate* isolate)
 v8::Handle<v8::Value>
 JSFeature::GetFeatureAttr(const std::string& attr, Feature const* feature)
 {
-  AttributeTable::const_iterator it = feature->getAttrs().find(attr);
+  AttributeValue value;
 
   // If the key is not present return an empty handle as signal
-  if (it == feature->getAttrs().end())
+  if (!feature->getAttr(attr, value))
     return v8::Handle<v8::Value>();
 
   // Otherwise fetch the value and wrap it in a JavaScript string
-  osgEarth::Features::AttributeType atype = (*it).second.first;
+  osgEarth::Features::AttributeType atype = value.first;
   switch (atype)
   {
     case osgEarth::Features::ATTRTYPE_BOOL:
-      return v8::Boolean::New((*it).second.second.set ? (*it).second.getBool() : false);
+      return v8::Boolean::New(value.second.set ? value.getBool() : false);
     case osgEarth::Features::ATTRTYPE_DOUBLE:
-      if ((*it).second.second.set)
-        return v8::Number::New((*it).second.getDouble());
+      if (value.second.set)
+        return v8::Number::New(value.getDouble());
       else
         return v8::Undefined();
     case osgEarth::Features::ATTRTYPE_INT:
-      if ((*it).second.second.set)
-        return v8::Integer::New((*it).second.getInt());
+      if (value.second.set)
+        return v8::Integer::New(value.getInt());
       else
         return v8::Undefined();
     default:
-      std::string val = (*it).second.second.set ? (*it).second.getString() : "";
+      std::string val = value.second.set ? value.getString() : "";
       return v8::String::New(val.c_str(), val.length());
   }
 }
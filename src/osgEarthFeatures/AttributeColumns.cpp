@@ -0,0 +1,332 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthFeatures/AttributeColumns>
+#include <osgEarth/StringUtils>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+
+#define LC "[AttributeColumns] "
+
+//----------------------------------------------------------------------------
+
+AttributeColumns::AttributeColumns() :
+_numRows( 0u )
+{
+    //nop
+}
+
+AttributeColumns::AttributeColumns(const FeatureSchema& schema) :
+_numRows( 0u )
+{
+    for(FeatureSchema::const_iterator i = schema.begin(); i != schema.end(); ++i)
+    {
+        addColumn( i->first, i->second );
+    }
+}
+
+unsigned
+AttributeColumns::addColumn(const std::string& name, AttributeType type)
+{
+    std::map<std::string, unsigned, CIStringComp>::const_iterator i = _columnIndex.find(name);
+    if ( i != _columnIndex.end() )
+        return i->second;
+
+    unsigned col = _columns.size();
+    _columns.push_back( Column() );
+
+    Column& column = _columns.back();
+    column._name = name;
+    column._type = type;
+    if ( type == ATTRTYPE_STRING )
+    {
+        column._strings.push_back( EMPTY_STRING );
+        column._codeOf[EMPTY_STRING] = 0u;
+    }
+    resize( column, _numRows );
+
+    _columnIndex[name] = col;
+    return col;
+}
+
+int
+AttributeColumns::getColumn(const std::string& name) const
+{
+    std::map<std::string, unsigned, CIStringComp>::const_iterator i = _columnIndex.find(name);
+    return i != _columnIndex.end() ? (int)i->second : -1;
+}
+
+FeatureSchema
+AttributeColumns::getSchema() const
+{
+    FeatureSchema schema;
+    for(std::vector<Column>::const_iterator i = _columns.begin(); i != _columns.end(); ++i)
+    {
+        schema[i->_name] = i->_type;
+    }
+    return schema;
+}
+
+unsigned
+AttributeColumns::addRow()
+{
+    for(std::vector<Column>::iterator i = _columns.begin(); i != _columns.end(); ++i)
+    {
+        resize( *i, _numRows+1 );
+    }
+    return _numRows++;
+}
+
+void
+AttributeColumns::resize(Column& column, unsigned rows)
+{
+    // NULLs store 0, "" or false, which is what they read as.
+    switch( column._type ) {
+        case ATTRTYPE_STRING: column._codes.resize(rows, 0u); break;
+        case ATTRTYPE_DOUBLE: column._doubles.resize(rows, 0.0); break;
+        case ATTRTYPE_INT:    column._ints.resize(rows, 0); break;
+        case ATTRTYPE_BOOL:   column._bools.resize(rows, false); break;
+        case ATTRTYPE_UNSPECIFIED: break;
+    }
+    column._set.resize(rows, false);
+}
+
+unsigned
+AttributeColumns::encode(Column& column, const std::string& value)
+{
+    // finishLoading() dropped the index; rebuild it.
+    if ( column._codeOf.size() < column._strings.size() )
+    {
+        for(unsigned code = 0; code < column._strings.size(); ++code)
+            column._codeOf[column._strings[code]] = code;
+    }
+
+    std::map<std::string, unsigned>::const_iterator i = column._codeOf.find(value);
+    if ( i != column._codeOf.end() )
+        return i->second;
+
+    unsigned code = column._strings.size();
+    column._strings.push_back( value );
+    column._codeOf[value] = code;
+    return code;
+}
+
+void
+AttributeColumns::set(unsigned row, unsigned col, const std::string& value)
+{
+    Column& column = _columns[col];
+    switch( column._type ) {
+        case ATTRTYPE_STRING: column._codes[row]   = encode(column, value); break;
+        case ATTRTYPE_DOUBLE: column._doubles[row] = osgEarth::as<double>(value, 0.0); break;
+        case ATTRTYPE_INT:    column._ints[row]    = osgEarth::as<int>(value, 0); break;
+        case ATTRTYPE_BOOL:   column._bools[row]   = osgEarth::as<bool>(value, false); break;
+        case ATTRTYPE_UNSPECIFIED: break;
+    }
+    column._set[row] = true;
+}
+
+void
+AttributeColumns::set(unsigned row, unsigned col, double value)
+{
+    Column& column = _columns[col];
+    switch( column._type ) {
+        case ATTRTYPE_STRING: column._codes[row]   = encode(column, osgEarth::toString(value)); break;
+        case ATTRTYPE_DOUBLE: column._doubles[row] = value; break;
+        case ATTRTYPE_INT:    column._ints[row]    = (int)value; break;
+        case ATTRTYPE_BOOL:   column._bools[row]   = value != 0.0; break;
+        case ATTRTYPE_UNSPECIFIED: break;
+    }
+    column._set[row] = true;
+}
+
+void
+AttributeColumns::set(unsigned row, unsigned col, int value)
+{
+    Column& column = _columns[col];
+    switch( column._type ) {
+        case ATTRTYPE_STRING: column._codes[row]   = encode(column, osgEarth::toString(value)); break;
+        case ATTRTYPE_DOUBLE: column._doubles[row] = (double)value; break;
+        case ATTRTYPE_INT:    column._ints[row]    = value; break;
+        case ATTRTYPE_BOOL:   column._bools[row]   = value != 0; break;
+        case ATTRTYPE_UNSPECIFIED: break;
+    }
+    column._set[row] = true;
+}
+
+void
+AttributeColumns::set(unsigned row, unsigned col, bool value)
+{
+    Column& column = _columns[col];
+    switch( column._type ) {
+        case ATTRTYPE_STRING: column._codes[row]   = encode(column, osgEarth::toString(value)); break;
+        case ATTRTYPE_DOUBLE: column._doubles[row] = value? 1.0 : 0.0; break;
+        case ATTRTYPE_INT:    column._ints[row]    = value? 1 : 0; break;
+        case ATTRTYPE_BOOL:   column._bools[row]   = value; break;
+        case ATTRTYPE_UNSPECIFIED: break;
+    }
+    column._set[row] = true;
+}
+
+void
+AttributeColumns::setNull(unsigned row, unsigned col)
+{
+    Column& column = _columns[col];
+    switch( column._type ) {
+        case ATTRTYPE_STRING: column._codes[row]   = 0u; break;
+        case ATTRTYPE_DOUBLE: column._doubles[row] = 0.0; break;
+        case ATTRTYPE_INT:    column._ints[row]    = 0; break;
+        case ATTRTYPE_BOOL:   column._bools[row]   = false; break;
+        case ATTRTYPE_UNSPECIFIED: break;
+    }
+    column._set[row] = false;
+}
+
+std::string
+AttributeColumns::getString(unsigned row, unsigned col) const
+{
+    const Column& column = _columns[col];
+    switch( column._type ) {
+        case ATTRTYPE_STRING: return column._strings[column._codes[row]];
+        case ATTRTYPE_DOUBLE: return osgEarth::toString(column._doubles[row]);
+        case ATTRTYPE_INT:    return osgEarth::toString(column._ints[row]);
+        case ATTRTYPE_BOOL:   return osgEarth::toString((bool)column._bools[row]);
+        case ATTRTYPE_UNSPECIFIED: break;
+    }
+    return EMPTY_STRING;
+}
+
+double
+AttributeColumns::getDouble(unsigned row, unsigned col, double defaultValue) const
+{
+    const Column& column = _columns[col];
+    switch( column._type ) {
+        case ATTRTYPE_STRING: return osgEarth::as<double>(column._strings[column._codes[row]], defaultValue);
+        case ATTRTYPE_DOUBLE: return column._doubles[row];
+        case ATTRTYPE_INT:    return (double)column._ints[row];
+        case ATTRTYPE_BOOL:   return column._bools[row]? 1.0 : 0.0;
+        case ATTRTYPE_UNSPECIFIED: break;
+    }
+    return defaultValue;
+}
+
+int
+AttributeColumns::getInt(unsigned row, unsigned col, int defaultValue) const
+{
+    const Column& column = _columns[col];
+    switch( column._type ) {
+        case ATTRTYPE_STRING: return osgEarth::as<int>(column._strings[column._codes[row]], defaultValue);
+        case ATTRTYPE_DOUBLE: return (int)column._doubles[row];
+        case ATTRTYPE_INT:    return column._ints[row];
+        case ATTRTYPE_BOOL:   return column._bools[row]? 1 : 0;
+        case ATTRTYPE_UNSPECIFIED: break;
+    }
+    return defaultValue;
+}
+
+bool
+AttributeColumns::getBool(unsigned row, unsigned col, bool defaultValue) const
+{
+    const Column& column = _columns[col];
+    switch( column._type ) {
+        case ATTRTYPE_STRING: return osgEarth::as<bool>(column._strings[column._codes[row]], defaultValue);
+        case ATTRTYPE_DOUBLE: return column._doubles[row] != 0.0;
+        case ATTRTYPE_INT:    return column._ints[row] != 0;
+        case ATTRTYPE_BOOL:   return column._bools[row];
+        case ATTRTYPE_UNSPECIFIED: break;
+    }
+    return defaultValue;
+}
+
+namespace
+{
+    // frees a vector's spare capacity (C++98 has no shrink_to_fit)
+    template<typename T>
+    void shrink(std::vector<T>& v)
+    {
+        std::vector<T>(v).swap(v);
+    }
+}
+
+void
+AttributeColumns::finishLoading()
+{
+    for(std::vector<Column>::iterator i = _columns.begin(); i != _columns.end(); ++i)
+    {
+        std::map<std::string, unsigned>().swap( i->_codeOf );
+        shrink( i->_doubles );
+        shrink( i->_ints );
+        shrink( i->_bools );
+        shrink( i->_codes );
+        shrink( i->_strings );
+        shrink( i->_set );
+    }
+}
+
+unsigned
+AttributeColumns::getSizeInBytes() const
+{
+    // map nodes hold three pointers and a color besides the entry.
+    const unsigned mapNodeSize = 4u*sizeof(void*);
+
+    unsigned size = sizeof(AttributeColumns);
+    for(std::vector<Column>::const_iterator i = _columns.begin(); i != _columns.end(); ++i)
+    {
+        size += sizeof(Column) + i->_name.capacity();
+        size += i->_doubles.capacity() * sizeof(double);
+        size += i->_ints.capacity() * sizeof(int);
+        size += i->_bools.capacity() / 8u;
+        size += i->_codes.capacity() * sizeof(unsigned);
+        size += i->_set.capacity() / 8u;
+        size += i->_strings.capacity() * sizeof(std::string);
+        for(std::vector<std::string>::const_iterator s = i->_strings.begin(); s != i->_strings.end(); ++s)
+            size += s->capacity();
+        for(std::map<std::string, unsigned>::const_iterator c = i->_codeOf.begin(); c != i->_codeOf.end(); ++c)
+            size += mapNodeSize + sizeof(*c) + c->first.capacity();
+    }
+    return size;
+}
+
+void
+AttributeColumns::getValue(unsigned row, unsigned col, AttributeValue& out) const
+{
+    const Column& column = _columns[col];
+    out.first = column._type;
+    out.second.stringValue.clear();
+    out.second.doubleValue = 0.0;
+    out.second.intValue = 0;
+    out.second.boolValue = false;
+    switch( column._type ) {
+        case ATTRTYPE_STRING: out.second.stringValue = column._strings[column._codes[row]]; break;
+        case ATTRTYPE_DOUBLE: out.second.doubleValue = column._doubles[row]; break;
+        case ATTRTYPE_INT:    out.second.intValue    = column._ints[row]; break;
+        case ATTRTYPE_BOOL:   out.second.boolValue   = column._bools[row]; break;
+        case ATTRTYPE_UNSPECIFIED: break;
+    }
+    out.second.set = column._set[row];
+}
+
+void
+AttributeColumns::getRow(unsigned row, AttributeTable& out) const
+{
+    out.clear();
+    for(unsigned col = 0; col < _columns.size(); ++col)
+    {
+        getValue( row, col, out[_columns[col]._name] );
+    }
+}
@@ -0,0 +1,271 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthFeatures/CompiledExpression>
+#include <osgEarthFeatures/FilterContext>
+#include <osgEarthFeatures/ScriptEngine>
+#include <osgEarthFeatures/Session>
+#include <osgEarth/StringUtils>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+#define LC "[CompiledExpression] "
+
+//------------------------------------------------------------------------
+
+void
+CompiledExpression::bind(const std::vector<std::string>& varNames, const FeatureSchema& schema)
+{
+    _slots.clear();
+    _varSlots.clear();
+
+    for (unsigned v = 0; v < varNames.size(); ++v)
+    {
+        const std::string& name = varNames[v];
+
+        unsigned s = 0;
+        while (s < _slots.size() && _slots[s]._name != name)
+            ++s;
+
+        if (s == _slots.size())
+        {
+            Slot slot;
+            slot._name = name;
+            slot._attrName = toLower(name);
+            slot._schemaIndex = -1;
+
+            int index = 0;
+            for (FeatureSchema::const_iterator i = schema.begin(); i != schema.end(); ++i, ++index)
+            {
+                if (ciEquals(i->first, name))
+                {
+                    slot._schemaIndex = index;
+                    break;
+                }
+            }
+
+            // A function call that isn't in the schema can only be a script.
+            slot._scriptOnly =
+                !schema.empty() &&
+                slot._schemaIndex < 0 &&
+                name.find('(') != std::string::npos;
+
+            _slots.push_back(slot);
+        }
+
+        _varSlots.push_back(s);
+    }
+
+    _attrs.resize(_slots.size());
+    _slotColumns.resize(_slots.size());
+    _columns = 0L;
+}
+
+const AttributeColumns*
+CompiledExpression::lookup(const Feature* feature)
+{
+    for (unsigned s = 0; s < _slots.size(); ++s)
+        _attrs[s] = 0L;
+
+    // features from the same batch share columns, so this binds rarely.
+    const AttributeColumns* columns = feature->getAttributeColumns();
+    if (columns)
+    {
+        if (columns != _columns.get())
+        {
+            _columns = columns;
+            for (unsigned s = 0; s < _slots.size(); ++s)
+                _slotColumns[s] = _slots[s]._scriptOnly ? -1 : columns->getColumn(_slots[s]._name);
+        }
+        return columns;
+    }
+
+    const AttributeTable& attrs = feature->getAttrs();
+    for (unsigned s = 0; s < _slots.size(); ++s)
+    {
+        if (!_slots[s]._scriptOnly)
+        {
+            AttributeTable::const_iterator i = attrs.find(_slots[s]._attrName);
+            if (i != attrs.end())
+                _attrs[s] = &i->second;
+        }
+    }
+    return 0L;
+}
+
+ScriptEngine*
+CompiledExpression::getScriptEngine(FilterContext const* context)
+{
+    return context && context->getSession() ? context->getSession()->getScriptEngine() : 0L;
+}
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    template<typename T>
+    std::vector<std::string> getVariableNames(const T& expr)
+    {
+        std::vector<std::string> names;
+        const typename T::Variables& vars = expr.variables();
+        for (typename T::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i)
+            names.push_back(i->first);
+        return names;
+    }
+}
+
+CompiledNumericExpression::CompiledNumericExpression(const NumericExpression& expr, const FeatureSchema& schema) :
+_expr( expr )
+{
+    bind(getVariableNames(expr), schema);
+    _slotValues.resize(_slots.size());
+    _values.resize(_varSlots.size());
+}
+
+double
+CompiledNumericExpression::eval(const Feature* feature, FilterContext const* context)
+{
+    return eval(feature, getScriptEngine(context), context);
+}
+
+void
+CompiledNumericExpression::eval(const FeatureList& features, std::vector<double>& out, FilterContext const* context)
+{
+    ScriptEngine* engine = getScriptEngine(context);
+
+    out.resize(features.size());
+    unsigned n = 0;
+    for (FeatureList::const_iterator i = features.begin(); i != features.end(); ++i, ++n)
+    {
+        out[n] = i->valid() ? eval(i->get(), engine, context) : 0.0;
+    }
+}
+
+double
+CompiledNumericExpression::eval(const Feature* feature, ScriptEngine* engine, FilterContext const* context)
+{
+    if (_slots.empty())
+        return _expr.eval(0L);
+
+    const AttributeColumns* columns = lookup(feature);
+    unsigned row = feature->getAttributeRow();
+
+    for (unsigned s = 0; s < _slots.size(); ++s)
+    {
+        double val = 0.0;
+        if (columns && _slotColumns[s] >= 0)
+        {
+            val = columns->getDouble(row, _slotColumns[s], 0.0);
+        }
+        else if (_attrs[s])
+        {
+            val = _attrs[s]->getDouble(0.0);
+        }
+        else if (engine)
+        {
+            //No attr found, look for script
+            ScriptResult result = engine->run(_slots[s]._name, feature, context);
+            if (result.success())
+                val = result.asDouble();
+            else
+                OE_WARN << LC << "Feature Script error on '" << _expr.expr() << "': " << result.message() << std::endl;
+        }
+        _slotValues[s] = val;
+    }
+
+    for (unsigned v = 0; v < _varSlots.size(); ++v)
+        _values[v] = _slotValues[_varSlots[v]];
+
+    return _expr.eval(&_values[0]);
+}
+
+//------------------------------------------------------------------------
+
+CompiledStringExpression::CompiledStringExpression(const StringExpression& expr, const FeatureSchema& schema) :
+_expr( expr )
+{
+    bind(getVariableNames(expr), schema);
+    _slotValues.resize(_slots.size());
+    _values.resize(_varSlots.size());
+}
+
+const std::string&
+CompiledStringExpression::eval(const Feature* feature, FilterContext const* context)
+{
+    eval(feature, getScriptEngine(context), context, _result);
+    return _result;
+}
+
+void
+CompiledStringExpression::eval(const FeatureList& features, std::vector<std::string>& out, FilterContext const* context)
+{
+    ScriptEngine* engine = getScriptEngine(context);
+
+    out.resize(features.size());
+    unsigned n = 0;
+    for (FeatureList::const_iterator i = features.begin(); i != features.end(); ++i, ++n)
+    {
+        if (i->valid())
+            eval(i->get(), engine, context, out[n]);
+        else
+            out[n].clear();
+    }
+}
+
+void
+CompiledStringExpression::eval(const Feature* feature, ScriptEngine* engine, FilterContext const* context, std::string& out)
+{
+    if (_slots.empty())
+    {
+        out = _expr.eval();
+        return;
+    }
+
+    const AttributeColumns* columns = lookup(feature);
+    unsigned row = feature->getAttributeRow();
+
+    for (unsigned s = 0; s < _slots.size(); ++s)
+    {
+        std::string& val = _slotValues[s];
+        val.clear();
+        if (columns && _slotColumns[s] >= 0)
+        {
+            val = columns->getString(row, _slotColumns[s]);
+        }
+        else if (_attrs[s])
+        {
+            val = _attrs[s]->getString();
+        }
+        else if (engine)
+        {
+            //No attr found, look for script
+            ScriptResult result = engine->run(_slots[s]._name, feature, context);
+            if (result.success())
+                val = result.asString();
+            else
+                OE_WARN << LC << "Feature Script error on '" << _expr.expr() << "': " << result.message() << std::endl;
+        }
+    }
+
+    for (unsigned v = 0; v < _varSlots.size(); ++v)
+        _values[v] = _slotValues[_varSlots[v]];
+
+    _expr.eval(&_values[0], out);
+}
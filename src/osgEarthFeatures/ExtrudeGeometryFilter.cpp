@@ -18,6 +18,8 @@
  */
 #include <osgEarthFeatures/ExtrudeGeometryFilter>
 #include <osgEarthFeatures/Session>
+#include <osgEarthFeatures/CompiledExpression>
+#include <osgEarthFeatures/FeatureSource>
 #include <osgEarthFeatures/FeatureSourceIndexNode>
 #include <osgEarthSymbology/ResourceCache>
 #include <osgEarth/ECEF>
@@ -932,7 +934,26 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
     Random wallSkinPRNG( _wallSkinSymbol.valid()? *_wallSkinSymbol->randomSeed() : 0, Random::METHOD_FAST );
     Random roofSkinPRNG( _roofSkinSymbol.valid()? *_roofSkinSymbol->randomSeed() : 0, Random::METHOD_FAST );
 
-    for( FeatureList::iterator f = features.begin(); f != features.end(); ++f )
+    // evaluate the height expression for all features at once, unless a
+    // symbol script might change the attributes first.
+    std::vector<double> heights;
+    bool batchHeights =
+        _heightExpr.isSet() &&
+        !_heightCallback.valid() &&
+        !_extrusionSymbol->script().isSet();
+
+    if ( batchHeights )
+    {
+        FeatureSchema schema;
+        if ( context.getSession() && context.getSession()->getFeatureSource() )
+            schema = context.getSession()->getFeatureSource()->getSchema();
+
+        CompiledNumericExpression heightExpr( *_heightExpr, schema );
+        heightExpr.eval( features, heights, &context );
+    }
+
+    unsigned index = 0;
+    for( FeatureList::iterator f = features.begin(); f != features.end(); ++f, ++index )
     {
         Feature* input = f->get();
 
@@ -982,6 +1003,10 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
             {
                 height = _heightCallback->operator()(input, context);
             }
+            else if ( batchHeights )
+            {
+                height = heights[index];
+            }
             else if ( _heightExpr.isSet() )
             {
                 height = input->eval( _heightExpr.mutable_value(), &context );
@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarthFeatures/Feature>
+#include <osgEarthFeatures/AttributeColumns>
 #include <osgEarthFeatures/Session>
 #include <osgEarthFeatures/GeometryUtils>
 #include <osgEarth/StringUtils>
@@ -146,7 +147,8 @@ AttributeValue::getBool( bool defaultValue ) const
 
 Feature::Feature( FeatureID fid ) :
 _fid( fid ),
-_srs( 0L )
+_srs( 0L ),
+_row( 0u )
 //_cachedBoundingPolytopeValid( false )
 {
     //NOP
@@ -155,7 +157,8 @@ _srs( 0L )
 Feature::Feature( Geometry* geom, const SpatialReference* srs, const Style& style, FeatureID fid ) :
 _geom ( geom ),
 _srs  ( srs ),
-_fid  ( fid )
+_fid  ( fid ),
+_row  ( 0u )
 {
     if ( !style.empty() )
         _style = style;
@@ -168,7 +171,9 @@ _fid      ( rhs._fid ),
 _attrs    ( rhs._attrs ),
 _style    ( rhs._style ),
 _geoInterp( rhs._geoInterp ),
-_srs      ( rhs._srs.get() )
+_srs      ( rhs._srs.get() ),
+_columns  ( rhs._columns.get() ),
+_row      ( rhs._row )
 {
     if ( rhs._geom.valid() )
         _geom = rhs._geom->clone();
@@ -176,6 +181,11 @@ _srs      ( rhs._srs.get() )
     dirty();
 }
 
+Feature::~Feature()
+{
+    //nop
+}
+
 FeatureID
 Feature::getFID() const 
 {
@@ -202,6 +212,59 @@ Feature::setGeometry( Geometry* geom )
     dirty();
 }
 
+void
+Feature::setAttributeColumns( const AttributeColumns* columns, unsigned row )
+{
+    _attrs.clear();
+    _columns = columns;
+    _row = row;
+}
+
+void
+Feature::detachAttributes()
+{
+    if ( _columns.valid() )
+    {
+        _columns->getRow( _row, _attrs );
+        _columns = 0L;
+        _row = 0u;
+    }
+}
+
+void
+Feature::getAttrs( AttributeTable& out ) const
+{
+    if ( _columns.valid() )
+        _columns->getRow( _row, out );
+    else
+        out = _attrs;
+}
+
+bool
+Feature::getAttr( const std::string& name, AttributeValue& out ) const
+{
+    int c = findColumn(name);
+    if ( c >= 0 )
+    {
+        _columns->getValue( _row, c, out );
+        return true;
+    }
+
+    AttributeTable::const_iterator i = _attrs.find(toLower(name));
+    if ( i != _attrs.end() )
+    {
+        out = i->second;
+        return true;
+    }
+    return false;
+}
+
+int
+Feature::findColumn( const std::string& name ) const
+{
+    return _columns.valid() ? _columns->getColumn(name) : -1;
+}
+
 void
 Feature::dirty()
 {
@@ -213,6 +276,7 @@ Feature::dirty()
 void
 Feature::set( const std::string& name, const std::string& value )
 {
+    detachAttributes();
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_STRING;
     a.second.stringValue = value;
@@ -222,6 +286,7 @@ Feature::set( const std::string& name, const std::string& value )
 void
 Feature::set( const std::string& name, double value )
 {
+    detachAttributes();
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_DOUBLE;
     a.second.doubleValue = value;
@@ -231,6 +296,7 @@ Feature::set( const std::string& name, double value )
 void
 Feature::set( const std::string& name, int value )
 {
+    detachAttributes();
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_INT;
     a.second.intValue = value;
@@ -240,12 +306,14 @@ Feature::set( const std::string& name, int value )
 void
 Feature::set( const std::string& name, const AttributeValue& value)
 {
+    detachAttributes();
     _attrs[ name ] = value;
 }
 
 void
 Feature::set( const std::string& name, bool value )
 {
+    detachAttributes();
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_BOOL;
     a.second.boolValue = value;
@@ -255,6 +323,7 @@ Feature::set( const std::string& name, bool value )
 void
 Feature::setNull( const std::string& name)
 {
+    detachAttributes();
     AttributeValue& a = _attrs[name];    
     a.second.set = false;
 }
@@ -262,6 +331,7 @@ Feature::setNull( const std::string& name)
 void
 Feature::setNull( const std::string& name, AttributeType type)
 {
+    detachAttributes();
     AttributeValue& a = _attrs[name];
     a.first = type;    
     a.second.set = false;
@@ -273,12 +343,18 @@ Feature::setNull( const std::string& name, AttributeType type)
 bool
 Feature::hasAttr( const std::string& name ) const
 {
+    if ( _columns.valid() )
+        return findColumn(name) >= 0;
     return _attrs.find(toLower(name)) != _attrs.end();
 }
 
 std::string
 Feature::getString( const std::string& name ) const
 {
+    int c = findColumn(name);
+    if ( c >= 0 )
+        return _columns->getString(_row, c);
+
     AttributeTable::const_iterator i = _attrs.find(toLower(name));
     return i != _attrs.end()? i->second.getString() : EMPTY_STRING;
 }
@@ -286,6 +362,10 @@ Feature::getString( const std::string& name ) const
 double
 Feature::getDouble( const std::string& name, double defaultValue ) const 
 {
+    int c = findColumn(name);
+    if ( c >= 0 )
+        return _columns->getDouble(_row, c, defaultValue);
+
     AttributeTable::const_iterator i = _attrs.find(toLower(name));
     return i != _attrs.end()? i->second.getDouble(defaultValue) : defaultValue;
 }
@@ -293,6 +373,10 @@ Feature::getDouble( const std::string& name, double defaultValue ) const
 int
 Feature::getInt( const std::string& name, int defaultValue ) const 
 {
+    int c = findColumn(name);
+    if ( c >= 0 )
+        return _columns->getInt(_row, c, defaultValue);
+
     AttributeTable::const_iterator i = _attrs.find(toLower(name));
     return i != _attrs.end()? i->second.getInt(defaultValue) : defaultValue;
 }
@@ -300,6 +384,10 @@ Feature::getInt( const std::string& name, int defaultValue ) const
 bool
 Feature::getBool( const std::string& name, bool defaultValue ) const 
 {
+    int c = findColumn(name);
+    if ( c >= 0 )
+        return _columns->getBool(_row, c, defaultValue);
+
     AttributeTable::const_iterator i = _attrs.find(toLower(name));
     return i != _attrs.end()? i->second.getBool(defaultValue) : defaultValue;
 }
@@ -307,6 +395,10 @@ Feature::getBool( const std::string& name, bool defaultValue ) const
 bool
 Feature::isSet( const std::string& name) const
 {
+    int c = findColumn(name);
+    if ( c >= 0 )
+        return _columns->isSet(_row, c);
+
     AttributeTable::const_iterator i = _attrs.find(toLower(name));
     return i != _attrs.end()? i->second.second.set : false;
 }
@@ -318,8 +410,13 @@ Feature::eval( NumericExpression& expr, FilterContext const* context ) const
     for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
       double val = 0.0;
+      int c = findColumn(i->first);
       AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-      if (ai != _attrs.end())
+      if (c >= 0)
+      {
+        val = _columns->getDouble(_row, c, 0.0);
+      }
+      else if (ai != _attrs.end())
       {
         val = ai->second.getDouble(0.0);
       }
@@ -351,8 +448,13 @@ Feature::eval(NumericExpression& expr, Session* session) const
     for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
         double val = 0.0;
+        int c = findColumn(i->first);
         AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-        if (ai != _attrs.end())
+        if (c >= 0)
+        {
+            val = _columns->getDouble(_row, c, 0.0);
+        }
+        else if (ai != _attrs.end())
         {
             val = ai->second.getDouble(0.0);
         }
@@ -387,8 +489,13 @@ Feature::eval( StringExpression& expr, FilterContext const* context ) const
     for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
       std::string val = "";
+      int c = findColumn(i->first);
       AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-      if (ai != _attrs.end())
+      if (c >= 0)
+      {
+        val = _columns->getString(_row, c);
+      }
+      else if (ai != _attrs.end())
       {
         val = ai->second.getString();
       }
@@ -419,8 +526,13 @@ Feature::eval(StringExpression& expr, Session* session) const
     for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
         std::string val = "";
+        int c = findColumn(i->first);
         AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-        if (ai != _attrs.end())
+        if (c >= 0)
+        {
+            val = _columns->getString(_row, c);
+        }
+        else if (ai != _attrs.end())
         {
             val = ai->second.getString();
         }
@@ -552,10 +664,12 @@ Feature::getGeoJSON() const
 
     //Write out all the properties         
     Json::Value props(Json::objectValue);    
-    if (getAttrs().size() > 0)
+    AttributeTable attrs;
+    getAttrs( attrs );
+    if (attrs.size() > 0)
     {
 
-        for (AttributeTable::const_iterator itr = getAttrs().begin(); itr != getAttrs().end(); ++itr)
+        for (AttributeTable::const_iterator itr = attrs.begin(); itr != attrs.end(); ++itr)
         {
             if (itr->second.first == ATTRTYPE_INT)
             {
@@ -283,6 +283,84 @@ OgrUtils::createFeature(OGRFeatureH handle, const FeatureProfile* profile)
     return f;
 }            
 
+Feature*
+OgrUtils::createFeature(OGRFeatureH handle, const FeatureProfile* profile, AttributeColumns* columns)
+{
+    if ( !columns )
+        return createFeature( handle, profile );
+
+    long fid = OGR_F_GetFID( handle );
+
+    OGRGeometryH geomRef = OGR_F_GetGeometryRef( handle );
+
+    Symbology::Geometry* geom = 0;
+
+    if ( geomRef )
+    {
+        geom = OgrUtils::createGeometry( geomRef );
+    }
+
+    Feature* feature = new Feature( geom, profile ? profile->getSRS() : 0L, Style(), fid );
+    if ( profile && profile->geoInterp().isSet() )
+        feature->geoInterp() = profile->geoInterp().get();
+
+    // the columns follow the field order (see createAttributeColumns), and
+    // take the same values createFeature() puts in the attribute table.
+    unsigned row = columns->addRow();
+
+    int numAttrs = osg::minimum( OGR_F_GetFieldCount(handle), (int)columns->getNumColumns() );
+    for (int i = 0; i < numAttrs; ++i)
+    {
+        if (OGR_F_IsFieldSet( handle, i ))
+        {
+            switch( columns->getColumnType(i) )
+            {
+            case ATTRTYPE_INT:
+                columns->set( row, i, (int)OGR_F_GetFieldAsInteger(handle, i) );
+                break;
+            case ATTRTYPE_DOUBLE:
+                columns->set( row, i, (double)OGR_F_GetFieldAsDouble(handle, i) );
+                break;
+            default:
+                columns->set( row, i, std::string(OGR_F_GetFieldAsString(handle, i)) );
+            }
+        }
+    }
+
+    feature->setAttributeColumns( columns, row );
+
+    return feature;
+}
+
+AttributeColumns*
+OgrUtils::createAttributeColumns(OGRFeatureDefnH layerDef)
+{
+    osg::ref_ptr<AttributeColumns> columns = new AttributeColumns();
+
+    int numFields = OGR_FD_GetFieldCount( layerDef );
+    for (int i = 0; i < numFields; ++i)
+    {
+        OGRFieldDefnH fieldDef = OGR_FD_GetFieldDefn( layerDef, i );
+
+        // same names and types as createFeature() gives the attributes:
+        std::string name = osgEarth::toLower( std::string(OGR_Fld_GetNameRef(fieldDef)) );
+        AttributeType type =
+            OGR_Fld_GetType(fieldDef) == OFTInteger ? ATTRTYPE_INT :
+            OGR_Fld_GetType(fieldDef) == OFTReal    ? ATTRTYPE_DOUBLE :
+            ATTRTYPE_STRING;
+
+        // fields whose names differ only by case share one attribute, so
+        // the columns couldn't follow the field order; leave those layers
+        // to attribute tables.
+        if ( columns->getColumn(name) >= 0 )
+            return 0L;
+
+        columns->addColumn( name, type );
+    }
+
+    return columns.release();
+}
+
 Feature*
 OgrUtils::createFeature( OGRFeatureH handle, const SpatialReference* srs )
 {
@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarthFeatures/ScriptEngine>
+#include <osgEarthFeatures/Feature>
 #include <osgEarth/Notify>
 #include <osgEarth/Registry>
 #include <osgDB/ReadFile>
@@ -26,6 +27,19 @@ using namespace osgEarth::Features;
 
 /****************************************************************/
 
+void
+ScriptEngine::run(const std::string& code, const FeatureList& features, std::vector<ScriptResult>& results, FilterContext const* context)
+{
+    results.clear();
+    results.reserve(features.size());
+    for (FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+    {
+        results.push_back(run(code, i->get(), context));
+    }
+}
+
+/****************************************************************/
+
 void
 ScriptEngineOptions::fromConfig( const Config& conf )
 {
@@ -87,17 +87,26 @@ ScriptFilter::push( FeatureList& input, FilterContext& context )
         return context;
     }
 
-    bool ok = true;
+    // features without geometry never pass:
     for( FeatureList::iterator i = input.begin(); i != input.end(); )
     {
-        if ( push( i->get(), context ) )
-        {
+        if ( i->valid() && i->get()->getGeometry() )
+            ++i;
+        else
+            i = input.erase(i);
+    }
+
+    // run the script over the whole batch, and keep what passes:
+    std::vector<ScriptResult> results;
+    _engine->run( _expression.get(), input, results, &context );
+
+    unsigned n = 0;
+    for( FeatureList::iterator i = input.begin(); i != input.end(); ++n )
+    {
+        if ( n < results.size() && results[n].asBool() )
             ++i;
-        }
         else
-        {
             i = input.erase(i);
-        }
     }
 
     return context;
@@ -30,7 +30,8 @@ using namespace osgEarth::Symbology;
 
 NumericExpression::NumericExpression() :
 _value(0.0),
-_dirty(true)
+_dirty(true),
+_stackSize(0u)
 {
     //nop
 }
@@ -38,7 +39,8 @@ _dirty(true)
 NumericExpression::NumericExpression( const std::string& expr ) : 
 _src  ( expr ),
 _value( 0.0 ),
-_dirty( true )
+_dirty( true ),
+_stackSize( 0u )
 {
     init();
 }
@@ -48,14 +50,17 @@ _src  ( rhs._src ),
 _rpn  ( rhs._rpn ),
 _vars ( rhs._vars ),
 _value( rhs._value ),
-_dirty( rhs._dirty )
+_dirty( rhs._dirty ),
+_program  ( rhs._program ),
+_stackSize( rhs._stackSize )
 {
     //nop
 }
 
 NumericExpression::NumericExpression( double staticValue ) :
 _value( staticValue ),
-_dirty( false )
+_dirty( false ),
+_stackSize( 0u )
 {
     _src = Stringify() << staticValue;
     init();
@@ -63,7 +68,8 @@ _dirty( false )
 
 NumericExpression::NumericExpression( const Config& conf ) :
 _value( 0.0 ),
-_dirty( true )
+_dirty( true ),
+_stackSize( 0u )
 {
     mergeConfig( conf );
     init();
@@ -264,6 +270,52 @@ NumericExpression::init()
         _rpn.push_back( s.top() );
         s.pop();
     }
+
+    compile();
+}
+
+void
+NumericExpression::compile()
+{
+    _program.clear();
+    _stackSize = 0u;
+
+    // which variable (if any) each RPN atom holds:
+    std::vector<int> varAt( _rpn.size(), -1 );
+    for( unsigned v=0; v<_vars.size(); ++v )
+        varAt[_vars[v].second] = v;
+
+    // The stack depth at each step doesn't depend on the values, so we can
+    // find the operators that eval() would skip for lack of operands.
+    unsigned depth = 0u;
+    for( unsigned i=0; i<_rpn.size(); ++i )
+    {
+        const Atom& a = _rpn[i];
+
+        Instruction inst;
+        inst._op = a.first;
+        inst._value = a.second;
+        inst._var = 0u;
+
+        if ( IS_OPERATOR(a) || a.first == MIN || a.first == MAX )
+        {
+            if ( depth < 2u )
+                continue;
+            --depth;
+        }
+        else
+        {
+            // anything else pushes its value, like eval() does:
+            if ( a.first == VARIABLE && varAt[i] >= 0 )
+                inst._var = varAt[i];
+            else
+                inst._op = OPERAND;
+
+            _stackSize = std::max( _stackSize, ++depth );
+        }
+
+        _program.push_back( inst );
+    }
 }
 
 void 
@@ -364,6 +416,47 @@ NumericExpression::eval() const
     return !osg::isNaN( _value ) ? _value : 0.0;
 }
 
+double
+NumericExpression::eval( const double* values ) const
+{
+    // literals don't have a usable program (see setLiteral), and without
+    // variables there's nothing to substitute anyway.
+    if ( _vars.empty() )
+        return eval();
+
+    double fixedStack[16];
+    std::vector<double> dynamicStack;
+    double* s = fixedStack;
+    if ( _stackSize > 16u )
+    {
+        dynamicStack.resize( _stackSize );
+        s = &dynamicStack.front();
+    }
+
+    // "n" counts the values on the stack; compile() made sure that each
+    // operator has two.
+    unsigned n = 0u;
+    for( Program::const_iterator i = _program.begin(); i != _program.end(); ++i )
+    {
+        switch( i->_op )
+        {
+        case OPERAND:  s[n++] = i->_value; break;
+        case VARIABLE: s[n++] = values[i->_var]; break;
+        case ADD:  --n; s[n-1] = s[n-1] + s[n]; break;
+        case SUB:  --n; s[n-1] = s[n-1] - s[n]; break;
+        case MULT: --n; s[n-1] = s[n-1] * s[n]; break;
+        case DIV:  --n; s[n-1] = s[n-1] / s[n]; break;
+        case MOD:  --n; s[n-1] = fmod(s[n-1], s[n]); break;
+        case MIN:  --n; s[n-1] = std::min(s[n-1], s[n]); break;
+        case MAX:  --n; s[n-1] = std::max(s[n-1], s[n]); break;
+        default: break;
+        }
+    }
+
+    double value = n > 0u ? s[n-1] : 0.0;
+    return !osg::isNaN( value ) ? value : 0.0;
+}
+
 //------------------------------------------------------------------------
 
 StringExpression::StringExpression() :
@@ -413,6 +506,11 @@ StringExpression::setLiteral( const std::string& expr )
     _src = "\"" + expr + "\"";
     _value = expr;
     _dirty = false;
+
+    // drop any variables, so setting them can't bring the old expression back
+    _vars.clear();
+    _infix.clear();
+    _infix.push_back( Atom(OPERAND, expr) );
 }
 
 StringExpression::StringExpression( const Config& conf )
@@ -561,6 +659,27 @@ StringExpression::eval() const
     return _value;
 }
 
+void
+StringExpression::eval( const std::string* values, std::string& out ) const
+{
+    // without variables (a literal, for one) there's nothing to substitute.
+    if ( _vars.empty() )
+    {
+        out = eval();
+        return;
+    }
+
+    out.clear();
+    unsigned v = 0;
+    for( unsigned i=0; i<_infix.size(); ++i )
+    {
+        if ( v < _vars.size() && _vars[v].second == i )
+            out += values[v++];
+        else
+            out += _infix[i].second;
+    }
+}
+
 URI
 StringExpression::evalURI() const
 {
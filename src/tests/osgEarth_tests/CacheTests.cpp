@@ -0,0 +1,548 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/CacheBin>
+#include <osgEarth/WriteBehindCacheBin>
+#include <osgEarth/MemCache>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarth/FileUtils>
+#include <osgEarth/StringUtils>
+#include <osgEarthDrivers/cache_filesystem/FileSystemCache>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <osg/Image>
+#include <map>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <utime.h>
+#endif
+
+using namespace osgEarth;
+
+namespace CacheTests
+{
+    /**
+     * In-memory bin whose writes wait until the gate is open, so tests can
+     * hold the write-behind thread in the middle of a write.
+     */
+    class GatedBin : public CacheBin
+    {
+    public:
+        GatedBin() : CacheBin("gated"), _writes(0u) { _gate.set(); }
+
+        ReadResult read(const std::string& key)
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            Records::iterator i = _records.find(key);
+            if (i == _records.end())
+                return ReadResult();
+            return ReadResult(const_cast<osg::Object*>(i->second.get()));
+        }
+
+        ReadResult readObject(const std::string& key, const osgDB::Options*) { return read(key); }
+        ReadResult readImage(const std::string& key, const osgDB::Options*)  { return read(key); }
+        ReadResult readString(const std::string& key, const osgDB::Options*) { return read(key); }
+
+        bool write(const std::string& key, const osg::Object* object, const Config&, const osgDB::Options*)
+        {
+            _entered.set();
+            _gate.wait();
+            Threading::ScopedMutexLock lock(_mutex);
+            _records[key] = object;
+            ++_writes;
+            return true;
+        }
+
+        RecordStatus getRecordStatus(const std::string& key)
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            return _records.find(key) != _records.end() ? STATUS_OK : STATUS_NOT_FOUND;
+        }
+
+        bool remove(const std::string& key)
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            return _records.erase(key) > 0u;
+        }
+
+        bool touch(const std::string& key) { return getRecordStatus(key) == STATUS_OK; }
+
+        std::string getHashedKey(const std::string& key) const { return key; }
+
+        typedef std::map<std::string, osg::ref_ptr<const osg::Object> > Records;
+        Records          _records;
+        unsigned         _writes;
+        Threading::Mutex _mutex;
+        Threading::Event _gate;     // writes wait for this
+        Threading::Event _entered;  // set when a write starts
+    };
+
+    // Opens the gate on the way out, so a failed test can't leave the
+    // write thread parked while the bin waits for it.
+    struct OpenGate
+    {
+        OpenGate(GatedBin* bin) : _bin(bin) { }
+        ~OpenGate() { _bin->_gate.set(); }
+        GatedBin* _bin;
+    };
+
+    // Closes the gate and parks the write thread in a write of "busy".
+    void holdWriter(GatedBin* bin, WriteBehindCacheBin* wb)
+    {
+        bin->_gate.reset();
+        bin->_entered.reset();
+        wb->write("busy", new StringObject("busy"), 0L);
+        bin->_entered.wait();
+    }
+}
+
+TEST_CASE( "WriteBehindCacheBin queues writes" ) {
+
+    osg::ref_ptr<CacheTests::GatedBin> bin = new CacheTests::GatedBin();
+    osg::ref_ptr<WriteBehindCacheBin> wb = new WriteBehindCacheBin(bin.get(), 2u);
+    CacheTests::OpenGate openGate(bin.get());
+
+    CacheTests::holdWriter(bin.get(), wb.get());
+
+    SECTION("Reads see queued records and the record being written") {
+        REQUIRE(wb->write("a", new StringObject("1"), 0L));
+        REQUIRE(bin->getRecordStatus("a") == CacheBin::STATUS_NOT_FOUND);
+        REQUIRE(wb->getRecordStatus("a") == CacheBin::STATUS_OK);
+        REQUIRE(wb->readString("a", 0L).getString() == "1");
+        REQUIRE(wb->readString("busy", 0L).getString() == "busy");
+
+        bin->_gate.set();
+        wb->flush();
+        REQUIRE(wb->getQueueSize() == 0u);
+        REQUIRE(bin->readString("a", 0L).getString() == "1");
+        REQUIRE(bin->_writes == 2u);
+    }
+
+    SECTION("Writes to a queued key are coalesced") {
+        REQUIRE(wb->write("a", new StringObject("1"), 0L));
+        REQUIRE(wb->write("a", new StringObject("2"), 0L));
+        REQUIRE(wb->getNumCoalesced() == 1u);
+        REQUIRE(wb->getQueueSize() == 1u);
+        REQUIRE(wb->readString("a", 0L).getString() == "2");
+
+        bin->_gate.set();
+        wb->flush();
+        REQUIRE(bin->readString("a", 0L).getString() == "2");
+        REQUIRE(bin->_writes == 2u);
+    }
+
+    SECTION("Writes to a full queue are dropped") {
+        REQUIRE(wb->write("a", new StringObject("1"), 0L));
+        REQUIRE(wb->write("b", new StringObject("2"), 0L));
+        osg::ref_ptr<StringObject> c = new StringObject("3");
+        REQUIRE(!wb->write("c", c.get(), 0L));
+        REQUIRE(wb->getNumDropped() == 1u);
+
+        bin->_gate.set();
+        wb->flush();
+        REQUIRE(bin->getRecordStatus("b") == CacheBin::STATUS_OK);
+        REQUIRE(bin->getRecordStatus("c") == CacheBin::STATUS_NOT_FOUND);
+    }
+
+    SECTION("Removing a queued record cancels its write") {
+        REQUIRE(wb->write("a", new StringObject("1"), 0L));
+        wb->remove("a");
+        REQUIRE(wb->getRecordStatus("a") == CacheBin::STATUS_NOT_FOUND);
+
+        bin->_gate.set();
+        wb->flush();
+        REQUIRE(bin->getRecordStatus("a") == CacheBin::STATUS_NOT_FOUND);
+    }
+
+    SECTION("Queued images are copies") {
+        osg::ref_ptr<osg::Image> image = new osg::Image();
+        image->allocateImage(1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        image->data()[0] = 1;
+        REQUIRE(wb->write("image", image.get(), 0L));
+
+        // the caller keeps using its image:
+        image->data()[0] = 2;
+
+        osg::ref_ptr<osg::Image> queued = wb->readImage("image", 0L).getImage();
+        REQUIRE(queued.valid());
+        REQUIRE(queued->data()[0] == 1);
+
+        bin->_gate.set();
+        wb->flush();
+    }
+
+    SECTION("Destroying the bin writes out the queue") {
+        REQUIRE(wb->write("a", new StringObject("1"), 0L));
+        REQUIRE(wb->write("b", new StringObject("2"), 0L));
+
+        bin->_gate.set();
+        wb = 0L;
+        REQUIRE(bin->getRecordStatus("a") == CacheBin::STATUS_OK);
+        REQUIRE(bin->getRecordStatus("b") == CacheBin::STATUS_OK);
+    }
+}
+
+TEST_CASE( "MemCache bins keep to their limits" ) {
+
+    SECTION("A bin holds at most maxBinSize records, across all its shards") {
+        unsigned sizes[3] = { 1u, 3u, 16u };
+        for (unsigned s = 0; s < 3; ++s)
+        {
+            osg::ref_ptr<MemCache> cache = new MemCache(sizes[s]);
+            CacheBin* bin = cache->addBin("test");
+            for (unsigned i = 0; i < 100u; ++i)
+            {
+                REQUIRE(bin->write(Stringify() << "key" << i, new StringObject("value"), 0L));
+                REQUIRE(cache->getStats("test")._entries <= sizes[s]);
+            }
+            REQUIRE(cache->getStats("test")._entries == sizes[s]);
+
+            // the last record written is always kept
+            REQUIRE(bin->readString("key99", 0L).getString() == "value");
+        }
+    }
+
+    SECTION("Removing a bin releases its memory") {
+        osg::ref_ptr<MemCache> cache = new MemCache(16u, 1000000u);
+        osg::ref_ptr<CacheBin> a = cache->addBin("a");
+        CacheBin* b = cache->addBin("b");
+        REQUIRE(a->write("key", new StringObject("a"), 0L));
+        REQUIRE(b->write("key", new StringObject("b"), 0L));
+        unsigned bothBytes = cache->getNumBytes();
+
+        cache->removeBin(a.get());
+        REQUIRE(cache->getBin("a") == 0L);
+        REQUIRE(cache->getNumBytes() < bothBytes);
+        REQUIRE(cache->getStats()._entries == 1u);
+        REQUIRE(b->readString("key", 0L).getString() == "b");
+    }
+}
+
+#ifndef _WIN32
+
+namespace CacheTests
+{
+    // Opens a filesystem cache that stores its bins in the pack format.
+    Cache* openPackCache(const std::string& path)
+    {
+        osgEarth::Drivers::FileSystemCacheOptions options;
+        options.rootPath() = path;
+        options.format() = "pack";
+        return CacheFactory::create(options);
+    }
+
+    std::string readString(CacheBin* bin, const std::string& key)
+    {
+        ReadResult r = bin->readString(key, 0L);
+        return r.succeeded() ? r.getString() : std::string("(not found)");
+    }
+
+    // Opens a filesystem cache that stores its bins one file per record,
+    // sharing the files of identical records if "dedup" is set.
+    Cache* openFilesCache(const std::string& path, bool dedup)
+    {
+        osgEarth::Drivers::FileSystemCacheOptions options;
+        options.rootPath() = path;
+        options.deduplicate() = dedup;
+        return CacheFactory::create(options);
+    }
+
+    // The file holding a record in a bin that doesn't hash its keys.
+    std::string recordPath(const std::string& root, const std::string& key)
+    {
+        return osgDB::concatPaths(osgDB::concatPaths(root, "test"), key + ".osgb");
+    }
+
+    ino_t inodeOf(const std::string& path)
+    {
+        struct stat info;
+        return ::stat(path.c_str(), &info) == 0 ? info.st_ino : 0;
+    }
+
+    // Sets a file's modification time the given number of seconds back.
+    void age(const std::string& path, TimeSpan seconds)
+    {
+        struct utimbuf times;
+        times.actime = times.modtime = DateTime().asTimeStamp() - seconds;
+        ::utime(path.c_str(), &times);
+    }
+
+    // Number of shared files in a bin.
+    unsigned countBlobs(const std::string& root)
+    {
+        unsigned count = 0u;
+        std::string blobs = osgDB::concatPaths(osgDB::concatPaths(root, "test"), "blobs");
+        osgDB::DirectoryContents buckets = osgDB::getDirectoryContents(blobs);
+        for (unsigned b = 0; b < buckets.size(); ++b)
+        {
+            if (buckets[b] == "." || buckets[b] == "..")
+                continue;
+            osgDB::DirectoryContents files = osgDB::getDirectoryContents(osgDB::concatPaths(blobs, buckets[b]));
+            for (unsigned f = 0; f < files.size(); ++f)
+                if (osgEarth::endsWith(files[f], ".osgb"))
+                    ++count;
+        }
+        return count;
+    }
+}
+
+TEST_CASE( "Pack cache bins store records" ) {
+
+    std::string path = osgEarth::getTempName(osgDB::concatPaths(osgEarth::getTempPath(), "osgearth_pack_test"));
+
+    osg::ref_ptr<Cache> cache = CacheTests::openPackCache(path);
+    REQUIRE(cache.valid());
+    REQUIRE(cache->isOK());
+
+    osg::ref_ptr<CacheBin> bin = cache->addBin("test");
+    REQUIRE(bin.valid());
+
+    SECTION("Records read back with their metadata") {
+        Config meta;
+        meta.set("color", "red");
+        REQUIRE(bin->write("a", new StringObject("1"), meta, 0L));
+
+        ReadResult r = bin->readString("a", 0L);
+        REQUIRE(r.succeeded());
+        REQUIRE(r.getString() == "1");
+        REQUIRE(r.metadata().value("color") == "red");
+        REQUIRE(r.lastModifiedTime() > 0);
+
+        REQUIRE(bin->getRecordStatus("a") == CacheBin::STATUS_OK);
+        REQUIRE(bin->getRecordStatus("b") == CacheBin::STATUS_NOT_FOUND);
+        REQUIRE(!bin->readString("b", 0L).succeeded());
+        REQUIRE(bin->touch("a"));
+        REQUIRE(!bin->touch("b"));
+    }
+
+    SECTION("Overwriting a record replaces it") {
+        REQUIRE(bin->write("a", new StringObject("1"), 0L));
+        REQUIRE(bin->write("a", new StringObject("2"), 0L));
+        REQUIRE(CacheTests::readString(bin.get(), "a") == "2");
+    }
+
+    SECTION("Removed records are gone and can be written again") {
+        REQUIRE(bin->write("a", new StringObject("1"), 0L));
+        REQUIRE(bin->write("b", new StringObject("2"), 0L));
+        REQUIRE(bin->remove("a"));
+        REQUIRE(!bin->remove("a"));
+        REQUIRE(bin->getRecordStatus("a") == CacheBin::STATUS_NOT_FOUND);
+        REQUIRE(CacheTests::readString(bin.get(), "b") == "2");
+
+        REQUIRE(bin->write("a", new StringObject("3"), 0L));
+        REQUIRE(CacheTests::readString(bin.get(), "a") == "3");
+    }
+
+    SECTION("The index grows past its initial capacity") {
+        // The index starts with 65536 slots and is rebuilt once 70% of
+        // them are taken; removed slots count toward that load.
+        const unsigned count = 46000u;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            std::string key = Stringify() << "key" << i;
+            REQUIRE(bin->write(key, new StringObject(key), 0L));
+            if (i % 1000u == 0u)
+                REQUIRE(bin->remove(key));
+        }
+
+        unsigned mismatches = 0u;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            std::string key = Stringify() << "key" << i;
+            std::string expected = i % 1000u == 0u ? std::string("(not found)") : key;
+            if (CacheTests::readString(bin.get(), key) != expected)
+                ++mismatches;
+        }
+        REQUIRE(mismatches == 0u);
+    }
+
+    SECTION("Compacting keeps the live records") {
+        for (unsigned i = 0; i < 10u; ++i)
+            REQUIRE(bin->write("a", new StringObject(Stringify() << i), 0L));
+        REQUIRE(bin->write("b", new StringObject("b"), 0L));
+        REQUIRE(bin->remove("b"));
+        REQUIRE(bin->write("last", new StringObject("last"), 0L));
+
+        unsigned size = bin->getStorageSize();
+        REQUIRE(bin->compact());
+        REQUIRE(bin->getStorageSize() < size);
+
+        REQUIRE(CacheTests::readString(bin.get(), "a") == "9");
+        REQUIRE(bin->getRecordStatus("b") == CacheBin::STATUS_NOT_FOUND);
+        REQUIRE(CacheTests::readString(bin.get(), "last") == "last");
+
+        // the new generation takes writes:
+        REQUIRE(bin->write("c", new StringObject("c"), 0L));
+        REQUIRE(CacheTests::readString(bin.get(), "c") == "c");
+
+        // and is what a reopened bin sees:
+        bin = 0L;
+        cache = 0L;
+        cache = CacheTests::openPackCache(path);
+        bin = cache->addBin("test");
+
+        REQUIRE(CacheTests::readString(bin.get(), "a") == "9");
+        REQUIRE(bin->getRecordStatus("b") == CacheBin::STATUS_NOT_FOUND);
+        REQUIRE(CacheTests::readString(bin.get(), "last") == "last");
+        REQUIRE(CacheTests::readString(bin.get(), "c") == "c");
+    }
+
+    SECTION("Records survive closing and reopening the bin") {
+        REQUIRE(bin->write("a", new StringObject("1"), 0L));
+        REQUIRE(bin->write("b", new StringObject("2"), 0L));
+        REQUIRE(bin->remove("b"));
+
+        bin = 0L;
+        cache = 0L;
+        cache = CacheTests::openPackCache(path);
+        bin = cache->addBin("test");
+
+        REQUIRE(CacheTests::readString(bin.get(), "a") == "1");
+        REQUIRE(bin->getRecordStatus("b") == CacheBin::STATUS_NOT_FOUND);
+
+        REQUIRE(bin->write("c", new StringObject("3"), 0L));
+        REQUIRE(CacheTests::readString(bin.get(), "c") == "3");
+    }
+
+    bin->clear();
+}
+
+TEST_CASE( "Deduplicating cache bins share identical records" ) {
+
+    std::string path = osgEarth::getTempName(osgDB::concatPaths(osgEarth::getTempPath(), "osgearth_dedup_test"));
+
+    osg::ref_ptr<Cache> cache = CacheTests::openFilesCache(path, true);
+    REQUIRE(cache.valid());
+    REQUIRE(cache->isOK());
+
+    osg::ref_ptr<CacheBin> bin = cache->addBin("test");
+    REQUIRE(bin.valid());
+    bin->setHashKeys(false);
+
+    std::string a = CacheTests::recordPath(path, "a");
+    std::string b = CacheTests::recordPath(path, "b");
+
+    // an hour old counts as expired
+    CachePolicy policy;
+    policy.maxAge() = 3600;
+
+    SECTION("Identical writes share one file") {
+        REQUIRE(bin->write("a", new StringObject("blank"), 0L));
+        REQUIRE(bin->write("b", new StringObject("blank"), 0L));
+        REQUIRE(bin->write("c", new StringObject("other"), 0L));
+
+        REQUIRE(CacheTests::inodeOf(a) != 0);
+        REQUIRE(CacheTests::inodeOf(a) == CacheTests::inodeOf(b));
+        REQUIRE(CacheTests::inodeOf(a) != CacheTests::inodeOf(CacheTests::recordPath(path, "c")));
+        REQUIRE(CacheTests::countBlobs(path) == 2u);
+
+        REQUIRE(CacheTests::readString(bin.get(), "a") == "blank");
+        REQUIRE(CacheTests::readString(bin.get(), "b") == "blank");
+        REQUIRE(CacheTests::readString(bin.get(), "c") == "other");
+    }
+
+    SECTION("Overwriting one linked record leaves the other intact") {
+        REQUIRE(bin->write("a", new StringObject("blank"), 0L));
+        REQUIRE(bin->write("b", new StringObject("blank"), 0L));
+        TimeStamp bTime = bin->readString("b", 0L).lastModifiedTime();
+
+        // make the shared file look old, so a record that reported its
+        // time would show it
+        CacheTests::age(b, 7200);
+
+        REQUIRE(bin->write("a", new StringObject("changed"), 0L));
+        REQUIRE(CacheTests::inodeOf(a) != CacheTests::inodeOf(b));
+        REQUIRE(CacheTests::readString(bin.get(), "a") == "changed");
+
+        ReadResult r = bin->readString("b", 0L);
+        REQUIRE(r.succeeded());
+        REQUIRE(r.getString() == "blank");
+        REQUIRE(r.lastModifiedTime() == bTime);
+    }
+
+    SECTION("Compacting links duplicates and removes unused files") {
+        // records written without deduplication, one an expired copy of another
+        osg::ref_ptr<Cache> plainCache = CacheTests::openFilesCache(path, false);
+        osg::ref_ptr<CacheBin> plainBin = plainCache->addBin("test");
+        plainBin->setHashKeys(false);
+        REQUIRE(plainBin->write("a", new StringObject("blank"), 0L));
+        REQUIRE(plainBin->write("b", new StringObject("blank"), 0L));
+        REQUIRE(plainBin->write("c", new StringObject("other"), 0L));
+        CacheTests::age(a, 7200);
+        REQUIRE(CacheTests::inodeOf(a) != CacheTests::inodeOf(b));
+
+        REQUIRE(bin->compact());
+        REQUIRE(CacheTests::inodeOf(a) == CacheTests::inodeOf(b));
+        REQUIRE(CacheTests::countBlobs(path) == 2u);
+        REQUIRE(CacheTests::readString(bin.get(), "a") == "blank");
+        REQUIRE(CacheTests::readString(bin.get(), "b") == "blank");
+        REQUIRE(CacheTests::readString(bin.get(), "c") == "other");
+
+        // each record keeps the time it was written
+        REQUIRE(policy.isExpired(bin->readString("a", 0L).lastModifiedTime()));
+        REQUIRE(!policy.isExpired(bin->readString("b", 0L).lastModifiedTime()));
+
+        // once no record uses a shared file, compacting removes it
+        REQUIRE(bin->remove("c"));
+        REQUIRE(bin->write("a", new StringObject("changed"), 0L));
+        REQUIRE(bin->write("b", new StringObject("changed"), 0L));
+        REQUIRE(CacheTests::countBlobs(path) == 3u);
+
+        REQUIRE(bin->compact());
+        REQUIRE(CacheTests::countBlobs(path) == 1u);
+        REQUIRE(CacheTests::inodeOf(a) == CacheTests::inodeOf(b));
+        REQUIRE(CacheTests::readString(bin.get(), "a") == "changed");
+        REQUIRE(CacheTests::readString(bin.get(), "b") == "changed");
+    }
+
+    SECTION("Touched and expired records report their own time") {
+        osg::ref_ptr<Cache> plainCache = CacheTests::openFilesCache(path, false);
+        osg::ref_ptr<CacheBin> plainBin = plainCache->addBin("test");
+        plainBin->setHashKeys(false);
+        REQUIRE(plainBin->write("a", new StringObject("blank"), 0L));
+        REQUIRE(plainBin->write("b", new StringObject("blank"), 0L));
+        CacheTests::age(a, 7200);
+        CacheTests::age(b, 7200);
+        REQUIRE(bin->compact());
+        REQUIRE(CacheTests::inodeOf(a) == CacheTests::inodeOf(b));
+
+        // the shared file looks fresh, but both records are expired
+        REQUIRE(osgEarth::touchFile(a));
+        REQUIRE(!policy.isExpired(osgEarth::getLastModifiedTime(a)));
+        REQUIRE(policy.isExpired(bin->readString("a", 0L).lastModifiedTime()));
+        REQUIRE(policy.isExpired(bin->readString("b", 0L).lastModifiedTime()));
+
+        // touching one record renews it alone
+        CacheTests::age(a, 7200);
+        REQUIRE(bin->touch("a"));
+        REQUIRE(!policy.isExpired(bin->readString("a", 0L).lastModifiedTime()));
+        REQUIRE(policy.isExpired(bin->readString("b", 0L).lastModifiedTime()));
+        REQUIRE(policy.isExpired(osgEarth::getLastModifiedTime(b)));
+    }
+
+    bin->clear();
+}
+
+#endif // _WIN32
@@ -0,0 +1,142 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/TileSource>
+#include <osgEarth/Registry>
+#include <osgEarth/Random>
+
+using namespace osgEarth;
+
+namespace ElevationLayerTests
+{
+    const float UNSET = -1234.0f;
+
+    /**
+     * Random heightfields with NO_DATA posts scattered through them. Each key
+     * seeds its own generator, so a key reads the same data every time.
+     */
+    class RandomHeights : public TileSource
+    {
+    public:
+        RandomHeights() : TileSource(TileSourceOptions()) { }
+
+        Status initialize(const osgDB::Options*)
+        {
+            setProfile(Registry::instance()->getGlobalGeodeticProfile());
+            return STATUS_OK;
+        }
+
+        osg::HeightField* createHeightField(const TileKey& key, ProgressCallback*)
+        {
+            Random prng(key.getLOD()*1000003u + key.getTileY()*1009u + key.getTileX());
+            osg::HeightField* hf = new osg::HeightField();
+            hf->allocate(17, 17);
+            for (unsigned i = 0; i < hf->getFloatArray()->size(); ++i)
+                (*hf->getFloatArray())[i] = prng.next(10u) == 0u ? NO_DATA_VALUE : (float)(prng.next() * 1000.0);
+            return hf;
+        }
+    };
+
+    // Samples the tile's grid one point at a time, the way
+    // populateHeightFieldAndNormalMap used to.
+    void samplePerPoint(const GeoHeightField& layerHF, const TileKey& key, ElevationInterpolation interp,
+                        unsigned numColumns, unsigned numRows, std::vector<float>& out)
+    {
+        const SpatialReference* srs = key.getProfile()->getSRS();
+        double dx = key.getExtent().width() / (double)(numColumns-1);
+        double dy = key.getExtent().height() / (double)(numRows-1);
+
+        out.assign(numColumns*numRows, UNSET);
+        for (unsigned r = 0; r < numRows; ++r)
+        {
+            for (unsigned c = 0; c < numColumns; ++c)
+            {
+                double x = key.getExtent().xMin() + dx*(double)c;
+                double y = key.getExtent().yMin() + dy*(double)r;
+                float elevation;
+                if (layerHF.getElevation(srs, x, y, interp, srs, elevation) && elevation != NO_DATA_VALUE)
+                    out[r*numColumns + c] = elevation;
+            }
+        }
+    }
+}
+
+// The region sampler must give exactly what per-point sampling gives,
+// including next to NO_DATA posts and on the clamped edges of the tile.
+TEST_CASE( "Region sampling matches per-point sampling" ) {
+
+    osg::ref_ptr<TileSource> source = new ElevationLayerTests::RandomHeights();
+    REQUIRE(source->open().isOK());
+
+    ElevationLayerOptions layerOptions("random");
+    layerOptions.cachePolicy() = CachePolicy::NO_CACHE;
+    osg::ref_ptr<ElevationLayer> layer = new ElevationLayer(layerOptions, source.get());
+    REQUIRE(layer->open().isOK());
+
+    ElevationLayerVector layers;
+    layers.push_back(layer.get());
+
+    ElevationInterpolation modes[3] = { INTERP_NEAREST, INTERP_AVERAGE, INTERP_BILINEAR };
+
+    // grids that line up with the layer's posts, and grids that don't
+    unsigned sizes[3] = { 17u, 15u, 9u };
+
+    Random prng(42u);
+    const Profile* profile = layer->getProfile();
+
+    for (unsigned k = 0; k < 20; ++k)
+    {
+        unsigned lod = 3u + prng.next(6u);
+        unsigned wide, high;
+        profile->getNumTiles(lod, wide, high);
+        TileKey key(lod, prng.next(wide), prng.next(high), profile);
+
+        GeoHeightField layerHF = layer->createHeightField(key, 0L);
+        REQUIRE(layerHF.valid());
+
+        for (unsigned m = 0; m < 3; ++m)
+        {
+            for (unsigned s = 0; s < 3; ++s)
+            {
+                osg::ref_ptr<osg::HeightField> hf = new osg::HeightField();
+                hf->allocate(sizes[s], sizes[s]);
+                hf->getFloatArray()->assign(sizes[s]*sizes[s], ElevationLayerTests::UNSET);
+
+                REQUIRE(layers.populateHeightFieldAndNormalMap(hf.get(), 0L, key, 0L, modes[m], 0L));
+
+                std::vector<float> expected;
+                ElevationLayerTests::samplePerPoint(layerHF, key, modes[m], sizes[s], sizes[s], expected);
+
+                unsigned mismatches = 0u;
+                for (unsigned i = 0; i < expected.size(); ++i)
+                {
+                    if ((*hf->getFloatArray())[i] != expected[i])
+                        ++mismatches;
+                }
+                REQUIRE(mismatches == 0u);
+            }
+        }
+    }
+}
@@ -0,0 +1,362 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/Map>
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/ElevationPool>
+#include <osgEarth/TileSource>
+#include <osgEarth/Registry>
+#include <OpenThreads/Thread>
+
+#include <osgEarthDrivers/gdal/GDALOptions>
+
+#include <vector>
+#include <float.h>
+#include <math.h>
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+
+namespace ElevationPoolTests
+{
+    Map* createMap()
+    {
+        GDALOptions gdal;
+        gdal.url() = "../data/terrain/mt_rainier_90m.tif";
+        ElevationLayerOptions layerOptions("rainier", gdal);
+        layerOptions.cachePolicy() = CachePolicy::NO_CACHE;
+
+        Map* map = new Map();
+        map->addLayer(new ElevationLayer(layerOptions));
+        return map;
+    }
+
+    // A grid of points over the dataset and a bit past its edges, so that
+    // some of them have no data.
+    void createGrid(const SpatialReference* srs, std::vector<GeoPoint>& points)
+    {
+        const SpatialReference* geoSRS = srs->getGeographicSRS();
+        for (unsigned r = 0; r < 25; ++r)
+        {
+            for (unsigned c = 0; c < 25; ++c)
+            {
+                GeoPoint p(geoSRS, -122.1 + 0.05*(double)c, 45.9 + 0.05*(double)r, 0.0, ALTMODE_ABSOLUTE);
+                points.push_back(p.transform(srs));
+            }
+        }
+    }
+
+    /**
+     * Flat heightfields that wait until the gate is open, so tests can hold
+     * the pool's query threads in the middle of a tile load.
+     */
+    class GatedHeights : public TileSource
+    {
+    public:
+        GatedHeights() : TileSource(TileSourceOptions()) { _gate.set(); }
+
+        Status initialize(const osgDB::Options*)
+        {
+            setProfile(Registry::instance()->getGlobalGeodeticProfile());
+            return STATUS_OK;
+        }
+
+        osg::HeightField* createHeightField(const TileKey& key, ProgressCallback*)
+        {
+            ++_entered;
+            _gate.wait();
+            osg::HeightField* hf = new osg::HeightField();
+            hf->allocate(17, 17);
+            hf->getFloatArray()->assign(17*17, 100.0f);
+            return hf;
+        }
+
+        Threading::Event    _gate;     // loads wait for this
+        OpenThreads::Atomic _entered;  // loads started
+    };
+
+    // Changes the pool's thread count from another thread, since the call
+    // waits for the queries the gate is holding.
+    class SetNumThreads : public OpenThreads::Thread
+    {
+    public:
+        SetNumThreads(ElevationPool* pool, unsigned num) : _pool(pool), _num(num) { }
+        void run() { _pool->setNumThreads(_num); }
+        ElevationPool* _pool;
+        unsigned       _num;
+    };
+
+    // Each query uses a new envelope, so that it goes to the pool's cache
+    // instead of the envelope's own tiles.
+    float query(ElevationPool* pool, const SpatialReference* srs, double lon, double lat)
+    {
+        osg::ref_ptr<ElevationEnvelope> envelope = pool->createEnvelope(srs, 10u);
+        return envelope->getElevation(lon, lat);
+    }
+}
+
+TEST_CASE( "ElevationPool caches tiles within its budget" ) {
+
+    osg::ref_ptr<Map> map = ElevationPoolTests::createMap();
+
+    ElevationPool* pool = map->getElevationPool();
+    pool->setTileSize(17u);
+    pool->setMaxEntries(4u);
+    pool->resetStats();
+
+    const SpatialReference* srs = map->getProfile()->getSRS();
+
+    // Points in six different LOD 10 tiles of the dataset
+    double lon[6] = { -121.9, -121.5, -121.1, -121.9, -121.5, -121.1 };
+    double lat[6] = {   46.2,   46.2,   46.2,   46.8,   46.8,   46.8 };
+
+    SECTION("A budget in tiles follows the tile size") {
+        unsigned bytes = pool->getMaxBytes();
+        pool->setTileSize(33u);
+        REQUIRE(pool->getMaxEntries() == 4u);
+        REQUIRE(pool->getMaxBytes() > bytes);
+
+        pool->setMaxBytes(bytes);
+        pool->setTileSize(17u);
+        REQUIRE(pool->getMaxBytes() == bytes);
+    }
+
+    SECTION("Least recently used tiles are evicted") {
+        for (unsigned i = 0; i < 6; ++i)
+            REQUIRE(ElevationPoolTests::query(pool, srs, lon[i], lat[i]) != NO_DATA_VALUE);
+
+        ElevationPool::Stats stats = pool->getStats();
+        REQUIRE(stats.misses == 6u);
+        REQUIRE(stats.hits == 0u);
+        REQUIRE(stats.evictions == 2u);
+        REQUIRE(stats.entries == 4u);
+        REQUIRE(stats.bytes == pool->getMaxBytes());
+
+        // Tiles 2-5 are cached. Using tile 2 leaves tile 3 the oldest.
+        ElevationPoolTests::query(pool, srs, lon[2], lat[2]);
+        REQUIRE(pool->getStats().hits == 1u);
+
+        ElevationPoolTests::query(pool, srs, lon[0], lat[0]);
+        stats = pool->getStats();
+        REQUIRE(stats.misses == 7u);
+        REQUIRE(stats.evictions == 3u);
+
+        ElevationPoolTests::query(pool, srs, lon[2], lat[2]);
+        REQUIRE(pool->getStats().hits == 2u);
+
+        ElevationPoolTests::query(pool, srs, lon[3], lat[3]);
+        REQUIRE(pool->getStats().misses == 8u);
+    }
+
+    SECTION("Failed loads are counted apart from hits") {
+        // Nowhere near the data, all the way up to LOD 0:
+        REQUIRE(ElevationPoolTests::query(pool, srs, 100.0, 0.0) == NO_DATA_VALUE);
+        REQUIRE(ElevationPoolTests::query(pool, srs, 100.0, 0.0) == NO_DATA_VALUE);
+
+        ElevationPool::Stats stats = pool->getStats();
+        REQUIRE(stats.misses == 1u);
+        REQUIRE(stats.failures == 1u);
+        REQUIRE(stats.hits == 0u);
+    }
+}
+
+TEST_CASE( "ElevationEnvelope batch queries match single queries" ) {
+
+    osg::ref_ptr<Map> map = ElevationPoolTests::createMap();
+    ElevationPool* pool = map->getElevationPool();
+
+    // Query in the map's SRS, and in one the batch has to transform from.
+    const char* srsNames[2] = { "wgs84", "spherical-mercator" };
+
+    for (unsigned s = 0; s < 2; ++s)
+    {
+        osg::ref_ptr<const SpatialReference> srs = SpatialReference::create(srsNames[s]);
+        REQUIRE(srs.valid());
+
+        std::vector<GeoPoint> points;
+        ElevationPoolTests::createGrid(srs.get(), points);
+
+        std::vector<osg::Vec3d> input;
+        for (unsigned i = 0; i < points.size(); ++i)
+            input.push_back(points[i].vec3d());
+
+        osg::ref_ptr<ElevationEnvelope> batch = pool->createEnvelope(srs.get(), 10u);
+        std::vector<float> elevations;
+        unsigned numValid = batch->getElevations(input, elevations);
+        REQUIRE(elevations.size() == input.size());
+
+        // Reference values from the per-point path, in a separate envelope:
+        osg::ref_ptr<ElevationEnvelope> single = pool->createEnvelope(srs.get(), 10u);
+        unsigned expectedValid = 0u;
+        unsigned mismatches = 0u;
+        float expectedMin = FLT_MAX, expectedMax = -FLT_MAX;
+
+        for (unsigned i = 0; i < input.size(); ++i)
+        {
+            float expected = single->getElevation(input[i].x(), input[i].y());
+            if (expected != NO_DATA_VALUE)
+            {
+                ++expectedValid;
+                expectedMin = osg::minimum(expectedMin, expected);
+                expectedMax = osg::maximum(expectedMax, expected);
+                if (elevations[i] == NO_DATA_VALUE || fabs(elevations[i] - expected) > 1e-5f * osg::maximum(1.0f, (float)fabs(expected)))
+                    ++mismatches;
+            }
+            else if (elevations[i] != NO_DATA_VALUE)
+            {
+                ++mismatches;
+            }
+        }
+
+        REQUIRE(mismatches == 0u);
+        REQUIRE(numValid == expectedValid);
+        REQUIRE(numValid > 0u);
+        REQUIRE(numValid < input.size());
+
+        float min, max;
+        REQUIRE(batch->getElevationExtrema(input, min, max));
+        REQUIRE(min == Approx(expectedMin));
+        REQUIRE(max == Approx(expectedMax));
+    }
+}
+
+TEST_CASE( "ElevationPool answers asynchronous queries" ) {
+
+    osg::ref_ptr<Map> map = ElevationPoolTests::createMap();
+    ElevationPool* pool = map->getElevationPool();
+
+    pool->setNumThreads(3u);
+    REQUIRE(pool->getNumThreads() == 3u);
+
+    SECTION("Batch queries match single queries") {
+        osg::ref_ptr<const SpatialReference> geo  = SpatialReference::create("wgs84");
+        osg::ref_ptr<const SpatialReference> merc = SpatialReference::create("spherical-mercator");
+
+        // Runs of points in two SRS's, enough of them to be split across the threads
+        std::vector<GeoPoint> points;
+        ElevationPoolTests::createGrid(geo.get(), points);
+        ElevationPoolTests::createGrid(merc.get(), points);
+
+        Future<ElevationSamples> future = pool->getElevations(points, 10u);
+        osg::ref_ptr<ElevationSamples> samples = future.get();
+        REQUIRE(samples.valid());
+        REQUIRE(samples->elevations.size() == points.size());
+        REQUIRE(samples->resolutions.size() == points.size());
+
+        unsigned mismatches = 0u;
+        for (unsigned i = 0; i < points.size(); ++i)
+        {
+            osg::ref_ptr<ElevationEnvelope> envelope = pool->createEnvelope(points[i].getSRS(), 10u);
+            float expected = envelope->getElevation(points[i].x(), points[i].y());
+            if (expected == NO_DATA_VALUE ?
+                samples->elevations[i] != NO_DATA_VALUE :
+                fabs(samples->elevations[i] - expected) > 1e-5f * osg::maximum(1.0f, (float)fabs(expected)))
+            {
+                ++mismatches;
+            }
+        }
+        REQUIRE(mismatches == 0u);
+    }
+
+    SECTION("An empty batch resolves") {
+        Future<ElevationSamples> future = pool->getElevations(std::vector<GeoPoint>(), 10u);
+        osg::ref_ptr<ElevationSamples> samples = future.get();
+        REQUIRE(samples.valid());
+        REQUIRE(samples->elevations.empty());
+    }
+
+    SECTION("Concurrent queries for one tile load it once") {
+        osg::ref_ptr<const SpatialReference> geo = SpatialReference::create("wgs84");
+        GeoPoint point(geo.get(), -121.76, 46.85, 0.0, ALTMODE_ABSOLUTE);
+
+        pool->clear();
+        pool->resetStats();
+
+        std::vector< Future<ElevationSample> > futures;
+        for (unsigned i = 0; i < 16; ++i)
+            futures.push_back(pool->getElevation(point, 10u));
+
+        for (unsigned i = 0; i < futures.size(); ++i)
+        {
+            ElevationSample* sample = futures[i].get();
+            REQUIRE(sample != 0L);
+            REQUIRE(sample->elevation != NO_DATA_VALUE);
+        }
+
+        REQUIRE(pool->getStats().misses == 1u);
+    }
+}
+
+TEST_CASE( "Changing the ElevationPool thread count keeps pending queries" ) {
+
+    osg::ref_ptr<ElevationPoolTests::GatedHeights> source = new ElevationPoolTests::GatedHeights();
+    REQUIRE(source->open().isOK());
+
+    ElevationLayerOptions layerOptions("gated");
+    layerOptions.cachePolicy() = CachePolicy::NO_CACHE;
+
+    osg::ref_ptr<Map> map = new Map();
+    map->addLayer(new ElevationLayer(layerOptions, source.get()));
+
+    ElevationPool* pool = map->getElevationPool();
+    pool->setNumThreads(3u);
+
+    // Queries in twelve different tiles; each thread takes one and waits at
+    // the gate while the rest stay queued.
+    osg::ref_ptr<const SpatialReference> geo = SpatialReference::create("wgs84");
+    source->_gate.reset();
+
+    std::vector< Future<ElevationSample> > futures;
+    for (unsigned i = 0; i < 12; ++i)
+    {
+        GeoPoint point(geo.get(), -121.0 + (double)i, 46.0, 0.0, ALTMODE_ABSOLUTE);
+        futures.push_back(pool->getElevation(point, 10u));
+    }
+
+    for (unsigned i = 0; i < 10000u && source->_entered < 3u; ++i)
+        OpenThreads::Thread::microSleep(1000u);
+    bool held = source->_entered == 3u;
+
+    // Change the thread count while the three queries are in progress:
+    ElevationPoolTests::SetNumThreads setter(pool, 1u);
+    setter.start();
+    OpenThreads::Thread::microSleep(100000u);
+    source->_gate.set();
+    setter.join();
+
+    REQUIRE(held);
+    REQUIRE(pool->getNumThreads() == 1u);
+
+    for (unsigned i = 0; i < futures.size(); ++i)
+    {
+        ElevationSample* sample = futures[i].get();
+        REQUIRE(sample != 0L);
+        REQUIRE(sample->elevation == 100.0f);
+    }
+
+    // The new thread takes new queries:
+    GeoPoint point(geo.get(), -121.0, 47.0, 0.0, ALTMODE_ABSOLUTE);
+    Future<ElevationSample> future = pool->getElevation(point, 10u);
+    REQUIRE(future.get() != 0L);
+}
@@ -0,0 +1,285 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarthFeatures/Feature>
+#include <osgEarth/StringUtils>
+#include <osgEarthFeatures/AttributeColumns>
+#include <osgEarthFeatures/CompiledExpression>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+
+TEST_CASE( "Features read attributes from columns like from tables" ) {
+    osg::ref_ptr<AttributeColumns> columns = new AttributeColumns();
+    unsigned name   = columns->addColumn("name",   ATTRTYPE_STRING);
+    unsigned height = columns->addColumn("height", ATTRTYPE_DOUBLE);
+    unsigned floors = columns->addColumn("floors", ATTRTYPE_INT);
+
+    // the same attributes, in columns and in a table:
+    unsigned row = columns->addRow();
+    columns->set(row, name, std::string("tower"));
+    columns->set(row, height, 42.5);
+
+    osg::ref_ptr<Feature> viewed = new Feature(0L, 0L);
+    viewed->setAttributeColumns(columns.get(), row);
+
+    osg::ref_ptr<Feature> stored = new Feature(0L, 0L);
+    stored->set("name", std::string("tower"));
+    stored->set("height", 42.5);
+    stored->setNull("floors", ATTRTYPE_INT);
+
+    REQUIRE(viewed->getString("NAME") == stored->getString("NAME"));
+    REQUIRE(viewed->getDouble("height") == stored->getDouble("height"));
+    REQUIRE(viewed->getString("height") == stored->getString("height"));
+    REQUIRE(viewed->getInt("floors", 7) == stored->getInt("floors", 7));
+    REQUIRE(viewed->isSet("floors") == stored->isSet("floors"));
+    REQUIRE(viewed->hasAttr("floors"));
+    REQUIRE(!viewed->hasAttr("width"));
+    REQUIRE(viewed->getDouble("width", 1.0) == 1.0);
+
+    NumericExpression expr("[height] * 2");
+    REQUIRE(viewed->eval(expr) == 85.0);
+
+    SECTION("Changing an attribute moves the row into the feature") {
+        viewed->set("height", 10.0);
+        REQUIRE(viewed->getAttributeColumns() == 0L);
+        REQUIRE(viewed->getDouble("height") == 10.0);
+        REQUIRE(viewed->getString("name") == "tower");
+        REQUIRE(viewed->getAttrs().size() == 3);
+        REQUIRE(columns->getDouble(row, height) == 42.5);
+    }
+
+    SECTION("Reading attributes leaves them in the columns") {
+        REQUIRE(viewed->getAttrs().empty());
+
+        AttributeValue value;
+        REQUIRE(viewed->getAttr("HEIGHT", value));
+        REQUIRE(value.first == ATTRTYPE_DOUBLE);
+        REQUIRE(value.getDouble() == 42.5);
+        REQUIRE(!viewed->getAttr("width", value));
+
+        AttributeTable viewedAttrs, storedAttrs;
+        viewed->getAttrs(viewedAttrs);
+        stored->getAttrs(storedAttrs);
+        REQUIRE(viewedAttrs.size() == 3);
+        REQUIRE(viewedAttrs.size() == storedAttrs.size());
+        REQUIRE(viewedAttrs["name"].getString() == storedAttrs["name"].getString());
+        REQUIRE(viewedAttrs["floors"].second.set == storedAttrs["floors"].second.set);
+
+        REQUIRE(viewed->getAttributeColumns() == columns.get());
+
+        viewed->detachAttributes();
+        REQUIRE(viewed->getAttributeColumns() == 0L);
+        REQUIRE(viewed->getAttrs().size() == 3);
+        REQUIRE(viewed->getDouble("height") == 42.5);
+    }
+
+    SECTION("Strings are stored once per column") {
+        for(unsigned i = 0; i < 100; ++i)
+            columns->set(columns->addRow(), name, std::string(i%2 ? "house" : "tower"));
+        REQUIRE(columns->getNumStrings(name) == 3); // "", "tower", "house"
+    }
+
+    SECTION("Distinct strings are kept once after loading") {
+        // long, distinct strings, like names or addresses
+        osg::ref_ptr<AttributeColumns> names = new AttributeColumns();
+        unsigned col = names->addColumn("address", ATTRTYPE_STRING);
+        unsigned textBytes = 0u;
+        for(unsigned i = 0; i < 1000; ++i)
+        {
+            std::string address = Stringify() << i << " Some Long Street Name, Some Town, Some Region";
+            names->set(names->addRow(), col, address);
+            textBytes += address.size();
+        }
+        REQUIRE(names->getNumStrings(col) == 1001);
+
+        // while loading, the index holds a second copy of each string
+        REQUIRE(names->getSizeInBytes() > 2u*textBytes);
+
+        names->finishLoading();
+        REQUIRE(names->getSizeInBytes() < 2u*textBytes);
+        REQUIRE(names->getString(7, col) == "7 Some Long Street Name, Some Town, Some Region");
+
+        // writing afterwards still finds the existing strings
+        names->set(names->addRow(), col, std::string("7 Some Long Street Name, Some Town, Some Region"));
+        REQUIRE(names->getNumStrings(col) == 1001);
+    }
+}
+
+namespace FeatureTests
+{
+    // Features with attributes in tables and in columns, with some of the
+    // attributes missing.
+    void createFeatures(FeatureList& features)
+    {
+        osg::ref_ptr<Feature> f;
+
+        f = new Feature(0L, 0L);
+        f->set("name", std::string("tower"));
+        f->set("height", 42.5);
+        f->set("floors", 12);
+        features.push_back(f.get());
+
+        f = new Feature(0L, 0L);
+        f->set("name", std::string("house"));
+        f->set("height", 7.0);
+        features.push_back(f.get());
+
+        features.push_back(new Feature(0L, 0L));
+
+        osg::ref_ptr<AttributeColumns> columns = new AttributeColumns();
+        unsigned name   = columns->addColumn("name",   ATTRTYPE_STRING);
+        unsigned height = columns->addColumn("height", ATTRTYPE_DOUBLE);
+        unsigned floors = columns->addColumn("floors", ATTRTYPE_INT);
+        for (unsigned i = 0; i < 3; ++i)
+        {
+            unsigned row = columns->addRow();
+            columns->set(row, name, std::string(i == 0 ? "shed" : "barn"));
+            columns->set(row, height, 3.25 * (double)(i + 1));
+            if (i != 1)
+                columns->set(row, floors, (int)i + 1);
+
+            f = new Feature(0L, 0L);
+            f->setAttributeColumns(columns.get(), row);
+            features.push_back(f.get());
+        }
+    }
+
+    // Checks that a compiled expression gives what Feature::eval gives, one
+    // feature at a time and over the whole list.
+    void checkNumeric(const NumericExpression& expr, const FeatureList& features)
+    {
+        INFO("expression: " << expr.expr());
+
+        CompiledNumericExpression compiled(expr);
+        std::vector<double> results;
+        compiled.eval(features, results);
+        REQUIRE(results.size() == features.size());
+
+        unsigned n = 0;
+        for (FeatureList::const_iterator i = features.begin(); i != features.end(); ++i, ++n)
+        {
+            NumericExpression copy(expr);
+            double expected = i->get()->eval(copy);
+            REQUIRE(compiled.eval(i->get()) == expected);
+            REQUIRE(results[n] == expected);
+        }
+    }
+
+    void checkString(const StringExpression& expr, const FeatureList& features)
+    {
+        INFO("expression: " << expr.expr());
+
+        CompiledStringExpression compiled(expr);
+        std::vector<std::string> results;
+        compiled.eval(features, results);
+        REQUIRE(results.size() == features.size());
+
+        unsigned n = 0;
+        for (FeatureList::const_iterator i = features.begin(); i != features.end(); ++i, ++n)
+        {
+            StringExpression copy(expr);
+            std::string expected = i->get()->eval(copy);
+            REQUIRE(compiled.eval(i->get()) == expected);
+            REQUIRE(results[n] == expected);
+        }
+    }
+}
+
+TEST_CASE( "Compiled expressions evaluate like Feature::eval" ) {
+    FeatureList features;
+    FeatureTests::createFeatures(features);
+
+    SECTION("Numeric expressions") {
+        const char* exprs[] = {
+            "[height] * 2",
+            "[height] + [floors] * [height] - [height] / 4",  // repeated variables
+            "[HEIGHT] + [Floors]",                             // names in another case
+            "min([height], [floors] * 3) + max(1, [floors])",
+            "max(min([height], 10), [floors]) % 5",
+            "[height] +",                                      // operators missing operands
+            "* [height]",
+            "[height] * + 2",
+            "[missing] + 3",                                   // no such attribute
+            "2 * [missing] - [height]",
+            "17.5",
+            ""
+        };
+        for (unsigned i = 0; i < sizeof(exprs)/sizeof(exprs[0]); ++i)
+            FeatureTests::checkNumeric(NumericExpression(exprs[i]), features);
+    }
+
+    SECTION("Numeric literals") {
+        NumericExpression literal;
+        literal.setLiteral(12.5);
+        FeatureTests::checkNumeric(literal, features);
+
+        // a literal replaces any variables the expression had
+        NumericExpression replaced("[height] * 2");
+        replaced.setLiteral(-3.0);
+        FeatureTests::checkNumeric(replaced, features);
+        REQUIRE(CompiledNumericExpression(replaced).eval(features.front().get()) == -3.0);
+    }
+
+    SECTION("String expressions") {
+        const char* exprs[] = {
+            "[name]",
+            "\"The \" + [name] + \" is \" + [height] + \" high; \" + [name]",  // repeated variable
+            "[NAME] + \" has \" + [floors] + \" floors\"",
+            "[missing] + \"?\"",
+            "\"plain text\"",
+            ""
+        };
+        for (unsigned i = 0; i < sizeof(exprs)/sizeof(exprs[0]); ++i)
+            FeatureTests::checkString(StringExpression(exprs[i]), features);
+    }
+
+    SECTION("String literals") {
+        StringExpression literal;
+        literal.setLiteral("constant");
+        FeatureTests::checkString(literal, features);
+
+        StringExpression replaced("[name]");
+        replaced.setLiteral("constant");
+        FeatureTests::checkString(replaced, features);
+        REQUIRE(CompiledStringExpression(replaced).eval(features.front().get()) == "constant");
+    }
+
+    SECTION("Compiling against a schema") {
+        osg::ref_ptr<const AttributeColumns> columns = features.back()->getAttributeColumns();
+        REQUIRE(columns.valid());
+
+        CompiledNumericExpression compiled(NumericExpression("[height] + [floors] + [missing]"), columns->getSchema());
+        REQUIRE(compiled.getNumSlots() == 3u);
+        REQUIRE(compiled.getSchemaIndex(0) >= 0);
+        REQUIRE(compiled.getSchemaIndex(1) >= 0);
+        REQUIRE(compiled.getSchemaIndex(2) == -1);
+
+        for (FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+        {
+            NumericExpression copy(compiled.getExpression());
+            REQUIRE(compiled.eval(i->get()) == i->get()->eval(copy));
+        }
+    }
+}
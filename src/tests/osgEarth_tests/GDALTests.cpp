@@ -0,0 +1,134 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/ImageLayer>
+#include <osgEarth/ElevationLayer>
+
+#include <osgEarthDrivers/gdal/GDALOptions>
+
+#include <stdlib.h>
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+
+namespace GDALTests
+{
+    GDALOptions gdalOptions(const std::string& url, ElevationInterpolation interp)
+    {
+        GDALOptions opt;
+        opt.url() = url;
+        opt.interpolation() = interp;
+        opt.interpolateImagery() = true;
+        return opt;
+    }
+
+    ImageLayer* openImageLayer(GDALOptions opt, bool windowed)
+    {
+        opt.windowedReads() = windowed;
+        ImageLayerOptions layerOptions("image", opt);
+        layerOptions.cachePolicy() = CachePolicy::NO_CACHE;
+        ImageLayer* layer = new ImageLayer(layerOptions);
+        layer->open();
+        return layer;
+    }
+
+    ElevationLayer* openElevationLayer(GDALOptions opt, bool windowed)
+    {
+        opt.windowedReads() = windowed;
+        ElevationLayerOptions layerOptions("elevation", opt);
+        layerOptions.cachePolicy() = CachePolicy::NO_CACHE;
+        ElevationLayer* layer = new ElevationLayer(layerOptions);
+        layer->open();
+        return layer;
+    }
+}
+
+// These tiles are small enough for the windowed reads to happen at full
+// resolution, where they must agree with the per-sample reads. Both tiles
+// hang over the edge of their dataset, so NO_DATA samples are covered too.
+TEST_CASE( "GDAL windowed reads match per-sample reads" ) {
+
+    ElevationInterpolation modes[3] = { INTERP_NEAREST, INTERP_AVERAGE, INTERP_BILINEAR };
+
+    SECTION("Interpolated imagery") {
+        for (unsigned m = 0; m < 3; ++m)
+        {
+            GDALOptions opt = GDALTests::gdalOptions("../data/boston-inset-wgs84.tif", modes[m]);
+            osg::ref_ptr<ImageLayer> windowed  = GDALTests::openImageLayer(opt, true);
+            osg::ref_ptr<ImageLayer> perSample = GDALTests::openImageLayer(opt, false);
+            REQUIRE(windowed->getStatus().isOK());
+            REQUIRE(perSample->getStatus().isOK());
+
+            TileKey key = windowed->getProfile()->createTileKey(-71.06, 42.35, 8u);
+            GeoImage a = windowed->createImage(key);
+            GeoImage b = perSample->createImage(key);
+            REQUIRE(a.valid());
+            REQUIRE(b.valid());
+            REQUIRE(a.getImage()->getImageSizeInBytes() == b.getImage()->getImageSizeInBytes());
+
+            // Truncating to a byte can differ by one where the rounding does.
+            const unsigned char* pa = a.getImage()->data();
+            const unsigned char* pb = b.getImage()->data();
+            unsigned mismatches = 0u;
+            for (unsigned i = 0; i < a.getImage()->getImageSizeInBytes(); ++i)
+            {
+                if (abs((int)pa[i] - (int)pb[i]) > 1)
+                    ++mismatches;
+            }
+            REQUIRE(mismatches == 0u);
+        }
+    }
+
+    SECTION("Heightfields") {
+        for (unsigned m = 0; m < 3; ++m)
+        {
+            GDALOptions opt = GDALTests::gdalOptions("../data/terrain/mt_rainier_90m.tif", modes[m]);
+            osg::ref_ptr<ElevationLayer> windowed  = GDALTests::openElevationLayer(opt, true);
+            osg::ref_ptr<ElevationLayer> perSample = GDALTests::openElevationLayer(opt, false);
+            REQUIRE(windowed->getStatus().isOK());
+            REQUIRE(perSample->getStatus().isOK());
+
+            TileKey key = windowed->getProfile()->createTileKey(-121.995, 46.5, 11u);
+            GeoHeightField a = windowed->createHeightField(key);
+            GeoHeightField b = perSample->createHeightField(key);
+            REQUIRE(a.valid());
+            REQUIRE(b.valid());
+
+            const osg::HeightField::HeightList& ha = a.getHeightField()->getHeightList();
+            const osg::HeightField::HeightList& hb = b.getHeightField()->getHeightList();
+            REQUIRE(ha.size() == hb.size());
+
+            unsigned mismatches = 0u;
+            for (unsigned i = 0; i < ha.size(); ++i)
+            {
+                bool same = (ha[i] == NO_DATA_VALUE || hb[i] == NO_DATA_VALUE) ?
+                    ha[i] == hb[i] :
+                    fabs(ha[i] - hb[i]) <= 0.001f * osg::maximum(1.0f, (float)fabs(hb[i]));
+                if (!same)
+                    ++mismatches;
+            }
+            REQUIRE(mismatches == 0u);
+        }
+    }
+}
@@ -23,6 +23,9 @@
 #include <osgEarth/catch.hpp>
 
 #include <osgEarth/SpatialReference>
+#include <osgEarth/ECEF>
+
+#include <cfloat>
 
 using namespace osgEarth;
 
@@ -90,3 +93,224 @@ TEST_CASE("Plate Carre SpatialReferences can be created") {
     REQUIRE(!plateCarre->isGeodetic());
     REQUIRE(plateCarre->isProjected());
 }
+
+namespace SpatialReferenceTests
+{
+    // WGS84 defining constants, so the reference values below don't come
+    // from the code under test.
+    const double WGS84_A = 6378137.0;
+    const double WGS84_F = 1.0/298.257223563;
+
+    osg::Vec3d geodeticToECEF(const osg::Vec3d& p)
+    {
+        double e2 = WGS84_F * (2.0 - WGS84_F);
+        double lon = p.x() * osg::PI / 180.0;
+        double lat = p.y() * osg::PI / 180.0;
+        double n = WGS84_A / sqrt(1.0 - e2*sin(lat)*sin(lat));
+        return osg::Vec3d(
+            (n + p.z()) * cos(lat) * cos(lon),
+            (n + p.z()) * cos(lat) * sin(lon),
+            (n*(1.0 - e2) + p.z()) * sin(lat));
+    }
+
+    // Difference between two longitudes in degrees, so that -180 == 180.
+    double lonDelta(double a, double b)
+    {
+        double d = fmod(fabs(a - b), 360.0);
+        return d > 180.0 ? 360.0 - d : d;
+    }
+
+    // Whether two results agree to within "ulps" units in the last place of
+    // the largest coordinate of the results or of the input they came from
+    // (a point that cancels out to near zero still carries the input's error).
+    bool withinUlps(const osg::Vec3d& a, const osg::Vec3d& b, const osg::Vec3d& input, double ulps)
+    {
+        double scale = 0.0;
+        for (unsigned c = 0; c < 3; ++c)
+            scale = osg::maximum(scale, osg::maximum(fabs(input[c]), osg::maximum(fabs(a[c]), fabs(b[c]))));
+
+        double tolerance = ulps * DBL_EPSILON * scale;
+        for (unsigned c = 0; c < 3; ++c)
+            if (fabs(a[c] - b[c]) > tolerance)
+                return false;
+        return true;
+    }
+
+    // Runs one batch conversion with the SIMD code and with the scalar code,
+    // and checks the two agree.
+    template<typename CONVERT>
+    void checkSIMD(const std::vector<osg::Vec3d>& input, CONVERT convert)
+    {
+        std::vector<osg::Vec3d> simd(input), scalar(input);
+
+        ECEF::setUseSIMD(false);
+        convert(&scalar[0], scalar.size());
+        ECEF::setUseSIMD(true);
+        convert(&simd[0], simd.size());
+
+        for (unsigned i = 0; i < input.size(); ++i) {
+            INFO("point " << i << ": " << input[i].x() << ", " << input[i].y() << ", " << input[i].z());
+            REQUIRE(withinUlps(simd[i], scalar[i], input[i], 4.0));
+        }
+    }
+
+    struct GeodeticToECEF {
+        const osg::EllipsoidModel* _em;
+        void operator()(osg::Vec3d* p, unsigned n) const { ECEF::geodeticToECEF(p, n, _em); }
+    };
+
+    struct GeodeticToMercator {
+        void operator()(osg::Vec3d* p, unsigned n) const { ECEF::geodeticToSphericalMercator(p, n); }
+    };
+
+    struct MercatorToGeodetic {
+        void operator()(osg::Vec3d* p, unsigned n) const { ECEF::sphericalMercatorToGeodetic(p, n); }
+    };
+
+    struct Localize {
+        osg::Matrixd _m;
+        void operator()(osg::Vec3d* p, unsigned n) const { ECEF::localize(p, n, _m); }
+    };
+}
+
+TEST_CASE("Batch conversions match reference values") {
+    osg::ref_ptr< const SpatialReference > wgs84 = SpatialReference::create("wgs84");
+    REQUIRE(wgs84.valid());
+
+    std::vector<osg::Vec3d> geodetic;
+    for (double lat = -90.0; lat <= 90.0; lat += 7.5)
+        for (double lon = -180.0; lon <= 180.0; lon += 7.5)
+            geodetic.push_back(osg::Vec3d(lon, lat, lat * 100.0));
+
+    const osg::EllipsoidModel* em = wgs84->getEllipsoid();
+
+    SECTION("geodetic to ECEF and back") {
+        std::vector<osg::Vec3d> ecef(geodetic);
+        ECEF::geodeticToECEF(&ecef[0], ecef.size(), em);
+
+        // a few points whose coordinates are known outright
+        osg::Vec3d known[3] = { osg::Vec3d(0, 0, 0), osg::Vec3d(90, 0, 0), osg::Vec3d(0, 90, 0) };
+        ECEF::geodeticToECEF(known, 3u, em);
+        REQUIRE(known[0].x() == Approx(6378137.0));
+        REQUIRE(known[1].y() == Approx(6378137.0));
+        REQUIRE(known[2].z() == Approx(6356752.314245));
+
+        for (unsigned i = 0; i < geodetic.size(); ++i) {
+            REQUIRE((ecef[i] - SpatialReferenceTests::geodeticToECEF(geodetic[i])).length() < 1e-6);
+        }
+
+        // back to where we started
+        std::vector<osg::Vec3d> back(ecef);
+        ECEF::ECEFToGeodetic(&back[0], back.size(), em);
+
+        // (longitude and height are ill-conditioned right at the poles)
+        for (unsigned i = 0; i < geodetic.size(); ++i) {
+            REQUIRE(fabs(back[i].y() - geodetic[i].y()) < 1e-9);
+            if (fabs(geodetic[i].y()) < 90.0) {
+                REQUIRE(SpatialReferenceTests::lonDelta(back[i].x(), geodetic[i].x()) < 1e-9);
+                REQUIRE(fabs(back[i].z() - geodetic[i].z()) < 1e-6);
+            }
+        }
+    }
+
+    SECTION("geodetic to spherical mercator and back") {
+        // stay inside the square mercator extent
+        std::vector<osg::Vec3d> points;
+        for (unsigned i = 0; i < geodetic.size(); ++i)
+            if (fabs(geodetic[i].y()) < 85.0)
+                points.push_back(geodetic[i]);
+
+        std::vector<osg::Vec3d> merc(points);
+        ECEF::geodeticToSphericalMercator(&merc[0], merc.size());
+
+        for (unsigned i = 0; i < points.size(); ++i) {
+            double lon = points[i].x() * osg::PI / 180.0;
+            double lat = points[i].y() * osg::PI / 180.0;
+            REQUIRE(fabs(merc[i].x() - SpatialReferenceTests::WGS84_A*lon) < 1e-6);
+            REQUIRE(fabs(merc[i].y() - SpatialReferenceTests::WGS84_A*log(tan(osg::PI/4.0 + lat/2.0))) < 1e-6);
+            REQUIRE(merc[i].z() == points[i].z());
+        }
+
+        ECEF::sphericalMercatorToGeodetic(&merc[0], merc.size());
+
+        for (unsigned i = 0; i < points.size(); ++i) {
+            REQUIRE(fabs(merc[i].x() - points[i].x()) < 1e-9);
+            REQUIRE(fabs(merc[i].y() - points[i].y()) < 1e-9);
+        }
+    }
+
+    SECTION("transformToWorld") {
+        std::vector<osg::Vec3d> world(geodetic);
+        REQUIRE(wgs84->transformToWorld(world));
+
+        for (unsigned i = 0; i < geodetic.size(); ++i) {
+            REQUIRE((world[i] - SpatialReferenceTests::geodeticToECEF(geodetic[i])).length() < 1e-6);
+        }
+    }
+
+    SECTION("localize") {
+        std::vector<osg::Vec3d> ecef(geodetic);
+        ECEF::geodeticToECEF(&ecef[0], ecef.size(), em);
+
+        osg::Matrixd local2world, world2local;
+        wgs84->getECEF()->createLocalToWorld(ecef[100], local2world);
+        world2local.invert(local2world);
+
+        std::vector<osg::Vec3d> local(ecef);
+        ECEF::localize(&local[0], local.size(), world2local);
+
+        // the tangent point is the local origin, and a rigid transform
+        // keeps the distances to it
+        REQUIRE(local[100].length() < 1e-6);
+
+        for (unsigned i = 0; i < ecef.size(); ++i) {
+            REQUIRE(fabs(local[i].length() - (ecef[i] - ecef[100]).length()) < 1e-6);
+        }
+    }
+}
+
+TEST_CASE("SIMD batch conversions match the scalar code") {
+    osg::ref_ptr< const SpatialReference > wgs84 = SpatialReference::create("wgs84");
+    REQUIRE(wgs84.valid());
+
+    // an odd number of points, so the leftover point of the two-wide
+    // loops gets converted too; includes the poles and points out of range.
+    std::vector<osg::Vec3d> geodetic;
+    for (double lat = -90.0; lat <= 90.0; lat += 7.5)
+        for (double lon = -180.0; lon <= 180.0; lon += 7.5)
+            geodetic.push_back(osg::Vec3d(lon, lat, lat * 100.0));
+    geodetic.push_back(osg::Vec3d(200.0, -100.0, 0.0));
+    geodetic.push_back(osg::Vec3d(-200.0, 100.0, 0.0));
+    REQUIRE(geodetic.size() % 2u == 1u);
+
+    SECTION("geodetic to ECEF") {
+        SpatialReferenceTests::GeodeticToECEF convert = { wgs84->getEllipsoid() };
+        SpatialReferenceTests::checkSIMD(geodetic, convert);
+    }
+
+    SECTION("geodetic to spherical mercator") {
+        SpatialReferenceTests::checkSIMD(geodetic, SpatialReferenceTests::GeodeticToMercator());
+    }
+
+    SECTION("spherical mercator to geodetic") {
+        std::vector<osg::Vec3d> merc;
+        for (double y = -2.5e7; y <= 2.5e7; y += 1.0e6)
+            for (double x = -2.5e7; x <= 2.5e7; x += 1.0e6)
+                merc.push_back(osg::Vec3d(x, y, 0.0));
+        merc.push_back(osg::Vec3d(0.0, 0.0, 0.0));
+        REQUIRE(merc.size() % 2u == 1u);
+        SpatialReferenceTests::checkSIMD(merc, SpatialReferenceTests::MercatorToGeodetic());
+    }
+
+    SECTION("localize") {
+        std::vector<osg::Vec3d> ecef(geodetic);
+        ECEF::geodeticToECEF(&ecef[0], ecef.size(), wgs84->getEllipsoid());
+
+        osg::Matrixd local2world;
+        wgs84->getECEF()->createLocalToWorld(ecef[100], local2world);
+
+        SpatialReferenceTests::Localize convert;
+        convert._m.invert(local2world);
+        SpatialReferenceTests::checkSIMD(ecef, convert);
+    }
+}
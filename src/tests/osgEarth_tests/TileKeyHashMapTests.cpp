@@ -0,0 +1,211 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/TileKeyHashMap>
+#include <osgEarth/Registry>
+#include <algorithm>
+#include <map>
+
+using namespace osgEarth;
+
+namespace TileKeyHashMapTests
+{
+    // A new map has 16 slots, and keeps them until it holds more than 7 keys.
+    const unsigned SMALL_MASK = 15u;
+
+    // Same home slot as TileKeyHashMap computes, so the tests can pick keys
+    // that collide.
+    unsigned home(const TileKey& key, unsigned mask)
+    {
+        unsigned long long h = TileKeyHashMap<int>::pack(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return (unsigned)h & mask;
+    }
+
+    // Appends "count" LOD 10 keys whose home slot in a 16-slot table is "slot",
+    // skipping any key already in "out".
+    void findKeysAt(unsigned slot, unsigned count, const Profile* profile, std::vector<TileKey>& out)
+    {
+        for (unsigned x = 0u; count > 0u; ++x)
+        {
+            TileKey key(10u, x, 7u, profile);
+            if (home(key, SMALL_MASK) == slot && std::find(out.begin(), out.end(), key) == out.end())
+            {
+                out.push_back(key);
+                --count;
+            }
+        }
+    }
+
+    // Checks the map against a reference map, both by key and by index.
+    void check(const TileKeyHashMap<int>& map, const std::map<TileKey, int>& ref)
+    {
+        REQUIRE(map.size() == ref.size());
+
+        for (std::map<TileKey, int>::const_iterator i = ref.begin(); i != ref.end(); ++i)
+        {
+            const int* value = map.find(i->first);
+            REQUIRE(value != 0L);
+            REQUIRE(*value == i->second);
+        }
+
+        for (unsigned i = 0; i < map.size(); ++i)
+        {
+            std::map<TileKey, int>::const_iterator r = ref.find(map.at(i).first);
+            REQUIRE(r != ref.end());
+            REQUIRE(map.at(i).second == r->second);
+        }
+    }
+}
+
+TEST_CASE("TileKeyHashMap") {
+    const Profile* profile = Registry::instance()->getGlobalGeodeticProfile();
+
+    TileKeyHashMap<int> map;
+    std::map<TileKey, int> ref;
+
+    // A probe chain: three keys that share home slot 5, which end up in
+    // slots 5, 6 and 7, then a key whose home is slot 6, which gets pushed
+    // along to slot 8.
+    std::vector<TileKey> keys;
+    TileKeyHashMapTests::findKeysAt(5u, 3u, profile, keys);
+    TileKeyHashMapTests::findKeysAt(6u, 1u, profile, keys);
+    for (unsigned i = 0; i < keys.size(); ++i)
+    {
+        map[keys[i]] = ref[keys[i]] = 100 + i;
+    }
+
+    SECTION("Colliding keys are all found") {
+        TileKeyHashMapTests::check(map, ref);
+
+        // a key that isn't there, but whose home is in the chain
+        std::vector<TileKey> missing(keys);
+        TileKeyHashMapTests::findKeysAt(5u, 1u, profile, missing);
+        REQUIRE(map.find(missing.back()) == 0L);
+        REQUIRE(map.erase(missing.back()) == false);
+        TileKeyHashMapTests::check(map, ref);
+
+        // inserting an existing key doesn't add it again
+        map[keys[1]] = 42;
+        ref[keys[1]] = 42;
+        TileKeyHashMapTests::check(map, ref);
+    }
+
+    SECTION("Keys that pack to the same bits are kept apart") {
+        // pack() keeps 29 bits of x, so these two share a packed key
+        TileKey a(30u, 1u, 2u, profile);
+        TileKey b(30u, (1u<<29) + 1u, 2u, profile);
+        REQUIRE(TileKeyHashMap<int>::pack(a) == TileKeyHashMap<int>::pack(b));
+
+        map[a] = ref[a] = 1;
+        map[b] = ref[b] = 2;
+        TileKeyHashMapTests::check(map, ref);
+
+        REQUIRE(map.erase(a));
+        ref.erase(a);
+        REQUIRE(map.find(a) == 0L);
+        TileKeyHashMapTests::check(map, ref);
+    }
+
+    SECTION("Erasing from the middle of a probe chain keeps the rest reachable") {
+        // the middle of the chain; the keys after it shift back
+        REQUIRE(map.erase(keys[1]));
+        ref.erase(keys[1]);
+        REQUIRE(map.find(keys[1]) == 0L);
+        TileKeyHashMapTests::check(map, ref);
+
+        // the head of the chain
+        REQUIRE(map.erase(keys[0]));
+        ref.erase(keys[0]);
+        REQUIRE(map.find(keys[0]) == 0L);
+        TileKeyHashMapTests::check(map, ref);
+
+        // the key pushed out of its home slot by the chain
+        REQUIRE(map.erase(keys[3]));
+        ref.erase(keys[3]);
+        TileKeyHashMapTests::check(map, ref);
+
+        REQUIRE(map.erase(keys[3]) == false);
+
+        // put them back
+        map[keys[3]] = ref[keys[3]] = 3;
+        map[keys[0]] = ref[keys[0]] = 0;
+        map[keys[1]] = ref[keys[1]] = 1;
+        TileKeyHashMapTests::check(map, ref);
+
+        // and empty it
+        for (unsigned i = 0; i < keys.size(); ++i)
+            REQUIRE(map.erase(keys[i]));
+        REQUIRE(map.empty());
+        REQUIRE(map.find(keys[0]) == 0L);
+    }
+
+    SECTION("The map grows and shrinks") {
+        // enough keys to rehash many times; the rehash moves every key
+        // to a new slot, so the probe chains change underneath
+        for (unsigned x = 0; x < 64u; ++x)
+            for (unsigned y = 0; y < 64u; ++y)
+            {
+                TileKey key(12u, x, y, profile);
+                map[key] = ref[key] = (int)(x*64u + y);
+            }
+        TileKeyHashMapTests::check(map, ref);
+
+        // erase every other key, then insert a different set over the holes
+        for (unsigned x = 0; x < 64u; ++x)
+            for (unsigned y = (x & 1u); y < 64u; y += 2u)
+            {
+                TileKey key(12u, x, y, profile);
+                REQUIRE(map.erase(key));
+                ref.erase(key);
+            }
+        TileKeyHashMapTests::check(map, ref);
+
+        for (unsigned x = 0; x < 32u; ++x)
+            for (unsigned y = 0; y < 32u; ++y)
+            {
+                TileKey key(11u, x, y, profile);
+                map[key] = ref[key] = -(int)(x*32u + y);
+            }
+        TileKeyHashMapTests::check(map, ref);
+
+        map.clear();
+        REQUIRE(map.empty());
+        REQUIRE(map.find(keys[0]) == 0L);
+
+        // reserve, then fill without a rehash
+        map.reserve(1000u);
+        ref.clear();
+        for (unsigned i = 0; i < 1000u; ++i)
+        {
+            TileKey key(14u, i, i, profile);
+            map[key] = ref[key] = (int)i;
+        }
+        TileKeyHashMapTests::check(map, ref);
+    }
+}